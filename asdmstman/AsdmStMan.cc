@@ -50,8 +50,7 @@ namespace casa {
   : DataManager    (),
     itsDataManName (dataManName),
     itsBDF         (0),
-    itsOpenBDF     (-1),
-    itsNBl(0)
+    itsOpenBDF     (-1)
   {}
 
   AsdmStMan::AsdmStMan (const String& dataManName,
@@ -59,16 +58,14 @@ namespace casa {
   : DataManager    (),
     itsDataManName (dataManName),
     itsBDF         (0),
-    itsOpenBDF     (-1),
-    itsNBl(0)
+    itsOpenBDF     (-1)
   {}
 
   AsdmStMan::AsdmStMan (const AsdmStMan& that)
   : DataManager    (),
     itsDataManName (that.itsDataManName),
     itsBDF         (0),
-    itsOpenBDF     (-1),
-    itsNBl(0)
+    itsOpenBDF     (-1)
   {}
 
   AsdmStMan::~AsdmStMan()
@@ -240,13 +237,12 @@ namespace casa {
     for (uInt i=0; i<itsIndex.size(); ++i) {
       itsIndexRows[i] = itsIndex[i].row;
     }
+    makeRowIndex();
     // Fill the specification record (only used for reporting purposes).
     itsSpec.define ("version", itsVersion);
     itsSpec.define ("bigEndian", asBigEndian);
     itsSpec.define ("BDFs", Vector<String>(itsBDFNames));
     // Set to nothing read yet.
-    itsStartRow   = -1;
-    itsEndRow     = -1;
     itsIndexEntry = 0;
 
     if(itsIndex.size()>0){
@@ -274,8 +270,65 @@ namespace casa {
 
   }
 
+  void AsdmStMan::makeRowIndex()
+  {
+    itsRowStride = 0;
+    itsEntryTranspose.assign (itsIndex.size(), 0);
+    itsTransposeBLNum.clear();
+    if (itsIndex.empty()) {
+      return;
+    }
+    // If the entries follow each other with the same number of rows, the
+    // entry of a row is found by a division.
+    Int64 stride = itsIndexRows.size() > 1  ?  itsIndexRows[1] : 0;
+    map<uInt, uInt> transposeNr;
+    for (uInt i=0; i<itsIndex.size(); ++i) {
+      const AsdmIndex& ix = itsIndex[i];
+      if (itsIndexRows[i] != i*stride) {
+	stride = 0;
+      }
+      // Correlator data need the baseline numbers transposed.
+      if (ix.dataType != 10) {
+	map<uInt, uInt>::const_iterator iter = transposeNr.find (ix.nBl);
+	if (iter == transposeNr.end()) {
+	  iter = transposeNr.insert (make_pair(ix.nBl,
+					       uInt(itsTransposeBLNum.size()))).first;
+	  itsTransposeBLNum.push_back (vector<uInt>());
+	  makeTransposeBLNum (ix.nBl, itsTransposeBLNum.back());
+	}
+	itsEntryTranspose[i] = iter->second;
+      }
+    }
+    itsRowStride = stride;
+  }
+
+  Bool AsdmStMan::isIndexEntry (uInt entry, Int64 rownr) const
+  {
+    // Same result as the binary search: the first entry starting at the
+    // row, otherwise the last entry starting before it.
+    if (itsIndexRows[entry] == rownr) {
+      return entry == 0  ||  itsIndexRows[entry-1] < rownr;
+    }
+    return itsIndexRows[entry] < rownr
+      &&  (entry+1 == itsIndexRows.size()  ||  itsIndexRows[entry+1] > rownr);
+  }
+
   uInt AsdmStMan::searchIndex (Int64 rownr)
   {
+    const uInt nentry = itsIndexRows.size();
+    if (rownr >= 0) {
+      if (itsRowStride > 0) {
+	return std::min(Int64(nentry-1), rownr/itsRowStride);
+      }
+      // Rows are mostly read in order, so try the current entry and the
+      // next one before searching.
+      if (itsIndexEntry < nentry  &&  isIndexEntry (itsIndexEntry, rownr)) {
+	return itsIndexEntry;
+      }
+      if (itsIndexEntry+1 < nentry  &&  isIndexEntry (itsIndexEntry+1, rownr)) {
+	return itsIndexEntry+1;
+      }
+    }
     // Search index entry matching this rownr.
     // If not exactly found, it is previous one.
     ///  vector<uInt>::const_iterator low = std::lower_bound (itsIndexRows.begin(),
@@ -299,16 +352,7 @@ namespace casa {
 
   const AsdmIndex& AsdmStMan::findIndex (Int64 rownr)
   {
-    // Only get if not current.
-    if (rownr < itsStartRow  ||  rownr >= itsEndRow) {
-      itsIndexEntry = searchIndex (rownr);
-      const AsdmIndex& ix = itsIndex[itsIndexEntry];
-      // Resize to indicate not read yet.
-      // Note that reserved size stays the same, so no extra mallocs needed.
-      // itsData.resize (0);  commented out by Michel Caillat 03 Dec 2012
-      itsStartRow = ix.row;
-      itsEndRow   = ix.row + ix.nrow();
-    }
+    itsIndexEntry = searchIndex (rownr);
     return itsIndex[itsIndexEntry];
   }
 
@@ -481,11 +525,6 @@ namespace casa {
   {
     const AsdmIndex& ix = findIndex (rownr);
   
-    // If we are in front of Correlator data, do we have to update the baseline numbers tranposition ?
-    if (ix.dataType != 10)
-      if (ix.nBl != itsNBl)
-	setTransposeBLNum(ix.nBl);
-  
     // Open the BDF if needed.
     if (Int(ix.fileNr) != itsOpenBDF) {
       closeBDF();
@@ -517,9 +556,8 @@ namespace casa {
     //
     // Attention !!! If we are in front of Correlator data we must apply the transposition function
     uInt bl;
-    //cerr << "shape0 "<< itsTransposeBLNum_v.size() << endl; 
     if (ix.dataType != 10 ) 
-      bl = itsTransposeBLNum_v[rownr - ix.row];
+      bl = itsTransposeBLNum[itsEntryTranspose[itsIndexEntry]][rownr - ix.row];
     else
       bl = (rownr - ix.row);
 
@@ -568,14 +606,14 @@ namespace casa {
   
   }
 
-  void AsdmStMan::setTransposeBLNum(uInt nBl) {
+  void AsdmStMan::makeTransposeBLNum(uInt nBl, vector<uInt>& transposeBLNum) {
     
-    itsTransposeBLNum_v.clear();
+    transposeBLNum.clear();
 
     // Deduce the number of antennas from the number of baselines
     uInt numAnt = (uInt) (floor((1 + sqrt(1 + 8*nBl)) / 2 + 0.5));
 
-    //cerr << "AsdmStMan::setTransposeBLNum, numAnt=" << numAnt << endl;
+    //cerr << "AsdmStMan::makeTransposeBLNum, numAnt=" << numAnt << endl;
     
     uInt blNum = 0;
     map<uInt, map<uInt, uInt> > _mm;
@@ -590,9 +628,7 @@ namespace casa {
 
     for (uInt i1 = 0; i1 < numAnt; i1++)
       for (uInt i2 = i1+1; i2 < numAnt; i2++)
-	itsTransposeBLNum_v.push_back(_mm[i2][i1]);
-
-    itsNBl = nBl;
+	transposeBLNum.push_back(_mm[i2][i1]);
   }
   
 } //# end namespace
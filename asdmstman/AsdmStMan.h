@@ -267,6 +267,14 @@ private:
   // Close the currently open BDF file.
   void closeBDF();
 
+  // Determine if the index entries are equally long and fill the baseline
+  // transpositions used by the entries, so that finding the data of a row
+  // does not depend on the order in which rows are accessed.
+  void makeRowIndex();
+
+  // Is the entry the one the binary search of searchIndex finds for the row?
+  Bool isIndexEntry (uInt entry, Int64 rownr) const;
+
   // Return the entry number in the index containing the row.
   uInt searchIndex (Int64 rownr);
 
@@ -283,8 +291,8 @@ private:
   // </group>
 
 
-  // set transposeBLNum_v
-  void setTransposeBLNum(uInt nBl);
+  // Fill the transposition of the baseline numbers for nBl baselines.
+  static void makeTransposeBLNum(uInt nBl, vector<uInt>& transposeBLNum);
 
   //# Declare member variables.
   // Name of data manager.
@@ -299,16 +307,14 @@ private:
   Bool   itsDoSwap;       //# True = byte-swapping is needed
   Record itsSpec;         //# Data manager properties
   uInt   itsVersion;      //# Version of AsdmStMan MeasurementSet
-  //# Fields to keep track of last block accessed.
-  Int64  itsStartRow;     //# First row of data block
-  Int64  itsEndRow;       //# First row of next data block
   uInt   itsIndexEntry;   //# Index entry number of current data block
   vector<char>      itsData;
   vector<AsdmIndex> itsIndex;
   vector<Int64>     itsIndexRows;
-
-  uInt              itsNBl;
-  vector<uInt>      itsTransposeBLNum_v;
+  //# Lookup filled by makeRowIndex.
+  Int64                 itsRowStride;       //# Rows per entry if all equal
+  vector<uInt>          itsEntryTranspose;  //# Transposition used by each entry
+  vector<vector<uInt> > itsTransposeBLNum;  //# Transpositions per nBl
 };
 
 
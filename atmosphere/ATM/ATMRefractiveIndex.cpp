@@ -296,6 +296,27 @@ ATM_NAMESPACE_BEGIN
 
   }
 
+  RefractiveIndex::LineParameters& RefractiveIndex::lineParameters(unsigned int site, unsigned int nlines,
+								  double temp, double pr, double eh2o){
+
+    if(v_lineParameters_.size() <= site) v_lineParameters_.resize(site+1);
+    LineParameters& lp = v_lineParameters_[site];
+    if(lp.done.size() != nlines){
+      lp.width.resize(nlines);
+      lp.interf.resize(nlines);
+      lp.boltzmann.resize(nlines);
+      lp.stimulated.resize(nlines);
+      lp.done.assign(nlines, false);
+    }else if(lp.temperature != temp || lp.pressure != pr || lp.wvpressure != eh2o){
+      lp.done.assign(nlines, false);
+    }
+    lp.temperature = temp;
+    lp.pressure = pr;
+    lp.wvpressure = eh2o;
+    return lp;
+
+  }
+
   ////////////////////////////////////////////////////////////////////////////////
   //   ATM    1: 16o16o      7: no2        13: hh18o          19: 16o16o16o_v3  //
   // opacity  2: 16o16o_vib  8: so2        14: hh17o          20: 16o16o18o     //
@@ -715,11 +736,17 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(8,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -928,11 +955,17 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(7,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -1346,11 +1379,17 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(6,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -1731,11 +1770,17 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(5,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -2764,11 +2809,18 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(12,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening_water(fre[i],tt,pp,eh2o,ensanche[i][0],ensanche[i][1],ensanche[i][2],ensanche[i][3]),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening_water(fre[i],tt,pp,eh2o,ensanche[i][0],ensanche[i][1],ensanche[i][2],ensanche[i][3]);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*gl[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*gl[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -3958,13 +4010,20 @@ ATM_NAMESPACE_BEGIN
       //      cout << "nu=" << nu << " GHz: including lines from " << fre[ini] << " GHz to " << fre[ifin] << " GHz" << endl;
 
 
+      LineParameters& lp=lineParameters(11,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
       for(unsigned int i=ini; i<ifin+1; i++){
 
 	//  	for(unsigned int i=0; i<522; i++){
 
-	lshape=lineshape(nu,fre[i],linebroadening_water(fre[i],tt,pp,eh2o,ensanche[i][0],ensanche[i][1],ensanche[i][2],ensanche[i][3]),0.0);
+	if(!lp.done[i]){
+	  lp.width[i]=linebroadening_water(fre[i],tt,pp,eh2o,ensanche[i][0],ensanche[i][1],ensanche[i][2],ensanche[i][3]);
+	  lp.boltzmann[i]=exp(-el[i]/tt);
+	  lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	  lp.done[i]=true;
+	}
+	lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	lshape=lshape*flin[i]*gl[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	lshape=lshape*flin[i]*gl[i]*lp.boltzmann[i]*lp.stimulated[i];
 
 	lshapeacum=lshapeacum+lshape;
 
@@ -4381,11 +4440,18 @@ ATM_NAMESPACE_BEGIN
 
       }else{
 
+	LineParameters& lp=lineParameters(14,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening_hh18o_hh17o(tt,pp,eh2o,dv0[i],dvlm[i],temp_exp[i]),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening_hh18o_hh17o(tt,pp,eh2o,dv0[i],dvlm[i],temp_exp[i]);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*gl[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*gl[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -5131,11 +5197,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_hdo(double tt, double p
 
       }else{
 
+	LineParameters& lp=lineParameters(15,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini1; i<ifin1+1; i++){
 
-	  lshape=lineshape(nu,fre[i],0.003*pp*pow((300/tt),0.7),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=0.003*pp*pow((300/tt),0.7);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum1=lshapeacum1+lshape;
 
@@ -5152,11 +5225,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_hdo(double tt, double p
 
       }else{
 
+	LineParameters& lp=lineParameters(24,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini2; i<ifin2+1; i++){
 
-	  lshape=lineshape(nu,fre[i],0.003*pp,0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=0.003*pp;
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum2=lshapeacum2+lshape;
 
@@ -5571,11 +5651,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_hdo(double tt, double p
 
       }else{
 
+	LineParameters& lp=lineParameters(13,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening_hh18o_hh17o(tt,pp,eh2o,dv0[i],dvlm[i],temp_exp[i]),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening_hh18o_hh17o(tt,pp,eh2o,dv0[i],dvlm[i],temp_exp[i]);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*gl[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*gl[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -5614,11 +5701,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_hdo(double tt, double p
 
     if(nu>999.9){return complex<double> (0.0,0.0);}
 
+    LineParameters& lp=lineParameters(2,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
     for(unsigned int i=0; i<6; i++){
 
-      lshape=lineshape(nu,fre[i], linebroadening_o2(fre[i],tt,pp,eh2o,32.0,dv0,0.2),0.0);
+      if(!lp.done[i]){
+        lp.width[i]=linebroadening_o2(fre[i],tt,pp,eh2o,32.0,dv0,0.2);
+        lp.boltzmann[i]=exp(-el[i]/tt);
+        lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+        lp.done[i]=true;
+      }
+      lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-      lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+      lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
       lshapeacum=lshapeacum+lshape;
 
@@ -5663,11 +5757,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_hdo(double tt, double p
 
     if(nu>999.9){return complex<double> (0.0,0.0);}
 
+    LineParameters& lp=lineParameters(4,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
     for(unsigned int i=0; i<14; i++){
 
-      lshape=lineshape(nu,fre[i],linebroadening_o2(fre[i],tt,pp,eh2o,33.0,dv0,0.2),0.0);
+      if(!lp.done[i]){
+        lp.width[i]=linebroadening_o2(fre[i],tt,pp,eh2o,33.0,dv0,0.2);
+        lp.boltzmann[i]=exp(-el[i]/tt);
+        lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+        lp.done[i]=true;
+      }
+      lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-      lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+      lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
       lshapeacum=lshapeacum+lshape;
 
@@ -5712,11 +5813,18 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
     if(nu>999.9){return complex<double> (0.0,0.0);}
 
+    LineParameters& lp=lineParameters(3,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
     for(unsigned int i=0; i<15; i++){
 
-      lshape=lineshape(nu,fre[i], linebroadening_o2(fre[i],tt,pp,eh2o,34.0,dv0,0.2),0.0);
+      if(!lp.done[i]){
+        lp.width[i]=linebroadening_o2(fre[i],tt,pp,eh2o,34.0,dv0,0.2);
+        lp.boltzmann[i]=exp(-el[i]/tt);
+        lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+        lp.done[i]=true;
+      }
+      lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-      lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+      lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
       lshapeacum=lshapeacum+lshape;
 
@@ -6380,13 +6488,19 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
 	//	cout << "ini ifin nu " << ini << " " << ifin << " " << nu << " GHz" << endl;
 
+	LineParameters& lp=lineParameters(1,sizeof(fre)/sizeof(fre[0]),tt,pp,eh2o);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],
-			   linebroadening_o2(fre[i],tt,pp,eh2o,32.0,ensanche[i][0],ensanche[i][1]),
-			   interf_o2(tt,pp,ensanche[i][2],ensanche[i][3]));
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening_o2(fre[i],tt,pp,eh2o,32.0,ensanche[i][0],ensanche[i][1]);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.stimulated[i]=(1-exp(-0.047992745509*fre[i]/tt));
+	    lp.interf[i]=interf_o2(tt,pp,ensanche[i][2],ensanche[i][3]);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],lp.interf[i]);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*(1-exp(-0.047992745509*fre[i]/tt));
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*lp.stimulated[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -6803,11 +6917,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 	
       }else{
 	
+	LineParameters& lp=lineParameters(18,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 	  
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 	  
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 	  
           lshapeacum=lshapeacum+lshape;
 	  
@@ -7244,11 +7364,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 	
       }else{
 	
+	LineParameters& lp=lineParameters(19,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 	  
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 	  
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 	  
           lshapeacum=lshapeacum+lshape;
 	  
@@ -7615,11 +7741,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(17,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -8816,11 +8948,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(16,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -9901,11 +10039,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(20,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -10983,11 +11127,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(21,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -11755,11 +11905,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(22,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -12408,11 +12564,17 @@ complex<double>  RefractiveIndex::mkSpecificRefractivity_16o18o(double tt, doubl
 
       }else{
 
+	LineParameters& lp=lineParameters(23,sizeof(fre)/sizeof(fre[0]),tt,pp,0.0);
 	for(unsigned int i=ini; i<ifin+1; i++){
 
-	  lshape=lineshape(nu,fre[i],linebroadening(fre[i],tt,pp,mmol,0.0025,0.76),0.0);
+	  if(!lp.done[i]){
+	    lp.width[i]=linebroadening(fre[i],tt,pp,mmol,0.0025,0.76);
+	    lp.boltzmann[i]=exp(-el[i]/tt);
+	    lp.done[i]=true;
+	  }
+	  lshape=lineshape(nu,fre[i],lp.width[i],0.0);
 
-	  lshape=lshape*flin[i]*exp(-el[i]/tt)*fre[i];
+	  lshape=lshape*flin[i]*lp.boltzmann[i]*fre[i];
 
           lshapeacum=lshapeacum+lshape;
 
@@ -31,6 +31,7 @@
 
 #include "ATMCommon.h"
 #include <complex>
+#include <vector>
 
 using namespace std;
 
@@ -982,6 +983,34 @@ private:
                             double linebroad,
                             double interf);
 
+  /** Frequency independent parameters of the lines of one opacity source: the
+      line widths (and O2 interference terms), Boltzmann factors and stimulated
+      emission terms at one temperature, pressure and water vapor pressure. They
+      are filled line by line as the lines are first needed, and kept until the
+      source is evaluated for another layer, so that the channels evaluated one
+      after the other for the same layer work them out only once. */
+  struct LineParameters {
+    double temperature;
+    double pressure;
+    double wvpressure;
+    std::vector<double> width;
+    std::vector<double> interf;
+    std::vector<double> boltzmann;
+    std::vector<double> stimulated;
+    std::vector<bool> done;
+  };
+
+  /** The line parameters of source <b>site</b> (the species number, or 24 for
+      the second band of HDO lines) with <b>nlines</b> lines for the given layer,
+      emptied if they were for another layer. */
+  LineParameters& lineParameters(unsigned int site,
+                                 unsigned int nlines,
+                                 double temperature,
+                                 double pressure,
+                                 double wvpressure);
+
+  std::vector<LineParameters> v_lineParameters_;
+
 }; // class RefractiveIndex
 
 ATM_NAMESPACE_END
@@ -290,19 +290,9 @@ void RefractiveIndexProfile::mkRefractiveIndexProfile()
   //    static const double abun_D=0.000298444;
   //    static const double o2_mixing_ratio=0.2092;
   //    static const double mmol_h2o=18.005059688;  //   20*0.0020439+19*(0.0003750+2*0.000298444)+18*(1-0.0020439-0.0003750-2*0.000298444)
-  static const double pi = 3.141592654;
 
   static bool first = true;
 
-  double abun_O3, abun_CO, abun_N2O, abun_NO2, abun_SO2;
-  double wvt, wv, t;
-  double nu, nu2, nu_pi; 
-  // double width;s
-  // unsigned int npoints;
-  RefractiveIndex atm;
-  //    double sumAbsO3Lines1, sumAbsCOLines1, sumAbsN2OLines1, sumAbsNO2Lines1, sumAbsSO2Lines1; 
-
-
   //TODO we will have to put numLayer_ and v_chanFreq_.size() const
   //we do not want to resize! ==> pas de setter pour SpectralGrid
 
@@ -322,16 +312,6 @@ void RefractiveIndexProfile::mkRefractiveIndexProfile()
     rmRefractiveIndexProfile(); // delete all the layer profiles for all the frequencies
   }
 
-  vector<complex<double> >* v_N_H2OLinesPtr;
-  vector<complex<double> >* v_N_H2OContPtr;
-  vector<complex<double> >* v_N_O2LinesPtr;
-  vector<complex<double> >* v_N_DryContPtr;
-  vector<complex<double> >* v_N_O3LinesPtr;
-  vector<complex<double> >* v_N_COLinesPtr;
-  vector<complex<double> >* v_N_N2OLinesPtr;
-  vector<complex<double> >* v_N_NO2LinesPtr;
-  vector<complex<double> >* v_N_SO2LinesPtr;
-
   // cout << "v_chanFreq_.size()=" << v_chanFreq_.size() << endl;
   // cout << "numLayer_=" << numLayer_ << endl;
   // cout << "v_chanFreq_[0]=" << v_chanFreq_[0] << endl;
@@ -340,31 +320,68 @@ void RefractiveIndexProfile::mkRefractiveIndexProfile()
   /*  cout << "vv_N_H2OLinesPtr_.size()="<<vv_N_H2OLinesPtr_.size()<<endl; */
   ncmin = vv_N_H2OLinesPtr_.size(); // will be > 0 if spectral window(s) have been added
   if(newBasicParam_) ncmin = 0;
+  const unsigned int nchan = v_chanFreq_.size();
 
   //    cout << "ncmin=" << ncmin << endl;
 
-  for(unsigned int nc = ncmin; nc < v_chanFreq_.size(); nc++) {
-
-    v_N_H2OLinesPtr = new vector<complex<double> > ;
-    v_N_H2OContPtr = new vector<complex<double> > ;
-    v_N_O2LinesPtr = new vector<complex<double> > ;
-    v_N_DryContPtr = new vector<complex<double> > ;
-    v_N_O3LinesPtr = new vector<complex<double> > ;
-    v_N_COLinesPtr = new vector<complex<double> > ;
-    v_N_N2OLinesPtr = new vector<complex<double> > ;
-    v_N_NO2LinesPtr = new vector<complex<double> > ;
-    v_N_SO2LinesPtr = new vector<complex<double> > ;
-    v_N_H2OLinesPtr->reserve(numLayer_);
-    v_N_H2OContPtr->reserve(numLayer_);
-    v_N_O2LinesPtr->reserve(numLayer_);
-    v_N_DryContPtr->reserve(numLayer_);
-    v_N_O3LinesPtr->reserve(numLayer_);
-    v_N_COLinesPtr->reserve(numLayer_);
-    v_N_N2OLinesPtr->reserve(numLayer_);
-    v_N_NO2LinesPtr->reserve(numLayer_);
-    v_N_SO2LinesPtr->reserve(numLayer_);
+  if(vv_N_H2OLinesPtr_.size() == 0) first = true;
+
+  // Make room for the new channels first so that the channel loop below
+  // only ever writes its own slot and can run in parallel.
+  if(vv_N_H2OLinesPtr_.size() < nchan) {
+    vv_N_H2OLinesPtr_.resize(nchan, 0);
+    vv_N_H2OContPtr_.resize(nchan, 0);
+    vv_N_O2LinesPtr_.resize(nchan, 0);
+    vv_N_DryContPtr_.resize(nchan, 0);
+    vv_N_O3LinesPtr_.resize(nchan, 0);
+    vv_N_COLinesPtr_.resize(nchan, 0);
+    vv_N_N2OLinesPtr_.resize(nchan, 0);
+    vv_N_NO2LinesPtr_.resize(nchan, 0);
+    vv_N_SO2LinesPtr_.resize(nchan, 0);
+  }
+
+  // The layer quantities do not depend on frequency: work them out once
+  // rather than once per channel.
+  vector<double> v_wvt(numLayer_);
+  for(unsigned int j = 0; j < numLayer_; j++) {
+    double wv = v_layerWaterVapor_[j] * 1000.0; // se multiplica por 10**3 por cuestión de unidades en las rutinas fortran.
+    v_wvt[j] = wv * v_layerTemperature_[j] / 217.0; // v_layerWaterVapor_[j] está en kg/m**3
+  }
+
+  // The channels are independent, so the (expensive) line sums are spread
+  // over blocks of channels.  Within a block the layers are taken one after
+  // the other, so that each RefractiveIndex works out the frequency
+  // independent line parameters of a layer once for all the channels of the
+  // block; each thread has its own RefractiveIndex.
+  static const int chanBlock = 64;
+  const int ncfirst = ncmin;
+  const int nclast = nchan;
+  const int nblock = (nclast - ncfirst + chanBlock - 1) / chanBlock;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+  RefractiveIndex atm;
 
-    nu = 1.0E-9 * v_chanFreq_[nc]; // ATM uses GHz units
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+  for(int b = 0; b < nblock; b++) {
+
+    const int ncbeg = ncfirst + b * chanBlock;
+    const int ncend = min(nclast, ncbeg + chanBlock);
+
+    for(int nc = ncbeg; nc < ncend; nc++) {
+      vv_N_H2OLinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_H2OContPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_O2LinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_DryContPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_O3LinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_COLinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_N2OLinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_NO2LinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+      vv_N_SO2LinesPtr_[nc] = new vector<complex<double> >(numLayer_);
+    }
 
     // cout << "freq. points =" << v_chanFreq_.size() << endl;
 
@@ -392,137 +409,68 @@ void RefractiveIndexProfile::mkRefractiveIndexProfile()
 
     */
 
-
-
-    // cout << "nc =" << nc << " nu=" << nu << " width=" << width << " GHz    npoints=" << npoints << endl;
-
-    nu2 = nu * nu;
-    nu_pi = nu / pi;
-
     for(unsigned int j = 0; j < numLayer_; j++) {
 
-      wv = v_layerWaterVapor_[j] * 1000.0; // se multiplica por 10**3 por cuestión de unidades en las rutinas fortran.
-      wvt = wv * v_layerTemperature_[j] / 217.0; // v_layerWaterVapor_[j] está en kg/m**3
-      t = v_layerTemperature_[j] / 300.0;
-
-
-      // cout <<"ATMRefractiveIndexProfile: " << v_layerTemperature_[j] << " K " << v_layerPressure_[j] << " mb "  << nu << " GHz " << endl;
-      // cout <<"ATMRefractiveIndexProfile: O2" <<  atm.getRefractivity_o2(v_layerTemperature_[j],v_layerPressure_[j],wvt,nu) << endl;
-      // cout << "ATMRefractiveIndexProfile: O2" << atm.getRefractivity_o2(v_layerTemperature_[j],v_layerPressure_[j],wvt,nu,width,npoints) << endl;
-      // cout << "ATMRefractiveIndexProfile: H2O" << atm.getRefractivity_h2o(v_layerTemperature_[j],v_layerPressure_[j],wvt,nu) << endl;
-      // cout << "ATMRefractiveIndexProfile: H2O" << atm.getRefractivity_h2o(v_layerTemperature_[j],v_layerPressure_[j],wvt,nu,width,npoints) << endl;
-      // cout <<"ATMRefractiveIndexProfile: O3" <<  atm.getRefractivity_o3(v_layerTemperature_[j],v_layerPressure_[j],nu,v_layerO3_[j]) << endl;
-      // cout << "ATMRefractiveIndexProfile: O3" << atm.getRefractivity_o3(v_layerTemperature_[j],v_layerPressure_[j],nu,width,npoints,v_layerO3_[j]) << endl;      
-      // cout <<"ATMRefractiveIndexProfile: CO" <<  atm.getSpecificRefractivity_co(v_layerTemperature_[j],v_layerPressure_[j],nu) << endl;
-      // cout << "ATMRefractiveIndexProfile: CO" << atm.getSpecificRefractivity_co(v_layerTemperature_[j],v_layerPressure_[j],nu,width,npoints) << endl;
-
-      v_N_O2LinesPtr->push_back(atm.getRefractivity_o2(v_layerTemperature_[j],
-                                                       v_layerPressure_[j],
-                                                       wvt,
-                                                       nu));     // ,width,npoints)); TO BE IMPLEMENTED IN NEXT RELEASE
-
-      complex<double> cont_h2o =
-        atm.getSpecificRefractivity_cnth2o(v_layerTemperature_[j],
-                                           v_layerPressure_[j],
-                                           wvt,
-                                           nu);                   // ,width,npoints); TO BE IMPLEMENTED IN NEXT RELEASE
-      complex<double> cont_dry =
-          atm.getSpecificRefractivity_cntdry(v_layerTemperature_[j],
-                                             v_layerPressure_[j],
-                                             wvt,
-                                             nu);                  // ,width,npoints); TO BE IMPLEMENTED IN NEXT RELEASE
-
-      v_N_H2OContPtr->push_back(cont_h2o);
-      v_N_DryContPtr->push_back(cont_dry);
-
-      if(v_layerWaterVapor_[j] > 0) {
-
-        v_N_H2OLinesPtr->push_back(atm.getRefractivity_h2o(v_layerTemperature_[j],
-                                                           v_layerPressure_[j],
-                                                           wvt,
-                                                           nu)); // ,width,npoints)); TO BE IMPLEMENTED IN NEXT RELEASE
-      } else {
-        v_N_H2OLinesPtr->push_back(0.0);
-      }
-
-      //	if(v_layerO3_[j]<0.0||j==10){cout << "v_layerO3_[" << j << "]=" << v_layerO3_[j] << endl;}
-
-      if(v_layerO3_[j] > 0) {
-
-        abun_O3 = v_layerO3_[j] * 1E-6;
-        v_N_O3LinesPtr->push_back(atm.getRefractivity_o3(v_layerTemperature_[j],
-                                                         v_layerPressure_[j],
-                                                         nu,      // width,npoints, TO BE IMPLEMENTED IN NEXT RELEASE
-                                                         abun_O3 * 1e6));
-      } else {
-        v_N_O3LinesPtr->push_back(0.0);
-      }
-
-      if(v_layerCO_[j] > 0) {
-        abun_CO = v_layerCO_[j] * 1E-6; // in cm^-3
-        v_N_COLinesPtr->push_back(atm.getSpecificRefractivity_co(v_layerTemperature_[j],
-								 v_layerPressure_[j],
-								 nu)            // ,width,npoints) TO BE IMPLEMENTED IN NEXT RELEASE
-				  * abun_CO * 1e6); // m^2 * m^-3 = m^-1
-        } else {
-        v_N_COLinesPtr->push_back(0.0);
-      }
-
-      if(v_layerN2O_[j] > 0) {
-        abun_N2O = v_layerN2O_[j] * 1E-6;
-        v_N_N2OLinesPtr->push_back(atm.getSpecificRefractivity_n2o(v_layerTemperature_[j],
-								   v_layerPressure_[j],
-								   nu)             // ,width,npoints) TO BE IMPLEMENTED IN NEXT RELEASE
-				   * abun_N2O * 1e6); // m^2 * m^-3 = m^-1
-        } else {
-        v_N_N2OLinesPtr->push_back(0.0);
-      }
-
-      if(v_layerNO2_[j] > 0) {
-        abun_NO2 = v_layerNO2_[j] * 1E-6;
-        v_N_NO2LinesPtr->push_back(atm.getSpecificRefractivity_no2(v_layerTemperature_[j],
-								   v_layerPressure_[j],
-								   nu)             // ,width,npoints) TO BE IMPLEMENTED IN NEXT RELEASE
-				   * abun_NO2 * 1e6); // m^2 * m^-3 = m^-1
-      } else {
-        v_N_NO2LinesPtr->push_back(0.0);
-      }
-
-      if(v_layerSO2_[j] > 0) {
-        abun_SO2 = v_layerSO2_[j] * 1E-6;
-        v_N_SO2LinesPtr->push_back(atm.getSpecificRefractivity_so2(v_layerTemperature_[j],
-								   v_layerPressure_[j],
-								   nu)            // ,width,npoints) TO BE IMPLEMENTED IN NEXT RELEASE
-				   * abun_SO2 * 1e6); // m^2 * m^-3 = m^-1
-      } else {
-        v_N_SO2LinesPtr->push_back(0.0);
+      for(int nc = ncbeg; nc < ncend; nc++) {
+
+        double nu = 1.0E-9 * v_chanFreq_[nc]; // ATM uses GHz units
+
+        const double temperature = v_layerTemperature_[j];
+        const double pressure = v_layerPressure_[j];
+        const double wvt = v_wvt[j];
+
+        (*vv_N_O2LinesPtr_[nc])[j] = atm.getRefractivity_o2(temperature,
+                                                      pressure,
+                                                      wvt,
+                                                      nu);     // ,width,npoints)); TO BE IMPLEMENTED IN NEXT RELEASE
+
+        (*vv_N_H2OContPtr_[nc])[j] = atm.getSpecificRefractivity_cnth2o(temperature,
+                                                                  pressure,
+                                                                  wvt,
+                                                                  nu); // ,width,npoints); TO BE IMPLEMENTED IN NEXT RELEASE
+        (*vv_N_DryContPtr_[nc])[j] = atm.getSpecificRefractivity_cntdry(temperature,
+                                                                  pressure,
+                                                                  wvt,
+                                                                  nu); // ,width,npoints); TO BE IMPLEMENTED IN NEXT RELEASE
+
+        if(v_layerWaterVapor_[j] > 0) {
+          (*vv_N_H2OLinesPtr_[nc])[j] = atm.getRefractivity_h2o(temperature,
+                                                          pressure,
+                                                          wvt,
+                                                          nu); // ,width,npoints)); TO BE IMPLEMENTED IN NEXT RELEASE
+        }
+
+        // the abundances are stored in cm^-3: *1E-6 then *1e6 for m^2 * m^-3 = m^-1
+        if(v_layerO3_[j] > 0) {
+          double abun_O3 = v_layerO3_[j] * 1E-6;
+          (*vv_N_O3LinesPtr_[nc])[j] = atm.getRefractivity_o3(temperature,
+                                                        pressure,
+                                                        nu,      // width,npoints, TO BE IMPLEMENTED IN NEXT RELEASE
+                                                        abun_O3 * 1e6);
+        }
+
+        if(v_layerCO_[j] > 0) {
+          double abun_CO = v_layerCO_[j] * 1E-6;
+          (*vv_N_COLinesPtr_[nc])[j] = atm.getSpecificRefractivity_co(temperature, pressure, nu) * abun_CO * 1e6;
+        }
+
+        if(v_layerN2O_[j] > 0) {
+          double abun_N2O = v_layerN2O_[j] * 1E-6;
+          (*vv_N_N2OLinesPtr_[nc])[j] = atm.getSpecificRefractivity_n2o(temperature, pressure, nu) * abun_N2O * 1e6;
+        }
+
+        if(v_layerNO2_[j] > 0) {
+          double abun_NO2 = v_layerNO2_[j] * 1E-6;
+          (*vv_N_NO2LinesPtr_[nc])[j] = atm.getSpecificRefractivity_no2(temperature, pressure, nu) * abun_NO2 * 1e6;
+        }
+
+        if(v_layerSO2_[j] > 0) {
+          double abun_SO2 = v_layerSO2_[j] * 1E-6;
+          (*vv_N_SO2LinesPtr_[nc])[j] = atm.getSpecificRefractivity_so2(temperature, pressure, nu) * abun_SO2 * 1e6;
+        }
       }
     }
-
-    if(vv_N_H2OLinesPtr_.size() == 0) first = true;
-
-    if(vv_N_H2OLinesPtr_.size() < v_chanFreq_.size()) {
-      vv_N_H2OLinesPtr_.push_back(v_N_H2OLinesPtr);
-      vv_N_H2OContPtr_.push_back(v_N_H2OContPtr);
-      vv_N_O2LinesPtr_.push_back(v_N_O2LinesPtr);
-      vv_N_DryContPtr_.push_back(v_N_DryContPtr);
-      vv_N_O3LinesPtr_.push_back(v_N_O3LinesPtr);
-      vv_N_COLinesPtr_.push_back(v_N_COLinesPtr);
-      vv_N_N2OLinesPtr_.push_back(v_N_N2OLinesPtr);
-      vv_N_NO2LinesPtr_.push_back(v_N_NO2LinesPtr);
-      vv_N_SO2LinesPtr_.push_back(v_N_SO2LinesPtr);
-    } else {
-      vv_N_H2OLinesPtr_[nc] = v_N_H2OLinesPtr;
-      vv_N_H2OContPtr_[nc] = v_N_H2OContPtr;
-      vv_N_O2LinesPtr_[nc] = v_N_O2LinesPtr;
-      vv_N_DryContPtr_[nc] = v_N_DryContPtr;
-      vv_N_O3LinesPtr_[nc] = v_N_O3LinesPtr;
-      vv_N_COLinesPtr_[nc] = v_N_COLinesPtr;
-      vv_N_N2OLinesPtr_[nc] = v_N_N2OLinesPtr;
-      vv_N_NO2LinesPtr_[nc] = v_N_NO2LinesPtr;
-      vv_N_SO2LinesPtr_[nc] = v_N_SO2LinesPtr;
-    }
-
+  }
   }
 
   newBasicParam_ = false;
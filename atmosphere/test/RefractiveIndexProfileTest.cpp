@@ -0,0 +1,253 @@
+// Copyright (C) 2016
+// Associated Universities, Inc. Washington DC, USA.
+//
+// This program is free software; you can redistribute it and/or modify it
+// under the terms of the GNU General Public License as published by the Free
+// Software Foundation; either version 2 of the License, or (at your option)
+// any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT
+// ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+// FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+// more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software Foundation,
+// Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+
+/**
+   Checks the refractivity profiles of RefractiveIndexProfile over a
+   4000 channel spectral window and an added 500 channel one, before and
+   after the basic atmospheric parameters change:
+
+   - against the opacities and path lengths that the serial,
+     channel-by-channel mkRefractiveIndexProfile gave at a set of channels
+     (the reference table below, printed by that code with --print);
+   - with one thread against four threads, for every channel, which must
+     agree exactly.
+
+   Prints OK and returns 0 if all agree.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// Unfortunately the using statement below is required because of poor
+// desgin of the header files
+using namespace std;
+
+#include "ATMRefractiveIndexProfile.h"
+#include "ATMProfile.h"
+#include "ATMSpectralGrid.h"
+
+namespace {
+
+const unsigned int nQuantity = 6;
+
+const unsigned int sampleChan[] = {0, 137, 500, 1000, 1500, 2000, 2500, 3000,
+                                   3500, 3999, 4000, 4123, 4250, 4499};
+const unsigned int nSample = sizeof(sampleChan) / sizeof(sampleChan[0]);
+
+// Dry, wet and O3 lines opacities, dispersive H2O, non-dispersive dry and
+// dispersive dry path lengths (m) at sampleChan, for the first and second
+// atmosphere, as given by the serial mkRefractiveIndexProfile
+const double reference[2][nSample][nQuantity] = {
+  {
+    {0.012104818466997977, 0.0089327515518312257, 7.9956612628430365e-06,
+     7.4582179480586614e-05, 1.3594938374262815, -0.0027256526792543909},
+    {1.1416650977599738, 0.015601325144552633, 0.00011751544115696064,
+     0.00013388636608991028, 1.3594938366509421, 0.0012618625345143721},
+    {0.0075840226798834769, 0.19573606723557713, 7.5443332483361009e-05,
+     0.00016066823882581108, 1.3594938359665651, -4.7014274137652263e-05},
+    {0.014573719595847688, 0.11513992807620171, 0.0013505520190300688,
+     0.00092543063233488387, 1.3594938357249546, 2.8555082598363993e-06},
+    {0.026374802573908184, 1.0276526048459027, 0.00048615887843736922,
+     0.0013663357957402005, 1.3594938356436483, 2.8150819932715666e-05},
+    {0.26111810739192842, 1.5781552093175961, 0.0018255760104692804,
+     0.0050276654397856512, 1.3594938356067772, -0.00016502471461480027},
+    {0.06013896124995418, 6.1233892877431062, 0.014900265335150249,
+     -0.0078417431102767807, 1.3594938355869999, -1.3902114071653639e-06},
+    {0.067653157187575294, 1.7788102301499151, 0.0021962600291686729,
+     0.0015614536465574436, 1.3594938355751764, 1.5474370442477296e-05},
+    {0.11196159173435717, 3.5620200983982149, 0.0011258502467539754,
+     -0.0021766817283388495, 1.3594938355675508, -6.185678851328136e-05},
+    {0.10240335874159179, 1.9373859950722117, 0.0024828214964486908,
+     0.0037819570477715119, 1.3594938355623563, -1.3212150102397529e-05},
+    {0.13563201156438923, 1.6495770659628775, 0.081289924798853316,
+     -0.00099171620276375686, 1.359493835579501, -8.4225013845102935e-06},
+    {0.061940885745510814, 1.636368016572926, 0.0070747046966768059,
+     -0.00091295478434933711, 1.3594938355793629, 1.41695638886924e-06},
+    {0.078779800109095341, 1.6257972035999906, 0.022790094010055283,
+     -0.00083246244595190741, 1.3594938355792219, 1.1473417313900318e-05},
+    {0.10014723267541607, 1.6198233508347044, 0.028133543715782569,
+     -0.00067652923029475705, 1.3594938355789459, 1.2298726040142349e-05}
+  },
+  {
+    {0.0116774886283236, 0.021566177277377519, 7.7584924890887857e-06,
+     0.00017823527166345825, 1.3585833735866635, -0.0026687801327194495},
+    {1.0937937484633646, 0.037674671610780988, 0.0001129187290919424,
+     0.00032029382104772713, 1.3585833728308412, 0.0012054327676662318},
+    {0.0073342427994191857, 0.47281074627848035, 7.5588181110531081e-05,
+     0.00038383673680370759, 1.3585833721636911, -4.492396337525849e-05},
+    {0.014075901602361352, 0.27786524431494652, 0.0013097730987453456,
+     0.0022152207248777554, 1.3585833719281624, 2.7410936324093338e-06},
+    {0.025471657753621622, 2.500564046682431, 0.00048067807146866926,
+     0.0032460869497490021, 1.3585833718489035, 2.6960226061205958e-05},
+    {0.25315921581340917, 3.8156092710254406, 0.0018015942846333975,
+     0.011945301271925567, 1.3585833718129596, -0.00015779812682517082},
+    {0.05865406287616199, 14.616970217461024, 0.015086197571261645,
+     -0.018501885218783622, 1.3585833717936804, -1.236862152989738e-06},
+    {0.065235935099907993, 4.2706451434299, 0.0021777272160657651,
+     0.0038329944898852883, 1.3585833717821552, 1.4895369408736187e-05},
+    {0.10816831550038605, 8.5512564514969505, 0.0011375382434983491,
+     -0.0050504055419176973, 1.3585833717747211, -5.9334920409372251e-05},
+    {0.098619628966085587, 4.6772863338224226, 0.002431681090158165,
+     0.009209075717829274, 1.3585833717696574, -1.2725041330346661e-05},
+    {0.13189568360988554, 3.9605980906700773, 0.079556166696503894,
+     -0.0022536586308252765, 1.3585833717863705, -8.1263143135291459e-06},
+    {0.059784870005057424, 3.9299935147817999, 0.0069302624386862613,
+     -0.0020655929867456403, 1.3585833717862359, 1.3960513277504229e-06},
+    {0.07625663859315808, 3.906410598988129, 0.022290869108095183,
+     -0.0018733303222472097, 1.3585833717860978, 1.1170064578921007e-05},
+    {0.097333286563363347, 3.8999869920833605, 0.027491403750086244,
+     -0.0015005007027615474, 1.3585833717858293, 1.2033986457162574e-05}
+  }
+};
+
+// Relative tolerance against the reference table, which allows for the
+// compiler and platform it was made with
+const double tolerance = 1.0e-10;
+
+atm::AtmProfile makeAtmosphere()
+{
+  return atm::AtmProfile(atm::Length(5000.0, "m"),
+                         atm::Pressure(555.0, "mb"),
+                         atm::Temperature(270.0, "K"),
+                         -5.6,
+                         atm::Humidity(20.0, "%"),
+                         atm::Length(2.0, "km"),
+                         atm::Pressure(10.0, "mb"),
+                         1.2,
+                         atm::Length(48.0, "km"),
+                         1);
+}
+
+void quantities(atm::RefractiveIndexProfile &rip, unsigned int nc,
+                double *q)
+{
+  q[0] = rip.getDryOpacity(nc).get();
+  q[1] = rip.getWetOpacity(rip.getGroundWH2O(), nc).get();
+  q[2] = rip.getO3LinesOpacity(nc).get();
+  q[3] = rip.getDispersiveH2OPathLength(rip.getGroundWH2O(), nc).get();
+  q[4] = rip.getNonDispersiveDryPathLength(nc).get();
+  q[5] = rip.getDispersiveDryPathLength(nc).get();
+}
+
+// All the quantities of every channel, for the first atmosphere and then
+// for the second one
+vector<double> profile(int nThreads)
+{
+#ifdef _OPENMP
+  omp_set_num_threads(nThreads);
+#else
+  (void)nThreads;
+#endif
+  atm::AtmProfile atmosphere(makeAtmosphere());
+  // A 4000 channel window from 90 GHz to 890 GHz, which crosses the strong
+  // O2 and H2O lines, and an added 500 channel window near 650 GHz
+  atm::SpectralGrid grid(4000, 0, atm::Frequency(90.0, "GHz"),
+                         atm::Frequency(200.0, "MHz"));
+  atm::RefractiveIndexProfile rip(grid, atmosphere);
+  rip.addNewSpectralWindow(500, 0, atm::Frequency(648.0, "GHz"),
+                           atm::Frequency(10.0, "MHz"));
+  vector<double> values;
+  for(unsigned int pass = 0; pass < 2; pass++) {
+    if(pass == 1) {
+      rip.setBasicAtmosphericParameters(atm::Length(5000.0, "m"),
+                                        atm::Pressure(560.0, "mb"),
+                                        atm::Temperature(275.0, "K"),
+                                        -5.6,
+                                        atm::Humidity(35.0, "%"),
+                                        atm::Length(2.0, "km"));
+    }
+    for(unsigned int nc = 0; nc < rip.getNumIndividualFrequencies(); nc++) {
+      double q[nQuantity];
+      quantities(rip, nc, q);
+      values.insert(values.end(), q, q + nQuantity);
+    }
+  }
+  return values;
+}
+
+bool near(double a, double b)
+{
+  return fabs(a - b) <= tolerance * max(fabs(a), fabs(b));
+}
+
+} // anonymous namespace
+
+int main(int argc, char *argv[])
+{
+  const bool print = (argc > 1 && strcmp(argv[1], "--print") == 0);
+  int nThreads = 1;
+#ifdef _OPENMP
+  nThreads = 4;
+#endif
+
+  const vector<double> serial(profile(1));
+  const unsigned int nchan = serial.size() / (2 * nQuantity);
+  if(nchan != 4500) {
+    cout << "Expected 4500 channels, got " << nchan << endl << "FAIL" << endl;
+    return 1;
+  }
+
+  unsigned int nBad = 0;
+  for(unsigned int pass = 0; pass < 2; pass++) {
+    if(print) printf("  {\n");
+    for(unsigned int s = 0; s < nSample; s++) {
+      const double *q = &serial[(pass * nchan + sampleChan[s]) * nQuantity];
+      if(print) {
+        printf("    {%.17g, %.17g, %.17g,\n     %.17g, %.17g, %.17g}%s\n",
+               q[0], q[1], q[2], q[3], q[4], q[5], s + 1 < nSample ? "," : "");
+        continue;
+      }
+      for(unsigned int k = 0; k < nQuantity; k++) {
+        if(!near(q[k], reference[pass][s][k])) {
+          cout << "Atmosphere " << pass << ", channel " << sampleChan[s]
+               << ", quantity " << k << ": " << q[k] << " instead of "
+               << reference[pass][s][k] << endl;
+          nBad++;
+        }
+      }
+    }
+    if(print) printf("  }%s\n", pass == 0 ? "," : "");
+  }
+  if(print) return 0;
+
+  if(nThreads > 1) {
+    const vector<double> parallel(profile(nThreads));
+    for(unsigned int i = 0; i < serial.size(); i++) {
+      if(parallel[i] != serial[i]) {
+        cout << nThreads << " threads differ from 1 thread at channel "
+             << (i / nQuantity) % nchan << ", quantity " << i % nQuantity
+             << endl;
+        nBad++;
+        break;
+      }
+    }
+  }
+
+  if(nBad > 0) {
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -61,10 +61,55 @@
 #include <images/Images/ImageInfo.h>
 #include <lattices/Lattices/LatticeIterator.h>
 #include <lattices/Lattices/LatticeStepper.h>
+#include <components/ComponentModels/ComponentShape.h>
+#include <components/ComponentModels/TwoSidedShape.h>
+#include <casa/Utilities/CountedPtr.h>
 #include <casa/iostream.h>
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
+namespace {
+
+// Upper limit, in samples, on the shape values held in memory at once
+// for the components overlapping one chunk.
+const uInt maxBatchSamples = 1 << 24;
+
+// The part of a component that does not depend on the pixel being
+// sampled: its shape (already converted to the image direction frame,
+// so sampling it needs no Measures conversion and is safe to do from
+// several threads), the pixel box outside which the shape is zero and
+// its Stokes flux in the image units at every channel.
+struct ComponentFootprint {
+	CountedPtr<ComponentShape> shape;
+	Int blc[2];
+	Int trc[2];
+	Vector<Double> iquv;
+};
+
+// Angular radius outside which the shape samples to zero, or a negative
+// value if the shape is not known to be bounded.  For Gaussians this is
+// the same cutoff used by GaussianShape::sample.
+Double supportRadius(const ComponentShape& shape) {
+	switch (shape.type()) {
+	case ComponentType::POINT:
+		return 0.0;
+	case ComponentType::GAUSSIAN:
+		return 4.0 * dynamic_cast<const TwoSidedShape&>(shape).majorAxisInRad();
+	case ComponentType::DISK:
+	case ComponentType::LDISK:
+		return 0.5 * dynamic_cast<const TwoSidedShape&>(shape).majorAxisInRad();
+	default:
+		return -1.0;
+	}
+}
+
+}
+
+
 void ComponentImager::project(ImageInterface<Float>& image, const ComponentList& list) 
 {
 	const CoordinateSystem& coords = image.coordinates();
@@ -248,10 +293,8 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 		chunkShape(latAxis) = tileShape(latAxis);
 		chunkShape(longAxis) = tileShape(longAxis);
 	}
-	IPosition pixelShape = imageShape;
-	pixelShape(latAxis) = pixelShape(longAxis) = 1;
-	LatticeStepper pixelStepper(imageShape, pixelShape, LatticeStepper::RESIZE);
 	LatticeIterator<Float> chunkIter(image, chunkShape);
+	const uInt nx = chunkShape(latAxis);
 	const uInt nDirs = chunkShape(latAxis) * chunkShape(longAxis);
 	Cube<Double> pixelVals(4, nDirs, nFreqs);
 	Vector<MVDirection> dirVals(nDirs);
@@ -261,6 +304,57 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 	uInt d;
 	IPosition pixelPosition(naxis, 0);
 
+	// Work out, once for the whole image, which pixels each component can
+	// contribute to and what its flux is in every channel. The spectral
+	// model is therefore evaluated once per channel rather than once per
+	// chunk, and each chunk only samples the components that overlap it.
+	const uInt nComps = list.nelements();
+	std::vector<ComponentFootprint> footprints(nComps);
+	{
+		const Double pixelSize = min(pixelLatSize.radian(), pixelLongSize.radian());
+		Vector<Double> fluxVal(4);
+		Vector<Double> compPixel(2);
+		for (uInt c = 0; c < nComps; c++) {
+			const SkyComponent& comp = list.component(c);
+			ComponentFootprint& fp = footprints[c];
+			fp.shape = comp.shape().clone();
+			const MDirection& compDir = fp.shape->refDirection();
+			if (compDir.getRef() != dirRef) {
+				fp.shape->setRefDirection(MDirection::Convert(compDir, dirRef)());
+			}
+			fp.blc[0] = fp.blc[1] = 0;
+			fp.trc[0] = imageShape(latAxis) - 1;
+			fp.trc[1] = imageShape(longAxis) - 1;
+			const Double radius = supportRadius(*fp.shape);
+			if (radius >= 0 && dirCoord.toPixel(compPixel, fp.shape->refDirection())) {
+				// Two pixels of slack cover a point component sitting on a pixel
+				// edge and the small difference between angular and pixel
+				// distance across the support.
+				const Double pixRadius = radius/pixelSize + 2;
+				for (uInt i = 0; i < 2; i++) {
+					fp.blc[i] = max(fp.blc[i], Int(floor(compPixel(i) - pixRadius)));
+					fp.trc[i] = min(fp.trc[i], Int(ceil(compPixel(i) + pixRadius)));
+				}
+			}
+			Flux<Double> flux = comp.flux().copy();
+			flux.convertUnit(fluxUnits);
+			flux.value(fluxVal);
+			Vector<Vector<Double> > freqIQUV(nFreqs);
+			freqIQUV.set(fluxVal);
+			comp.spectrum().sampleStokes(freqIQUV, freqValues, freqRef);
+			fp.iquv.resize(4*nFreqs);
+			for (uInt f = 0; f < nFreqs; f++) {
+				for (uInt s = 0; s < 4; s++) {
+					fp.iquv(4*f + s) = freqIQUV(f)(s);
+				}
+			}
+		}
+	}
+	Int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+
 	// Does the image have a writable mask ?  Output pixel values are
 	// only modified if the mask==T  and the coordinate conversions
 	// succeeded.  The mask==F on output if the coordinate conversion
@@ -279,6 +373,8 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 	if (doMask) pixelMaskPtr = &image.pixelMask();
 	PtrHolder<Array<Bool> > maskPtr;
 	Int polAxis = coords.polarizationAxisNumber(False);
+	std::vector<uInt> overlapping;
+	std::vector<Vector<Double> > dirScales;
 	for (chunkIter.reset(); !chunkIter.atEnd(); chunkIter++) {
 
 		// Iterate through sky plane of cursor and do coordinate conversions
@@ -289,6 +385,9 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 		pixelDir(1) = blc(longAxis);
 		coordIsGood = True;
 		while (pixelDir(1) <= trc(longAxis)) {
+			// Keep the chunk stride so that partial chunks at the image
+			// edge are indexed the same way as when the model is added.
+			d = (uInt(pixelDir(1)) - blc(longAxis)) * nx;
 			pixelDir(0) = blc(latAxis);
 			while (pixelDir(0) <= trc(latAxis)) {
 				if (!dirCoord.toWorld(dirVals(d), pixelDir)) {
@@ -302,9 +401,98 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 		}
 
 		// Sample model, converting the values in the components
-		// to the specified direction and spectral frames
-		list.sample(pixelVals, fluxUnits, dirVals, dirRef, pixelLatSize,
-				pixelLongSize, freqValues, freqRef);
+		// to the specified direction and spectral frames. Only the
+		// components whose support overlaps this chunk are sampled, in
+		// batches that bound the memory used for their shape values.
+		pixelVals = 0.0;
+		const Int cx0 = blc(latAxis);
+		const Int cy0 = blc(longAxis);
+		const Int cx1 = trc(latAxis);
+		const Int cy1 = trc(longAxis);
+		uInt next = 0;
+		while (next < nComps) {
+			overlapping.clear();
+			uInt batchSamples = 0;
+			while (next < nComps && batchSamples < maxBatchSamples) {
+				const ComponentFootprint& fp = footprints[next];
+				if (
+					fp.blc[0] <= cx1 && fp.trc[0] >= cx0
+					&& fp.blc[1] <= cy1 && fp.trc[1] >= cy0
+				) {
+					overlapping.push_back(next);
+					batchSamples += (min(fp.trc[0], cx1) - max(fp.blc[0], cx0) + 1)
+						* (min(fp.trc[1], cy1) - max(fp.blc[1], cy0) + 1);
+				}
+				next++;
+			}
+			const Int nOverlap = overlapping.size();
+			if (nOverlap == 0) {
+				continue;
+			}
+			dirScales.resize(nOverlap);
+
+			// Evaluate each shape over the pixels of its box that fall in
+			// this chunk; components are independent so they are shared
+			// out between threads.
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+			for (Int k = 0; k < nOverlap; k++) {
+				const ComponentFootprint& fp = footprints[overlapping[k]];
+				const Int x0 = max(fp.blc[0], cx0);
+				const Int x1 = min(fp.trc[0], cx1);
+				const Int y0 = max(fp.blc[1], cy0);
+				const Int y1 = min(fp.trc[1], cy1);
+				const uInt w = x1 - x0 + 1;
+				Vector<MVDirection> boxDirs(w * (y1 - y0 + 1));
+				uInt b = 0;
+				for (Int y = y0; y <= y1; y++) {
+					const uInt rowStart = (y - cy0)*nx - cx0;
+					for (Int x = x0; x <= x1; x++, b++) {
+						boxDirs(b) = dirVals(rowStart + x);
+					}
+				}
+				dirScales[k].resize(boxDirs.nelements());
+				fp.shape->sample(
+					dirScales[k], boxDirs, dirRef, pixelLatSize, pixelLongSize
+				);
+			}
+
+			// Accumulate scale times the per channel flux. Each thread owns
+			// a set of rows of the chunk so no two threads write the same
+			// pixel.
+			Bool delPix;
+			Double* pixStor = pixelVals.getStorage(delPix);
+			const Int nRows = cy1 - cy0 + 1;
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+			for (Int row = 0; row < nRows; row++) {
+				const Int y = cy0 + row;
+				for (Int k = 0; k < nOverlap; k++) {
+					const ComponentFootprint& fp = footprints[overlapping[k]];
+					const Int y0 = max(fp.blc[1], cy0);
+					if (y < y0 || y > min(fp.trc[1], cy1)) {
+						continue;
+					}
+					const Int x0 = max(fp.blc[0], cx0);
+					const Int x1 = min(fp.trc[0], cx1);
+					const Double* scales = dirScales[k].data() + (y - y0)*(x1 - x0 + 1);
+					const Double* iquv = fp.iquv.data();
+					for (Int x = x0; x <= x1; x++) {
+						const Double scale = scales[x - x0];
+						if (scale == 0) {
+							continue;
+						}
+						Double* pix = pixStor + 4*((y - cy0)*nx + (x - cx0));
+						for (uInt f = 0; f < nFreqs; f++) {
+							Double* pixf = pix + 4*nDirs*f;
+							const Double* fluxf = iquv + 4*f;
+							for (uInt s = 0; s < 4; s++) {
+								pixf[s] += scale * fluxf[s];
+							}
+						}
+					}
+				}
+			}
+			pixelVals.putStorage(pixStor, delPix);
+		}
 
 		// Modify data by model for this chunk of data
 		Array<Float>& imageChunk = chunkIter.rwCursor();
@@ -353,4 +541,3 @@ void ComponentImager::project(ImageInterface<Float>& image, const ComponentList&
 	}
 }
 } //# NAMESPACE CASA - END
-
@@ -94,6 +94,14 @@ class LogIO;
 // pixels will be masked, otherwise they are just zeroed.  Any pixels
 // that are already masked mask=F) will not have their values changed
 // (perhaps this behaviour should be changed).
+//
+// Each component is only sampled at the pixels within its support (a few
+// widths for a Gaussian, the disk itself for a disk and the pixel it
+// falls in for a point), and its spectral model is evaluated once per
+// channel for the whole image. Components overlapping a chunk of the image
+// are sampled in parallel when OpenMP is available, so large lists of
+// compact components can be projected in a time that scales with the
+// number of pixels they cover rather than with the size of the image.
 // </synopsis>
 //
 // <example>
@@ -191,6 +191,16 @@ private:
 		T majorAxis, T ratio, T positionAngle
 	);
 
+	// Convolve the planes of imageIn that start at starts (all of shape
+	// planeShape) by kernels[planeKernel[i]] into imageOut, or copy them
+	// if planeKernel[i] is negative. The kernels must already be scaled.
+	static void _convolvePlanes(
+		LogIO& os, SPIIT imageOut, const ImageInterface<T>& imageIn,
+		const vector<IPosition>& starts, const IPosition& planeShape,
+		const vector<Int>& planeKernel, const vector<Array<T> >& kernels,
+		const IPosition& pixelAxes, Bool copyMiscellaneous
+	);
+
 	static T _makeKernel(
 		Array<T>& kernel,
 		VectorKernel::KernelTypes kernelType,
@@ -55,10 +55,15 @@
 #include <casa/Quanta/MVAngle.h>
 #include <casa/Quanta/Unit.h>
 #include <casa/Quanta/QLogical.h>
+#include <casa/Utilities/CountedPtr.h>
 #include <casa/iostream.h>
 
 #include <memory>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace casa { //# NAMESPACE CASA - BEGIN
 
 template <class T> 
@@ -264,6 +269,17 @@ template <class T> void Image2DConvolver<T>::convolve(
 		    : nChan > 0
 		      ? nChan
 		      : nPol;
+		// First work out the (scaled) kernel of every plane. The kernel, scale
+		// factor and output beam only depend on the input beam, so they are
+		// computed once for each distinct beam and the planes that share a
+		// beam share the kernel.
+		vector<IPosition> starts(count);
+		vector<Int> planeKernel(count, -1);
+		vector<Array<T> > kernels;
+		vector<GaussianBeam> kernelBeamIn;
+		vector<GaussianBeam> kernelBeamOut;
+		vector<String> kernelUnitOut;
+		vector<T> kernelScale;
 		for (uInt i=0; i<count; i++) {
 			if (nChan > 0) {
 				channel = i % nChan;
@@ -275,14 +291,7 @@ template <class T> void Image2DConvolver<T>::convolve(
 					: i;
 				start[polAxis] = polarization;
 			}
-			Slicer slice(start, end);
-			SubImage<T> subImage(imageIn, slice);
-			CoordinateSystem subCsys = subImage.coordinates();
-			if (subCsys.hasSpectralAxis()) {
-				Vector<Double> subRefPix = subCsys.referencePixel();
-				subRefPix[specAxis] = 0;
-				subCsys.setReferencePixel(subRefPix);
-			}
+			starts[i] = start;
 			GaussianBeam inputBeam = imageInfo.restoringBeam(channel, polarization);
 			Bool doConvolve = True;
 			if (targetres) {
@@ -306,27 +315,55 @@ template <class T> void Image2DConvolver<T>::convolve(
 					kernelParms = _getConvolvingBeamForTargetResolution(
 						parameters, inputBeam
 					);
-					kernelVolume = _makeKernel(
-						kernel, kernelType, kernelParms, pixelAxes, imageIn
-					);
-
 					os << ": Convolving image which has a beam of " << inputBeam
 						<< " with a Gaussian of "
 						<< GaussianBeam(kernelParms) << " to reach a target resolution of "
 						<< GaussianBeam(parameters) << LogIO::POST;
 				}
 			}
-			TempImage<Float> subImageOut(
-				subImage.shape(), subImage.coordinates()
-			);
 			if (doConvolve) {
-				T scaleFactor = _dealWithRestoringBeam(
-					os, brightnessUnitOut, beamOut, kernel, kernelVolume,
-					kernelType, kernelParms, pixelAxes, subCsys, inputBeam,
-					brightnessUnit, autoScale, scale, i == 0
-				);
+				Int k = kernels.size() - 1;
+				while (k >= 0 && kernelBeamIn[k] != inputBeam) {
+					k--;
+				}
+				if (k < 0) {
+					if (targetres) {
+						kernelVolume = _makeKernel(
+							kernel, kernelType, kernelParms, pixelAxes, imageIn
+						);
+					}
+					Slicer slice(start, end);
+					SubImage<T> subImage(imageIn, slice);
+					CoordinateSystem subCsys = subImage.coordinates();
+					if (subCsys.hasSpectralAxis()) {
+						Vector<Double> subRefPix = subCsys.referencePixel();
+						subRefPix[specAxis] = 0;
+						subCsys.setReferencePixel(subRefPix);
+					}
+					T scaleFactor = _dealWithRestoringBeam(
+						os, brightnessUnitOut, beamOut, kernel, kernelVolume,
+						kernelType, kernelParms, pixelAxes, subCsys, inputBeam,
+						brightnessUnit, autoScale, scale, i == 0
+					);
+					if (targetres && near(beamOut.getMajor(), beamOut.getMinor(), 1e-7)) {
+						// circular beam should have same PA as given by user if
+						// targetres
+						beamOut.setPA(parameters[2]);
+					}
+					k = kernels.size();
+					kernels.push_back(scaleFactor*kernel);
+					kernelBeamIn.push_back(inputBeam);
+					kernelBeamOut.push_back(beamOut);
+					kernelUnitOut.push_back(brightnessUnitOut);
+					kernelScale.push_back(scaleFactor);
+				}
+				else {
+					beamOut = kernelBeamOut[k];
+					brightnessUnitOut = kernelUnitOut[k];
+				}
+				planeKernel[i] = k;
 				{
-					os << LogIO::NORMAL << "Scaling pixel values by " << scaleFactor
+					os << LogIO::NORMAL << "Scaling pixel values by " << kernelScale[k]
 						<< " for ";
 					if (channel >= 0) {
 						os << "channel number " << channel;
@@ -339,45 +376,10 @@ template <class T> void Image2DConvolver<T>::convolve(
 					}
 					os << LogIO::POST;
 				}
-				if (targetres && near(beamOut.getMajor(), beamOut.getMinor(), 1e-7)) {
-					// circular beam should have same PA as given by user if
-					// targetres
-					beamOut.setPA(parameters[2]);
-				}
-				ImageConvolver<T> aic;
-				aic.convolve(
-					os, subImageOut, subImage, scaleFactor*kernel,
-					ImageConvolver<T>::NONE, 1.0, copyMiscellaneous
-				);
 			}
 			else {
 				brightnessUnitOut = imageIn.units().getName();
 				beamOut = inputBeam;
-				subImageOut.put(subImage.get());
-			}
-			{
-				Bool doMask = imageOut->isMasked() && imageOut->hasPixelMask();
-				Lattice<Bool>* pMaskOut = 0;
-				if (doMask) {
-					pMaskOut = &imageOut->pixelMask();
-					if (! pMaskOut->isWritable()) {
-						doMask = False;
-					}
-				}
-				IPosition cursorShape = subImageOut.niceCursorShape();
-				IPosition outPos = start;
-				LatticeStepper stepper(
-					subImageOut.shape(), cursorShape, LatticeStepper::RESIZE
-				);
-				RO_MaskedLatticeIterator<T> iter(subImageOut, stepper);
-				for (iter.reset(); !iter.atEnd(); iter++) {
-					IPosition cursorShape = iter.cursorShape();
-					imageOut->putSlice(iter.cursor(), outPos);
-					if (doMask) {
-						pMaskOut->putSlice(iter.getMask(), outPos);
-					}
-					outPos = outPos + cursorShape;
-				}
 			}
 			if (! targetres) {
 				iiOut.setBeam(
@@ -385,6 +387,12 @@ template <class T> void Image2DConvolver<T>::convolve(
 				);
 			}
 		}
+		os << LogIO::NORMAL << "Convolving " << count << " planes with "
+			<< kernels.size() << " distinct kernels" << LogIO::POST;
+		_convolvePlanes(
+			os, imageOut, imageIn, starts, end, planeKernel, kernels,
+			pixelAxes, copyMiscellaneous
+		);
 	}
 	else {
 		GaussianBeam inputBeam = imageInfo.restoringBeam();
@@ -441,6 +449,159 @@ template <class T> void Image2DConvolver<T>::convolve(
 
 // Private functions
 
+template <class T> void Image2DConvolver<T>::_convolvePlanes(
+	LogIO& os, SPIIT imageOut, const ImageInterface<T>& imageIn,
+	const vector<IPosition>& starts, const IPosition& planeShape,
+	const vector<Int>& planeKernel, const vector<Array<T> >& kernels,
+	const IPosition& pixelAxes, Bool copyMiscellaneous
+) {
+	Bool doMask = imageOut->isMasked() && imageOut->hasPixelMask();
+	Lattice<Bool>* pMaskOut = 0;
+	if (doMask) {
+		pMaskOut = &imageOut->pixelMask();
+		if (! pMaskOut->isWritable()) {
+			doMask = False;
+		}
+	}
+	uInt count = starts.size();
+	if (planeShape.product() != planeShape[pixelAxes[0]]*planeShape[pixelAxes[1]]) {
+		// the planes have other non-degenerate axes; leave these to
+		// ImageConvolver one plane at a time
+		for (uInt i=0; i<count; i++) {
+			Slicer slice(starts[i], planeShape);
+			SubImage<T> subImage(imageIn, slice);
+			TempImage<T> subImageOut(
+				subImage.shape(), subImage.coordinates()
+			);
+			if (planeKernel[i] >= 0) {
+				ImageConvolver<T> aic;
+				aic.convolve(
+					os, subImageOut, subImage, kernels[planeKernel[i]],
+					ImageConvolver<T>::NONE, 1.0, copyMiscellaneous
+				);
+			}
+			else {
+				subImageOut.put(subImage.get());
+			}
+			IPosition cursorShape = subImageOut.niceCursorShape();
+			IPosition outPos = starts[i];
+			LatticeStepper stepper(
+				subImageOut.shape(), cursorShape, LatticeStepper::RESIZE
+			);
+			RO_MaskedLatticeIterator<T> iter(subImageOut, stepper);
+			for (iter.reset(); !iter.atEnd(); iter++) {
+				IPosition cursorShape = iter.cursorShape();
+				imageOut->putSlice(iter.cursor(), outPos);
+				if (doMask) {
+					pMaskOut->putSlice(iter.getMask(), outPos);
+				}
+				outPos = outPos + cursorShape;
+			}
+		}
+		return;
+	}
+	// The planes are read (and written) in batches, one thread at a time, and
+	// the planes of a batch are convolved concurrently. Each thread keeps the
+	// Convolver, which holds the transformed kernel and the FFT set up for the
+	// plane shape, of the last kernel it used.
+	Int nThreads = 1;
+#ifdef _OPENMP
+	nThreads = omp_get_max_threads();
+#endif
+	static const Int64 maxBatchBytes = 536870912;
+	Int64 planeBytes = planeShape.product()*sizeof(T);
+	uInt batch = max(
+		(Int64)1,
+		min((Int64)(4*nThreads), maxBatchBytes/max(planeBytes, (Int64)1))
+	);
+	Bool inMasked = imageIn.isMasked();
+	vector<CountedPtr<Convolver<T> > > convolvers(nThreads);
+	vector<Int> convolverKernel(nThreads, -1);
+	Array<Bool> noMask(planeShape, True);
+	for (uInt b0=0; b0<count; b0+=batch) {
+		uInt nb = min(batch, count - b0);
+		vector<Array<T> > planes(nb);
+		vector<Array<Bool> > masks(nb);
+		for (uInt j=0; j<nb; j++) {
+			Slicer slice(starts[b0 + j], planeShape);
+			planes[j] = imageIn.getSlice(slice);
+			if (inMasked) {
+				masks[j] = imageIn.getMaskSlice(slice);
+			}
+		}
+		String errMsg;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) num_threads(nThreads)
+#endif
+		for (Int j=0; j<(Int)nb; j++) {
+			Int k = planeKernel[b0 + j];
+			if (k < 0) {
+				continue;
+			}
+			try {
+				Int thread = 0;
+#ifdef _OPENMP
+				thread = omp_get_thread_num();
+#endif
+				if (convolverKernel[thread] != k) {
+					// FFT plans are not necessarily made thread safely.
+					// The Convolver only makes its forward plan on
+					// construction, so one convolution of an empty plane
+					// makes the inverse plan here too.
+#ifdef _OPENMP
+#pragma omp critical (Image2DConvolver_makeConvolver)
+#endif
+					{
+						IPosition convShape = planeShape.nonDegenerate(pixelAxes);
+						convolvers[thread] = new Convolver<T>(
+							kernels[k].nonDegenerate(pixelAxes), convShape
+						);
+						Array<T> warmIn(convShape, T(0));
+						Array<T> warmOut;
+						convolvers[thread]->linearConv(warmOut, warmIn);
+					}
+					convolverKernel[thread] = k;
+				}
+				if (inMasked) {
+					// masked pixels are zero in the convolution, as in
+					// ImageConvolver
+					Bool delData, delMask;
+					T* data = planes[j].getStorage(delData);
+					const Bool* mask = masks[j].getStorage(delMask);
+					Int64 n = planes[j].nelements();
+					for (Int64 p=0; p<n; p++) {
+						if (! mask[p]) {
+							data[p] = 0;
+						}
+					}
+					planes[j].putStorage(data, delData);
+					masks[j].freeStorage(mask, delMask);
+				}
+				Array<T> plane = planes[j].nonDegenerate(pixelAxes);
+				Array<T> result;
+				convolvers[thread]->linearConv(result, plane);
+				plane = result;
+			}
+			catch (const AipsError& x) {
+#ifdef _OPENMP
+#pragma omp critical (Image2DConvolver_convolvePlanes)
+#endif
+				errMsg = x.getMesg();
+			}
+		}
+		ThrowIf(! errMsg.empty(), errMsg);
+		for (uInt j=0; j<nb; j++) {
+			imageOut->putSlice(planes[j], starts[b0 + j]);
+			if (doMask) {
+				pMaskOut->putSlice(
+					inMasked && planeKernel[b0 + j] >= 0 ? masks[j] : noMask,
+					starts[b0 + j]
+				);
+			}
+		}
+	}
+}
+
 template <class T> T Image2DConvolver<T>::_makeKernel(
 	Array<T>& kernelArray,
 	VectorKernel::KernelTypes kernelType,
@@ -97,10 +97,14 @@ private:
 
 	void _finishConstruction();
 
-	// necessary to improve performance
-	void _doMedian(
-		SPCIIT image,
-		TempImage<T>& outImage
+	// necessary to improve performance. Collapse image into outImage a chunk
+	// at a time, evaluating the lines along the collapse axes in parallel.
+	// If function is null, the median of the unmasked pixels is computed
+	// and output pixels with no unmasked input are masked; otherwise
+	// function is applied to every line and the mask is ignored.
+	void _collapseLines(
+		SPCIIT image, TempImage<T>& outImage,
+		T (*function)(const Array<T>&)
 	) const;
 
 	void _attachOutputMask(
@@ -29,6 +29,7 @@
 
 #include <casa/Arrays/ArrayLogical.h>
 #include <casa/BasicSL/STLIO.h>
+#include <casa/OS/Timer.h>
 #include <images/Images/ImageStatistics.h>
 #include <images/Images/ImageUtilities.h>
 #include <images/Images/PagedImage.h>
@@ -37,8 +38,13 @@
 #include <lattices/Lattices/LatticeUtilities.h>
 #include <lattices/LatticeMath/LatticeMathUtil.h>
 
+#include <algorithm>
 #include <memory>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace casa {
 
 template<class T> map<uInt, T (*)(const Array<T>&)> ImageCollapser<T>::_funcMap;
@@ -130,7 +136,6 @@ template<class T> SPIIT ImageCollapser<T>::collapse() const {
 	Vector<Double> refValues = outCoords.referenceValue();
 	Vector<Double> refPixels = outCoords.referencePixel();
 	IPosition outShape = inShape;
-	IPosition shape(outShape.nelements(), 1);
 	for (
 		IPosition::const_iterator iter=_axes.begin();
 		iter != _axes.end(); iter++
@@ -139,7 +144,6 @@ template<class T> SPIIT ImageCollapser<T>::collapse() const {
 		refValues[i] = (blc[i] + trc[i])/2;
 		refPixels[i] = 0;
 		outShape[i] = 1;
-		shape[i] = inShape[i];
 	}
 	ThrowIf(
 		! outCoords.setReferenceValue(refValues),
@@ -155,7 +159,7 @@ template<class T> SPIIT ImageCollapser<T>::collapse() const {
 		tmpIm.put(zeros);
 	}
 	else if (_aggType == ImageCollapserData::MEDIAN) {
-		_doMedian(subImage, tmpIm);
+		_collapseLines(subImage, tmpIm, 0);
 	}
 	else {
 		Bool lowPerf = _aggType == ImageCollapserData::FLUX;
@@ -307,14 +311,8 @@ template<class T> SPIIT ImageCollapser<T>::collapse() const {
 		else {
 			// no mask, can use higher performance method
 			T (*function)(const Array<T>&) = _getFuncMap().find(_aggType)->second;
-			Array<T> data = subImage->get(False);
 			Int64 nelements = outShape.product();
-			for (uInt i=0; i<nelements; i++) {
-				IPosition start = toIPositionInArray(i, outShape);
-				IPosition end = start + shape - 1;
-				Slicer s(start, end, Slicer::endIsLast);
-				tmpIm.putAt(function(data(s)), start);
-			}
+			_collapseLines(subImage, tmpIm, function);
 			if (
 				_aggType == ImageCollapserData::SQRTSUM
 				|| _aggType == ImageCollapserData::SQRTSUM_NPIX
@@ -425,74 +423,154 @@ template<class T> void ImageCollapser<T>::_invert() {
 	}
 }
 
-template<class T> void ImageCollapser<T>::_doMedian(
-	SPCIIT image, TempImage<T>& outImage
+template<class T> void ImageCollapser<T>::_collapseLines(
+	SPCIIT image, TempImage<T>& outImage,
+	T (*function)(const Array<T>&)
 ) const {
-	IPosition cursorShape(image->ndim(), 1);
-	for (uInt i=0; i<cursorShape.size(); i++) {
-		for (uInt j=0; j<_axes.size(); j++) {
-			if (_axes[j] == i) {
-				cursorShape[i] = image->shape()[i];
-				break;
+	// The image is read a chunk of whole lines at a time, a line being all
+	// the pixels along the collapse axes that go into one output pixel.
+	// Each chunk is reordered so that its lines are contiguous, the lines are
+	// evaluated in parallel and the resulting piece of the output is written
+	// before the next chunk is read, so the full cube is never held in memory.
+	static const Int64 maxChunkPixels = 16777216;
+	Timer timer;
+	IPosition inShape = image->shape();
+	uInt ndim = inShape.size();
+	Vector<Bool> isCollapseAxis(ndim, False);
+	for (uInt j=0; j<_axes.size(); j++) {
+		isCollapseAxis[_axes[j]] = True;
+	}
+	IPosition chunkShape(ndim, 1);
+	IPosition newOrder(ndim, 0);
+	uInt n = 0;
+	for (uInt i=0; i<ndim; i++) {
+		if (isCollapseAxis[i]) {
+			chunkShape[i] = inShape[i];
+			newOrder[n] = i;
+			n++;
+		}
+	}
+	Int64 lineLength = chunkShape.product();
+	// grow the chunk over the other axes, fastest varying first, keeping its
+	// edges on tile boundaries where possible
+	IPosition tileShape = image->niceCursorShape();
+	Int64 chunkPixels = lineLength;
+	Bool full = False;
+	for (uInt i=0; i<ndim; i++) {
+		if (isCollapseAxis[i]) {
+			continue;
+		}
+		newOrder[n] = i;
+		n++;
+		if (full) {
+			continue;
+		}
+		Int64 fit = max(maxChunkPixels/chunkPixels, (Int64)1);
+		if (fit >= inShape[i]) {
+			chunkShape[i] = inShape[i];
+		}
+		else {
+			if (fit >= tileShape[i]) {
+				fit -= fit % tileShape[i];
 			}
+			chunkShape[i] = fit;
+			full = True;
 		}
+		chunkPixels *= chunkShape[i];
 	}
-	LatticeStepper stepper(image->shape(), cursorShape);
-	Array<T> ary = image->get(False);
-	Array<Bool> mask = image->getMask();
-	if (image->hasPixelMask()) {
-		mask = mask && image->pixelMask().get(False);
+	Bool doMedian = function == 0;
+	Bool hasMaskedPixels = False;
+	if (doMedian) {
+		hasMaskedPixels = image->isMasked() || image->hasPixelMask();
 	}
 	std::auto_ptr<Array<Bool> > outMask(0);
-	Bool hasMaskedPixels = ! allTrue(mask);
+	LatticeStepper stepper(inShape, chunkShape, LatticeStepper::RESIZE);
 	for (stepper.reset(); !stepper.atEnd(); stepper++) {
 		Slicer slicer(stepper.position(), stepper.endPosition(), Slicer::endIsLast);
-		// Vector<T> kk(ary(slicer).tovector());
-		vector<T> data = ary(slicer).tovector();
+		Array<T> lines = reorderArray(image->getSlice(slicer), newOrder);
+		Array<Bool> maskLines;
 		if (hasMaskedPixels) {
-			Vector<Bool> maskSlice(mask(slicer).tovector());
-			if (! anyTrue(maskSlice)) {
-				if (outMask.get() == 0) {
-					outMask.reset(new Array<Bool>(outImage.shape(), True));
-				}
-				(*outMask)(stepper.position()) = False;
-				//kk.resize(0);
-				data.resize(0);
+			Array<Bool> mask = image->getMaskSlice(slicer);
+			if (image->hasPixelMask()) {
+				mask = mask && image->pixelMask().getSlice(slicer);
 			}
-			else if (! allTrue(maskSlice)) {
-				//vector<T> data = kk.tovector();
-				typename vector<T>::iterator diter = data.begin();
-				Vector<Bool>::iterator miter = maskSlice.begin();
-				while (diter != data.end()) {
-					if (! *miter) {
-						data.erase(diter);
-						if (diter == data.end()) {
-							break;
+			maskLines = reorderArray(mask, newOrder);
+		}
+		IPosition outChunkShape = slicer.length();
+		for (uInt j=0; j<_axes.size(); j++) {
+			outChunkShape[_axes[j]] = 1;
+		}
+		Array<T> outChunk(outChunkShape);
+		Array<Bool> outMaskChunk(outChunkShape, True);
+		Int64 nLines = outChunkShape.product();
+		T* linesData = lines.data();
+		const Bool* maskData = hasMaskedPixels ? maskLines.data() : 0;
+		T* outData = outChunk.data();
+		Bool* outMaskData = outMaskChunk.data();
+#ifdef _OPENMP
+#pragma omp parallel if (nLines > 1)
+#endif
+		{
+			vector<T> data;
+			if (doMedian) {
+				data.reserve(lineLength);
+			}
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 64)
+#endif
+			for (Int64 k=0; k<nLines; k++) {
+				T* line = linesData + k*lineLength;
+				if (! doMedian) {
+					Array<T> lineArray(IPosition(1, lineLength), line, SHARE);
+					outData[k] = function(lineArray);
+					continue;
+				}
+				if (hasMaskedPixels) {
+					const Bool* lineMask = maskData + k*lineLength;
+					data.resize(0);
+					for (Int64 p=0; p<lineLength; p++) {
+						if (lineMask[p]) {
+							data.push_back(line[p]);
 						}
 					}
-					else {
-						diter++;
-					}
-					miter++;
 				}
+				else {
+					data.assign(line, line + lineLength);
+				}
+				uInt s = data.size();
+				if (s == 0) {
+					outData[k] = 0;
+					outMaskData[k] = False;
+					continue;
+				}
+				// selection rather than a full sort; for an even number of
+				// values the next lower one is the largest of the lower half
+				typename vector<T>::iterator mid = data.begin() + s/2;
+				nth_element(data.begin(), mid, data.end());
+				outData[k] = s % 2 == 1
+					? *mid
+					: (*mid + *max_element(data.begin(), mid))/2;
 			}
 		}
-		uInt s = data.size();
-		if (s > 0) {
-			sort(data.begin(), data.end());
+		outImage.putSlice(outChunk, stepper.position());
+		if (! allTrue(outMaskChunk)) {
+			if (outMask.get() == 0) {
+				outMask.reset(new Array<Bool>(outImage.shape(), True));
+			}
+			(*outMask)(Slicer(stepper.position(), outChunkShape)) = outMaskChunk;
 		}
-		outImage.putAt(
-			s == 0
-				? 0
-				: s % 2 == 1
-				  ? data[s/2]
-				  : (data[s/2] + data[s/2 - 1])/2,
-			stepper.position()
-		);
 	}
 	if (outMask.get() != 0) {
 		_attachOutputMask(outImage, *outMask.get());
 	}
+	Double mb = inShape.product()*sizeof(T)/1048576.0;
+	Double secs = timer.real();
+	*this->_getLog() << LogOrigin(getClass(), __func__) << LogIO::NORMAL
+		<< "Collapsed " << mb << " MB in " << secs << " s";
+	if (secs > 0) {
+		*this->_getLog() << " (" << mb/secs << " MB/s)";
+	}
+	*this->_getLog() << LogIO::POST;
 }
 
 template<class T> void ImageCollapser<T>::_attachOutputMask(
@@ -31,12 +31,19 @@
 #include <imageanalysis/ImageAnalysis/SubImageFactory.h>
 #include <images/Images/ImageConcat.h>
 #include <images/Images/ImageRegrid.h>
+#include <lattices/Lattices/LatticeStepper.h>
 #include <scimath/Mathematics/Geometry.h>
 
+#include <casa/Arrays/ArrayLogical.h>
 #include <casa/BasicSL/STLIO.h>
+#include <casa/OS/Timer.h>
 #include <memory>
 #include <stdcasa/cboost_foreach.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace casa {
 
 const String  ImageRegridder::_class = "ImageRegridder";
@@ -50,7 +57,7 @@ ImageRegridder::ImageRegridder(
 ) : ImageRegridderBase<Float>(
 		image, regionRec, maskInp, outname,
 		overwrite, csysTo, axes, shape
-	), _debug(0) {}
+	), _debug(0), _parallelPlanes(False) {}
 
 ImageRegridder::ImageRegridder(
 	const SPCIIF image, const String& outname,
@@ -61,7 +68,7 @@ ImageRegridder::ImageRegridder(
 		image, regionRec, maskInp, outname, overwrite,
 		templateIm->coordinates(), axes, shape
 	),
-	_debug(0) {}
+	_debug(0), _parallelPlanes(False) {}
 
 ImageRegridder::~ImageRegridder() {}
 
@@ -125,14 +132,19 @@ SPIIF ImageRegridder::_regrid() const {
 		"There is no overlap between the (region chosen in) the input image"
 		" and the output image with respect to the axes being regridded."
 	);
-	ImageRegrid<Float> ir;
-	ir.showDebugInfo(_debug);
-	ir.disableReferenceConversions(! _getDoRefChange());
-	ir.regrid(
-		*workIm, _getMethod(), _getAxes(), *subImage,
-		_getReplicate(), _getDecimate(), True,
-		_getForceRegrid()
-	);
+	if (
+		! _parallelPlanes
+		|| ! _regridPlanes(*workIm, *subImage, coordsToRegrid)
+	) {
+		ImageRegrid<Float> ir;
+		ir.showDebugInfo(_debug);
+		ir.disableReferenceConversions(! _getDoRefChange());
+		ir.regrid(
+			*workIm, _getMethod(), _getAxes(), *subImage,
+			_getReplicate(), _getDecimate(), True,
+			_getForceRegrid()
+		);
+	}
 	if (! _getOutputStokes().empty()) {
 		workIm = _decimateStokes(workIm);
 	}
@@ -179,6 +191,190 @@ SPIIF ImageRegridder::_regrid() const {
 	return workIm;
 }
 
+Bool ImageRegridder::_regridPlanes(
+	ImageInterface<Float>& outIm, const ImageInterface<Float>& inIm,
+	const std::set<Coordinate::Type>& coordsToRegrid
+) const {
+	const Interpolate2D::Method method = _getMethod();
+	if (
+		coordsToRegrid.size() != 1
+		|| coordsToRegrid.find(Coordinate::DIRECTION) == coordsToRegrid.end()
+		|| (method != Interpolate2D::LINEAR && method != Interpolate2D::NEAREST)
+		|| _getReplicate() || ! outIm.hasPixelMask()
+	) {
+		return False;
+	}
+	const CoordinateSystem& csysIn = inIm.coordinates();
+	const CoordinateSystem& csysOut = outIm.coordinates();
+	const Int dcIn = csysIn.directionCoordinateNumber();
+	const Int dcOut = csysOut.directionCoordinateNumber();
+	if (dcIn < 0 || dcOut < 0) {
+		return False;
+	}
+	const Vector<Int> dirAxes = csysIn.directionAxesNumbers();
+	if (
+		anyLT(dirAxes, 0)
+		|| ! allEQ(dirAxes, csysOut.directionAxesNumbers())
+	) {
+		return False;
+	}
+	const DirectionCoordinate& dirIn = csysIn.directionCoordinate(dcIn);
+	const DirectionCoordinate& dirOut = csysOut.directionCoordinate(dcOut);
+	if (
+		_getDoRefChange()
+		&& dirIn.directionType() != dirOut.directionType()
+	) {
+		// needs a frame conversion per pixel, which ImageRegrid does
+		return False;
+	}
+	const IPosition inShape = inIm.shape();
+	const IPosition outShape = outIm.shape();
+	const uInt ndim = inShape.size();
+	if (outShape.size() != ndim) {
+		return False;
+	}
+	// the sky plane, with xAxis < yAxis
+	const uInt xAxis = min(dirAxes[0], dirAxes[1]);
+	const uInt yAxis = max(dirAxes[0], dirAxes[1]);
+	for (uInt i=0; i<ndim; ++i) {
+		if (i != xAxis && i != yAxis && inShape[i] != outShape[i]) {
+			return False;
+		}
+	}
+	const Bool linear = method == Interpolate2D::LINEAR;
+	const Int nxIn = inShape[xAxis];
+	const Int nyIn = inShape[yAxis];
+	if (linear && (nxIn < 2 || nyIn < 2)) {
+		return False;
+	}
+	const uInt nxOut = outShape[xAxis];
+	const uInt nyOut = outShape[yAxis];
+	const uInt nOut = nxOut*nyOut;
+	// Direction pixel axis 0 is longitude; the sky plane may be transposed
+	const uInt lon = dirAxes[0] < dirAxes[1] ? 0 : 1;
+	const uInt lat = 1 - lon;
+	Timer timer;
+	// Input pixel position of each output pixel of the sky plane. This is
+	// the same for every plane, so it is computed once.
+	Vector<Double> xIn(nOut), yIn(nOut);
+	Vector<Bool> mapped(nOut);
+	{
+		const uInt rowsPerChunk = max(1u, 1048576u/nxOut);
+		Matrix<Double> pixel, world;
+		Vector<Bool> failOut, failIn;
+		for (uInt y0=0; y0<nyOut; y0+=rowsPerChunk) {
+			const uInt nRows = min(rowsPerChunk, nyOut - y0);
+			const uInt n = nRows*nxOut;
+			pixel.resize(2, n);
+			for (uInt j=0; j<nRows; ++j) {
+				for (uInt i=0; i<nxOut; ++i) {
+					const uInt k = j*nxOut + i;
+					pixel(lon, k) = i;
+					pixel(lat, k) = y0 + j;
+				}
+			}
+			dirOut.toWorldMany(world, pixel, failOut);
+			dirIn.toPixelMany(pixel, world, failIn);
+			for (uInt k=0; k<n; ++k) {
+				const uInt kOut = y0*nxOut + k;
+				mapped[kOut] = ! failOut[k] && ! failIn[k];
+				xIn[kOut] = pixel(lon, k);
+				yIn[kOut] = pixel(lat, k);
+			}
+		}
+	}
+	const Double mapTime = timer.real();
+	IPosition inCursor(ndim, 1);
+	inCursor[xAxis] = nxIn;
+	inCursor[yAxis] = nyIn;
+	IPosition outCursor(ndim, 1);
+	outCursor[xAxis] = nxOut;
+	outCursor[yAxis] = nyOut;
+	const Bool inMasked = inIm.isMasked();
+	Bool delX, delY, delMapped;
+	const Double *px = xIn.getStorage(delX);
+	const Double *py = yIn.getStorage(delY);
+	const Bool *pMapped = mapped.getStorage(delMapped);
+	Array<Float> outPix(outCursor);
+	Array<Bool> outMask(outCursor);
+	Array<Bool> inMask;
+	uInt nPlanes = 0;
+	LatticeStepper stepper(inShape, inCursor);
+	for (stepper.reset(); ! stepper.atEnd(); stepper++) {
+		const IPosition pos = stepper.position();
+		const Array<Float> inPix = inIm.getSlice(pos, inCursor);
+		if (inMasked) {
+			inMask = inIm.getMaskSlice(pos, inCursor);
+		}
+		Bool delIn, delInMask, delOut, delOutMask;
+		const Float *pIn = inPix.getStorage(delIn);
+		const Bool *pInMask = inMasked ? inMask.getStorage(delInMask) : 0;
+		Float *pOut = outPix.getStorage(delOut);
+		Bool *pOutMask = outMask.getStorage(delOutMask);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+		for (Int k=0; k<Int(nOut); ++k) {
+			const Double x = px[k];
+			const Double y = py[k];
+			Float value = 0;
+			Bool good = pMapped[k];
+			if (! good) {
+				// coordinate conversion failed
+			}
+			else if (linear) {
+				// bilinear, as Interpolate2D::LINEAR
+				good = x >= 0 && y >= 0 && x <= nxIn - 1 && y <= nyIn - 1;
+				if (good) {
+					const Int i = min(Int(x), nxIn - 2);
+					const Int j = min(Int(y), nyIn - 2);
+					const Int k00 = j*nxIn + i;
+					const Int k01 = k00 + nxIn;
+					if (pInMask) {
+						good = pInMask[k00] && pInMask[k00 + 1]
+							&& pInMask[k01] && pInMask[k01 + 1];
+					}
+					const Double dx = x - i;
+					const Double dy = y - j;
+					value = (1 - dy)*((1 - dx)*pIn[k00] + dx*pIn[k00 + 1])
+						+ dy*((1 - dx)*pIn[k01] + dx*pIn[k01 + 1]);
+				}
+			}
+			else {
+				const Int i = Int(floor(x + 0.5));
+				const Int j = Int(floor(y + 0.5));
+				good = i >= 0 && j >= 0 && i < nxIn && j < nyIn;
+				if (good) {
+					const Int kIn = j*nxIn + i;
+					good = ! pInMask || pInMask[kIn];
+					value = pIn[kIn];
+				}
+			}
+			pOut[k] = good ? value : 0;
+			pOutMask[k] = good;
+		}
+		inPix.freeStorage(pIn, delIn);
+		if (pInMask) {
+			inMask.freeStorage(pInMask, delInMask);
+		}
+		outPix.putStorage(pOut, delOut);
+		outMask.putStorage(pOutMask, delOutMask);
+		// the plane is at the same position in the output except
+		// along the sky axes, which start at 0 in both
+		outIm.putSlice(outPix, pos);
+		outIm.pixelMask().putSlice(outMask, pos);
+		++nPlanes;
+	}
+	xIn.freeStorage(px, delX);
+	yIn.freeStorage(py, delY);
+	mapped.freeStorage(pMapped, delMapped);
+	*this->_getLog() << LogOrigin(_class, __func__) << LogIO::NORMAL
+		<< "Regridded " << nPlanes << " plane(s) of " << nxOut << " x "
+		<< nyOut << " pixels in " << timer.real() << " s (pixel mapping "
+		<< mapTime << " s)" << LogIO::POST;
+	return True;
+}
+
 SPIIF ImageRegridder::_decimateStokes(SPIIF workIm) const {
 	ImageMetaData md(workIm);
 	if (_getOutputStokes().size() >= md.nStokes()) {
@@ -93,8 +93,16 @@ public:
 
 	void setDebug(Int debug) { _debug = debug; }
 
+	// If True, regridding of only the direction axes with the linear or nearest
+	// interpolation methods computes the output to input pixel mapping once for
+	// the sky plane and interpolates the pixels of each plane in parallel,
+	// rather than going through ImageRegrid. Other configurations always use
+	// ImageRegrid. Default is False.
+	void setParallelPlanes(Bool b) { _parallelPlanes = b; }
+
 private:
 	Int _debug;
+	Bool _parallelPlanes;
 	static const String _class;
 
 	// disallow default constructor
@@ -121,6 +129,15 @@ private:
 
 	SPIIF _decimateStokes(SPIIF workIm) const;
 
+	// Regrid the direction axes of <src>inIm</src> into <src>outIm</src>
+	// plane by plane using one output to input pixel mapping for all planes.
+	// Returns False, without touching <src>outIm</src>, if the configuration
+	// is not one this supports, in which case ImageRegrid must be used.
+	Bool _regridPlanes(
+		ImageInterface<Float>& outIm, const ImageInterface<Float>& inIm,
+		const std::set<Coordinate::Type>& coordsToRegrid
+	) const;
+
 	static Bool _doRectanglesIntersect(
 		const Vector<std::pair<Double, Double> >& corners0,
 		const Vector<std::pair<Double, Double> >& corners1
@@ -0,0 +1,144 @@
+//# dImageRegridder.cc: compare the ImageRegrid and per-plane regridding paths
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+// Usage: dImageRegridder [npix [nchan [method]]]
+//
+// Regrids a synthetic cube onto a shifted, rescaled and rotated sky grid
+// with ImageRegridder, once through ImageRegrid and once with
+// setParallelPlanes(True), checks that they agree and prints the time each
+// took. Without arguments a small cube is used so that it can run as a
+// test; e.g. "dImageRegridder 2048 256 linear" times a representative cube.
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/stdlib.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/MaskedArray.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/Timer.h>
+#include <casa/Utilities/Assert.h>
+#include <coordinates/Coordinates/CoordinateUtil.h>
+#include <coordinates/Coordinates/DirectionCoordinate.h>
+#include <imageanalysis/ImageAnalysis/ImageRegridder.h>
+#include <images/Images/TempImage.h>
+
+#include <casa/namespace.h>
+
+int main(int argc, char **argv)
+{
+  try {
+    Int npix = 128;
+    Int nchan = 8;
+    String method = "linear";
+    if (argc > 1) npix = atoi(argv[1]);
+    if (argc > 2) nchan = atoi(argv[2]);
+    if (argc > 3) method = argv[3];
+
+    // A few Gaussian sources per channel, with a masked corner
+    CoordinateSystem csys = CoordinateUtil::defaultCoords3D();
+    const IPosition shape(3, npix, npix, nchan);
+    SHARED_PTR<TempImage<Float> > image(new TempImage<Float>(shape, csys));
+    Array<Float> pixels(shape);
+    Array<Bool> mask(shape, True);
+    const Double sigma = npix/16.0;
+    for (Int k = 0; k < nchan; k++) {
+      for (Int j = 0; j < npix; j++) {
+	for (Int i = 0; i < npix; i++) {
+	  const IPosition pos(3, i, j, k);
+	  Double v = 0;
+	  for (Int s = 0; s < 3; s++) {
+	    const Double dx = i - npix*(0.3 + 0.2*s);
+	    const Double dy = j - npix*(0.6 - 0.15*s + 0.01*k);
+	    v += (1.0 + s)*exp(-0.5*(dx*dx + dy*dy)/(sigma*sigma));
+	  }
+	  pixels(pos) = v;
+	  mask(pos) = i > npix/8 || j > npix/8;
+	}
+      }
+    }
+    image->put(pixels);
+    image->attachMask(ArrayLattice<Bool>(mask));
+
+    // Output grid: shifted by a few pixels, 20% finer and rotated by 10 deg
+    CoordinateSystem csysTo = csys;
+    DirectionCoordinate dc = csysTo.directionCoordinate(
+      csysTo.directionCoordinateNumber()
+    );
+    Vector<Double> refPix = dc.referencePixel();
+    refPix += 3.5;
+    dc.setReferencePixel(refPix);
+    dc.setIncrement(dc.increment()*0.8);
+    Matrix<Double> xform(2, 2);
+    const Double pa = 10.0*C::pi/180.0;
+    xform(0, 0) = cos(pa);
+    xform(0, 1) = -sin(pa);
+    xform(1, 0) = sin(pa);
+    xform(1, 1) = cos(pa);
+    dc.setLinearTransform(xform);
+    csysTo.replaceCoordinate(dc, csysTo.directionCoordinateNumber());
+
+    SPIIF results[2];
+    Timer timer;
+    for (uInt p = 0; p < 2; p++) {
+      ImageRegridder regridder(
+	image, 0, "", "", False, csysTo, IPosition(2, 0, 1), shape
+      );
+      regridder.setMethod(method);
+      regridder.setDecimate(0);
+      regridder.setParallelPlanes(p == 1);
+      timer.mark();
+      results[p] = regridder.regrid();
+      cout << (p == 0 ? "ImageRegrid    : " : "parallel planes: ")
+	   << timer.real() << " s" << endl;
+    }
+
+    const Array<Bool> mask0 = results[0]->getMask();
+    const Array<Bool> mask1 = results[1]->getMask();
+    const Array<Float> pix0 = results[0]->get();
+    const Array<Float> pix1 = results[1]->get();
+    // The two paths may disagree on whether a pixel on the edge of the
+    // input grid is interpolable, but nowhere else.
+    const uInt nDiffMask = ntrue(mask0 != mask1);
+    cout << "mask differences: " << nDiffMask << endl;
+    AlwaysAssert(nDiffMask <= uInt(4*npix*nchan), AipsError);
+    const Array<Bool> both = mask0 && mask1;
+    AlwaysAssert(ntrue(both) > 0, AipsError);
+    Array<Float> diff = abs(pix0 - pix1);
+    diff(! both) = 0.0f;
+    cout << "max difference: " << max(diff) << endl;
+    AlwaysAssert(max(diff) < 1e-4*max(pixels), AipsError);
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -31,6 +31,7 @@
 #include <components/ComponentModels/ComponentType.h>
 #include <components/ComponentModels/ConstantSpectrum.h>
 #include <components/ComponentModels/Flux.h>
+#include <components/ComponentModels/GaussianShape.h>
 #include <components/ComponentModels/PointShape.h>
 #include <components/ComponentModels/SkyComponent.h>
 #include <components/ComponentModels/SpectralIndex.h>
@@ -145,6 +146,63 @@ int main() {
       image3D.table().markForDelete();
     }
     cerr << "Passed the 3-D Image test" << endl;
+    {
+      // Many small Gaussians, each covering only part of the image, must
+      // give the same pixel values as sampling the whole list directly.
+      const uInt n = 32;
+      CoordinateSystem coords;
+      CoordinateUtil::addDirAxes(coords);
+      CoordinateUtil::addIAxis(coords);
+      DirectionCoordinate dirCoord = coords.directionCoordinate(0);
+      dirCoord.setReferencePixel(Vector<Double>(2, n/2));
+      dirCoord.setWorldAxisUnits(Vector<String>(2, "arcsec"));
+      {
+	Vector<Double> inc(2, 1.0);
+	inc(0) = -1.0;
+	dirCoord.setIncrement(inc);
+      }
+      coords.replaceCoordinate(dirCoord, 0);
+      ComponentList glist;
+      for (uInt i = 0; i < 20; i++) {
+	const MDirection dir(Quantity(Double(Int(i*7 % 25) - 12), "arcsec"),
+			     Quantity(Double(Int(i*11 % 27) - 13), "arcsec"),
+			     MDirection::J2000);
+	SkyComponent c(Flux<Double>(1.0 + i),
+		       GaussianShape(dir, Quantity(2.0 + i%3, "arcsec"),
+				     Quantity(1.5, "arcsec"),
+				     Quantity(30.0*i, "deg")),
+		       ConstantSpectrum());
+	glist.add(c);
+      }
+      PagedImage<Float>
+	image((TiledShape(IPosition(3, n, n, 1))), coords,
+	      File::newUniqueName("./", "tComponentImager_tmp_")
+	      .absoluteName());
+      image.setUnits(Unit("Jy/pixel"));
+      image.set(0.0f);
+      ComponentImager::project(image, glist);
+      const MVAngle pixSize(Quantity(1.0, "arcsec"));
+      const MFrequency freq = glist.component(0).spectrum().refFrequency();
+      DirectionCoordinate worldCoord = coords.directionCoordinate(0);
+      MDirection pixDir;
+      Vector<Double> pix(2);
+      IPosition pos(3, 0);
+      for (uInt y = 0; y < n; y++) {
+	for (uInt x = 0; x < n; x++) {
+	  pix(0) = x;
+	  pix(1) = y;
+	  AlwaysAssert(worldCoord.toWorld(pixDir, pix), AipsError);
+	  const Double expected =
+	    glist.sample(pixDir, pixSize, pixSize, freq).value(0).real();
+	  pos(0) = x;
+	  pos(1) = y;
+	  AlwaysAssert(nearAbs(Double(image.getAt(pos)), expected, 1e-6),
+		       AipsError);
+	}
+      }
+      image.table().markForDelete();
+    }
+    cerr << "Passed the many component test" << endl;
   }
   catch (AipsError x) {
     cerr << x.getMesg() << endl;
@@ -21,6 +21,7 @@
 //# $Id: $
 
 #include <mstransform/MSTransform/MSTransformManager.h>
+#include <msvis/MSVis/UtilJ.h>
 
 
 
@@ -4852,6 +4853,14 @@ void MSTransformManager::setupBufferTransformations(vi::VisBuffer2 *vb)
 // -----------------------------------------------------------------------
 void MSTransformManager::fillOutputMs(vi::VisBuffer2 *vb)
 {
+	utilj::InstrumentationTimer fillTimer("MSTransformManager.fillOutputMs");
+	if (utilj::Instrumentation::isEnabled())
+	{
+		utilj::Instrumentation::addCount("MSTransformManager.rows",vb->nRows());
+		utilj::Instrumentation::addBytes("MSTransformManager.inputBytes",
+				Int64(vb->nRows())*vb->nChannels()*vb->nCorrelations()*sizeof(Complex));
+	}
+
 	setupBufferTransformations(vb);
 
 	if (not bufferMode_p)
@@ -4866,9 +4875,18 @@ void MSTransformManager::fillOutputMs(vi::VisBuffer2 *vb)
 		// Fill new rows
 		weightSpectrumFlatFilled_p = False;
 		weightSpectrumFromSigmaFilled_p = False;
-	    fillWeightCols(vb,rowRef);
-	    fillDataCols(vb,rowRef);
-		fillIdCols(vb,rowRef);
+		{
+			utilj::InstrumentationTimer timer("MSTransformManager.fillWeightCols");
+			fillWeightCols(vb,rowRef);
+		}
+		{
+			utilj::InstrumentationTimer timer("MSTransformManager.fillDataCols");
+			fillDataCols(vb,rowRef);
+		}
+		{
+			utilj::InstrumentationTimer timer("MSTransformManager.fillIdCols");
+			fillIdCols(vb,rowRef);
+		}
 	}
 
     return;
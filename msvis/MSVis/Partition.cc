@@ -88,14 +88,207 @@
 #include <casa/sstream.h>
 #include <casa/iomanip.h>
 #include <functional>
+#include <algorithm>
+#include <map>
+#include <vector>
 #include <measures/Measures/MeasTable.h>
 #include <casa/Quanta/MVTime.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace casa {
 
 //typedef ROVisibilityIterator ROVisIter;
 //typedef VisibilityIterator VisIter;
 
+// Memory used for each of the two row buffers of makePartitions(); the
+// rows gathered for the outputs take as much again.
+static const Double maxPartitionBlockBytes = 128.0 * 1024.0 * 1024.0;
+
+namespace {
+
+// The rows of one block of the selected MS that makePartitions() copies in
+// one go.  Rows are grouped by DATA_DESC_ID so that the array cells of a
+// group all have the same shape.
+struct PartitionBlock {
+  // Selected MS rows of each group.
+  Block<Vector<uInt> > inRows;
+  // For group g and output k (index g*nOut + k): the positions within
+  // inRows[g] of the rows going to k, and their row numbers in k.
+  Block<Vector<uInt> > outIdx, outRows;
+};
+
+// Copy the cells at positions idx of the last axis of in to out.
+template<class T>
+void gatherRows(const Array<T>& in, const Vector<uInt>& idx, Array<T>& out)
+{
+  IPosition shp(in.shape());
+  const uInt last = shp.nelements() - 1;
+  const uInt cell = in.nelements() / shp(last);
+  shp(last) = idx.nelements();
+  out.resize(shp);
+
+  Bool delin, delout;
+  const T* inp = in.getStorage(delin);
+  T* outp = out.getStorage(delout);
+  for(uInt j = 0; j < idx.nelements(); ++j)
+    std::copy(inp + idx[j] * cell, inp + (idx[j] + 1) * cell, outp + j * cell);
+  in.freeStorage(inp, delin);
+  out.putStorage(outp, delout);
+}
+
+// Copies one column of the selected MS to every output.  There are two
+// read buffers, so that the rows of one block can be gathered for the
+// outputs, in memory, while the next block is read.  read() and write()
+// use the table system; gather() does not.
+class PartitionCopier {
+public:
+  virtual ~PartitionCopier() {}
+  virtual void read(const uInt slot, const PartitionBlock& blk) = 0;
+  virtual void gather(const uInt slot, const PartitionBlock& blk) = 0;
+  virtual void write(const uInt k, const PartitionBlock& blk) = 0;
+  Double bytesRead() const {return bytes_p;}
+protected:
+  PartitionCopier() : bytes_p(0.0) {}
+  Double bytes_p;
+};
+
+template<class T>
+class PartitionScalarCopier : public PartitionCopier {
+public:
+  PartitionScalarCopier(const Table& in, const std::vector<MeasurementSet*>& outs,
+			const String& colname) :
+    in_p(in, colname), out_p(outs.size())
+  {
+    for(uInt k = 0; k < outs.size(); ++k)
+      out_p[k] = new ScalarColumn<T>(*outs[k], colname);
+  }
+  ~PartitionScalarCopier()
+  {
+    for(uInt k = 0; k < out_p.size(); ++k)
+      delete out_p[k];
+  }
+  void read(const uInt slot, const PartitionBlock& blk)
+  {
+    const uInt ngroups = blk.inRows.nelements();
+    buf_p[slot].resize(ngroups, True, False);
+    for(uInt g = 0; g < ngroups; ++g){
+      in_p.getColumnCells(RefRows(blk.inRows[g], False, True), buf_p[slot][g], True);
+      bytes_p += buf_p[slot][g].nelements() * sizeof(T);
+    }
+  }
+  void gather(const uInt slot, const PartitionBlock& blk)
+  {
+    const uInt nOut = out_p.size();
+    gathered_p.resize(blk.outIdx.nelements(), True, False);
+    for(uInt g = 0; g < buf_p[slot].nelements(); ++g)
+      for(uInt k = 0; k < nOut; ++k)
+	if(blk.outIdx[g * nOut + k].nelements() > 0)
+	  gatherRows(buf_p[slot][g], blk.outIdx[g * nOut + k], gathered_p[g * nOut + k]);
+  }
+  void write(const uInt k, const PartitionBlock& blk)
+  {
+    for(uInt i = k; i < blk.outRows.nelements(); i += out_p.size())
+      if(blk.outRows[i].nelements() > 0)
+	out_p[k]->putColumnCells(RefRows(blk.outRows[i], False, True), gathered_p[i]);
+  }
+private:
+  ROScalarColumn<T> in_p;
+  std::vector<ScalarColumn<T>*> out_p;
+  Block<Vector<T> > buf_p[2];
+  Block<Vector<T> > gathered_p;
+};
+
+template<class T>
+class PartitionArrayCopier : public PartitionCopier {
+public:
+  PartitionArrayCopier(const Table& in, const std::vector<MeasurementSet*>& outs,
+		       const String& incolname, const String& outcolname) :
+    in_p(in, incolname), out_p(outs.size())
+  {
+    for(uInt k = 0; k < outs.size(); ++k)
+      out_p[k] = new ArrayColumn<T>(*outs[k], outcolname);
+  }
+  ~PartitionArrayCopier()
+  {
+    for(uInt k = 0; k < out_p.size(); ++k)
+      delete out_p[k];
+  }
+  void read(const uInt slot, const PartitionBlock& blk)
+  {
+    const uInt ngroups = blk.inRows.nelements();
+    buf_p[slot].resize(ngroups, True, False);
+    for(uInt g = 0; g < ngroups; ++g){
+      in_p.getColumnCells(RefRows(blk.inRows[g], False, True), buf_p[slot][g], True);
+      bytes_p += buf_p[slot][g].nelements() * sizeof(T);
+    }
+  }
+  void gather(const uInt slot, const PartitionBlock& blk)
+  {
+    const uInt nOut = out_p.size();
+    gathered_p.resize(blk.outIdx.nelements(), True, False);
+    for(uInt g = 0; g < buf_p[slot].nelements(); ++g)
+      for(uInt k = 0; k < nOut; ++k)
+	if(blk.outIdx[g * nOut + k].nelements() > 0)
+	  gatherRows(buf_p[slot][g], blk.outIdx[g * nOut + k], gathered_p[g * nOut + k]);
+  }
+  void write(const uInt k, const PartitionBlock& blk)
+  {
+    for(uInt i = k; i < blk.outRows.nelements(); i += out_p.size())
+      if(blk.outRows[i].nelements() > 0)
+	out_p[k]->putColumnCells(RefRows(blk.outRows[i], False, True), gathered_p[i]);
+  }
+private:
+  ROArrayColumn<T> in_p;
+  std::vector<ArrayColumn<T>*> out_p;
+  Block<Array<T> > buf_p[2];
+  Block<Array<T> > gathered_p;
+};
+
+// Split rows [r0, r1) of the selection into DATA_DESC_ID groups and work out
+// where they go.  nextOutRow holds the next free row of each output.
+void planPartitionBlock(PartitionBlock& blk, const uInt r0, const uInt r1,
+			const Vector<Int>& ddid, const Vector<Int>& outOfRow,
+			Vector<uInt>& nextOutRow)
+{
+  const uInt nOut = nextOutRow.nelements();
+  std::map<Int, uInt> groupOfDDID;
+  std::vector<std::vector<uInt> > inRows;
+  std::vector<std::vector<uInt> > outIdx, outRows;
+  for(uInt r = r0; r < r1; ++r){
+    std::map<Int, uInt>::iterator it = groupOfDDID.find(ddid[r]);
+    uInt g;
+    if(it == groupOfDDID.end()){
+      g = inRows.size();
+      groupOfDDID[ddid[r]] = g;
+      inRows.resize(g + 1);
+      outIdx.resize((g + 1) * nOut);
+      outRows.resize((g + 1) * nOut);
+    }
+    else
+      g = it->second;
+    const uInt k = outOfRow[r];
+    outIdx[g * nOut + k].push_back(inRows[g].size());
+    outRows[g * nOut + k].push_back(nextOutRow[k]++);
+    inRows[g].push_back(r);
+  }
+
+  blk.inRows.resize(inRows.size(), True, False);
+  blk.outIdx.resize(outIdx.size(), True, False);
+  blk.outRows.resize(outRows.size(), True, False);
+  for(uInt g = 0; g < inRows.size(); ++g)
+    blk.inRows[g].reference(Vector<uInt>(inRows[g]));
+  for(uInt i = 0; i < outIdx.size(); ++i){
+    blk.outIdx[i].reference(Vector<uInt>(outIdx[i]));
+    blk.outRows[i].reference(Vector<uInt>(outRows[i]));
+  }
+}
+
+} // anonymous namespace
+
+
 Partition::Partition(String& theMS, Table::TableOption option) :
 		  ms_p(MeasurementSet(theMS, option)),
 		  mssel_p(ms_p),
@@ -338,98 +531,7 @@ Bool Partition::makePartition(String& msname, String& colname,
 		mscIn_p = new ROMSColumns(mssel_p);
 		// Note again the parseColumnNames() a few lines back that stops setupMS()
 		// from being called if the MS doesn't have the requested columns.
-		MeasurementSet* outpointer=0;
-
-		if(tileShape.nelements() == 3){
-			outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
-					colNamesTok, tileShape);
-
-		}
-		// the following calls MSTileLayout...  disabled for now because it
-		// forces tiles to be the full spw bandwidth in width (gmoellen, 2010/11/07)
-		/*
-      else if((tileShape.nelements()==1) && (tileShape[0]==0 || tileShape[0]==1)){
-      outpointer = setupMS(msname, nchan_p[0], ncorr_p[0],
-      mscIn_p->observation().telescopeName()(0),
-      colNamesTok, tileShape[0]);
-      }
-		 */
-		else{
-
-			// Derive tile shape based on input dataset's tiles, borrowed
-			//  from VisSet's scr col tile shape derivation
-			//  (this may need some tweaking for averaging cases)
-			TableDesc td = mssel_p.actualTableDesc();
-
-			// If a non-DATA column, i.e. CORRECTED_DATA, is being written to DATA,
-			// datacolname must be set to DATA because the tile management in
-			// setupMS() will look for "TiledDATA", not "TiledCorrectedData".
-			String datacolname = MS::columnName(MS::DATA);
-			// But if DATA is not present in the input MS, using it would cause a
-			// segfault.
-			if(!td.isColumn(datacolname))
-				// This is could be any other kind of *DATA column, including
-				// FLOAT_DATA or LAG_DATA, but it is guaranteed to be something.
-				datacolname = MS::columnName(colNamesTok[0]);
-
-			const ColumnDesc& cdesc = td[datacolname];
-
-			String dataManType = cdesc.dataManagerType();
-			String dataManGroup = cdesc.dataManagerGroup();
-
-			Bool tiled = (dataManType.contains("Tiled"));
-
-			if (tiled) {
-				ROTiledStManAccessor tsm(mssel_p, dataManGroup);
-				uInt nHyper = tsm.nhypercubes();
-
-				// Test clause
-				if(1){
-					os << LogIO::DEBUG1
-							<< datacolname << "'s max cache size: "
-							<< tsm.maximumCacheSize() << " bytes.\n"
-							<< "\tnhypercubes: " << nHyper << ".\n"
-							<< "\ttshp of row 0: " << tsm.tileShape(0)
-							<< "\n\thypercube shape of row 0: " << tsm.hypercubeShape(0)
-							<< LogIO::POST;
-				}
-
-
-				// Find smallest tile shape
-				Int highestProduct=-INT_MAX;
-				Int highestId=0;
-				for (uInt id=0; id < nHyper; id++) {
-					IPosition tshp(tsm.getTileShape(id));
-					Int product = tshp.product();
-
-					os << LogIO::DEBUG2
-							<< "\thypercube " << id << ":\n"
-							<< "\t\ttshp: " << tshp << "\n"
-							<< "\t\thypercube shape: " << tsm.getHypercubeShape(id)
-							<< ".\n\t\tcache size: " << tsm.getCacheSize(id)
-							<< " buckets.\n\t\tBucket size: " << tsm.getBucketSize(id)
-							<< " bytes."
-							<< LogIO::POST;
-
-					if (product > 0 && (product > highestProduct)) {
-						highestProduct = product;
-						highestId = id;
-					}
-				}
-				Vector<Int> dataTileShape = tsm.getTileShape(highestId).asVector();
-
-				outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
-						colNamesTok, dataTileShape);
-
-			}
-			else
-				//Sweep all other cases of bad tileshape to a default one.
-				//  (this probably never happens)
-				outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
-						mscIn_p->observation().telescopeName()(0),
-						colNamesTok, 0);
-
-		}
+		MeasurementSet* outpointer = setupPartitionMS(msname, colNamesTok, tileShape);
 
 		combine_p = combine;
 
@@ -483,6 +585,375 @@ Bool Partition::makePartition(String& msname, String& colname,
 
 }
 
+Bool Partition::makePartitions(const Vector<String>& msnames, String& colname,
+		const String& separationAxis, const Matrix<Int>& tileShapes)
+{
+	LogIO os(LogOrigin("Partition", "makePartitions()"));
+	const uInt nOut = msnames.nelements();
+	if(nOut == 0){
+		os << LogIO::SEVERE << "No output MS names were given." << LogIO::POST;
+		return False;
+	}
+	if(timeBin_p > 0.0){
+		os << LogIO::SEVERE
+				<< "Time averaging is not supported when making several partitions"
+				<< " at once; use makePartition() for each of them."
+				<< LogIO::POST;
+		ms_p=MeasurementSet();
+		return False;
+	}
+
+	std::vector<MeasurementSet*> outs;
+	std::vector<PartitionCopier*> copiers;
+	try{
+		if((spw_p.nelements()>0) && (max(spw_p) >= Int(ms_p.spectralWindow().nrow()))){
+			os << LogIO::SEVERE
+					<< "SpectralWindow selection contains elements that do not exist in "
+					<< "this MS"
+					<< LogIO::POST;
+			ms_p=MeasurementSet();
+			return False;
+		}
+
+		const Vector<MS::PredefinedColumns> colNamesTok = SubMS::parseColumnNames(colname,
+				ms_p);
+
+		if(!makeSelection()){
+			os << LogIO::SEVERE
+					<< "Failed on selection: the combination of spw, field, antenna, correlation, "
+					<< "and timerange may be invalid."
+					<< LogIO::POST;
+			ms_p = MeasurementSet();
+			return False;
+		}
+		delete mscIn_p;
+		mscIn_p = new ROMSColumns(mssel_p);
+
+		// Decide which output every selected row goes to.
+		const uInt nrow = mssel_p.nrow();
+		const String axis = downcase(separationAxis);
+		Vector<Int> outOfRow(nrow);
+		if(axis == "row"){
+			for(uInt r = 0; r < nrow; ++r)
+				outOfRow[r] = Int((Double(r) * nOut) / nrow);
+		}
+		else{
+			Vector<Int> key;
+			if(axis == "scan")
+				key = mscIn_p->scanNumber().getColumn();
+			else if(axis == "spw"){
+				// Several DATA_DESC_IDs can share a spw (e.g. with different
+				// polarization setups); they go to the same output.
+				const Vector<Int> spwOfDDID =
+						mscIn_p->dataDescription().spectralWindowId().getColumn();
+				key = mscIn_p->dataDescId().getColumn();
+				for(uInt r = 0; r < nrow; ++r)
+					key[r] = spwOfDDID[key[r]];
+			}
+			else
+				throw(AipsError("Unrecognized separation axis: " + separationAxis
+						+ " (use scan, spw or row)"));
+
+			// Hand out the scans (or spws) biggest first, each to the output with
+			// the fewest rows so far.
+			std::map<Int, uInt> nRowsOfKey;
+			for(uInt r = 0; r < nrow; ++r)
+				++nRowsOfKey[key[r]];
+			std::vector<std::pair<uInt, Int> > bySize;
+			for(std::map<Int, uInt>::const_iterator it = nRowsOfKey.begin();
+					it != nRowsOfKey.end(); ++it)
+				bySize.push_back(std::make_pair(it->second, it->first));
+			std::sort(bySize.rbegin(), bySize.rend());
+			std::vector<uInt> load(nOut, 0);
+			std::map<Int, Int> outOfKey;
+			for(uInt i = 0; i < bySize.size(); ++i){
+				const uInt k = std::min_element(load.begin(), load.end()) - load.begin();
+				load[k] += bySize[i].first;
+				outOfKey[bySize[i].second] = k;
+			}
+			for(uInt r = 0; r < nrow; ++r)
+				outOfRow[r] = outOfKey[key[r]];
+		}
+		Vector<uInt> nOutRows(nOut, 0);
+		for(uInt r = 0; r < nrow; ++r)
+			++nOutRows[outOfRow[r]];
+
+		// Create the outputs.  This goes through the table system's global
+		// state, so it is done serially.
+		for(uInt k = 0; k < nOut; ++k){
+			const Vector<Int> tileShape = (tileShapes.nrow() == 3 && k < tileShapes.ncolumn()) ?
+					Vector<Int>(tileShapes.column(k)) : Vector<Int>(1, 0);
+			outs.push_back(setupPartitionMS(msnames[k], colNamesTok, tileShape));
+
+			MSMainColumns msc(*outs[k]);
+			msc.setEpochRef(MEpoch::castType(mscIn_p->timeMeas().getMeasRef().getType()),
+					False);
+			msc.uvwMeas().setDescRefCode(Muvw::castType(mscIn_p->uvwMeas().getMeasRef().getType()));
+			outs[k]->addRow(nOutRows[k], True);
+			os << LogIO::NORMAL << msnames[k] << ": " << nOutRows[k] << " rows."
+					<< LogIO::POST;
+		}
+
+		// The columns to copy; see fillMainTable().
+		const MS::PredefinedColumns scalarInts[] = {
+				MS::ANTENNA1, MS::ANTENNA2, MS::FEED1, MS::FEED2, MS::SCAN_NUMBER,
+				MS::DATA_DESC_ID, MS::FIELD_ID, MS::ARRAY_ID, MS::STATE_ID,
+				MS::PROCESSOR_ID, MS::OBSERVATION_ID};
+		for(uInt i = 0; i < sizeof(scalarInts) / sizeof(scalarInts[0]); ++i)
+			copiers.push_back(new PartitionScalarCopier<Int>(mssel_p, outs,
+					MS::columnName(scalarInts[i])));
+		const MS::PredefinedColumns scalarDoubles[] = {
+				MS::EXPOSURE, MS::INTERVAL, MS::TIME, MS::TIME_CENTROID};
+		for(uInt i = 0; i < sizeof(scalarDoubles) / sizeof(scalarDoubles[0]); ++i)
+			copiers.push_back(new PartitionScalarCopier<Double>(mssel_p, outs,
+					MS::columnName(scalarDoubles[i])));
+		copiers.push_back(new PartitionScalarCopier<Bool>(mssel_p, outs,
+				MS::columnName(MS::FLAG_ROW)));
+		copiers.push_back(new PartitionArrayCopier<Double>(mssel_p, outs,
+				MS::columnName(MS::UVW), MS::columnName(MS::UVW)));
+		copiers.push_back(new PartitionArrayCopier<Float>(mssel_p, outs,
+				MS::columnName(MS::WEIGHT), MS::columnName(MS::WEIGHT)));
+		copiers.push_back(new PartitionArrayCopier<Float>(mssel_p, outs,
+				MS::columnName(MS::SIGMA), MS::columnName(MS::SIGMA)));
+		copiers.push_back(new PartitionArrayCopier<Bool>(mssel_p, outs,
+				MS::columnName(MS::FLAG), MS::columnName(MS::FLAG)));
+		if(!mscIn_p->weightSpectrum().isNull() && mscIn_p->weightSpectrum().isDefined(0))
+			copiers.push_back(new PartitionArrayCopier<Float>(mssel_p, outs,
+					MS::columnName(MS::WEIGHT_SPECTRUM), MS::columnName(MS::WEIGHT_SPECTRUM)));
+		if(!mscIn_p->flagCategory().isNull() && mscIn_p->flagCategory().isDefined(0)){
+			IPosition fcshape(mscIn_p->flagCategory().shape(0));
+			IPosition fshape(mscIn_p->flag().shape(0));
+			if(fcshape(0) == fshape(0) && fcshape(1) == fshape(1))
+				copiers.push_back(new PartitionArrayCopier<Bool>(mssel_p, outs,
+						MS::columnName(MS::FLAG_CATEGORY), MS::columnName(MS::FLAG_CATEGORY)));
+		}
+
+		Vector<MS::PredefinedColumns> complexCols;
+		const Bool doFloat = SubMS::sepFloat(colNamesTok, complexCols);
+		const uInt nDataCols = complexCols.nelements();
+		const Bool writeToDataCol = SubMS::mustConvertToData(nDataCols, complexCols);
+		for(uInt i = 0; i < nDataCols; ++i)
+			copiers.push_back(new PartitionArrayCopier<Complex>(mssel_p, outs,
+					MS::columnName(complexCols[i]),
+					MS::columnName(writeToDataCol ? MS::DATA : complexCols[i])));
+		if(doFloat)
+			copiers.push_back(new PartitionArrayCopier<Float>(mssel_p, outs,
+					MS::columnName(MS::FLOAT_DATA), MS::columnName(MS::FLOAT_DATA)));
+
+		// The input is read once, a block of rows at a time.  While a second
+		// thread gathers the rows of block b for each output in memory,
+		// block b+1 is read into the other buffer; then block b is written
+		// to the outputs.  The reads and writes never overlap, since the
+		// table system is not thread-safe.
+		const Double bytesPerRow = Double(maxnchan_p) * maxncorr_p *
+				(nDataCols * sizeof(Complex) + sizeof(Bool) + sizeof(Float));
+		const uInt blockRows = max(1000u,
+				uInt(min(Double(nrow), maxPartitionBlockBytes / bytesPerRow)));
+		const uInt nBlocks = (nrow + blockRows - 1) / blockRows;
+		const Vector<Int> ddid = mscIn_p->dataDescId().getColumn();
+		Vector<uInt> nextOutRow(nOut, 0);
+		PartitionBlock blocks[2];
+
+		Int nth = 1;
+#ifdef _OPENMP
+		nth = min(2, omp_get_max_threads());
+#endif
+		os << LogIO::NORMAL << "Writing " << nOut << " partitions in blocks of "
+				<< blockRows << " rows, reading ahead "
+				<< (nth > 1 ? "while gathering in a separate thread."
+						: "in the same thread.")
+				<< LogIO::POST;
+
+		ProgressMeter meter(0.0, nrow * 1.0, "partition", "rows copied", "", "",
+				True, 1);
+		Timer timer;
+		timer.mark();
+
+		planPartitionBlock(blocks[0], 0, min(nrow, blockRows), ddid, outOfRow, nextOutRow);
+		for(uInt c = 0; c < copiers.size(); ++c)
+			copiers[c]->read(0, blocks[0]);
+		for(uInt b = 0; b < nBlocks; ++b){
+			const uInt cur = b % 2;
+			const uInt next = 1 - cur;
+			const Bool more = (b + 1 < nBlocks);
+			if(more)
+				planPartitionBlock(blocks[next], (b + 1) * blockRows,
+						min(nrow, (b + 2) * blockRows), ddid, outOfRow, nextOutRow);
+
+			// Exceptions may not leave the parallel region.
+			String error;
+#pragma omp parallel for schedule(static, 1) num_threads(nth)
+			for(Int task = 0; task < 2; ++task){
+				try{
+					if(task == 0){
+						if(more)
+							for(uInt c = 0; c < copiers.size(); ++c)
+								copiers[c]->read(next, blocks[next]);
+					}
+					else
+						for(uInt c = 0; c < copiers.size(); ++c)
+							copiers[c]->gather(cur, blocks[cur]);
+				}
+				catch(AipsError x){
+#pragma omp critical (Partition_makePartitions)
+					error = x.getMesg();
+				}
+				catch(...){
+#pragma omp critical (Partition_makePartitions)
+					error = "Unknown exception while partitioning";
+				}
+			}
+			if(error != "")
+				throw(AipsError(error));
+			for(uInt k = 0; k < nOut; ++k)
+				for(uInt c = 0; c < copiers.size(); ++c)
+					copiers[c]->write(k, blocks[cur]);
+			meter.update(min(nrow, (b + 1) * blockRows));
+		}
+
+		for(uInt k = 0; k < nOut; ++k)
+			outs[k]->flush();
+		const Double elapsed = timer.real();
+		Double megabytes = 0.0;
+		for(uInt c = 0; c < copiers.size(); ++c)
+			megabytes += copiers[c]->bytesRead() / (1024.0 * 1024.0);
+		os << LogIO::NORMAL << "Partitioned " << nrow << " rows (" << megabytes
+				<< " MB) into " << nOut << " MSs in " << elapsed << " s, "
+				<< megabytes / max(elapsed, 1e-6) << " MB/s."
+				<< LogIO::POST;
+
+		// See makePartition().
+		if (isAllColumns(colNamesTok)){
+			for(uInt k = 0; k < nOut; ++k){
+				ROMSSpWindowColumns msSpW(outs[k]->spectralWindow());
+				Int nSpw=outs[k]->spectralWindow().nrow();
+				if(nSpw==0) nSpw=1;
+				Matrix<Int> selection(2,nSpw);
+				selection.row(0)=0; //start
+				selection.row(1)=msSpW.numChan().getColumn();
+				ArrayColumn<Complex> mcd(*outs[k],MS::columnName(MS::MODEL_DATA));
+				mcd.rwKeywordSet().define("CHANNEL_SELECTION",selection);
+			}
+		}
+	}
+	catch(AipsError x){
+		for(uInt c = 0; c < copiers.size(); ++c)
+			delete copiers[c];
+		for(uInt k = 0; k < outs.size(); ++k)
+			delete outs[k];
+		ms_p=MeasurementSet();
+		throw(x);
+	}
+
+	for(uInt c = 0; c < copiers.size(); ++c)
+		delete copiers[c];
+	for(uInt k = 0; k < outs.size(); ++k)
+		delete outs[k];
+	//Detaching the selected part
+	ms_p=MeasurementSet();
+	return True;
+}
+
+MeasurementSet* Partition::setupPartitionMS(const String& msname,
+		const Vector<MS::PredefinedColumns>& colNamesTok,
+		const Vector<Int>& tileShape)
+{
+	LogIO os(LogOrigin("Partition", "setupPartitionMS()"));
+	MeasurementSet* outpointer=0;
+
+	if(tileShape.nelements() == 3){
+		outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
+				colNamesTok, tileShape);
+
+	}
+	// the following calls MSTileLayout...  disabled for now because it
+	// forces tiles to be the full spw bandwidth in width (gmoellen, 2010/11/07)
+	/*
+      else if((tileShape.nelements()==1) && (tileShape[0]==0 || tileShape[0]==1)){
+      outpointer = setupMS(msname, nchan_p[0], ncorr_p[0],
+      mscIn_p->observation().telescopeName()(0),
+      colNamesTok, tileShape[0]);
+      }
+	 */
+	else{
+
+		// Derive tile shape based on input dataset's tiles, borrowed
+		//  from VisSet's scr col tile shape derivation
+		//  (this may need some tweaking for averaging cases)
+		TableDesc td = mssel_p.actualTableDesc();
+
+		// If a non-DATA column, i.e. CORRECTED_DATA, is being written to DATA,
+		// datacolname must be set to DATA because the tile management in
+		// setupMS() will look for "TiledDATA", not "TiledCorrectedData".
+		String datacolname = MS::columnName(MS::DATA);
+		// But if DATA is not present in the input MS, using it would cause a
+		// segfault.
+		if(!td.isColumn(datacolname))
+			// This is could be any other kind of *DATA column, including
+			// FLOAT_DATA or LAG_DATA, but it is guaranteed to be something.
+			datacolname = MS::columnName(colNamesTok[0]);
+
+		const ColumnDesc& cdesc = td[datacolname];
+
+		String dataManType = cdesc.dataManagerType();
+		String dataManGroup = cdesc.dataManagerGroup();
+
+		Bool tiled = (dataManType.contains("Tiled"));
+
+		if (tiled) {
+			ROTiledStManAccessor tsm(mssel_p, dataManGroup);
+			uInt nHyper = tsm.nhypercubes();
+
+			// Test clause
+			if(1){
+				os << LogIO::DEBUG1
+						<< datacolname << "'s max cache size: "
+						<< tsm.maximumCacheSize() << " bytes.\n"
+						<< "\tnhypercubes: " << nHyper << ".\n"
+						<< "\ttshp of row 0: " << tsm.tileShape(0)
+						<< "\n\thypercube shape of row 0: " << tsm.hypercubeShape(0)
+						<< LogIO::POST;
+			}
+
+
+			// Find smallest tile shape
+			Int highestProduct=-INT_MAX;
+			Int highestId=0;
+			for (uInt id=0; id < nHyper; id++) {
+				IPosition tshp(tsm.getTileShape(id));
+				Int product = tshp.product();
+
+				os << LogIO::DEBUG2
+						<< "\thypercube " << id << ":\n"
+						<< "\t\ttshp: " << tshp << "\n"
+						<< "\t\thypercube shape: " << tsm.getHypercubeShape(id)
+						<< ".\n\t\tcache size: " << tsm.getCacheSize(id)
+						<< " buckets.\n\t\tBucket size: " << tsm.getBucketSize(id)
+						<< " bytes."
+						<< LogIO::POST;
+
+				if (product > 0 && (product > highestProduct)) {
+					highestProduct = product;
+					highestId = id;
+				}
+			}
+			Vector<Int> dataTileShape = tsm.getTileShape(highestId).asVector();
+
+			outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
+					colNamesTok, dataTileShape);
+
+		}
+		else
+			//Sweep all other cases of bad tileshape to a default one.
+			//  (this probably never happens)
+			outpointer = setupMS(msname, mssel_p, maxnchan_p, maxncorr_p,
+					mscIn_p->observation().telescopeName()(0),
+					colNamesTok, 0);
+
+	}
+	return outpointer;
+}
+
 MeasurementSet* Partition::makeScratchPartition(const String& colname,
 		const Bool forceInMemory)
 {
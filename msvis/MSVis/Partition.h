@@ -68,6 +68,9 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 //      setmsselect
 //      selectTime
 //      makePartition
+//
+// makePartitions can be used instead of makePartition to split the selection
+// into several MSs in one pass over the input.
 // </synopsis>
 
 template<class T> class ROArrayColumn;
@@ -135,6 +138,20 @@ public:
 		     const Vector<Int>& tileShape=Vector<Int>(1, 0),
 		     const String& combine="");
 
+  // Make several partitions of the selection at once, one MS per element of
+  // outnames.  The input is read only once; the next block of rows is read
+  // by one thread while the outputs are written, one after the other, by
+  // another.  separationAxis decides which rows go where: "scan" and "spw"
+  // give whole scans or spectral windows (the SPECTRAL_WINDOW_ID of each
+  // DATA_DESC_ID) to the outputs, keeping their row counts as even as
+  // possible, and "row" splits the
+  // selection into consecutive runs of rows.  Column k of tileShapes (3 by
+  // nOutputs) is the tile shape of output k; without it the tile shape is
+  // derived as in makePartition().  Time averaging is not supported.
+  Bool makePartitions(const Vector<String>& outnames, String& whichDataCol,
+		      const String& separationAxis="scan",
+		      const Matrix<Int>& tileShapes=Matrix<Int>());
+
   //Method to make a scratch partition and even in memory if posssible
   //Useful if temporary subselection/averaging is necessary
   // It'll be in memory if the basic output ms is less than half of 
@@ -161,6 +178,12 @@ public:
   
   void verifyColumns(const MeasurementSet& ms, const Vector<MS::PredefinedColumns>& colNames);
 private:
+  // Make an empty output MS for the selection, using tileShape if it has 3
+  // elements and one derived from the input otherwise.
+  MeasurementSet* setupPartitionMS(const String& msname,
+				   const Vector<MS::PredefinedColumns>& colNamesTok,
+				   const Vector<Int>& tileShape);
+
   //method that returns the selected ms (?! - but it's Boolean - RR)
   Bool makeSelection();
 
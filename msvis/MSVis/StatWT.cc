@@ -34,6 +34,12 @@
 #include <casa/Logging/LogIO.h>
 #include <ms/MSSel/MSSelection.h>
 #include <casa/Arrays/ArrayMath.h>
+#include <algorithm>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa {
 
@@ -160,39 +166,86 @@ Bool StatWT::process(VisBuffGroup& vbg)
     }
   }
 
-  Cube<Bool> chanmaskedflags;
-
-  // Map from hashFunction(ant1, ant2) to running number of visibilities[corr]
-  std::map<uInt, Vector<uInt> > ns;
-
-  // Map from hashFunction(ant1, ant2) to running mean[corr]
-  std::map<uInt, Vector<Complex> > means;
-
-  // Map from hashFunction(ant1, ant2) to variance[corr], initially stored as
-  // running sums of squared differences.
-  std::map<uInt, Vector<Double> > variances;
-
-  // The accumulation of sums for the variances could be parallelized.
-  // See Chan, Tony F.; Golub, Gene H.; LeVeque, Randall J. (1979), "Updating
-  // Formulae and a Pairwise Algorithm for Computing Sample Variances.",
-  // Technical Report STAN-CS-79-773, Department of Computer Science, Stanford
-  // University.
-
+  // Dense running moments, indexed by hashFunction(ant1, ant2) * maxNCorr
+  // + corr.  maxAnt is numberAnt(), so it bounds every antenna ID.
+  const uInt nMoments = (hashFunction(maxAnt, maxAnt, maxAnt) + 1) * maxNCorr;
+
+  Vector<Bool> selected(maxNCorr, false);
+  for(Int corr = 0; corr < maxNCorr; ++corr)
+    selected[corr] = std::count(selcorrs_p.begin(), selcorrs_p.end(),
+                                static_cast<uInt>(corr)) != 0;
+
+  // VisBuffer fills its caches on demand, so everything the threads read
+  // is fetched here first.
+  std::vector<Cube<Complex> > data;
+  std::vector<Cube<Bool> > chanmaskedflags;
+  std::vector<Vector<Bool> > flagRows;
+  std::vector<Vector<Int> > a1s, a2s;
   for(uInt bufnum = 0; bufnum < nvbs; ++bufnum){
     Int spw = vbg(bufnum).spectralWindow();
 
     if(fitmask_p.count(spw) > 0){
-      VisBuffGroup::applyChanMask(chanmaskedflags, fitmask_p[spw], vbg(bufnum));
+      Cube<Bool> flags;
 
-      if(!update_variances(ns, means, variances, vbg(bufnum), chanmaskedflags,
-                           maxAnt))
+      VisBuffGroup::applyChanMask(flags, fitmask_p[spw], vbg(bufnum));
+      data.push_back(vbg(bufnum).dataCube(datacol_p));
+      if(data.back().shape() != flags.shape())
         return false;
+      chanmaskedflags.push_back(flags);
+      flagRows.push_back(vbg(bufnum).flagRow());
+      a1s.push_back(vbg(bufnum).antenna1());
+      a2s.push_back(vbg(bufnum).antenna2());
+    }
+  }
+
+  // Split the fitted rows into blocks of rowBlock rows.
+  const uInt rowBlock = 256;
+  std::vector<std::pair<uInt, uInt> > blocks;   // (fitted buffer, first row)
+  for(uInt i = 0; i < data.size(); ++i)
+    for(uInt r = 0; r < data[i].shape()[2]; r += rowBlock)
+      blocks.push_back(std::make_pair(i, r));
+  const Int nBlocks = blocks.size();
+
+  Int nth = 1;
+#ifdef _OPENMP
+  nth = max(1, min(omp_get_max_threads(), nBlocks));
+#endif
+
+  // Each thread accumulates its own moments over a fixed share of the
+  // blocks, and the shares are merged in thread order, so that the result
+  // does not depend on the timing.
+  std::vector<std::vector<Moments> > partial(nth);
+#pragma omp parallel num_threads(nth)
+  {
+    Int tid = 0;
+#ifdef _OPENMP
+    tid = omp_get_thread_num();
+#endif
+    std::vector<Moments>& mine = partial[tid];
+
+    mine.resize(nMoments);
+#pragma omp for schedule(static)
+    for(Int b = 0; b < nBlocks; ++b){
+      uInt i = blocks[b].first;
+      uInt rowEnd = min(blocks[b].second + rowBlock,
+                        static_cast<uInt>(data[i].shape()[2]));
+
+      update_variances(mine, data[i], chanmaskedflags[i], flagRows[i],
+                       a1s[i], a2s[i], selected, blocks[b].second, rowEnd,
+                       maxNCorr, maxAnt);
     }
   }
-  for(std::map<uInt, Vector<Double> >::iterator it = variances.begin();
-      it != variances.end(); ++it)
-    for(Int corr = 0; corr < maxNCorr; ++corr)
-      it->second[corr] /= ns[it->first][corr] - 1;
+
+  std::vector<Moments> moments;
+  moments.swap(partial[0]);
+  for(Int t = 1; t < nth; ++t){
+    if(partial[t].size() == nMoments){
+#pragma omp parallel for
+      for(Int k = 0; k < static_cast<Int>(nMoments); ++k)
+        merge_moments(moments[k], partial[t][k]);
+    }
+    std::vector<Moments>().swap(partial[t]);
+  }
 
   // TODO
   // if(byantenna_p){
@@ -213,7 +266,8 @@ Bool StatWT::process(VisBuffGroup& vbg)
 
     rowsdone_p += vbg(bufnum).nRow();
     if(outspws_p.find(spw) != outspws_p.end()){
-      worked &= apply_variances(vbg(bufnum), ns, variances, maxAnt);      
+      worked &= apply_variances(vbg(bufnum), moments, selected, maxNCorr,
+                                maxAnt);
       //cerr << "Wrote out row IDs " << oldrowsdone << " - " << rowsdone_p - 1 << ",";
     }
     //else
@@ -233,100 +287,111 @@ Bool StatWT::process(VisBuffGroup& vbg)
   return worked;
 }
 
-Bool StatWT::update_variances(std::map<uInt, Vector<uInt> >& ns,
-                              std::map<uInt, Vector<Complex> >& means,
-                              std::map<uInt, Vector<Double> >& variances,
-                              const VisBuffer& vb,
-                              const Cube<Bool>& chanmaskedflags, const uInt maxAnt)
+void StatWT::update_variances(std::vector<Moments>& moments,
+                              const Cube<Complex>& data,
+                              const Cube<Bool>& chanmaskedflags,
+                              const Vector<Bool>& flagRow,
+                              const Vector<Int>& a1, const Vector<Int>& a2,
+                              const Vector<Bool>& selected,
+                              const uInt rowBeg, const uInt rowEnd,
+                              const uInt nCorr, const uInt maxAnt) const
 {
-  Cube<Complex> data(vb.dataCube(datacol_p));
-
-  if(data.shape() != chanmaskedflags.shape())
-    return false;
-
-  Bool retval = true;
-  uInt nCorr = data.shape()[0];
+  uInt nDataCorr = data.shape()[0];
   uInt nChan = data.shape()[1];
-  uInt nRows = data.shape()[2];
-  Vector<uInt> unflagged(nChan);
-  Vector<Int> a1(vb.antenna1());
-  Vector<Int> a2(vb.antenna2());
-  Complex vis, vmoldmean, vmmean;
 
-  for(uInt r = 0; r < nRows; ++r){
-    if(!vb.flagRow()[r]){
+  for(uInt r = rowBeg; r < rowEnd; ++r){
+    if(!flagRow[r]){
       uInt hr = hashFunction(a1[r], a2[r], maxAnt);
 
-      for(uInt corr = 0; corr < nCorr; ++corr){
-        if (std::count(selcorrs_p.begin(), selcorrs_p.end(), corr)!=0) {
-	  for(uInt ch = 0; ch < nChan; ++ch){
-	    if(!chanmaskedflags(corr, ch, r)){
-	      if(!ns.count(hr)){
-		ns[hr] = Vector<uInt>(nCorr, 0);
-		means[hr] = Vector<Complex>(nCorr, 0);
-		variances[hr] = Vector<Double>(nCorr, 0);
-	      }
-	      ++ns[hr][corr];
-	      vis = data(corr, ch, r);
-	      vmoldmean = vis - means[hr][corr];
-
-	      if(!dorms_p)  // It's not that Complex / Int isn't defined, it's
-			    // that it is, along with Complex / Double, creating
-			    // an ambiguity.
-		means[hr][corr] += vmoldmean / static_cast<Double>(ns[hr][corr]);
-
-	      // This term is guaranteed to have its parts be nonnegative.
-	      vmmean = vis - means[hr][corr];
-	      variances[hr][corr] += vmmean.real() * vmoldmean.real() +
-				     vmmean.imag() * vmoldmean.imag();
-	    }
-	  }
-	}//selcorrs_p 
+      for(uInt corr = 0; corr < nDataCorr; ++corr){
+        if(selected[corr]){
+          Moments& m = moments[hr * nCorr + corr];
+
+          for(uInt ch = 0; ch < nChan; ++ch){
+            if(!chanmaskedflags(corr, ch, r)){
+              DComplex vis(data(corr, ch, r));
+              DComplex vmoldmean(vis - m.mean);
+
+              ++m.n;
+              if(!dorms_p)
+                m.mean += vmoldmean / static_cast<Double>(m.n);
+
+              // This term is guaranteed to have its parts be nonnegative.
+              DComplex vmmean(vis - m.mean);
+              m.m2 += vmmean.real() * vmoldmean.real() +
+                      vmmean.imag() * vmoldmean.imag();
+            }
+          }
+        }
       }
     }
   }
-  return retval;
 }
 
-Bool StatWT::apply_variances(VisBuffer& vb,
-                             std::map<uInt, Vector<uInt> >& ns,
-                             std::map<uInt, Vector<Double> >& variances,
-                             const uInt maxAnt)
+void StatWT::merge_moments(Moments& total, const Moments& other) const
+{
+  if(other.n == 0)
+    return;
+  if(total.n == 0){
+    total = other;
+    return;
+  }
+
+  Double n = static_cast<Double>(total.n) + other.n;
+
+  if(dorms_p)
+    total.m2 += other.m2;     // The means are fixed at 0.
+  else{
+    DComplex delta(other.mean - total.mean);
+
+    total.mean += delta * (other.n / n);
+    total.m2 += other.m2 + norm(delta) * (total.n * (other.n / n));
+  }
+  total.n += other.n;
+}
+
+Bool StatWT::apply_variances(VisBuffer& vb, const std::vector<Moments>& moments,
+                             const Vector<Bool>& selected,
+                             const uInt nCorr, const uInt maxAnt)
 {
   Bool retval = true;
-  IPosition shp(vb.flagCube().shape());
-  uInt nCorr = shp[0];
+  Cube<Bool>& flagCube = vb.flagCube();
+  Vector<Bool>& flagRow = vb.flagRow();
+  Matrix<Float>& sigmaMat = vb.sigmaMat();
+  Matrix<Float>& weightMat = vb.weightMat();
+  IPosition shp(flagCube.shape());
+  uInt nBufCorr = shp[0];
   uInt nChan = shp[1];
-  uInt nRows = shp[2];
+  Int nRows = shp[2];
   Vector<Int> a1(vb.antenna1());
   Vector<Int> a2(vb.antenna2());
 
-  for(uInt r = 0; r < nRows; ++r){
+#pragma omp parallel for
+  for(Int r = 0; r < nRows; ++r){
     uInt hr = hashFunction(a1[r], a2[r], maxAnt);
     Bool unflagged = false;
-    Bool havevar = ns.count(hr) > 0;
-
-    for(uInt corr = 0; corr < nCorr; ++corr){
-      if (std::count(selcorrs_p.begin(), selcorrs_p.end(), corr)!=0) {// modify only selected corrs
-	if(havevar &&
-	   (ns[hr][corr] >= minsamp_p) &&
-	   (0.0 < variances[hr][corr])){ // For some reason emacs likes 0 < v,
-					 // but not v > 0.
-	  Double var = variances[hr][corr];
-
-	  unflagged = true;
-	  vb.sigmaMat()(corr, r) = sqrt(var);
-	  vb.weightMat()(corr, r) = 1.0 / var;
-	}
-	else{
-	  vb.sigmaMat()(corr, r) = -1.0;
-	  vb.weightMat()(corr, r) = 0.0;
-	  for(uInt ch = 0; ch < nChan; ++ch){
-	    vb.flagCube()(corr, ch, r) = true;
-	  }
-	}
+
+    for(uInt corr = 0; corr < nBufCorr; ++corr){
+      if(selected[corr]){     // modify only selected corrs
+        const Moments& m = moments[hr * nCorr + corr];
+        Double var = m.m2 / (static_cast<Double>(m.n) - 1.0);
+
+        if((m.n >= minsamp_p) &&
+           (0.0 < var)){ // For some reason emacs likes 0 < v,
+                         // but not v > 0.
+          unflagged = true;
+          sigmaMat(corr, r) = sqrt(var);
+          weightMat(corr, r) = 1.0 / var;
+        }
+        else{
+          sigmaMat(corr, r) = -1.0;
+          weightMat(corr, r) = 0.0;
+          for(uInt ch = 0; ch < nChan; ++ch){
+            flagCube(corr, ch, r) = true;
+          }
+        }
         if(!unflagged)
-          vb.flagRow()[r] = true;
+          flagRow[r] = true;
       }
     }
   }
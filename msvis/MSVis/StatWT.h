@@ -35,6 +35,7 @@
 #include <msvis/MSVis/VisBufferComponents.h>
 #include <map>
 #include <set>
+#include <vector>
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
@@ -60,7 +61,9 @@ class VisBuffGroup;
 //
 //<synopsis>
 // Set the weights and sigmas according to the scatter of the
-// visibilities.
+// visibilities.  The moments of each baseline and correlation are
+// accumulated by the available threads over blocks of rows, and the partial
+// moments are merged with the pairwise update of Chan, Golub, and LeVeque.
 //</synopsis>
 //
 //<todo>
@@ -105,22 +108,39 @@ private:
   // Disable null c'tor.
   StatWT();
 
-  Bool update_variances(std::map<uInt, Vector<uInt> >& ns,
-                        std::map<uInt, Vector<Complex> >& means,
-                        std::map<uInt, Vector<Double> >& variances,
-                        const VisBuffer& vb,
-                        const Cube<Bool>& chanmaskedflags, const uInt maxAnt);
-
-  // ns and variances are effectively const here, but declaring them that way
-  // would take some gymnastics.
-  Bool apply_variances(VisBuffer& vb,
-                       std::map<uInt, Vector<uInt> >& ns,
-                       std::map<uInt, Vector<Double> >& variances,
-                       const uInt maxAnt);
+  // Running number, mean, and sum of squared differences from the mean of
+  // the visibilities of one baseline and correlation.
+  struct Moments
+  {
+    Moments() : n(0), mean(0.0, 0.0), m2(0.0) {}
+
+    uInt     n;
+    DComplex mean;
+    Double   m2;
+  };
+
+  // Add the unflagged visibilities of rows rowBeg to rowEnd - 1 of data to
+  // moments, which is indexed by hashFunction(ant1, ant2) * nCorr + corr.
+  void update_variances(std::vector<Moments>& moments,
+                        const Cube<Complex>& data,
+                        const Cube<Bool>& chanmaskedflags,
+                        const Vector<Bool>& flagRow,
+                        const Vector<Int>& a1, const Vector<Int>& a2,
+                        const Vector<Bool>& selected,
+                        const uInt rowBeg, const uInt rowEnd,
+                        const uInt nCorr, const uInt maxAnt) const;
+
+  // Merge the moments of a disjoint set of visibilities into total, using
+  // the pairwise formula of Chan, Golub, and LeVeque.
+  void merge_moments(Moments& total, const Moments& other) const;
+
+  Bool apply_variances(VisBuffer& vb, const std::vector<Moments>& moments,
+                       const Vector<Bool>& selected,
+                       const uInt nCorr, const uInt maxAnt);
 
   // Compute a baseline (row) index (ant1, ant2).
   // It ASSUMES that ant1 and ant2 are both <= maxAnt.
-  uInt hashFunction(const Int ant1, const Int ant2, const Int maxAnt)
+  uInt hashFunction(const Int ant1, const Int ant2, const Int maxAnt) const
   {
     return (maxAnt + 1) * ant1 - (ant1 * (ant1 - 1)) / 2 + ant2 - ant1;
   }
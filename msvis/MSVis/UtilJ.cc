@@ -13,12 +13,17 @@
 #include <casa/aips.h>
 #include <casa/aipstype.h>
 #include <casa/BasicSL/String.h>
+#include <casa/Containers/Record.h>
+#include <casa/System/Aipsrc.h>
+#include <casa/System/AipsrcValue.h>
 #include <casa/Utilities/CountedPtr.h>
 #include <sys/time.h>
 #include <execinfo.h>
 #include <algorithm>
 #include <math.h>
 #include <fstream>
+#include <pthread.h>
+#include <sstream>
 #include <unistd.h>
 #include <sys/time.h>
 #include <sys/resource.h>
@@ -706,6 +711,346 @@ RUsage::toString () const
                             nivcsw ());
 }
 
+namespace {
+
+// What one thread has recorded under one name
+
+class InstrumentationEntry {
+
+public:
+
+    InstrumentationEntry ()
+    : bytes_p (0), calls_p (0), count_p (0), cpu_p (0), elapsed_p (0),
+      elapsedMax_p (0), elapsedMin_p (0)
+    {}
+
+    void addTime (Double elapsed, Double cpu)
+    {
+        elapsedMin_p = calls_p == 0 ? elapsed : min (elapsedMin_p, elapsed);
+        elapsedMax_p = calls_p == 0 ? elapsed : max (elapsedMax_p, elapsed);
+        calls_p ++;
+        elapsed_p += elapsed;
+        cpu_p += cpu;
+    }
+
+    void merge (const InstrumentationEntry & other)
+    {
+        if (other.calls_p > 0){
+            elapsedMin_p = calls_p == 0 ? other.elapsedMin_p : min (elapsedMin_p, other.elapsedMin_p);
+            elapsedMax_p = calls_p == 0 ? other.elapsedMax_p : max (elapsedMax_p, other.elapsedMax_p);
+        }
+        bytes_p += other.bytes_p;
+        calls_p += other.calls_p;
+        count_p += other.count_p;
+        cpu_p += other.cpu_p;
+        elapsed_p += other.elapsed_p;
+    }
+
+    Int64 bytes_p;
+    Int64 calls_p;
+    Int64 count_p;
+    Double cpu_p;
+    Double elapsed_p;
+    Double elapsedMax_p;
+    Double elapsedMin_p;
+};
+
+typedef std::map<std::string, InstrumentationEntry> InstrumentationTable;
+
+// The entries of one thread.  The mutex is only contended while the
+// registry is being dumped or cleared.
+
+class InstrumentationThreadTable {
+
+public:
+
+    InstrumentationThreadTable () { pthread_mutex_init (& mutex_p, NULL);}
+
+    pthread_mutex_t mutex_p;
+    InstrumentationTable entries_p;
+};
+
+class InstrumentationLocker {
+
+public:
+
+    explicit InstrumentationLocker (pthread_mutex_t & mutex) : mutex_p (mutex)
+    {
+        pthread_mutex_lock (& mutex_p);
+    }
+
+    ~InstrumentationLocker () { pthread_mutex_unlock (& mutex_p);}
+
+private:
+
+    pthread_mutex_t & mutex_p;
+};
+
+// The merged entry of a name over all threads
+
+class InstrumentationSummary : public InstrumentationEntry {
+
+public:
+
+    InstrumentationSummary () : elapsedMaxThread_p (0), nThreads_p (0) {}
+
+    Double elapsedMaxThread_p;
+    Int nThreads_p;
+};
+
+typedef std::map<std::string, InstrumentationSummary> InstrumentationSummaries;
+
+// The thread tables are never deleted: a thread's entries have to outlive it
+// until the registry is dumped, possibly from an atexit handler.
+
+pthread_mutex_t instrumentationMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_once_t instrumentationOnce = PTHREAD_ONCE_INIT;
+pthread_key_t instrumentationKey;
+std::vector<InstrumentationThreadTable *> * instrumentationTables = 0;
+String * instrumentationFile = 0;
+
+void
+createInstrumentationKey ()
+{
+    pthread_key_create (& instrumentationKey, NULL);
+}
+
+InstrumentationThreadTable &
+instrumentationThreadTable ()
+{
+    pthread_once (& instrumentationOnce, createInstrumentationKey);
+
+    InstrumentationThreadTable * table =
+        static_cast<InstrumentationThreadTable *> (pthread_getspecific (instrumentationKey));
+
+    if (table == 0){
+
+        table = new InstrumentationThreadTable ();
+        pthread_setspecific (instrumentationKey, table);
+
+        InstrumentationLocker locker (instrumentationMutex);
+
+        if (instrumentationTables == 0){
+            instrumentationTables = new std::vector<InstrumentationThreadTable *> ();
+        }
+        instrumentationTables->push_back (table);
+    }
+
+    return * table;
+}
+
+InstrumentationSummaries
+summarizeInstrumentation ()
+{
+    InstrumentationSummaries summaries;
+    InstrumentationLocker locker (instrumentationMutex);
+
+    if (instrumentationTables == 0){
+        return summaries;
+    }
+
+    for (std::vector<InstrumentationThreadTable *>::iterator t = instrumentationTables->begin();
+         t != instrumentationTables->end();
+         t ++){
+
+        InstrumentationLocker tableLocker ((* t)->mutex_p);
+
+        for (InstrumentationTable::const_iterator e = (* t)->entries_p.begin();
+             e != (* t)->entries_p.end();
+             e ++){
+
+            InstrumentationSummary & summary = summaries [e->first];
+            summary.merge (e->second);
+            summary.nThreads_p ++;
+            summary.elapsedMaxThread_p = max (summary.elapsedMaxThread_p, e->second.elapsed_p);
+        }
+    }
+
+    return summaries;
+}
+
+String
+jsonString (const std::string & s)
+{
+    String result = "\"";
+    for (std::string::const_iterator c = s.begin(); c != s.end(); c ++){
+        if (* c == '"' || * c == '\\'){
+            result += '\\';
+        }
+        result += * c;
+    }
+    return result + "\"";
+}
+
+} // end anonymous namespace
+
+volatile Int Instrumentation::enabled_p = -1;
+
+Bool
+Instrumentation::initialize ()
+{
+    InstrumentationLocker locker (instrumentationMutex);
+
+    if (enabled_p < 0){
+
+        Bool enable;
+        AipsrcValue<Bool>::find (enable, "Instrumentation.enable", False);
+
+        String fileName;
+        Aipsrc::find (fileName, "Instrumentation.file", "");
+        if (! fileName.empty()){
+            instrumentationFile = new String (fileName);
+            atexit (writeAtExit);
+        }
+
+        enabled_p = enable ? 1 : 0;
+    }
+
+    return enabled_p > 0;
+}
+
+void
+Instrumentation::setEnabled (Bool enabled)
+{
+    isEnabled (); // so that the aipsrc variables are read only once
+    enabled_p = enabled ? 1 : 0;
+}
+
+void
+Instrumentation::addTime (const char * name, Double elapsed, Double cpu)
+{
+    if (! isEnabled ()){
+        return;
+    }
+
+    InstrumentationThreadTable & table = instrumentationThreadTable ();
+    InstrumentationLocker locker (table.mutex_p);
+    table.entries_p [name].addTime (elapsed, cpu);
+}
+
+void
+Instrumentation::addCount (const char * name, Int64 n)
+{
+    if (! isEnabled ()){
+        return;
+    }
+
+    InstrumentationThreadTable & table = instrumentationThreadTable ();
+    InstrumentationLocker locker (table.mutex_p);
+    table.entries_p [name].count_p += n;
+}
+
+void
+Instrumentation::addBytes (const char * name, Int64 nBytes)
+{
+    if (! isEnabled ()){
+        return;
+    }
+
+    InstrumentationThreadTable & table = instrumentationThreadTable ();
+    InstrumentationLocker locker (table.mutex_p);
+    table.entries_p [name].bytes_p += nBytes;
+}
+
+void
+Instrumentation::clear ()
+{
+    InstrumentationLocker locker (instrumentationMutex);
+
+    if (instrumentationTables == 0){
+        return;
+    }
+
+    for (std::vector<InstrumentationThreadTable *>::iterator t = instrumentationTables->begin();
+         t != instrumentationTables->end();
+         t ++){
+
+        InstrumentationLocker tableLocker ((* t)->mutex_p);
+        (* t)->entries_p.clear ();
+    }
+}
+
+Record
+Instrumentation::toRecord ()
+{
+    InstrumentationSummaries summaries = summarizeInstrumentation ();
+    Record result;
+
+    for (InstrumentationSummaries::const_iterator s = summaries.begin();
+         s != summaries.end();
+         s ++){
+
+        Record entry;
+        entry.define ("calls", s->second.calls_p);
+        entry.define ("elapsed", s->second.elapsed_p);
+        entry.define ("cpu", s->second.cpu_p);
+        entry.define ("elapsedMin", s->second.elapsedMin_p);
+        entry.define ("elapsedMax", s->second.elapsedMax_p);
+        entry.define ("count", s->second.count_p);
+        entry.define ("bytes", s->second.bytes_p);
+        entry.define ("threads", s->second.nThreads_p);
+        entry.define ("elapsedMaxThread", s->second.elapsedMaxThread_p);
+        result.defineRecord (String (s->first), entry);
+    }
+
+    return result;
+}
+
+String
+Instrumentation::toJson ()
+{
+    InstrumentationSummaries summaries = summarizeInstrumentation ();
+    std::ostringstream os;
+    os.precision (9);
+
+    os << "{";
+    String separator = "\n";
+
+    for (InstrumentationSummaries::const_iterator s = summaries.begin();
+         s != summaries.end();
+         s ++){
+
+        os << separator << "  " << jsonString (s->first) << ": {"
+           << "\"calls\": " << s->second.calls_p
+           << ", \"elapsed\": " << s->second.elapsed_p
+           << ", \"cpu\": " << s->second.cpu_p
+           << ", \"elapsedMin\": " << s->second.elapsedMin_p
+           << ", \"elapsedMax\": " << s->second.elapsedMax_p
+           << ", \"count\": " << s->second.count_p
+           << ", \"bytes\": " << s->second.bytes_p
+           << ", \"threads\": " << s->second.nThreads_p
+           << ", \"elapsedMaxThread\": " << s->second.elapsedMaxThread_p
+           << "}";
+        separator = ",\n";
+    }
+
+    os << "\n}\n";
+
+    return os.str();
+}
+
+Bool
+Instrumentation::writeJson (const String & fileName)
+{
+    ofstream os (fileName.c_str());
+
+    if (! os){
+        return False;
+    }
+
+    os << toJson ();
+
+    return os.good();
+}
+
+void
+Instrumentation::writeAtExit ()
+{
+    if (instrumentationFile != 0 && ! writeJson (* instrumentationFile)){
+        toStdError ("Could not write instrumentation to " + * instrumentationFile);
+    }
+}
+
 } // end namespace utilj
 
 } // end namespace casa
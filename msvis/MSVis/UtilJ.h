@@ -50,6 +50,7 @@
 
 namespace casa {
 
+class Record;
 class String;
 
 namespace utilj {
@@ -565,6 +566,102 @@ private:
 
 };
 
+// <summary>
+// Process-wide registry of named timers, counters and byte meters
+// </summary>
+//
+// <synopsis>
+// Instrumentation accumulates, under a name such as
+// "SynthesisImager.majorCycle", the elapsed and cpu time of timed sections
+// (see InstrumentationTimer), event counts and byte counts.  Each thread
+// accumulates into its own table, so recording takes no global lock; the
+// tables are merged when the registry is dumped with toRecord or toJson.
+//
+// Recording is off unless the aipsrc variable Instrumentation.enable is
+// true or setEnabled(True) is called; while it is off every entry point
+// returns after testing a flag.  If Instrumentation.file names a file the
+// registry is written to it as JSON when the process exits.
+// </synopsis>
+//
+// <example>
+// <srcblock>
+//   {
+//       InstrumentationTimer timer ("Calibrater.solve");
+//       ... // solve
+//   }
+//   Instrumentation::addBytes ("MSTransformManager.inputBytes", nBytes);
+// </srcblock>
+// </example>
+
+class Instrumentation {
+
+public:
+
+    static Bool isEnabled () { return enabled_p > 0 || (enabled_p < 0 && initialize ());}
+    static void setEnabled (Bool enabled);
+
+    // Names must be string literals or otherwise outlive the process; they
+    // are copied only when recording is on.
+    static void addTime (const char * name, Double elapsed, Double cpu);
+    static void addCount (const char * name, Int64 n = 1);
+    static void addBytes (const char * name, Int64 nBytes);
+
+    // Forget everything recorded so far, in all threads
+    static void clear ();
+
+    // One subrecord per name with the fields calls, elapsed, cpu,
+    // elapsedMin, elapsedMax, count, bytes, threads (the number of threads
+    // that recorded the name) and elapsedMaxThread (the largest elapsed
+    // total of any one of them).
+    static Record toRecord ();
+    static String toJson ();
+    static Bool writeJson (const String & fileName);
+
+private:
+
+    static Bool initialize ();
+    static void writeAtExit ();
+
+    static volatile Int enabled_p; // -1 until aipsrc has been read
+};
+
+// Times the section of code from its construction to its destruction (or to
+// stop) and adds it to the Instrumentation entry of the same name.
+
+class InstrumentationTimer {
+
+public:
+
+    explicit InstrumentationTimer (const char * name)
+    : name_p (name), running_p (Instrumentation::isEnabled ())
+    {
+        if (running_p){
+            ThreadTimes start = ThreadTimes::getTime ();
+            startElapsed_p = start.elapsed ();
+            startCpu_p = start.cpu ();
+        }
+    }
+
+    ~InstrumentationTimer () { stop ();}
+
+    void stop ()
+    {
+        if (running_p){
+            ThreadTimes end = ThreadTimes::getTime ();
+            Instrumentation::addTime (name_p, end.elapsed () - startElapsed_p,
+                                      end.cpu () - startCpu_p);
+            running_p = False;
+        }
+    }
+
+private:
+
+    const char * name_p;
+    Bool running_p;
+    Double startCpu_p;
+    Double startElapsed_p;
+};
+
 // Global Functions
 
 // <linkfrom anchor=unique-string-within-this-file classes="class-1,...,class-n">
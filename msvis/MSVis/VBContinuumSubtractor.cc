@@ -25,10 +25,11 @@
 //#
 //# $Id$
 //#
-//#include <casa/Arrays/ArrayLogical.h>
-//#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/ArrayMath.h>
 //#include <casa/Arrays/ArrayUtil.h>
 #include <casa/Arrays/Cube.h>
+#include <casa/Containers/Block.h>
 //#include <casa/Arrays/MaskedArray.h>
 //#include <casa/Arrays/MaskArrMath.h>
 //#include <casa/Containers/Record.h>
@@ -44,11 +45,173 @@
 #include <msvis/MSVis/VisBuffer.h>
 #include <scimath/Fitting/LinearFitSVD.h>
 #include <scimath/Functionals/Polynomial.h>
+#include <scimath/Mathematics/MatrixMathLA.h>
 
 //#include <algorithm>
+#include <map>
+#include <utility>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
+namespace {
+
+// Which of the channels a fit uses, and the weights of the buffers
+// relative to the first unflagged one (0 for a flagged row).
+typedef std::pair<std::vector<bool>, std::vector<Float> > ContinuumFitKey;
+
+// The (corr, baseline)s sharing a ContinuumFitKey.
+struct ContinuumFitPattern
+{
+  ContinuumFitPattern() : nUsers(0) {}
+
+  uInt           nUsers;  // How many (corr, baseline)s have this pattern.
+  Vector<Int>    chans;   // The unflagged channels, as indices into freqs.
+  Matrix<Double> proj;    // (order, chan): visibilities -> coefficients.
+                          // Empty if the pattern is to be fit with SVD.
+};
+
+Float continuumFitWeight(Float w)
+{
+  // 2/24/2011: VisBuffer doesn't (yet) have sigmaSpectrum, and I have
+  // never seen it in an MS anyway.  Settle for 1/sqrt(weightSpectrum)
+  // if it is available or sigmaMat otherwise.
+  // 5/13/2011: Sigh.  VisBuffAccumulator doesn't even handle
+  // WeightSpectrum, let alone sigma.
+  //
+  // w needs a sanity check, because a VisBuffer from vbga is not
+  // necessarily still attached to the MS and sigmaMat() is not one
+  // of the accumulated quantities.  This caused problems for
+  // the last integration in CAS-3135.  checkVisIter() didn't do the
+  // trick in that case.  Fortunately w isn't all that important; if
+  // all the channels have the same weight the only consequence of
+  // setting w to 1 is that the estimated errors (which we don't yet
+  // use) will be wrong.
+  //
+  // 5e-45 ended up getting squared in the fitter and producing a NaN.
+  if(isnan(w) || w < 1.0e-20 || w > 1.0e20)
+    w = 1.0;  // Emit a warning?
+  return w;
+}
+
+// Marks orders 0 to locFitOrd of coeffs(corrind, , blind) as good, and pads
+// the remaining ones up to fitorder with 0.
+void storeContinuumFitOrder(Cube<Complex>& coeffs, Cube<Bool>& coeffsOK,
+                            const uInt corrind, const uInt blind,
+                            const Int locFitOrd, const Int fitorder)
+{
+  for(Int ordind = 0; ordind <= locFitOrd; ++ordind)        // Note <=.
+    coeffsOK(corrind, ordind, blind) = True;
+
+  // Pad remaining orders (if any) with 0.0.  Note <=.
+  for(Int ordind = locFitOrd + 1; ordind <= fitorder; ++ordind){
+    coeffs(corrind, ordind, blind) = 0.0;
+
+    // Since coeffs(corrind, ordind, blind) == 0, it isn't necessary to
+    // pay attention to coeffsOK(corrind, ordind, blind) (especially?) if
+    // ordind > 0.  But Calibrater's SolvableVisCal::keep() and store()
+    // quietly go awry if you try coeffsOK.resize(ncorr_p, 1, nHashes_p);
+    coeffsOK(corrind, ordind, blind) = False;
+  }
+}
+
+// Fills pattern.chans and pattern.proj, the pseudo-inverse of the weighted
+// polynomial design matrix, from the normal equations.  The frequencies are
+// scaled to [-1, 1], so for continuum fit orders these are well enough
+// conditioned; if the normal matrix is singular or nearly so False is
+// returned and pattern.proj is left empty.
+Bool makeContinuumFitProjection(ContinuumFitPattern& pattern,
+                                const ContinuumFitKey& key,
+                                const Vector<Float>& freqs,
+                                const Vector<Int>& bufOfChan,
+                                const Vector<uInt>& nchans,
+                                const Int fitorder)
+{
+  const uInt totnumchan = key.first.size();
+  uInt nUsed = 0;
+  for(uInt c = 0; c < totnumchan; ++c)
+    if(key.first[c])
+      ++nUsed;
+
+  // Don't try to solve for more coefficients than valid channels.
+  const uInt nCoef = min(fitorder, static_cast<Int>(nUsed) - 1) + 1;
+
+  pattern.chans.resize(nUsed);
+  Matrix<Double> powers(nCoef, nUsed);
+  Vector<Double> wt(nUsed);
+  uInt k = 0;
+  for(uInt c = 0; c < totnumchan; ++c){
+    if(key.first[c]){
+      pattern.chans[k] = c;
+      wt[k] = key.second[bufOfChan[c]] / nchans[bufOfChan[c]];
+      Double xp = 1.0;
+      for(uInt i = 0; i < nCoef; ++i){
+        powers(i, k) = xp;
+        xp *= freqs[c];
+      }
+      ++k;
+    }
+  }
+
+  Matrix<Double> normal(nCoef, nCoef, 0.0);
+  for(uInt i = 0; i < nCoef; ++i)
+    for(uInt j = 0; j <= i; ++j){
+      Double sum = 0.0;
+      for(k = 0; k < nUsed; ++k)
+        sum += wt[k] * powers(i, k) * powers(j, k);
+      normal(i, j) = normal(j, i) = sum;
+    }
+
+  Matrix<Double> inverse;
+  Double det = 0.0;
+  try{
+    invertSymPosDef(inverse, det, normal);
+  }
+  catch(AipsError x){
+    return False;
+  }
+  if(!(det > 0.0) || !allEQ(isFinite(inverse), True))
+    return False;
+
+  // A matrix that is singular in exact arithmetic (e.g. fewer distinct
+  // frequencies than coefficients, because the spws overlap) can
+  // still come through the Cholesky factorization with a tiny positive
+  // pivot.  Check the 1-norm condition number of the diagonally scaled
+  // normal matrix: below 1e10 the Double solution is still at least as
+  // accurate as the Float SVD fit.
+  Double normScaled = 0.0;
+  Double normScaledInverse = 0.0;
+  for(uInt j = 0; j < nCoef; ++j){
+    Double colSum = 0.0;
+    Double invColSum = 0.0;
+    for(uInt i = 0; i < nCoef; ++i){
+      const Double scale = sqrt(normal(i, i) * normal(j, j));
+      colSum += fabs(normal(i, j)) / scale;
+      invColSum += fabs(inverse(i, j)) * scale;
+    }
+    normScaled = max(normScaled, colSum);
+    normScaledInverse = max(normScaledInverse, invColSum);
+  }
+  if(!(normScaled * normScaledInverse < 1.0e10))
+    return False;
+
+  pattern.proj.resize(nCoef, nUsed);
+  for(k = 0; k < nUsed; ++k)
+    for(uInt i = 0; i < nCoef; ++i){
+      Double sum = 0.0;
+      for(uInt j = 0; j < nCoef; ++j)
+        sum += inverse(i, j) * powers(j, k);
+      pattern.proj(i, k) = sum * wt[k];
+    }
+  return True;
+}
+
+} // anonymous namespace
+
 VBContinuumSubtractor::VBContinuumSubtractor():
   fitorder_p(-1),
   lofreq_p(-1.0),
@@ -173,14 +336,8 @@ void VBContinuumSubtractor::fit(VisBuffGroupAcc& vbga, const Int fitorder,
   if(!checkSize(coeffs, coeffsOK))
     throw(AipsError("Shape mismatch in the coefficient storage cubes."));
 
-  // Make the estimate
-  LinearFitSVD<Float> fitter;
-  fitter.asWeight(true);        // Makes the "sigma" arg = w = 1/sig**2
-
   coeffsOK.set(False);
 
-  // Translate vbga to arrays for use by LinearFitSVD.
-
   // The fitorder will actually be clamped on a baseline-by-baseline basis
   // because of flagging, but a summary note is in order here.
   if(static_cast<Int>(totnumchan_p) < fitorder_p)
@@ -192,19 +349,134 @@ void VBContinuumSubtractor::fit(VisBuffGroupAcc& vbga, const Int fitorder,
   // Scale frequencies to [-1, 1].
   midfreq_p = 0.5 * (lofreq_p + hifreq_p);
   freqscale_p = calcFreqScale();
+
+  // Pull everything needed out of the VisBuffers up front.  Their accessors
+  // fill caches on demand, so they must not be called from the parallel
+  // section below.
+  const Int nBuf = vbga.nBuf();
   Vector<Float> freqs(totnumchan_p);
+  Vector<Int> bufOfChan(totnumchan_p);
+  Vector<Int> chanOfChan(totnumchan_p);
+  Block<const Cube<Complex>*> viscubes(nBuf);
+  Block<const Matrix<Bool>*> flags(nBuf);
+  Block<const Vector<Bool>*> flagRows(nBuf);
+  Block<const Matrix<Float>*> weightMats(nBuf);
+  Vector<uInt> nchans(nBuf);
   uInt totchan = 0;
-  for(Int ibuf = 0; ibuf < vbga.nBuf(); ++ibuf){
+  for(Int ibuf = 0; ibuf < nBuf; ++ibuf){
     VisBuffer& vb(vbga(ibuf));
     Vector<Double> freq(vb.frequency());
     uInt nchan = vb.nChannel();
 
     for(uInt c = 0; c < nchan; ++c){
       freqs[totchan] = freqscale_p * (freq[c] - midfreq_p);
+      bufOfChan[totchan] = ibuf;
+      chanOfChan[totchan] = c;
       ++totchan;
     }
+    nchans[ibuf] = nchan;
+    viscubes[ibuf] = &vb.dataCube(whichcol);
+    // AAARRGGGHHH!!  With Calibrater you have to use vb.flag(), not
+    // flagCube(), to get the channel selection!
+    flags[ibuf] = &vb.flag();
+    flagRows[ibuf] = &vb.flagRow();
+    weightMats[ibuf] = &vb.weightMat();
+  }
+
+  // Every (corr, baseline) shares the same frequencies, so its least squares
+  // solution only depends on which channels are unflagged and on the
+  // relative weights of the buffers.  Group the (corr, baseline)s by that
+  // pattern, and for each pattern used more than once precompute the matrix
+  // that turns visibilities into coefficients.  Fitting a baseline is then
+  // one small matrix-vector product instead of two SVDs.
+  std::vector<ContinuumFitPattern> patterns;
+  std::map<ContinuumFitKey, Int> patternIndex;
+  Matrix<Int> patternOf(ncorr_p, nHashes_p, -1);
+  ContinuumFitKey key;
+  key.first.resize(totnumchan_p);
+  for(uInt blind = 0; blind < nHashes_p; ++blind){
+    totchan = 0;
+    uInt nUnflagged = 0;
+    for(Int ibuf = 0; ibuf < nBuf; ++ibuf){
+      const Bool rowFlagged = (*flagRows[ibuf])[blind];
+      for(uInt c = 0; c < nchans[ibuf]; ++c){
+        key.first[totchan] = !rowFlagged && !(*flags[ibuf])(c, blind);
+        if(key.first[totchan])
+          ++nUnflagged;
+        ++totchan;
+      }
+    }
+    if(nUnflagged == 0)
+      continue;
+
+    for(uInt corrind = 0; corrind < ncorr_p; ++corrind){
+      key.second.resize(0);
+      Float wref = 0.0;
+      for(Int ibuf = 0; ibuf < nBuf; ++ibuf){
+        if(!(*flagRows[ibuf])[blind]){
+          Float w = continuumFitWeight((*weightMats[ibuf])(corrind, blind));
+          if(wref == 0.0)
+            wref = w;
+          key.second.push_back(w / wref);
+        }
+        else
+          key.second.push_back(0.0);
+      }
+
+      std::map<ContinuumFitKey, Int>::iterator it = patternIndex.find(key);
+      if(it == patternIndex.end()){
+        it = patternIndex.insert(std::make_pair(key, Int(patterns.size()))).first;
+        patterns.push_back(ContinuumFitPattern());
+      }
+      patternOf(corrind, blind) = it->second;
+      ++patterns[it->second].nUsers;
+    }
+  }
+
+  Int nBatched = 0;
+  for(std::map<ContinuumFitKey, Int>::const_iterator it = patternIndex.begin();
+      it != patternIndex.end(); ++it){
+    ContinuumFitPattern& pattern = patterns[it->second];
+    if(pattern.nUsers > 1 && makeContinuumFitProjection(pattern, it->first,
+                                                         freqs, bufOfChan,
+                                                         nchans, fitorder_p))
+      ++nBatched;
+  }
+  os << LogIO::DEBUG1 << patterns.size() << " flag and weight patterns, "
+     << nBatched << " of them fitted in batch." << LogIO::POST;
+
+  const Int nFits = ncorr_p * nHashes_p;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 64)
+#endif
+  for(Int ifit = 0; ifit < nFits; ++ifit){
+    const uInt corrind = ifit % ncorr_p;
+    const uInt blind = ifit / ncorr_p;
+    const Int ipat = patternOf(corrind, blind);
+
+    if(ipat < 0 || patterns[ipat].proj.nelements() == 0)
+      continue;
+
+    const ContinuumFitPattern& pattern = patterns[ipat];
+    const uInt nCoef = pattern.proj.nrow();
+    for(uInt ordind = 0; ordind < nCoef; ++ordind){
+      DComplex sum(0.0, 0.0);
+      for(uInt k = 0; k < pattern.chans.nelements(); ++k){
+        const Int totc = pattern.chans[k];
+        sum += pattern.proj(ordind, k) *
+          DComplex((*viscubes[bufOfChan[totc]])(corrind, chanOfChan[totc], blind));
+      }
+      coeffs(corrind, ordind, blind) = Complex(sum);
+    }
+    storeContinuumFitOrder(coeffs, coeffsOK, corrind, blind, nCoef - 1,
+                           fitorder_p);
   }
 
+  // The (corr, baseline)s with a pattern of their own, or whose normal
+  // matrix could not be inverted, get an SVD fit of their own.
+  LinearFitSVD<Float> fitter;
+  fitter.asWeight(true);        // Makes the "sigma" arg = w = 1/sig**2
+
   Vector<Float> wt(totnumchan_p);
   Vector<Float> unflaggedfreqs(totnumchan_p);
   Vector<Complex> vizzes(totnumchan_p);
@@ -214,7 +486,11 @@ void VBContinuumSubtractor::fit(VisBuffGroupAcc& vbga, const Int fitorder,
 
   for(uInt corrind = 0; corrind < ncorr_p; ++corrind){
     for(uInt blind = 0; blind < nHashes_p; ++blind){
-      uInt totchan = 0;
+      const Int ipat = patternOf(corrind, blind);
+      if(ipat < 0 || patterns[ipat].proj.nelements() > 0)
+        continue;
+
+      totchan = 0;
       uInt totunflaggedchan = 0;
 
       // Fill wt, unflaggedfreqs, and vizzes with the baseline's values for
@@ -223,52 +499,17 @@ void VBContinuumSubtractor::fit(VisBuffGroupAcc& vbga, const Int fitorder,
       vizzes.resize(totnumchan_p);
       unflaggedfreqs.resize(totnumchan_p);
 
-      for(Int ibuf = 0; ibuf < vbga.nBuf(); ++ibuf){
-        VisBuffer& vb(vbga(ibuf));
-        uInt nchan = vb.nChannel();
-        //Int vbrow = vbga.outToInRow(ibuf, False)[blind];
-
-        if(!vb.flagRow()[blind]){
-          Cube<Complex>& viscube(vb.dataCube(whichcol));
-          Float w;
-
-          // 2/24/2011: VisBuffer doesn't (yet) have sigmaSpectrum, and I have
-          // never seen it in an MS anyway.  Settle for 1/sqrt(weightSpectrum)
-          // if it is available or sigmaMat otherwise.
-          //const Bool haveWS = vb.existsWeightSpectrum();
-          // 5/13/2011: Sigh.  VisBuffAccumulator doesn't even handle
-          // WeightSpectrum, let alone sigma.
-          //const Bool haveWS = false;
-
-          //if(!haveWS) // w is needed either way, in case ws == 0.0.
-          w = vb.weightMat()(corrind, blind);
-
-          // w needs a sanity check, because a VisBuffer from vbga is not
-          // necessarily still attached to the MS and sigmaMat() is not one
-          // of the accumulated quantities.  This caused problems for
-          // the last integration in CAS-3135.  checkVisIter() didn't do the
-          // trick in that case.  Fortunately w isn't all that important; if
-          // all the channels have the same weight the only consequence of
-          // setting w to 1 is that the estimated errors (which we don't yet
-          // use) will be wrong.
-          //
-          // 5e-45 ended up getting squared in the fitter and producing a NaN.
-          if(isnan(w) || w < 1.0e-20 || w > 1.0e20)
-            w = 1.0;  // Emit a warning?
+      for(Int ibuf = 0; ibuf < nBuf; ++ibuf){
+        uInt nchan = nchans[ibuf];
+
+        if(!(*flagRows[ibuf])[blind]){
+          const Cube<Complex>& viscube(*viscubes[ibuf]);
+          Float w = continuumFitWeight((*weightMats[ibuf])(corrind, blind));
 
           for(uInt c = 0; c < nchan; ++c){
-            // AAARRGGGHHH!!  With Calibrater you have to use vb.flag(), not
-            // flagCube(), to get the channel selection!
-            //if(!vb.flagCube()(corrind, c, vbrow)){
-            if(!vb.flag()(c, blind)){
+            if(!(*flags[ibuf])(c, blind)){
               unflaggedfreqs[totunflaggedchan] = freqs[totchan];
-              // if(haveWS){
-              //   Double ws = vb.weightSpectrum()(corrind, c, vbrow);
-
-              //   wt[totunflaggedchan] = ws;
-              // }
-              // else
-                wt[totunflaggedchan] = w / nchan;
+              wt[totunflaggedchan] = w / nchan;
               vizzes[totunflaggedchan] = viscube(corrind, c, blind);
               ++totunflaggedchan;
             }
@@ -279,90 +520,47 @@ void VBContinuumSubtractor::fit(VisBuffGroupAcc& vbga, const Int fitorder,
           totchan += nchan;
       }
 
-      if(totunflaggedchan > 0){                 // OK, try a fit.
-        // Truncate the Vectors.
-        wt.resize(totunflaggedchan, True);
-        //vizzes.resize(totunflaggedchan, True);
-        floatvs.resize(totunflaggedchan);
-        unflaggedfreqs.resize(totunflaggedchan, True);
-
-        // perform least-squares fit of a polynomial.
-        // Don't try to solve for more coefficients than valid channels.
-        Int locFitOrd = min(fitorder_p, static_cast<Int>(totunflaggedchan) - 1);
-
-        // if(locFitOrd < 1)
-        //   os << LogIO::DEBUG1
-        //      << "locFitOrd = " << locFitOrd
-        //      << LogIO::POST;
-
-        Polynomial<AutoDiff<Float> > pnom(locFitOrd);
-
-        // The way LinearFit is templated, "y" can be Complex, but at the cost
-        // of "x" being Complex as well, and worse, wt too.  It is better to
-        // separately fit the reals and imags.
-        // Do reals.
-        for(Int ordind = 0; ordind <= locFitOrd; ++ordind)       // Note <=.
-          pnom.setCoefficient(ordind, 1.0);
-
-        for(uInt c = 0; c < totunflaggedchan; ++c)
-          floatvs[c] = vizzes[c].real();
-
-        fitter.setFunction(pnom);
-        realsolution(Slice(0,locFitOrd+1,1)) = fitter.fit(unflaggedfreqs, floatvs, wt);
-
-        // if(isnan(realsolution[0])){
-        //   os << LogIO::DEBUG1 << "NaN found." << LogIO::POST;
-        //   for(uInt c = 0; c < totunflaggedchan; ++c){
-        //     if(isnan(unflaggedfreqs[c]))
-        //       os << LogIO::DEBUG1
-        //          << "unflaggedfreqs[" << c << "] is a NaN."
-        //          << LogIO::POST;
-        //     if(isnan(floatvs[c]))
-        //       os << LogIO::DEBUG1
-        //          << "floatvs[" << c << "] is a NaN."
-        //          << LogIO::POST;
-        //     if(isnan(wt[c]))
-        //       os << LogIO::DEBUG1
-        //          << "wt[" << c << "] is a NaN."
-        //          << LogIO::POST;
-        //     else if(wt[c] <= 0.0)
-        //       os << LogIO::DEBUG1
-        //          << "wt[" << c << "] = " << wt[c]
-        //          << LogIO::POST;
-        //   }
-        // }
-
-        // Do imags.
-        for(Int ordind = 0; ordind <= locFitOrd; ++ordind)       // Note <=.
-          pnom.setCoefficient(ordind, 1.0);
-
-        for(uInt c = 0; c < totunflaggedchan; ++c)
-          floatvs[c] = vizzes[c].imag();
-
-        fitter.setFunction(pnom);
-        imagsolution(Slice(0,locFitOrd+1,1)) = fitter.fit(unflaggedfreqs, floatvs, wt);
-
-          
-
-        for(Int ordind = 0; ordind <= locFitOrd; ++ordind){      // Note <=.
-          coeffs(corrind, ordind, blind) = Complex(realsolution[ordind],
-                                                   imagsolution[ordind]);
-          coeffsOK(corrind, ordind, blind) = True;
-        }
+      // Truncate the Vectors.
+      wt.resize(totunflaggedchan, True);
+      floatvs.resize(totunflaggedchan);
+      unflaggedfreqs.resize(totunflaggedchan, True);
 
-        // Pad remaining orders (if any) with 0.0.  Note <=.
-        for(Int ordind = locFitOrd + 1; ordind <= fitorder_p; ++ordind){
-          coeffs(corrind, ordind, blind) = 0.0;
+      // perform least-squares fit of a polynomial.
+      // Don't try to solve for more coefficients than valid channels.
+      Int locFitOrd = min(fitorder_p, static_cast<Int>(totunflaggedchan) - 1);
 
-          // Since coeffs(corrind, ordind, blind) == 0, it isn't necessary to
-          // pay attention to coeffsOK(corrind, ordind, blind) (especially?) if
-          // ordind > 0.  But Calibrater's SolvableVisCal::keep() and store()
-          // quietly go awry if you try coeffsOK.resize(ncorr_p, 1, nHashes_p);
-          coeffsOK(corrind, ordind, blind) = False;
-        }
+      Polynomial<AutoDiff<Float> > pnom(locFitOrd);
 
-        // TODO: store uncertainties
-      }
+      // The way LinearFit is templated, "y" can be Complex, but at the cost
+      // of "x" being Complex as well, and worse, wt too.  It is better to
+      // separately fit the reals and imags.
+      // Do reals.
+      for(Int ordind = 0; ordind <= locFitOrd; ++ordind)       // Note <=.
+        pnom.setCoefficient(ordind, 1.0);
+
+      for(uInt c = 0; c < totunflaggedchan; ++c)
+        floatvs[c] = vizzes[c].real();
+
+      fitter.setFunction(pnom);
+      realsolution(Slice(0,locFitOrd+1,1)) = fitter.fit(unflaggedfreqs, floatvs, wt);
+
+      // Do imags.
+      for(Int ordind = 0; ordind <= locFitOrd; ++ordind)       // Note <=.
+        pnom.setCoefficient(ordind, 1.0);
+
+      for(uInt c = 0; c < totunflaggedchan; ++c)
+        floatvs[c] = vizzes[c].imag();
+
+      fitter.setFunction(pnom);
+      imagsolution(Slice(0,locFitOrd+1,1)) = fitter.fit(unflaggedfreqs, floatvs, wt);
+
+      for(Int ordind = 0; ordind <= locFitOrd; ++ordind)        // Note <=.
+        coeffs(corrind, ordind, blind) = Complex(realsolution[ordind],
+                                                 imagsolution[ordind]);
+      storeContinuumFitOrder(coeffs, coeffsOK, corrind, blind, locFitOrd,
+                             fitorder_p);
+
+      // TODO: store uncertainties
     }
   }
 }
@@ -0,0 +1,135 @@
+//# tInstrumentation.cc: test the utilj::Instrumentation registry
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/Containers/Record.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/iostream.h>
+#include <casa/Utilities/Assert.h>
+#include <msvis/MSVis/AsynchronousTools.h>
+#include <msvis/MSVis/UtilJ.h>
+
+#include <vector>
+
+#include <casa/namespace.h>
+using namespace casa::utilj;
+
+namespace {
+
+// Records nEvents timed events, counts and bytes from its own thread
+class RecordingThread : public async::Thread {
+public:
+  explicit RecordingThread(Int nEvents) : nEvents_p(nEvents) {}
+protected:
+  void *run() {
+    for (Int i = 0; i < nEvents_p; i++) {
+      InstrumentationTimer timer("tInstrumentation.threaded");
+      Instrumentation::addCount("tInstrumentation.threaded");
+      Instrumentation::addBytes("tInstrumentation.threaded", 8);
+    }
+    return 0;
+  }
+private:
+  Int nEvents_p;
+};
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    // Nothing is recorded while disabled
+    Instrumentation::setEnabled(False);
+    {
+      InstrumentationTimer timer("tInstrumentation.disabled");
+      Instrumentation::addCount("tInstrumentation.disabled", 3);
+    }
+    AlwaysAssert(!Instrumentation::toRecord().isDefined("tInstrumentation.disabled"),
+		 AipsError);
+
+    Instrumentation::setEnabled(True);
+    AlwaysAssert(Instrumentation::isEnabled(), AipsError);
+    for (Int i = 0; i < 3; i++) {
+      InstrumentationTimer timer("tInstrumentation.timer");
+      sleepMs(10);
+    }
+    {
+      // Stopped timers do not record again when destroyed
+      InstrumentationTimer timer("tInstrumentation.stopped");
+      timer.stop();
+    }
+    Instrumentation::addCount("tInstrumentation.counter");
+    Instrumentation::addCount("tInstrumentation.counter", 4);
+    Instrumentation::addBytes("tInstrumentation.bytes", 1024);
+
+    const Int nThreads = 4;
+    const Int nEvents = 1000;
+    std::vector<RecordingThread *> threads;
+    for (Int i = 0; i < nThreads; i++) {
+      threads.push_back(new RecordingThread(nEvents));
+      threads.back()->startThread();
+    }
+    for (Int i = 0; i < nThreads; i++) {
+      threads[i]->join();
+      delete threads[i];
+    }
+
+    Record rec = Instrumentation::toRecord();
+    cout << Instrumentation::toJson();
+
+    const Record &timer = rec.subRecord("tInstrumentation.timer");
+    AlwaysAssert(timer.asInt64("calls") == 3, AipsError);
+    AlwaysAssert(timer.asDouble("elapsed") >= 0.03, AipsError);
+    AlwaysAssert(timer.asDouble("elapsedMin") >= 0.01, AipsError);
+    AlwaysAssert(timer.asDouble("elapsedMax") <= timer.asDouble("elapsed"), AipsError);
+    AlwaysAssert(timer.asInt("threads") == 1, AipsError);
+
+    AlwaysAssert(rec.subRecord("tInstrumentation.stopped").asInt64("calls") == 1,
+		 AipsError);
+    AlwaysAssert(rec.subRecord("tInstrumentation.counter").asInt64("count") == 5,
+		 AipsError);
+    AlwaysAssert(rec.subRecord("tInstrumentation.bytes").asInt64("bytes") == 1024,
+		 AipsError);
+
+    const Record &threaded = rec.subRecord("tInstrumentation.threaded");
+    AlwaysAssert(threaded.asInt64("calls") == nThreads*nEvents, AipsError);
+    AlwaysAssert(threaded.asInt64("count") == nThreads*nEvents, AipsError);
+    AlwaysAssert(threaded.asInt64("bytes") == 8*nThreads*nEvents, AipsError);
+    AlwaysAssert(threaded.asInt("threads") == nThreads, AipsError);
+    AlwaysAssert(threaded.asDouble("elapsedMaxThread") <= threaded.asDouble("elapsed"),
+		 AipsError);
+
+    Instrumentation::clear();
+    AlwaysAssert(Instrumentation::toRecord().nfields() == 0, AipsError);
+  } catch (AipsError x) {
+    cout << "Caught exception: " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
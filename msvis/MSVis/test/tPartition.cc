@@ -0,0 +1,164 @@
+//# tPartition.cc: test multi-output partitioning with Partition::makePartitions
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/iostream.h>
+#include <casa/Utilities/Assert.h>
+#include <ms/MeasurementSets/MSColumns.h>
+#include <msvis/MSVis/Partition.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <tables/Tables/Table.h>
+
+#include <map>
+
+#include <casa/namespace.h>
+using namespace std;
+using namespace casa::vi::test;
+
+namespace {
+
+// Row key of a main table row: (time, antenna1, antenna2, DATA_DESC_ID)
+typedef pair<pair<Double, Int>, pair<Int, Int> > RowKey;
+
+RowKey rowKey(const ROMSColumns& msc, uInt row)
+{
+  return make_pair(make_pair(msc.time()(row), msc.antenna1()(row)),
+		   make_pair(msc.antenna2()(row), msc.dataDescId()(row)));
+}
+
+// Check that the outputs between them hold every row of ms exactly once,
+// with the same data, flags and weights.  Returns the number of rows of each
+// output.
+Vector<uInt> checkOutputs(const MeasurementSet& ms, const Vector<String>& names)
+{
+  ROMSColumns msc(ms);
+  map<RowKey, uInt> inRow;
+  for (uInt row = 0; row < ms.nrow(); ++row) {
+    inRow[rowKey(msc, row)] = row;
+  }
+
+  Vector<uInt> nrows(names.nelements());
+  uInt total = 0;
+  for (uInt k = 0; k < names.nelements(); ++k) {
+    MeasurementSet out(names[k]);
+    ROMSColumns outc(out);
+    nrows[k] = out.nrow();
+    total += out.nrow();
+    for (uInt row = 0; row < out.nrow(); ++row) {
+      map<RowKey, uInt>::iterator it = inRow.find(rowKey(outc, row));
+      AlwaysAssert(it != inRow.end(), AipsError);
+      const uInt in = it->second;
+      inRow.erase(it);
+      AlwaysAssert(allEQ(outc.data()(row), msc.data()(in)), AipsError);
+      AlwaysAssert(allEQ(outc.flag()(row), msc.flag()(in)), AipsError);
+      AlwaysAssert(allEQ(outc.weight()(row), msc.weight()(in)), AipsError);
+      AlwaysAssert(allEQ(outc.uvw()(row), msc.uvw()(in)), AipsError);
+      AlwaysAssert(outc.scanNumber()(row) == msc.scanNumber()(in), AipsError);
+      AlwaysAssert(outc.flagRow()(row) == msc.flagRow()(in), AipsError);
+      AlwaysAssert(outc.exposure()(row) == msc.exposure()(in), AipsError);
+    }
+  }
+  AlwaysAssert(total == ms.nrow(), AipsError);
+  AlwaysAssert(inRow.empty(), AipsError);
+  return nrows;
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    MsFactory msFactory("tPartition_in.ms");
+    msFactory.setTimeInfo(0, 120, 1);
+    msFactory.addSpectralWindows(2);
+    msFactory.addAntennas(4);
+    msFactory.addFeeds(10);
+    msFactory.addField("field0", MDirection());
+    pair<MeasurementSet *, Int> made = msFactory.createMs();
+    MeasurementSet ms(*made.first);
+    delete made.first;
+
+    String datacol("data");
+
+    // Consecutive runs of rows
+    {
+      Vector<String> names(3);
+      for (uInt k = 0; k < names.nelements(); ++k) {
+	names[k] = "tPartition_row" + String::toString(k) + ".ms";
+      }
+      Partition partition(ms);
+      AlwaysAssert(partition.setmsselect(), AipsError);
+      partition.selectTime();
+      AlwaysAssert(partition.makePartitions(names, datacol, "row"), AipsError);
+      Vector<uInt> nrows = checkOutputs(ms, names);
+      AlwaysAssert(max(nrows) - min(nrows) <= 1, AipsError);
+      for (uInt k = 0; k < names.nelements(); ++k) {
+	Table::deleteTable(names[k]);
+      }
+    }
+
+    // Whole spws, with an explicit tile shape
+    {
+      Vector<String> names(2);
+      names[0] = "tPartition_spw0.ms";
+      names[1] = "tPartition_spw1.ms";
+      Matrix<Int> tileShapes(3, 2);
+      tileShapes.column(0) = 4;
+      tileShapes.column(1) = 4;
+      Partition partition(ms);
+      AlwaysAssert(partition.setmsselect(), AipsError);
+      partition.selectTime();
+      AlwaysAssert(partition.makePartitions(names, datacol, "spw", tileShapes), AipsError);
+      checkOutputs(ms, names);
+      for (uInt k = 0; k < names.nelements(); ++k) {
+	MeasurementSet out(names[k]);
+	ROMSColumns outc(out);
+	// Every row of an output belongs to the same spectral window
+	Vector<Int> spw = outc.dataDescId().getColumn();
+	const Vector<Int> spwOfDDID = outc.dataDescription().spectralWindowId().getColumn();
+	for (uInt row = 0; row < spw.nelements(); ++row) {
+	  spw[row] = spwOfDDID[spw[row]];
+	}
+	AlwaysAssert(spw.nelements() > 0 && allEQ(spw, spw[0]), AipsError);
+      }
+      for (uInt k = 0; k < names.nelements(); ++k) {
+	Table::deleteTable(names[k]);
+      }
+    }
+
+    ms = MeasurementSet();
+    Table::deleteTable("tPartition_in.ms");
+  } catch (AipsError x) {
+    cout << "Caught exception: " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,218 @@
+//# tStatWT.cc: check the weights of StatWT, with one and several threads,
+//# against a serial two-pass variance
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/Containers/Block.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <measures/Measures/MDirection.h>
+#include <ms/MeasurementSets/MSColumns.h>
+#include <msvis/MSVis/GroupProcessor.h>
+#include <msvis/MSVis/StatWT.h>
+#include <msvis/MSVis/VisibilityIterator.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <tables/Tables/Table.h>
+
+#include <map>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include <casa/namespace.h>
+using namespace std;
+using namespace casa::vi::test;
+
+namespace {
+
+// Enough antennas that every time has more baselines than StatWT puts in a
+// block of rows, so the rows of a buffer are shared among the threads
+const Int nAnt = 30;
+const Int nChan = 16;
+const Int nCorr = 2;
+
+// Pseudo-random noise in [-0.5, 0.5)
+Double noise(uInt seed)
+{
+  seed = seed * 1103515245u + 12345u;
+  seed ^= seed >> 16;
+  seed *= 2654435761u;
+  seed ^= seed >> 13;
+  return (seed % 100000) / 100000.0 - 0.5;
+}
+
+// A mean that differs by baseline and correlation, plus noise whose
+// amplitude differs by baseline
+class GenerateNoisyData : public Generator<Complex> {
+public:
+  Complex operator()(const FillState &fillState, Int channel, Int correlation) const {
+    const uInt seed = ((fillState.rowNumber_p * nChan + channel) * nCorr + correlation) * 2;
+    const Double amplitude = 1.0 + 0.1 * fillState.antenna1_p + 0.05 * fillState.antenna2_p;
+    return Complex(3.0 + fillState.antenna1_p - correlation + amplitude * noise(seed),
+                   -2.0 + 0.5 * fillState.antenna2_p + amplitude * noise(seed + 1));
+  }
+};
+
+// Flag about one sample in seven
+class GenerateSomeFlags : public Generator<Bool> {
+public:
+  Bool operator()(const FillState &fillState, Int channel, Int correlation) const {
+    return (fillState.rowNumber_p + 3 * channel + correlation) % 7 == 0;
+  }
+};
+
+typedef pair<pair<Int, Int>, Int> Key;      // ((antenna1, antenna2), correlation)
+
+// Variance of the unflagged samples of every baseline and correlation of
+// the MS, from the mean and then the squared deviations from it
+map<Key, Double> twoPassVariances(const MeasurementSet& ms)
+{
+  ROMSColumns msc(ms);
+  map<Key, DComplex> sums;
+  map<Key, uInt> counts;
+  for (uInt pass = 0; pass < 2; ++pass) {
+    map<Key, Double> squares;
+    for (uInt row = 0; row < ms.nrow(); ++row) {
+      if (msc.flagRow()(row)) {
+        continue;
+      }
+      const Matrix<Complex> data(msc.data()(row));
+      const Matrix<Bool> flag(msc.flag()(row));
+      const pair<Int, Int> baseline(msc.antenna1()(row), msc.antenna2()(row));
+      for (Int corr = 0; corr < nCorr; ++corr) {
+	const Key key(baseline, corr);
+	for (Int chan = 0; chan < nChan; ++chan) {
+	  if (flag(corr, chan)) {
+	    continue;
+	  }
+	  const DComplex vis(data(corr, chan));
+	  if (pass == 0) {
+	    sums[key] += vis;
+	    ++counts[key];
+	  } else {
+	    squares[key] += norm(vis - sums[key] / Double(counts[key]));
+	  }
+	}
+      }
+    }
+    if (pass == 1) {
+      map<Key, Double> variances;
+      map<Key, Double>::const_iterator it;
+      for (it = squares.begin(); it != squares.end(); ++it) {
+	variances[it->first] = it->second / (counts[it->first] - 1.0);
+      }
+      return variances;
+    }
+  }
+  return map<Key, Double>();
+}
+
+// Run StatWT over a copy of ms, with nThreads threads, and return the
+// weights it wrote
+Matrix<Float> statwt(const MeasurementSet& ms, const String& name, Int nThreads)
+{
+#ifdef _OPENMP
+  omp_set_num_threads(nThreads);
+#else
+  (void)nThreads;
+#endif
+  ms.deepCopy(name, Table::New);
+  Matrix<Float> weights;
+  {
+    MeasurementSet copy(name, Table::Update);
+    // One chunk per field and spw, so the variances are over all the times
+    ROVisibilityIterator vi(copy, Block<Int>(), 0.0);
+    vi.originChunks();
+    vector<uInt> selcorrs;
+    for (Int corr = 0; corr < nCorr; ++corr) {
+      selcorrs.push_back(corr);
+    }
+    StatWT worker(vi, MS::DATA, "*", "*", False, 2, selcorrs);
+    GroupProcessor processor(vi, &worker);
+    AlwaysAssert(processor.go(), AipsError);
+  }
+  {
+    MeasurementSet copy(name);
+    weights = ROMSColumns(copy).weight().getColumn();
+  }
+  Table::deleteTable(name);
+  return weights;
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const String msName("tStatWT.ms");
+    {
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(0, 20.0, 1.0);
+      msFactory.addAntennas(nAnt);
+      msFactory.addFeeds(nAnt);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", nChan, 1.0e9, 1.0e6, "RR LL");
+      msFactory.setDataGenerator(MSMainEnums::DATA, new GenerateNoisyData);
+      msFactory.setDataGenerator(MSMainEnums::FLAG, new GenerateSomeFlags);
+      msFactory.setDataGenerator(MSMainEnums::FLAG_ROW, new GenerateConstant<Bool>(False));
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+    MeasurementSet ms(msName);
+    AlwaysAssert(ms.nrow() > 256, AipsError);
+
+    const Matrix<Float> serial = statwt(ms, "tStatWT_1.ms", 1);
+    const Matrix<Float> parallel = statwt(ms, "tStatWT_N.ms", 4);
+    AlwaysAssert(serial.shape().isEqual(parallel.shape()), AipsError);
+    AlwaysAssert(allNear(serial, parallel, 1.0e-6), AipsError);
+
+    const map<Key, Double> variances = twoPassVariances(ms);
+    ROMSColumns msc(ms);
+    for (uInt row = 0; row < ms.nrow(); ++row) {
+      const pair<Int, Int> baseline(msc.antenna1()(row), msc.antenna2()(row));
+      for (Int corr = 0; corr < nCorr; ++corr) {
+	map<Key, Double>::const_iterator it = variances.find(Key(baseline, corr));
+	AlwaysAssert(it != variances.end() && it->second > 0.0, AipsError);
+	AlwaysAssert(near(Double(serial(corr, row)), 1.0 / it->second, 1.0e-5), AipsError);
+	AlwaysAssert(near(Double(parallel(corr, row)), 1.0 / it->second, 1.0e-5), AipsError);
+      }
+    }
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
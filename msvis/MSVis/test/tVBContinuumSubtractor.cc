@@ -0,0 +1,265 @@
+//# tVBContinuumSubtractor.cc: check the continuum fits of
+//# VBContinuumSubtractor against per-baseline SVD fits
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Arrays/Slice.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/Containers/Block.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <measures/Measures/MDirection.h>
+#include <msvis/MSVis/VBContinuumSubtractor.h>
+#include <msvis/MSVis/VisBuffGroupAcc.h>
+#include <msvis/MSVis/VisBuffer.h>
+#include <msvis/MSVis/VisibilityIterator.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <scimath/Fitting/LinearFitSVD.h>
+#include <scimath/Functionals/Polynomial.h>
+#include <tables/Tables/Table.h>
+
+#include <casa/namespace.h>
+using namespace std;
+using namespace casa::vi::test;
+
+namespace {
+
+// 28 baselines (with the autocorrelations VisBuffAccumulator allows for)
+const Int nAnt = 7;
+const Int nChan = 8;
+const Int nCorr = 2;
+const Int fitorder = 2;
+
+// Pseudo-random noise in [-0.5, 0.5)
+Float noise(uInt seed)
+{
+  seed = seed * 1103515245u + 12345u;
+  seed ^= seed >> 16;
+  seed *= 2654435761u;
+  seed ^= seed >> 13;
+  return (seed % 100000) / 100000.0 - 0.5;
+}
+
+// The baselines of the accumulated buffers, by the flag and weight pattern
+// they are given:
+//   0 - 7   unflagged, with spw 1 weighted twice as much as spw 0:
+//           shared by 16 (corr, baseline)s and fitted in batch;
+//   8 - 13  spw 1 row flagged and channels 0 and 1 of spw 0 flagged:
+//           shared by 12 and fitted in batch;
+//   14 - 19 a different channel of spw 0 flagged per baseline and a
+//           different weight of spw 1 per correlation: a pattern of their
+//           own, fitted by SVD;
+//   20 - 23 only channel 5 of spw 0 and channel 1 of spw 1, which have the
+//           same frequency, unflagged: shared, but the normal matrix of a
+//           first order fit is singular, so fitted by SVD;
+//   24 - 25 every row flagged, and
+//   26 - 27 every channel flagged: not fitted at all.
+void setPatterns(VisBuffGroupAcc& vbga)
+{
+  for(Int ibuf = 0; ibuf < vbga.nBuf(); ++ibuf){
+    VisBuffer& vb(vbga(ibuf));
+    const Int spw = vb.spectralWindow();
+    const Int nRow = vb.nRow();
+    AlwaysAssert(nRow == nAnt * (nAnt + 1) / 2, AipsError);
+    AlwaysAssert(vb.nChannel() == nChan, AipsError);
+    AlwaysAssert(vb.nCorr() == nCorr, AipsError);
+
+    Cube<Complex>& vis(vb.visCube());
+    Matrix<Bool>& flag(vb.flag());
+    Vector<Bool>& flagRow(vb.flagRow());
+    Matrix<Float>& weight(vb.weightMat());
+    const Vector<Double>& freq(vb.frequency());
+
+    for(Int row = 0; row < nRow; ++row){
+      flagRow[row] = (row >= 8 && row < 14 && spw == 1) ||
+                     (row >= 24 && row < 26);
+      for(Int chan = 0; chan < nChan; ++chan){
+        Bool f = False;
+        if(row >= 8 && row < 14)
+          f = spw == 0 && chan < 2;
+        else if(row >= 14 && row < 20)
+          f = spw == 0 && chan == row - 14;
+        else if(row >= 20 && row < 24)
+          f = chan != (spw == 0 ? 5 : 1);
+        else if(row >= 26)
+          f = True;
+        flag(chan, row) = f;
+      }
+      for(Int corr = 0; corr < nCorr; ++corr){
+        Float w = 1.0;
+        if(row < 8)
+          w = spw == 0 ? 1.0 : 2.0;
+        else if(row >= 14 && row < 20 && spw == 1)
+          w = 1.0 + 0.5 * corr;
+        weight(corr, row) = w;
+
+        // A quadratic continuum that differs by baseline and correlation,
+        // plus noise.
+        for(Int chan = 0; chan < nChan; ++chan){
+          const Double x = (freq[chan] - 1.005e9) / 1.0e6;
+          const uInt seed = ((row * nCorr + corr) * 2 + spw) * nChan + chan;
+          vis(corr, chan, row) =
+            Complex(1.0 + 0.1 * row - 0.2 * corr * x + 0.01 * x * x,
+                    -0.5 + 0.05 * row * x + corr) +
+            0.05f * Complex(noise(2 * seed), noise(2 * seed + 1));
+        }
+      }
+    }
+  }
+}
+
+// The fit of (corr, row) that VBContinuumSubtractor made before fits were
+// batched: one SVD each for the reals and imaginaries, over the unflagged
+// channels of every buffer.  Returns the order of the fit, or -1 if there
+// were no unflagged channels.
+Int svdFit(VisBuffGroupAcc& vbga, const Vector<Float>& freqs,
+           const uInt corr, const uInt row, Vector<Complex>& coeffs)
+{
+  Vector<Float> wt(freqs.nelements());
+  Vector<Float> unflaggedfreqs(freqs.nelements());
+  Vector<Complex> vizzes(freqs.nelements());
+  uInt totchan = 0;
+  uInt nUnflagged = 0;
+  for(Int ibuf = 0; ibuf < vbga.nBuf(); ++ibuf){
+    VisBuffer& vb(vbga(ibuf));
+    const uInt nchan = vb.nChannel();
+    for(uInt c = 0; c < nchan; ++c, ++totchan){
+      if(!vb.flagRow()[row] && !vb.flag()(c, row)){
+        unflaggedfreqs[nUnflagged] = freqs[totchan];
+        wt[nUnflagged] = vb.weightMat()(corr, row) / nchan;
+        vizzes[nUnflagged] = vb.visCube()(corr, c, row);
+        ++nUnflagged;
+      }
+    }
+  }
+  if(nUnflagged == 0)
+    return -1;
+  wt.resize(nUnflagged, True);
+  unflaggedfreqs.resize(nUnflagged, True);
+
+  const Int locFitOrd = min(fitorder, static_cast<Int>(nUnflagged) - 1);
+  LinearFitSVD<Float> fitter;
+  fitter.asWeight(true);
+  Polynomial<AutoDiff<Float> > pnom(locFitOrd);
+  Vector<Float> floatvs(nUnflagged);
+  Vector<Float> solution[2];
+  for(uInt part = 0; part < 2; ++part){
+    for(Int ordind = 0; ordind <= locFitOrd; ++ordind)
+      pnom.setCoefficient(ordind, 1.0);
+    for(uInt c = 0; c < nUnflagged; ++c)
+      floatvs[c] = part == 0 ? vizzes[c].real() : vizzes[c].imag();
+    fitter.setFunction(pnom);
+    solution[part] = fitter.fit(unflaggedfreqs, floatvs, wt);
+  }
+  coeffs.resize(locFitOrd + 1);
+  for(Int ordind = 0; ordind <= locFitOrd; ++ordind)
+    coeffs[ordind] = Complex(solution[0][ordind], solution[1][ordind]);
+  return locFitOrd;
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const String msName("tVBContinuumSubtractor.ms");
+    {
+      // Two spws whose upper and lower halves share frequencies.
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(0, 1.0, 1.0);
+      msFactory.addAntennas(nAnt);
+      msFactory.addFeeds(nAnt);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", nChan, 1.000e9, 1.0e6, "RR LL");
+      msFactory.addSpectralWindow("spw1", nChan, 1.004e9, 1.0e6, "RR LL");
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+
+    Cube<Complex> coeffs;
+    Cube<Bool> coeffsOK;
+    {
+      MeasurementSet ms(msName);
+      ROVisibilityIterator vi(ms, Block<Int>(), 0.0);
+      VisBuffer vb(vi);
+      VisBuffGroupAcc vbga(nAnt, 2, 1, 0.0, false);
+      for(vi.originChunks(); vi.moreChunks(); vi.nextChunk())
+        for(vi.origin(); vi.more(); vi++)
+          vbga.accumulate(vb);
+      vbga.finalizeAverage();
+      AlwaysAssert(vbga.nBuf() == 2, AipsError);
+      setPatterns(vbga);
+
+      VBContinuumSubtractor vbcs;
+      vbcs.initFromVBGA(vbga);
+      vbcs.fit(vbga, fitorder, MS::DATA, coeffs, coeffsOK, False, True,
+               False);
+
+      // The frequencies scaled to [-1, 1] as the fit scales them
+      const Double midfreq = 0.5 * (vbcs.getLowFreq() + vbcs.getHighFreq());
+      const Double freqscale = vbcs.calcFreqScale();
+      Vector<Float> freqs(vbcs.getTotNumChan());
+      uInt totchan = 0;
+      for(Int ibuf = 0; ibuf < vbga.nBuf(); ++ibuf){
+        const Vector<Double>& freq(vbga(ibuf).frequency());
+        for(uInt c = 0; c < freq.nelements(); ++c)
+          freqs[totchan++] = freqscale * (freq[c] - midfreq);
+      }
+      AlwaysAssert(totchan == 2 * nChan, AipsError);
+
+      for(Int row = 0; row < nAnt * (nAnt + 1) / 2; ++row){
+        for(Int corr = 0; corr < nCorr; ++corr){
+          Vector<Complex> expected;
+          const Int order = svdFit(vbga, freqs, corr, row, expected);
+          AlwaysAssert((order < 0) == (row >= 24), AipsError);
+          AlwaysAssert(row < 20 || row >= 24 || order == 1, AipsError);
+          for(Int ordind = 0; ordind <= fitorder; ++ordind){
+            AlwaysAssert(coeffsOK(corr, ordind, row) == (ordind <= order),
+                         AipsError);
+            if(ordind > order)
+              continue;
+            const Complex c(coeffs(corr, ordind, row));
+            const Complex e(expected[ordind]);
+            AlwaysAssert(isFinite(c.real()) && isFinite(c.imag()), AipsError);
+            AlwaysAssert(abs(c - e) <= 1.0e-4 * max(1.0f, abs(e)), AipsError);
+          }
+        }
+      }
+    }
+    Table::deleteTable(msName);
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
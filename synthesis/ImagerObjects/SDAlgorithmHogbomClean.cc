@@ -55,8 +55,14 @@
 #include <casa/Logging/LogSink.h>
 
 #include <casa/System/Choice.h>
+#include <casa/System/AipsrcValue.h>
 #include <msvis/MSVis/StokesVector.h>
 
+#include <vector>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
@@ -167,6 +173,7 @@ void REFHogbomCleanImageSkyModelmsgput(Int *npol, Int* /*pol*/, Int* iter, Int*
     //    itsMatMask()
  {
    itsAlgorithmName=String("Hogbom");
+   AipsrcValue<Bool>::find (itsUseFortran, "SDAlgorithmHogbomClean.useFortran", False);
  }
 
   SDAlgorithmHogbomClean::~SDAlgorithmHogbomClean()
@@ -248,15 +255,23 @@ void REFHogbomCleanImageSkyModelmsgput(Int *npol, Int* /*pol*/, Int* iter, Int*
     Int starting_iteration = 0;  
     Int ending_iteration=0;         
     Float cycleSpeedup = -1; // ie, ignore it
-    
-    hclean(limage_data, limageStep_data,
-	   (Float*)lpsf_data, &domaskI, (Float*)lmask_data,
-	   &newNx, &newNy, &npol,
-	   &fxbeg, &fxend, &fybeg, &fyend, &niter,
-	   &starting_iteration, &ending_iteration,
-	   &g, &thres, &cycleSpeedup,
-	   (void*) &REFHogbomCleanImageSkyModelmsgput,
-	   (void*) &REFHogbomCleanImageSkyModelstopnow);
+
+    if( itsUseFortran )
+      {
+	hclean(limage_data, limageStep_data,
+	       (Float*)lpsf_data, &domaskI, (Float*)lmask_data,
+	       &newNx, &newNy, &npol,
+	       &fxbeg, &fxend, &fybeg, &fyend, &niter,
+	       &starting_iteration, &ending_iteration,
+	       &g, &thres, &cycleSpeedup,
+	       (void*) &REFHogbomCleanImageSkyModelmsgput,
+	       (void*) &REFHogbomCleanImageSkyModelstopnow);
+      }
+    else
+      {
+	ending_iteration = hogbomClean( limage_data, limageStep_data, lpsf_data, lmask_data,
+					newNx, newNy, niter, g, thres );
+      }
     
     iterdone=ending_iteration;
     
@@ -273,6 +288,125 @@ void REFHogbomCleanImageSkyModelmsgput(Int *npol, Int* /*pol*/, Int* iter, Int*
     modelflux = sum( itsMatModel ); // Performance hog ?
   }	    
 
+  namespace {
+
+    // Number of iterations between polls of the stop request, as in hclean
+    const Int hogbomStopPoll = 100;
+
+    // Find the unmasked pixel of largest absolute value in rows
+    // [ybeg,yend), keeping the first one on ties as hclean does.
+    void hogbomScanRows( const Float* residual, const Float* mask, const Int nx,
+			 const Int ybeg, const Int yend, Float& peakAbs, Int& peakPos )
+    {
+      for( Int iy=ybeg; iy<yend; iy++ )
+	{
+	  const Float* res = residual + iy*nx;
+	  const Float* msk = mask + iy*nx;
+	  for( Int ix=0; ix<nx; ix++ )
+	    {
+	      const Float val = fabs( res[ix] );
+	      if( msk[ix] > 0.5 && val > peakAbs )
+		{
+		  peakAbs = val;
+		  peakPos = iy*nx + ix;
+		}
+	    }
+	}
+    }
+
+    // Rows [ybeg,yend) of the ny rows handled by thread ith of nth, in the
+    // contiguous blocks of a static schedule
+    void hogbomThreadRows( const Int ny, const Int nth, const Int ith, Int& ybeg, Int& yend )
+    {
+      const Int chunk = ny / nth;
+      const Int extra = ny % nth;
+      ybeg = ith*chunk + min( ith, extra );
+      yend = ybeg + chunk + ( ith < extra ? 1 : 0 );
+    }
+
+  }
+
+  Int SDAlgorithmHogbomClean::hogbomClean( Float* model, Float* residual, const Float* psf,
+					   const Float* mask, const Int nx, const Int ny,
+					   const Int niter, const Float gain, const Float threshold )
+  {
+    Int nth=1;
+#ifdef _OPENMP
+    nth=max( 1, min( ny, omp_get_max_threads() ) );
+#endif
+    std::vector<Float> threadPeak( nth );
+    std::vector<Int> threadPos( nth );
+
+    Float scale = 0.0;
+    Int peakPos = -1;
+    Int iter=0;
+    for( ; ; iter++ )
+      {
+	// Overlap of the psf, centred on the last peak, with the residual
+	Int xoff=0, yoff=0, xbeg=0, xend=0, ybeg=0, yend=0;
+	if( peakPos >= 0 )
+	  {
+	    xoff = nx/2 - peakPos % nx;
+	    yoff = ny/2 - peakPos / nx;
+	    xbeg = max( 0, -xoff );
+	    xend = min( nx, nx - xoff );
+	    ybeg = max( 0, -yoff );
+	    yend = min( ny, ny - yoff );
+	  }
+
+	// Subtract the psf of the last component and find the new peak in
+	// the same pass; each thread takes a block of rows and the blocks
+	// are merged in order so that ties resolve as in a serial scan.
+#pragma omp parallel num_threads(nth)
+	{
+	  Int ith=0;
+#ifdef _OPENMP
+	  ith=omp_get_thread_num();
+#endif
+	  Int rbeg, rend;
+	  hogbomThreadRows( ny, nth, ith, rbeg, rend );
+	  for( Int iy=max( rbeg, ybeg ); iy<min( rend, yend ); iy++ )
+	    {
+	      Float* res = residual + iy*nx;
+	      const Float* psfRow = psf + ( iy + yoff )*nx + xoff;
+	      for( Int ix=xbeg; ix<xend; ix++ )
+		{
+		  res[ix] -= scale * psfRow[ix];
+		}
+	    }
+	  threadPeak[ith] = -1.0;
+	  threadPos[ith] = -1;
+	  hogbomScanRows( residual, mask, nx, rbeg, rend, threadPeak[ith], threadPos[ith] );
+	}
+
+	if( iter >= niter ) break;
+
+	Float peakAbs = -1.0;
+	peakPos = -1;
+	for( Int ith=0; ith<nth; ith++ )
+	  {
+	    if( threadPos[ith] >= 0 && threadPeak[ith] > peakAbs )
+	      {
+		peakAbs = threadPeak[ith];
+		peakPos = threadPos[ith];
+	      }
+	  }
+	if( peakPos < 0 || peakAbs < threshold ) break;
+
+	if( iter > 0 && iter % hogbomStopPoll == 0 )
+	  {
+	    Int stop=0;
+	    REFHogbomCleanImageSkyModelstopnow( &stop );
+	    if( stop ) break;
+	  }
+
+	scale = gain * residual[peakPos];
+	model[peakPos] += scale;
+      }
+
+    return iter;
+  }
+
   void SDAlgorithmHogbomClean::finalizeDeconvolver()
   {
     (itsImages->residual())->put( itsMatResidual );
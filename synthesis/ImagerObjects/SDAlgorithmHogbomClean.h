@@ -54,6 +54,17 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     // Empty constructor
     SDAlgorithmHogbomClean();
     virtual  ~SDAlgorithmHogbomClean();
+
+    // Hogbom clean of one nx by ny plane, equivalent to the Fortran hclean
+    // with npol=1 and the mask applied. Peaks are only searched where the
+    // mask is above 0.5, and the psf (peak at nx/2,ny/2) is subtracted over
+    // its whole overlap with the residual; the threads subtract it and find
+    // the next peak in the same pass over the residual. A stop request is
+    // polled every 100 iterations, as hclean does. Returns the number of
+    // iterations done.
+    static Int hogbomClean( Float* model, Float* residual, const Float* psf,
+			    const Float* mask, const Int nx, const Int ny,
+			    const Int niter, const Float gain, const Float threshold );
     
   protected:
     
@@ -64,6 +75,10 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 
     Array<Float> itsMatResidual, itsMatModel, itsMatPsf, itsMatMask;
 
+    // Use the Fortran hclean rather than hogbomClean (aipsrc
+    // SDAlgorithmHogbomClean.useFortran)
+    Bool itsUseFortran;
+
   };
 
 } //# NAMESPACE CASA - END
@@ -57,6 +57,9 @@
 #include <tables/Tables/TableLock.h>
 
 #include <casa/sstream.h>
+#include <casa/BasicSL/Constants.h>
+#include <algorithm>
+#include <cstring>
 
 #include <casa/Logging/LogMessage.h>
 #include <casa/Logging/LogIO.h>
@@ -679,33 +682,16 @@ namespace casa { //# NAMESPACE CASA - BEGIN
                                const String& alg, 
                                const String& threshold, 
                                const Float& fracofpeak, 
-                               const String& resolution) 
+                               const String& resolution,
+                               const Float& minbeamfrac) 
   {
     LogIO os( LogOrigin("SDMaskHandler","autoMask",WHERE) );
     
-    cerr<<"alg="<<alg<<endl;
-    TempImage<Float>* tempres = new TempImage<Float>(imstore->residual()->shape(), imstore->residual()->coordinates()); 
-    Array<Float> resdata;
-    Array<Float> maskdata;
-    imstore->residual()->get(resdata);
-    tempres->put(resdata);
-    TempImage<Float>* tempmask = new TempImage<Float>(imstore->mask()->shape(), imstore->mask()->coordinates());
-    // get current mask
-    imstore->mask()->get(maskdata);
-    String maskname = imstore->getName()+".mask";
-    tempmask->put(maskdata);
-    // create pixel mask (set to False for the previous selected region(s))
-    LatticeExpr<Bool> pixmask( iif(*tempmask > 0.0, False, True) );
-    TempImage<Float>* dummy = new TempImage<Float>(tempres->shape(), tempres->coordinates());
-    dummy->attachMask(pixmask);
-    if (ntrue(dummy->getMask())) tempres->attachMask(pixmask);
-    delete dummy; dummy=0;
     //input 
     Quantity qthresh(0,"");
     Quantity qreso(0,"");
     Quantity::read(qreso,resolution);
-    cerr<<"input resolution="<<resolution<<" qreso.getValue()="<<qreso.getValue()<<endl;
-    Float sigma;
+    Float sigma = 0.0;
     // if fracofpeak (fraction of a peak) is specified, use it to set a threshold
     if ( fracofpeak != 0.0 ) {
       if (fracofpeak > 1.0 )
@@ -714,7 +700,6 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     }
     else if(Quantity::read(qthresh,threshold) ) {
       // evaluate threshold input 
-      cerr<<"qthresh="<<qthresh.get().getValue()<<" unit="<<qthresh.getUnit()<<endl;
       if (qthresh.getUnit()!="") {
         // use qthresh and set sigma =0.0 to ignore
         sigma = 0.0;
@@ -728,34 +713,58 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       }
     }
     else {
-      if (!sigma) {
-        throw(AipsError("Unrecognized automask threshold="+threshold));
-      }
+      throw(AipsError("Unrecognized automask threshold="+threshold));
     }
        
-    //do statistics
-    SHARED_PTR<casa::ImageInterface<float> > tempres_ptr(tempres);
-    ImageStatsCalculator imcalc( tempres_ptr, 0, "", False); 
-    Vector<Int> axes(2);
-    axes[0] = 0;
-    axes[1] = 1;
-    imcalc.setAxes(axes);
-    Record thestats = imcalc.statistics();
-    Array<Double> max, min, rms;
-    thestats.get(RecordFieldId("max"), max);
-    thestats.get(RecordFieldId("rms"), rms);
-    cerr<<"Stats -- rms.nelements()="<<rms.nelements()<<" rms(0)="<<rms[0]<<endl;
-    cerr<<"Stats -- max.nelements()="<<max.nelements()<<" max(0)="<<max[0]<<endl;
     if (alg==String("")) {
       makeAutoMask(imstore);
     }
     else if (alg==String("thresh")) {
-      autoMaskByThreshold(*tempmask, *tempres, qreso, qthresh, fracofpeak, thestats, sigma);
-      cerr<<" automaskbyThreshold...."<<endl;
-      tempmask->get(maskdata);
-      imstore->mask()->put(maskdata);
-    } 
-    delete tempmask; tempmask=0;
+      Float thresh = 0.0;
+      if (fracofpeak==0.0 && sigma==0.0) {
+        thresh = qthresh.getValue(Unit("Jy"));
+        if ( thresh==0.0 ) 
+          { throw(AipsError("Threshold for automask is not set"));}
+      }
+      Float fwhm = resolutionInPixels(*(imstore->residual()), qreso);
+
+      Array<Float> resdata;
+      Array<Float> maskdata;
+      imstore->residual()->get(resdata);
+      imstore->mask()->get(maskdata);
+      Int nplanes = autoMaskByPlanes(maskdata, resdata, fwhm, thresh, fracofpeak,
+                                     sigma, minbeamfrac);
+      if (nplanes > 0) imstore->mask()->put(maskdata);
+      os << LogIO::NORMAL1 << "Automask re-evaluated " << nplanes << " of "
+         << resdata.shape().product()/(resdata.shape()[0]*resdata.shape()[1])
+         << " planes, smoothing FWHM " << fwhm << " pixels" << LogIO::POST;
+    }
+    else {
+      throw(AipsError("Unrecognized automask algorithm="+alg));
+    }
+  }
+
+  Float SDMaskHandler::resolutionInPixels(const ImageInterface<Float>& res,
+                                          const Quantity& resolution)
+  {
+    const CoordinateSystem& incsys = res.coordinates();
+    Double inc = abs(incsys.increment()[0]);
+    Unit incUnit(incsys.worldAxisUnits()[0]);
+    if (resolution.getValue()) {
+      return Float(abs(resolution.getValue(incUnit))/inc);
+    }
+    ImageInfo resInfo = res.imageInfo();
+    if (!resInfo.hasBeam()) {
+      throw(AipsError("No restoring beam(s) in the input image or resolution is given"));
+    }
+    GaussianBeam beam;
+    if (resInfo.hasSingleBeam()) {
+      beam = resInfo.restoringBeam();
+    }
+    else {
+      beam = CasaImageBeamSet(resInfo.getBeamSet()).getCommonBeam();
+    }
+    return Float(abs(beam.getMajor().getValue(incUnit))/inc);
   }
 
   void SDMaskHandler::autoMaskByThreshold(ImageInterface<Float>& mask,
@@ -857,6 +866,177 @@ namespace casa { //# NAMESPACE CASA - BEGIN
      mask.copyData( (LatticeExpr<Float>)( iif((mask + themask) > 0.0, 1.0, 0.0  ) ) );
   }
   
+  // Checksum of the n pixels of a residual plane and its mask plane
+  static uInt64 planeChecksum(const Float* res, const Float* mask, Int64 n)
+  {
+    uInt64 sum = 14695981039346656037ULL;   // 64 bit FNV-1a over the words
+    uInt bits;
+    for (Int64 i=0; i<n; i++) {
+      memcpy(&bits, res+i, sizeof(bits));
+      sum = (sum ^ bits) * 1099511628211ULL;
+    }
+    for (Int64 i=0; i<n; i++) {
+      memcpy(&bits, mask+i, sizeof(bits));
+      sum = (sum ^ bits) * 1099511628211ULL;
+    }
+    return sum;
+  }
+
+  // 1.4826 times the median absolute deviation of the pixels of a plane
+  // outside its mask, or of all its pixels if the mask covers the plane
+  static Float robustRms(const Float* plane, const Float* mask, Int64 n)
+  {
+    std::vector<Float> vals;
+    vals.reserve(n);
+    for (Int64 i=0; i<n; i++) {
+      if (mask[i]==0.0) vals.push_back(plane[i]);
+    }
+    if (vals.size() < 2) vals.assign(plane, plane+n);
+    if (vals.empty()) return 0.0;
+    std::vector<Float>::iterator mid = vals.begin() + vals.size()/2;
+    std::nth_element(vals.begin(), mid, vals.end());
+    const Float median = *mid;
+    for (std::vector<Float>::iterator it=vals.begin(); it!=vals.end(); ++it) {
+      *it = abs(*it - median);
+    }
+    std::nth_element(vals.begin(), mid, vals.end());
+    return 1.4826 * (*mid);
+  }
+
+  // Convolve an nx by ny plane with a Gaussian of FWHM fwhm pixels, one axis
+  // at a time; pixels beyond the edges count as 0.
+  static void smoothPlane(std::vector<Float>& plane, Int nx, Int ny, Float fwhm)
+  {
+    if (fwhm <= 1.0) return;
+    const Double width = fwhm/sqrt(8.0*C::ln2);
+    const Int half = Int(ceil(3.0*width));
+    std::vector<Float> kernel(2*half+1);
+    Double ksum = 0.0;
+    for (Int k=-half; k<=half; k++) {
+      kernel[k+half] = exp(-0.5*(k*k)/(width*width));
+      ksum += kernel[k+half];
+    }
+    for (Int k=0; k<2*half+1; k++) kernel[k] /= ksum;
+
+    std::vector<Float> in(plane);
+    // along x
+    for (Int y=0; y<ny; y++) {
+      const Float* inrow = &in[Int64(y)*nx];
+      Float* outrow = &plane[Int64(y)*nx];
+      for (Int x=0; x<nx; x++) {
+        const Int k0 = max(-half, -x);
+        const Int k1 = min(half, nx-1-x);
+        Float sum = 0.0;
+        for (Int k=k0; k<=k1; k++) sum += kernel[k+half]*inrow[x+k];
+        outrow[x] = sum;
+      }
+    }
+    // along y, a row at a time
+    in = plane;
+    for (Int y=0; y<ny; y++) {
+      Float* outrow = &plane[Int64(y)*nx];
+      for (Int x=0; x<nx; x++) outrow[x] = 0.0;
+      const Int k0 = max(-half, -y);
+      const Int k1 = min(half, ny-1-y);
+      for (Int k=k0; k<=k1; k++) {
+        const Float w = kernel[k+half];
+        const Float* inrow = &in[Int64(y+k)*nx];
+        for (Int x=0; x<nx; x++) outrow[x] += w*inrow[x];
+      }
+    }
+  }
+
+  // Add to the mask plane the 8-connected regions of at least minsize
+  // pixels where the plane is above thresh
+  static void addRegions(Float* mask, const std::vector<Float>& plane,
+                         Int nx, Int ny, Float thresh, Float minsize)
+  {
+    const Int64 n = Int64(nx)*ny;
+    std::vector<Bool> done(n, False);
+    std::vector<Int64> region;
+    for (Int64 start=0; start<n; start++) {
+      if (done[start] || !(plane[start] > thresh)) continue;
+      // collect the region by a breadth-first search
+      region.clear();
+      region.push_back(start);
+      done[start] = True;
+      for (size_t i=0; i<region.size(); i++) {
+        const Int x = region[i] % nx;
+        const Int y = region[i] / nx;
+        for (Int yy=max(y-1, 0); yy<=min(y+1, ny-1); yy++) {
+          for (Int xx=max(x-1, 0); xx<=min(x+1, nx-1); xx++) {
+            const Int64 j = Int64(yy)*nx + xx;
+            if (!done[j] && plane[j] > thresh) {
+              done[j] = True;
+              region.push_back(j);
+            }
+          }
+        }
+      }
+      if (Float(region.size()) >= minsize) {
+        for (size_t i=0; i<region.size(); i++) mask[region[i]] = 1.0;
+      }
+    }
+  }
+
+  Int SDMaskHandler::autoMaskByPlanes(Array<Float>& mask,
+                                      const Array<Float>& res,
+                                      const Float& fwhm,
+                                      const Float& thresh,
+                                      const Float& fracofpeak,
+                                      const Float& sigma,
+                                      const Float& minbeamfrac)
+  {
+    if (!mask.shape().isEqual(res.shape()))
+      throw(AipsError("Mask and residual shapes differ in autoMaskByPlanes"));
+    const Int nx = res.shape()[0];
+    const Int ny = res.shape()[1];
+    const Int64 npix = Int64(nx)*ny;
+    const Int nplanes = (npix > 0) ? Int(res.nelements()/npix) : 0;
+
+    // Start afresh when the parameters or the number of planes change
+    std::vector<Float> pars(6);
+    pars[0] = fwhm; pars[1] = thresh; pars[2] = fracofpeak;
+    pars[3] = sigma; pars[4] = minbeamfrac; pars[5] = Float(npix);
+    if (pars != autoMaskPars_p || Int(planeChecksums_p.size()) != nplanes) {
+      autoMaskPars_p = pars;
+      planeChecksums_p.assign(nplanes, 0);
+    }
+    // Regions smaller than minbeamfrac of the area of the smoothing beam
+    const Float minsize = minbeamfrac * C::pi/(4.0*C::ln2) * max(fwhm, Float(1.0))
+                          * max(fwhm, Float(1.0));
+
+    Bool delRes, delMask;
+    const Float* resStor = res.getStorage(delRes);
+    Float* maskStor = mask.getStorage(delMask);
+    Int nevaluated = 0;
+
+#pragma omp parallel for schedule(dynamic) reduction(+: nevaluated)
+    for (Int p=0; p<nplanes; p++) {
+      const Float* resPlane = resStor + p*npix;
+      Float* maskPlane = maskStor + p*npix;
+      if (planeChecksums_p[p] != 0 &&
+          planeChecksum(resPlane, maskPlane, npix) == planeChecksums_p[p]) continue;
+
+      std::vector<Float> plane(resPlane, resPlane+npix);
+      smoothPlane(plane, nx, ny, fwhm);
+      Float planeThresh = thresh;
+      if (fracofpeak != 0.0) {
+        planeThresh = fracofpeak * (*std::max_element(plane.begin(), plane.end()));
+      }
+      else if (sigma != 0.0) {
+        planeThresh = sigma * robustRms(&plane[0], maskPlane, npix);
+      }
+      addRegions(maskPlane, plane, nx, ny, planeThresh, minsize);
+      planeChecksums_p[p] = planeChecksum(resPlane, maskPlane, npix);
+      nevaluated++;
+    }
+
+    res.freeStorage(resStor, delRes);
+    mask.putStorage(maskStor, delMask);
+    return nevaluated;
+  }
+
   void SDMaskHandler::makePBMask(CountedPtr<SIImageStore> imstore, Float weightlimit)
   {
     LogIO os( LogOrigin("SDMaskHandler","makeAutoMask",WHERE) );
@@ -41,6 +41,8 @@
 #include<synthesis/ImagerObjects/SIImageStoreMultiTerm.h>
 #include <synthesis/ImagerObjects/InteractiveMasking.h>
 
+#include <vector>
+
 namespace casa { //# NAMESPACE CASA - BEGIN
 
 class SDMaskHandler 
@@ -99,11 +101,14 @@ public:
   // Return a reference to an imageinterface for the mask.
   void makeAutoMask(CountedPtr<SIImageStore> imstore);
   // Top level autoMask interface...
+  // alg="thresh" uses autoMaskByPlanes with the beam of the residual, or
+  // resolution if given, as smoothing beam.
   void autoMask(CountedPtr<SIImageStore> imstore, 
                 const String& alg="",
                 const String& threshold="",
                 const Float& fracpeak=0.0,
-                const String& resolution="");
+                const String& resolution="",
+                const Float& minbeamfrac=0.3);
   // automask algorithms...  
   void autoMaskByThreshold (ImageInterface<Float>& mask,
                            const ImageInterface<Float>& res, 
@@ -112,7 +117,29 @@ public:
                            const Float& fracofpeak, 
                            const Record& theStats,
                            const Float& sigma=3.0);
-                           
+
+  // Automask each plane (first two axes) of res in memory, with the planes
+  // shared among the threads. The plane is smoothed with a Gaussian of FWHM
+  // fwhm pixels and thresholded at sigma times its robust rms (1.4826 times
+  // the median absolute deviation, outside the mask), or else at fracofpeak
+  // times its peak, or else at thresh. Connected regions smaller than
+  // minbeamfrac of the smoothing beam area are dropped and the rest are
+  // added to mask. Planes whose residual and mask did not change since the
+  // last call with the same parameters are skipped. Returns the number of
+  // planes evaluated.
+  Int autoMaskByPlanes(Array<Float>& mask,
+                       const Array<Float>& res,
+                       const Float& fwhm,
+                       const Float& thresh,
+                       const Float& fracofpeak,
+                       const Float& sigma,
+                       const Float& minbeamfrac=0.3);
+
+  // The FWHM in pixels of resolution or, if it is 0, of the (common)
+  // restoring beam of res.
+  static Float resolutionInPixels(const ImageInterface<Float>& res,
+                                  const Quantity& resolution);
+
 
 
   void makePBMask(CountedPtr<SIImageStore> imstore, Float weightlimit);
@@ -125,6 +152,11 @@ public:
 
 protected:
   InteractiveMasking *interactiveMasker_p;
+
+  // Checksums of the residual and mask planes and the parameters of the
+  // last autoMaskByPlanes call
+  std::vector<uInt64> planeChecksums_p;
+  std::vector<Float> autoMaskPars_p;
 };
 
 } //# NAMESPACE CASA - END
@@ -32,6 +32,7 @@
 #include <casa/Arrays/Matrix.h>
 #include <casa/Arrays/ArrayMath.h>
 #include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/ArrayIO.h>
 
 #include <casa/Logging.h>
 #include <casa/Logging/LogIO.h>
@@ -139,6 +140,10 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     Int nMappers = itsMappers.nelements();
     itsMappers.resize(nMappers+1, True);
     itsMappers[nMappers]=map;
+    itsGridTime.resize(nMappers+1, True);
+    itsGridTime[nMappers]=0.0;
+    itsDegridTime.resize(nMappers+1, True);
+    itsDegridTime[nMappers]=0.0;
   } 
 
   Int SIMapperCollection::nMappers()
@@ -196,11 +201,15 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 	    }
 	}// if non zero model
 
+	  // The mappers run one after the other: the FTMachines match channels
+	  // and read MS metadata through the VisBuffer's iterator, which is
+	  // not thread safe.
 	  for (uInt k=0; k < itsMappers.nelements(); ++k)
-	  {
-		  (itsMappers[k])->grid(vb, dopsf, col);
-
-	  }
+	    {
+	      Timer timer;
+	      (itsMappers[k])->grid(vb, dopsf, col);
+	      itsGridTime[k] += timer.real();
+	    }
   }
   ///////////////////////////////
   ////////////////////////////////
@@ -214,6 +223,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
         		  (itsMappers[k])->finalizeGrid(vb, dopsf);
 
       	  }
+	  logMapperTimes( dopsf ? "PSF gridding" : "Gridding", itsGridTime );
         }
 
 
@@ -243,8 +253,14 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     {
       if( itsIsNonZeroModel == True )
 	{
-	  	  for (uInt k=0; k < itsMappers.nelements(); ++k)
-	    				(itsMappers[k])->degrid(vb);
+	  // Serial for the same reason as grid(); a copy of the VisBuffer
+	  // still shares its iterator.
+	  for (uInt k=0; k < itsMappers.nelements(); ++k)
+	    {
+	      Timer timer;
+	      (itsMappers[k])->degrid(vb);
+	      itsDegridTime[k] += timer.real();
+	    }
 
   		  if(saveVirtualMod){
 		    saveVirtualModel(vb);
@@ -318,9 +334,21 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   		  (itsMappers[k])->finalizeDegrid();
 
   	  }
+	  logMapperTimes( "Degridding", itsDegridTime );
 	}// if non zero model
     }
 
+  void SIMapperCollection::logMapperTimes(const String& what, Vector<Double>& times)
+  {
+    LogIO os( LogOrigin("SIMapperCollection","logMapperTimes",WHERE) );
+    if( times.nelements() > 1 )
+      {
+	os << LogIO::NORMAL1 << what << " time per mapper (s) : " << times 
+	   << LogIO::POST;
+      }
+    times = 0.0;
+  }
+
 
   ///////////////////////////////////////////////////////////////////////////////////////////////////////
   //////////// End of VB dependent code.
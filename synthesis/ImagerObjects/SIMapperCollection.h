@@ -88,6 +88,9 @@ class SIMapperCollection
 
 protected:
 
+  // Log and reset the time each mapper spent since the last call.
+  void logMapperTimes(const String& what, Vector<Double>& times);
+
   ///////////////////// Member Objects
 
   Block<CountedPtr<SIMapper> >  itsMappers;
@@ -95,6 +98,9 @@ protected:
 
   Bool itsIsNonZeroModel;
 
+  // Seconds spent by each mapper in grid / degrid in this major cycle
+  Vector<Double> itsGridTime, itsDegridTime;
+
 };
 
 
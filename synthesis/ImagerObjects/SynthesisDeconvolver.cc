@@ -50,6 +50,7 @@
 #include <images/Regions/ImageRegion.h>
 
 #include <synthesis/ImagerObjects/SynthesisDeconvolver.h>
+#include <msvis/MSVis/UtilJ.h>
 
 #include <sys/types.h>
 #include <unistd.h>
@@ -267,12 +268,15 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   {
     LogIO os( LogOrigin("SynthesisDeconvolver","executeMinorCycle",WHERE) );
     Record returnRecord;
+    utilj::InstrumentationTimer cycleTimer("SynthesisDeconvolver.minorCycle");
 
     try {
       itsLoopController.setCycleControls(minorCycleControlRec);
 
       itsDeconvolver->deconvolve( itsLoopController, itsImages, itsDeconvolverId );
       returnRecord = itsLoopController.getCycleExecutionRecord();
+      utilj::Instrumentation::addCount("SynthesisDeconvolver.iterations",
+				       returnRecord.asInt("iterdone"));
 
       //scatterModel(); // This is a no-op for the single-node case.
 
@@ -66,6 +66,7 @@
 #include <msvis/MSVis/MSUtil.h>
 #include <msvis/MSVis/VisSetUtil.h>
 #include <msvis/MSVis/VisImagingWeight.h>
+#include <msvis/MSVis/UtilJ.h>
 
 #include <synthesis/TransformMachines/GridFT.h>
 #include <synthesis/TransformMachines/WPConvFunc.h>
@@ -1556,6 +1557,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 				      const Bool savemodel)
   {
     LogIO os( LogOrigin("SynthesisImager","runMajorCycle",WHERE) );
+    utilj::InstrumentationTimer cycleTimer(dopsf ? "SynthesisImager.psfCycle"
+					   : "SynthesisImager.majorCycle");
 
     //    cout << "Savemodel : " << savemodel << "   readonly : " << readOnly_p << "   usescratch : " << useScratch_p << endl;
 
@@ -1586,12 +1589,21 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     		{
 		  //		  cerr << "nRows "<< vb->nRow() << "   " << max(vb->visCube()) <<  endl;
     			if(!dopsf) {
+    				utilj::InstrumentationTimer degridTimer("SynthesisImager.degrid");
     				vb->setModelVisCube(Complex(0.0, 0.0));
     				itsMappers.degrid(*vb, savevirtualmodel );
     				if(savemodelcolumn && writeAccess_p )
     					wvi_p->setVis(vb->modelVisCube(),VisibilityIterator::Model);
     			}
-    			itsMappers.grid(*vb, dopsf, datacol_p);
+    			{
+    				utilj::InstrumentationTimer gridTimer("SynthesisImager.grid");
+    				itsMappers.grid(*vb, dopsf, datacol_p);
+    			}
+			if(utilj::Instrumentation::isEnabled()) {
+			  utilj::Instrumentation::addCount("SynthesisImager.rows", vb->nRow());
+			  utilj::Instrumentation::addBytes("SynthesisImager.visBytes",
+							   Int64(vb->nRow())*vb->nChannel()*vb->nCorr()*sizeof(Complex));
+			}
 			cohDone += vb->nRow();
 			pm.update(Double(cohDone));
     		}
@@ -0,0 +1,156 @@
+//# dHogbomClean.cc: compare the C++ and Fortran Hogbom minor cycles
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+// Usage: dHogbomClean [npix [niter]]
+//
+// Cleans a synthetic dirty image (a few point sources convolved with a
+// Gaussian psf with sidelobes) with both SDAlgorithmHogbomClean::hogbomClean
+// and the Fortran hclean, checks that they agree and prints the time each
+// took. Without arguments a small image is used so that it can run as a
+// test; e.g. "dHogbomClean 8192 200" times a representative large image.
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/stdlib.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/Timer.h>
+#include <casa/Utilities/Assert.h>
+#include <synthesis/ImagerObjects/SDAlgorithmHogbomClean.h>
+
+#include <casa/namespace.h>
+
+#define NEED_UNDERSCORES
+#if defined(NEED_UNDERSCORES)
+#define hclean hclean_
+#endif
+extern "C" {
+  void hclean(Float*, Float*, Float*, int*, Float*, int*, int*, int*,
+              int*, int*, int*, int*, int*, int*, int*, Float*, Float*,
+              Float*, void *, void *);
+};
+
+void dHogbomCleanMsgput(Int*, Int*, Int*, Int*, Int*, Float*) {}
+void dHogbomCleanStopnow(Int* yes) { *yes=0; }
+
+int main(int argc, char **argv)
+{
+  try {
+    Int npix = 256;
+    Int niter = 100;
+    if (argc > 1) npix = atoi(argv[1]);
+    if (argc > 2) niter = atoi(argv[2]);
+    Float gain = 0.1;
+    Float threshold = 0.0;
+
+    // Gaussian main lobe with a ring sidelobe, peak 1 at the centre
+    Matrix<Float> psf(npix, npix);
+    const Double sigma = 3.0;
+    for (Int j = 0; j < npix; j++) {
+      for (Int i = 0; i < npix; i++) {
+	const Double r = sqrt(Double(square(i - npix/2) + square(j - npix/2)));
+	psf(i, j) = exp(-0.5*square(r/sigma)) - 0.1*exp(-0.5*square((r - 4*sigma)/sigma));
+      }
+    }
+    psf(npix/2, npix/2) = 1.0;
+
+    // A few sources well inside the image
+    Matrix<Float> dirty(npix, npix, 0.0);
+    const Int nsrc = 5;
+    for (Int s = 0; s < nsrc; s++) {
+      const Int sx = npix/4 + (s*37) % (npix/2);
+      const Int sy = npix/4 + (s*53) % (npix/2);
+      const Float flux = 1.0 + s;
+      for (Int j = 0; j < npix; j++) {
+	for (Int i = 0; i < npix; i++) {
+	  const Int pi = i - sx + npix/2;
+	  const Int pj = j - sy + npix/2;
+	  if (pi >= 0 && pi < npix && pj >= 0 && pj < npix) {
+	    dirty(i, j) += flux * psf(pi, pj);
+	  }
+	}
+      }
+    }
+    Matrix<Float> mask(npix, npix, 1.0);
+
+    Matrix<Float> modelF(npix, npix, 0.0), residualF(dirty.copy());
+    Matrix<Float> modelC(npix, npix, 0.0), residualC(dirty.copy());
+
+    Timer timer;
+    {
+      Bool d1, d2, d3, d4;
+      Float* model = modelF.getStorage(d1);
+      Float* residual = residualF.getStorage(d2);
+      Float* lpsf = psf.getStorage(d3);
+      Float* lmask = mask.getStorage(d4);
+      Int domask = 1, npol = 1, xbeg = 1, xend = npix, ybeg = 1, yend = npix;
+      Int siter = 0, eiter = 0;
+      Float speedup = -1;
+      timer.mark();
+      hclean(model, residual, lpsf, &domask, lmask, &npix, &npix, &npol,
+	     &xbeg, &xend, &ybeg, &yend, &niter, &siter, &eiter,
+	     &gain, &threshold, &speedup,
+	     (void*) &dHogbomCleanMsgput, (void*) &dHogbomCleanStopnow);
+      cout << "Fortran hclean : " << eiter << " iterations in "
+	   << timer.real() << " s" << endl;
+      modelF.putStorage(model, d1);
+      residualF.putStorage(residual, d2);
+      psf.putStorage(lpsf, d3);
+      mask.putStorage(lmask, d4);
+    }
+    {
+      Bool d1, d2, d3, d4;
+      Float* model = modelC.getStorage(d1);
+      Float* residual = residualC.getStorage(d2);
+      const Float* lpsf = psf.getStorage(d3);
+      const Float* lmask = mask.getStorage(d4);
+      timer.mark();
+      const Int done = SDAlgorithmHogbomClean::hogbomClean(model, residual, lpsf, lmask,
+							   npix, npix, niter, gain, threshold);
+      cout << "C++ hogbomClean: " << done << " iterations in "
+	   << timer.real() << " s" << endl;
+      modelC.putStorage(model, d1);
+      residualC.putStorage(residual, d2);
+      psf.freeStorage(lpsf, d3);
+      mask.freeStorage(lmask, d4);
+    }
+
+    const Float tol = 1e-4 * max(abs(dirty));
+    AlwaysAssert(allNearAbs(modelC, modelF, tol), AipsError);
+    AlwaysAssert(allNearAbs(residualC, residualF, tol), AipsError);
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -38,6 +38,8 @@
 #include <casa/BasicSL/String.h>
 #include <casa/Containers/Block.h>
 #include <casa/Utilities/Assert.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/BasicMath/Random.h>
 
 #include <measures/Measures/MRadialVelocity.h>
 #include <coordinates/Coordinates/CoordinateSystem.h>
@@ -178,6 +180,53 @@ void testRegionToMaskImage()
   delete regionRec;
 }
 
+// test autoMaskByPlanes
+void testAutoMaskByPlanes()
+{
+  cout <<" Test autoMaskByPlanes()"<<endl;
+  // plane 0: noise, plane 1: noise, a 6x6 source and a hot pixel,
+  // plane 2: noise and a 6x6 source
+  IPosition shape(4, 64, 64, 1, 3);
+  Array<Float> res(shape);
+  Array<Float> mask(shape, 0.0);
+  MLCG gen(1, 1);
+  Normal noise(&gen, 0.0, 1.0);
+  for (Array<Float>::iterator it=res.begin(); it!=res.end(); ++it) {
+    *it = noise();
+  }
+  for (Int chan=1; chan < 3; chan++) {
+    for (Int y=30; y < 36; y++) {
+      for (Int x=20; x < 26; x++) {
+        res(IPosition(4, x, y, 0, chan)) += 10.0;
+      }
+    }
+  }
+  res(IPosition(4, 50, 10, 0, 1)) += 30.0;
+
+  // no smoothing, 5 sigma, regions of at least 3 beams of 1 pixel
+  SDMaskHandler maskhandler;
+  AlwaysAssert(maskhandler.autoMaskByPlanes(mask, res, 1.0, 0.0, 0.0, 5.0, 3.0)==3, AipsError);
+  AlwaysAssert(sum(mask(IPosition(4, 0, 0, 0, 0), IPosition(4, 63, 63, 0, 0)))==0.0, AipsError);
+  for (Int chan=1; chan < 3; chan++) {
+    AlwaysAssert(mask(IPosition(4, 22, 32, 0, chan))==1.0, AipsError);
+  }
+  // the hot pixel is too small a region
+  AlwaysAssert(mask(IPosition(4, 50, 10, 0, 1))==0.0, AipsError);
+
+  // unchanged planes are not evaluated again
+  AlwaysAssert(maskhandler.autoMaskByPlanes(mask, res, 1.0, 0.0, 0.0, 5.0, 3.0)==0, AipsError);
+  for (Int y=0; y < 4; y++) {
+    for (Int x=0; x < 4; x++) {
+      res(IPosition(4, 40+x, 50+y, 0, 2)) += 20.0;
+    }
+  }
+  AlwaysAssert(maskhandler.autoMaskByPlanes(mask, res, 1.0, 0.0, 0.0, 5.0, 3.0)==1, AipsError);
+  AlwaysAssert(mask(IPosition(4, 41, 51, 0, 2))==1.0, AipsError);
+  AlwaysAssert(mask(IPosition(4, 22, 32, 0, 2))==1.0, AipsError);
+  // all the planes are evaluated with new parameters
+  AlwaysAssert(maskhandler.autoMaskByPlanes(mask, res, 3.0, 0.0, 0.0, 5.0, 0.3)==3, AipsError);
+}
+
 void testRegionText()
 {
   cout <<" Test regionTextToImageRegion()"<<endl;
@@ -203,6 +252,7 @@ int main(int argc, char **argv)
       testMakeMask();
       testRegionToMaskImage();
       testRegionText();
+      testAutoMaskByPlanes();
   }catch( AipsError e ){
     cout << "Exception ocurred." << endl;
     cout << e.getMesg() << endl;
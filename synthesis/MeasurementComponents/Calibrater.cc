@@ -2233,6 +2233,7 @@ Bool Calibrater::solve() {
     else {
       //cout << "Fully self-directed data gather and solve" << endl;
       // Fully self-directed data gather and solve
+      InstrumentationTimer selfSolveTimer("Calibrater.selfGatherAndSolve");
       svc_p->selfGatherAndSolve(*vs_p,*ve_p);
     }
 
@@ -2256,6 +2257,8 @@ Bool Calibrater::genericGatherAndSolve() {
 
   //cout << "Generic gather and solve." << endl;
 
+  InstrumentationTimer gatherAndSolveTimer("Calibrater.gatherAndSolve");
+
   // Create the solver
   VisCalSolver vcs;
   
@@ -2301,6 +2304,7 @@ Bool Calibrater::genericGatherAndSolve() {
     //    VisBuffAccumulator vba(vs_p->numberAnt(),svc_p->preavg(),False); 
     VisBuffGroupAcc vbga(vs_p->numberAnt(),vs_p->numberSpw(),vs_p->numberFld(),svc_p->preavg()); 
     
+    InstrumentationTimer gatherTimer("Calibrater.gather");
     for (Int ichunk=0;ichunk<nChunkPerSol(isol);++ichunk) {
     
       // Current _chunk_'s spw
@@ -2357,6 +2361,7 @@ Bool Calibrater::genericGatherAndSolve() {
 	  if (nfalse(vb.flag())>0)
 	    vbga.accumulate(vb);
 	  
+	  Instrumentation::addCount("Calibrater.rows", vb.nRow());
 	}
       }
       else
@@ -2370,6 +2375,7 @@ Bool Calibrater::genericGatherAndSolve() {
     
     // Finalize the averged VisBuffer
     vbga.finalizeAverage();
+    gatherTimer.stop();
 
     // Establish meta-data for this interval
     //  (some of this may be used _during_ solve)
@@ -2380,6 +2386,8 @@ Bool Calibrater::genericGatherAndSolve() {
 
     if (vbOk) {
 
+      InstrumentationTimer solveTimer("Calibrater.solve");
+
       // Use spw of first VB in vbga
       // TBD: (currSpw==thisSpw) here??  (I.e., use svc_p->currSpw()?  currSpw is prot!)
       Int thisSpw=svc_p->spwMap()(vbga(0).spectralWindow());
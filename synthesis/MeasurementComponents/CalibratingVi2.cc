@@ -22,7 +22,31 @@
 
 #include <synthesis/MeasurementComponents/CalibratingVi2.h>
 #include <synthesis/MeasurementComponents/Calibrater.h>
+#include <casa/Arrays/ArrayLogical.h>
 #include <casa/Arrays/ArrayPartMath.h>
+#include <casa/Logging/LogIO.h>
+#include <casa/System/AipsrcValue.h>
+#include <casa/sstream.h>
+#include <msvis/MSVis/UtilJ.h>
+#include <iomanip>
+
+namespace {
+
+  // FNV-1a hash of a channel list, for the calibration cache keys
+  casa::uInt64 channelHash(const casa::Vector<casa::Int>& chans) {
+    casa::uInt64 hash=14695981039346656037ULL;
+    for (casa::uInt i=0;i<chans.nelements();++i) {
+      const casa::Int chan=chans(i);
+      const casa::uChar* bytes=reinterpret_cast<const casa::uChar*>(&chan);
+      for (casa::uInt k=0;k<sizeof(chan);++k) {
+	hash^=bytes[k];
+	hash*=1099511628211ULL;
+      }
+    }
+    return hash;
+  }
+
+}
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
@@ -129,7 +153,13 @@ CalibratingVi2::CalibratingVi2(	vi::VisibilityIterator2 * vi,
   cb_p(),
   ve_p(0),
   corrFactor_p(calpar.getCorrFactor()), // temporary
-  visCorrOK_p(False)
+  visCorrOK_p(False),
+  diagonalCal_p(False),
+  calcachefull_p(False),
+  calcachebytes_p(0),
+  maxcachebytes_p(0),
+  calcachehits_p(0),
+  calcachemisses_p(0)
 {
 
   // Initialize underlying ViImpl2
@@ -139,6 +169,8 @@ CalibratingVi2::CalibratingVi2(	vi::VisibilityIterator2 * vi,
   // Make a VisBuffer for CalibratingVi2 clients (it is connected to the vi interface)
   setVisBuffer(VisBuffer2::factory(vi,VbPlain,VbRekeyable));
 
+  initCalCache();
+
 }
 
 // -----------------------------------------------------------------------
@@ -150,7 +182,13 @@ CalibratingVi2::CalibratingVi2(	vi::VisibilityIterator2 * vi,
   cb_p(msname),
   ve_p(0),
   corrFactor_p(1.0),
-  visCorrOK_p(False)
+  visCorrOK_p(False),
+  diagonalCal_p(False),
+  calcachefull_p(False),
+  calcachebytes_p(0),
+  maxcachebytes_p(0),
+  calcachehits_p(0),
+  calcachemisses_p(0)
 {
 
   if (calpar.byCalLib()) {
@@ -173,6 +211,8 @@ CalibratingVi2::CalibratingVi2(	vi::VisibilityIterator2 * vi,
   // Make a VisBuffer for CalibratingVi2 clients (it is connected to the vi interface)
   setVisBuffer(VisBuffer2::factory(vi,VbPlain,VbRekeyable));
 
+  initCalCache();
+
 }
 
 // -----------------------------------------------------------------------
@@ -180,9 +220,45 @@ CalibratingVi2::CalibratingVi2(	vi::VisibilityIterator2 * vi,
 // -----------------------------------------------------------------------
 CalibratingVi2::~CalibratingVi2()
 {
+  if (calcachehits_p+calcachemisses_p>0) {
+    LogIO os(LogOrigin("CalibratingVi2","~CalibratingVi2"));
+    os << LogIO::NORMAL1 << "Calibration cache: " << calcachehits_p
+       << " subchunks calibrated from the cache, " << calcachemisses_p
+       << " by the VisEquation" << LogIO::POST;
+  }
   ve_p=0;
 }
 
+// -----------------------------------------------------------------------
+//
+// -----------------------------------------------------------------------
+void CalibratingVi2::initCalCache()
+{
+  Int cacheMB;
+  AipsrcValue<Int>::find(cacheMB, "CalibratingVi2.cachesize", 0);
+  setCalCache(Int64(cacheMB)*1024*1024);
+
+  // Only multiplicative, diagonal calibration is a factor per visibility
+  diagonalCal_p = (ve_p && ve_p->diagonalApply());
+
+  if (maxcachebytes_p>0 && ve_p && !diagonalCal_p) {
+    LogIO os(LogOrigin("CalibratingVi2","initCalCache"));
+    os << LogIO::NORMAL1 << "Calibration includes non-diagonal terms;"
+       << " the calibration cache will not be used." << LogIO::POST;
+  }
+}
+
+// -----------------------------------------------------------------------
+//
+// -----------------------------------------------------------------------
+void CalibratingVi2::setCalCache(Int64 maxBytes)
+{
+  maxcachebytes_p=maxBytes;
+  calcache_p.clear();
+  calcachefull_p=False;
+  calcachebytes_p=0;
+}
+
 
 
 // -----------------------------------------------------------------------
@@ -395,8 +471,9 @@ void CalibratingVi2::correctCurrentVB() const
 
     // If the VisEquation is set, use it, otherwise use the corrFactor_p
     if (ve_p) {
-      // Apply calibration via the VisEquation
-      ve_p->correct2(*vb,False,doWtSp);
+      // Apply calibration from the cache, or else via the VisEquation
+      if (!correctByCache(*vb,doWtSp))
+	ve_p->correct2(*vb,False,doWtSp);
 
       // Set unchan'd weights, in case they are requested
       if (doWtSp)
@@ -439,6 +516,183 @@ void CalibratingVi2::correctCurrentVB() const
 
 
 
+// -----------------------------------------------------------------------
+//
+// -----------------------------------------------------------------------
+Bool CalibratingVi2::correctByCache(VisBuffer2& vb, Bool doWtSp) const
+{
+  Int nRow=vb.nRows();
+  if (maxcachebytes_p<=0 || !diagonalCal_p || nRow==0)
+    return False;
+
+  // The VisCals assume a single timestamp, so must the cache
+  const Vector<Double>& time(vb.time());
+  if (time(0)!=time(nRow-1))
+    return False;
+
+  // The channels are in the key in full: selections of the same width
+  //  and first channel may still differ in stride or in their ranges
+  ostringstream oos;
+  oos << std::setprecision(15);
+  oos << vb.msId() << "_" << vb.spectralWindows()(0) << "_" << vb.fieldId()(0)
+      << "_" << vb.observationId()(0) << "_" << time(0)
+      << "_" << vb.nCorrelations() << "_" << vb.nChannels()
+      << "_" << std::hex << channelHash(vb.getChannelNumbers(0)) << std::dec
+      << "_" << doWtSp;
+  String key(oos);
+
+  std::map<String,std::vector<CalCacheBlock> >::const_iterator cached=calcache_p.find(key);
+  if (cached!=calcache_p.end() && applyCachedCal(vb,doWtSp,cached->second)) {
+    ++calcachehits_p;
+    utilj::Instrumentation::addCount("CalibratingVi2.calCacheHits");
+    return True;
+  }
+
+  ++calcachemisses_p;
+  utilj::Instrumentation::addCount("CalibratingVi2.calCacheMisses");
+
+  // Probing costs about as much again as correct2, so only do it for
+  //  blocks that will be kept.  Nothing is evicted to make room: on a
+  //  sweep over more data than fits, evicting the oldest times would drop
+  //  every block before it is used again.
+  Int64 nVis=Int64(vb.nCorrelations())*vb.nChannels()*nRow;
+  Int64 nWt=Int64(vb.nCorrelations())*(doWtSp ? vb.nChannels() : 1)*nRow;
+  Int64 nbytes=nVis*(sizeof(Complex)+sizeof(Bool))+nWt*sizeof(Float);
+  if (nbytes>maxcachebytes_p)
+    return False;
+  if (calcachebytes_p+nbytes>maxcachebytes_p) {
+    if (!calcachefull_p) {
+      LogIO os(LogOrigin("CalibratingVi2","correctByCache"));
+      os << LogIO::NORMAL1 << "Calibration cache is full ("
+	 << calcachebytes_p/(1024*1024) << " MB); subchunks not in it are"
+	 << " calibrated by the VisEquation." << LogIO::POST;
+      calcachefull_p=True;
+    }
+    return False;
+  }
+
+  std::vector<CalCacheBlock> probed(1);
+  probeCal(vb,doWtSp,probed[0]);
+
+  calcache_p[key].push_back(probed[0]);
+  calcachebytes_p+=probed[0].factor.nelements()*sizeof(Complex)+
+    probed[0].flag.nelements()*sizeof(Bool)+
+    probed[0].wtFactor.nelements()*sizeof(Float);
+
+  if (!applyCachedCal(vb,doWtSp,probed))
+    throw(AipsError("CalibratingVi2: failed to apply the probed calibration"));
+  return True;
+}
+
+// -----------------------------------------------------------------------
+//
+// -----------------------------------------------------------------------
+void CalibratingVi2::probeCal(VisBuffer2& vb, Bool doWtSp, CalCacheBlock& block) const
+{
+  // Keep the data, flags and weights prepared by correctCurrentVB
+  Cube<Complex> vis(vb.visCubeCorrected().copy());
+  Cube<Bool> flags(vb.flagCube().copy());
+  Cube<Float> wtsp;
+  Matrix<Float> wt;
+  if (doWtSp)
+    wtsp=vb.weightSpectrum();
+  else
+    wt=vb.weight();
+
+  // Calibrating unit data and weights without flags yields the factors
+  //  and the flags of the calibration itself
+  IPosition shape(vis.shape());
+  vb.setVisCubeCorrected(Cube<Complex>(shape,Complex(1.0)));
+  vb.setFlagCube(Cube<Bool>(shape,False));
+  if (doWtSp)
+    vb.setWeightSpectrum(Cube<Float>(shape,1.0f));
+  else
+    vb.setWeight(Matrix<Float>(shape(0),shape(2),1.0f));
+
+  ve_p->correct2(vb,False,doWtSp);
+
+  block.factor=vb.visCubeCorrected();
+  if (anyTrue(vb.flagCube()))
+    block.flag=vb.flagCube();
+  if (doWtSp)
+    block.wtFactor=vb.weightSpectrum();
+  else
+    block.wtFactor=vb.weight().reform(IPosition(3,shape(0),1,shape(2)));
+
+  const Vector<Int>& a1(vb.antenna1());
+  const Vector<Int>& a2(vb.antenna2());
+  for (Int row=0;row<shape(2);++row)
+    block.rowOf.insert(std::make_pair(std::make_pair(a1(row),a2(row)),row));
+
+  // Restore
+  vb.setVisCubeCorrected(vis);
+  vb.setFlagCube(flags);
+  if (doWtSp)
+    vb.setWeightSpectrum(wtsp);
+  else
+    vb.setWeight(wt);
+}
+
+// -----------------------------------------------------------------------
+//
+// -----------------------------------------------------------------------
+Bool CalibratingVi2::applyCachedCal(VisBuffer2& vb, Bool doWtSp,
+				    const std::vector<CalCacheBlock>& blocks) const
+{
+  // Find every baseline before changing anything
+  Int nRow=vb.nRows();
+  const Vector<Int>& a1(vb.antenna1());
+  const Vector<Int>& a2(vb.antenna2());
+  std::vector<const CalCacheBlock*> blockOf(nRow,0);
+  std::vector<Int> rowOf(nRow,-1);
+  for (Int row=0;row<nRow;++row) {
+    std::pair<Int,Int> bl(a1(row),a2(row));
+    for (uInt i=0;i<blocks.size() && !blockOf[row];++i) {
+      std::map<std::pair<Int,Int>,Int>::const_iterator r=blocks[i].rowOf.find(bl);
+      if (r!=blocks[i].rowOf.end()) {
+	blockOf[row]=&blocks[i];
+	rowOf[row]=r->second;
+      }
+    }
+    if (!blockOf[row])
+      return False;
+  }
+
+  Cube<Complex> vis(vb.visCubeCorrected().copy());
+  Cube<Bool> flags(vb.flagCube().copy());
+  Cube<Float> wt;
+  if (doWtSp)
+    wt=vb.weightSpectrum();
+  else
+    wt=vb.weight().reform(IPosition(3,vb.nCorrelations(),1,nRow));
+  Int nCorr=vis.shape()(0);
+  Int nChan=vis.shape()(1);
+  Int nWtChan=wt.shape()(1);
+
+  for (Int row=0;row<nRow;++row) {
+    const CalCacheBlock& b=*blockOf[row];
+    Int brow=rowOf[row];
+    for (Int chn=0;chn<nChan;++chn)
+      for (Int cor=0;cor<nCorr;++cor)
+	vis(cor,chn,row)*=b.factor(cor,chn,brow);
+    if (b.flag.nelements()>0)
+      for (Int chn=0;chn<nChan;++chn)
+	for (Int cor=0;cor<nCorr;++cor)
+	  flags(cor,chn,row)|=b.flag(cor,chn,brow);
+    for (Int chn=0;chn<nWtChan;++chn)
+      for (Int cor=0;cor<nCorr;++cor)
+	wt(cor,chn,row)*=b.wtFactor(cor,chn,brow);
+  }
+
+  vb.setVisCubeCorrected(vis);
+  vb.setFlagCube(flags);
+  if (doWtSp)
+    vb.setWeightSpectrum(wt);
+  else
+    vb.setWeight(wt.reform(IPosition(2,nCorr,nRow)));
+  return True;
+}
+
 } //# NAMESPACE VI - END
 } //# NAMESPACE CASA - END
 
@@ -30,6 +30,10 @@
 
 #include <casa/Containers/Record.h>
 
+#include <map>
+#include <utility>
+#include <vector>
+
 namespace casa { //# NAMESPACE CASA - BEGIN
 namespace vi { //# NAMESPACE VI - BEGIN
 
@@ -97,12 +101,53 @@ public:
   // Reports True in case of *Corrected columns
   //  (because this class provides it, even if it doesn't exist physically!)
   virtual Bool existsColumn (VisBufferComponent2 id) const;
+
+  // Calibration cache
+  //
+  // When every applied term is diagonal (see VisEquation::diagonalApply),
+  //  the calibration of a visibility is a complex factor, a weight factor
+  //  and a flag that depend only on the baseline, channel and correlation
+  //  at a given (MS, spw, field, obs, time).  These are kept per baseline,
+  //  so that later subchunks of the same time and later sweeps over the
+  //  data (e.g., imaging major cycles) are calibrated without the
+  //  VisEquation.  The aipsrc variable CalibratingVi2.cachesize sets the
+  //  size of the cache in MB; it is off (0) by default.  Nothing is
+  //  evicted: once the cache is full, subchunks that are not in it are
+  //  calibrated by the VisEquation alone, so that a sweep over more data
+  //  than the cache holds still finds the part that was kept.
+  void setCalCache(Int64 maxBytes);
+  Int64 calCacheHits() const { return calcachehits_p; };
+  Int64 calCacheMisses() const { return calcachemisses_p; };
   
 private:
 
+  // The calibration of the baselines of one subchunk
+  struct CalCacheBlock {
+    std::map<std::pair<Int,Int>,Int> rowOf;   // (ant1,ant2) -> row
+    Cube<Complex> factor;
+    Cube<Float> wtFactor;   // nChan=1 if the weights are unchannelized
+    Cube<Bool> flag;        // empty if the calibration flags nothing
+  };
+
+  // Read the cache size and whether the calibration can be cached
+  void initCalCache();
+
   // Correct the current VB
   void correctCurrentVB() const;
 
+  // Calibrate vb from the cache, adding the calibration of its baselines
+  //  first if they are not there; returns False if vb cannot be
+  //  calibrated this way
+  Bool correctByCache(VisBuffer2& vb, Bool doWtSp) const;
+
+  // Obtain the calibration factors of the baselines in vb
+  void probeCal(VisBuffer2& vb, Bool doWtSp, CalCacheBlock& block) const;
+
+  // Apply the calibration in blocks to vb; returns False unless every
+  //  baseline of vb is in blocks
+  Bool applyCachedCal(VisBuffer2& vb, Bool doWtSp,
+		      const std::vector<CalCacheBlock>& blocks) const;
+
   // Calibrater and VisEquation
   Calibrater cb_p;
   VisEquation *ve_p;   
@@ -113,6 +158,13 @@ private:
   // signals whether or not correctCurrentVB has been called
   mutable Bool visCorrOK_p;
 
+  // Calibration cache
+  Bool diagonalCal_p;
+  mutable std::map<String,std::vector<CalCacheBlock> > calcache_p;
+  mutable Bool calcachefull_p;
+  mutable Int64 calcachebytes_p, maxcachebytes_p;
+  mutable Int64 calcachehits_p, calcachemisses_p;
+
 };
 
 } //# NAMESPACE VI - END
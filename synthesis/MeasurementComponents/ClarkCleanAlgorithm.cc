@@ -39,6 +39,7 @@
 #include <casa/Exceptions/Error.h>
 #include <casa/BasicSL/String.h>
 #include <casa/Utilities/Assert.h>
+#include <casa/Utilities/CountedPtr.h>
 #include <casa/OS/HostInfo.h>
 
 #include <casa/sstream.h>
@@ -54,7 +55,7 @@
 namespace casa { //# NAMESPACE CASA - BEGIN
 
 ClarkCleanAlgorithm::ClarkCleanAlgorithm() : model_sl_p(0), 
-  myName("Clark Clean")
+  myName("Clark Clean"), inMemory_p(False)
 {
 // Default constructor
 //
@@ -82,9 +83,8 @@ void ClarkCleanAlgorithm::get()
   applicator.get(chan);
   applicator.get(nchan);
   if (model_sl_p) delete model_sl_p;
-  model_sl_p = new PagedArray<Float>(TiledShape(residual_sl.shape()));
+  model_sl_p = scratch(residual_sl.shape());
   model_sl_p->set(0.0f);
-  model_sl_p->setMaximumCacheSize(cache_p);
 }
 
 void ClarkCleanAlgorithm::put() 
@@ -101,18 +101,35 @@ String& ClarkCleanAlgorithm::name()
 return myName;
 };
 
+Algorithm *ClarkCleanAlgorithm::clone() const
+{
+// Return a new instance; the data are set by get()
+//
+  ClarkCleanAlgorithm *cleaner = new ClarkCleanAlgorithm;
+  cleaner->inMemory_p = True;
+  return cleaner;
+};
+
+Lattice<Float> *ClarkCleanAlgorithm::scratch(const IPosition &shape) const
+{
+  if (inMemory_p) {
+    return new ArrayLattice<Float>(shape);
+  }
+  PagedArray<Float> *paged = new PagedArray<Float>(TiledShape(shape));
+  paged->setMaximumCacheSize(cache_p);
+  return paged;
+}
+
 void ClarkCleanAlgorithm::task()
 {
 // Do the parallelized part of the Clark CLEAN, acting on
 // the local data obtained from the controller.
 //
   LogIO os(LogOrigin("task","solve in parallel",WHERE));
-  PagedArray<Float> dirty_sl(TiledShape(residual_sl.shape()));
-  dirty_sl.setMaximumCacheSize(cache_p);
-  dirty_sl.put(residual_sl);
-  PagedArray<Float> resid_sl(TiledShape(residual_sl.shape()));
-  resid_sl.setMaximumCacheSize(cache_p);
-  resid_sl.put(residual_sl);
+  CountedPtr<Lattice<Float> > dirty_sl(scratch(residual_sl.shape()));
+  dirty_sl->put(residual_sl);
+  CountedPtr<Lattice<Float> > resid_sl(scratch(residual_sl.shape()));
+  resid_sl->put(residual_sl);
 
   ArrayLattice<Float> al_psf_sl(psf_sf);
   Float psfmax;
@@ -126,7 +143,7 @@ void ClarkCleanAlgorithm::task()
   if(psfmax==0.0) {
     os << "No data for this channel: skipping" << LogIO::POST;
   } else {
-    LatConvEquation eqn(al_psf_sl, dirty_sl);
+    LatConvEquation eqn(al_psf_sl, *dirty_sl);
     ClarkCleanLatModel cleaner(*model_sl_p);
     ArrayLattice<Float> latMask(mask);
     if (mask.nelements() > 1) {
@@ -146,7 +163,7 @@ void ClarkCleanAlgorithm::task()
        << " to get to a max residual of " << cleaner.threshold() 
        << LogIO::POST;
     // cleaner.getModel(image);
-    eqn.residual(resid_sl, cleaner);
+    eqn.residual(*resid_sl, cleaner);
   }
 };
 
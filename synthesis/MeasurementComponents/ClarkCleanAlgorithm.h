@@ -31,7 +31,7 @@
 //# Includes
 #include <casa/BasicSL/String.h>
 #include <casa/Arrays/Array.h>
-#include <lattices/Lattices/PagedArray.h>
+#include <lattices/Lattices/Lattice.h>
 #include <synthesis/Parallel/Algorithm.h>
 
 namespace casa { //# NAMESPACE CASA - BEGIN
@@ -51,9 +51,14 @@ class ClarkCleanAlgorithm : public Algorithm {
   // Return the name of the algorithm
   String &name();
 
+  // A new instance for another worker thread. Its scratch lattices are
+  // kept in memory, since the worker threads cannot create and use the
+  // temporary tables of PagedArrays at the same time.
+  Algorithm *clone() const;
+
  private:
   // Local copies of the data and input parameters
-  PagedArray<Float> *model_sl_p;
+  Lattice<Float> *model_sl_p;
   Array<Float>      residual_sl;
   Array<Float>      psf_sf;
   Array<Float>      mask;
@@ -64,9 +69,13 @@ class ClarkCleanAlgorithm : public Algorithm {
   Int          nchan;
   String       myName;
   Int cache_p;
+  Bool inMemory_p;
 
   // Do the Clark CLEAN on the assigned data
   void task();
+
+  // A new scratch lattice: an ArrayLattice if inMemory_p, else a PagedArray
+  Lattice<Float> *scratch(const IPosition &shape) const;
 };
 
 
@@ -79,6 +79,8 @@ void MakeApproxPSFAlgorithm::get(){
   ft_p = new GridFT(container_ft);
   applicator.get(msFileName_p);
   applicator.get(weight_p);
+  // makeImage writes the weights; do not write into the sender's copy
+  weight_p.unique();
   
   Record image_container;
   applicator.get(image_container);
@@ -119,7 +121,8 @@ void MakeApproxPSFAlgorithm::task(){
 		    weight_p);
     StokesImageUtil::To(*psf_p, *cImage_p);
 
-    beam_p= *(new Vector<Float>(3));
+    // New storage: the beam of the last task may still be in transit
+    beam_p.reference(Vector<Float>(3));
     StokesImageUtil::FitGaussianPSF(*psf_p, beam_p);
 
     Int nx=psf_p->shape()(0);
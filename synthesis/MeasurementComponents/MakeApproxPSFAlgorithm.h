@@ -91,6 +91,9 @@ public:
   // Return the name of the algorithm
   String &name();
 
+  // Not cloneable: the task reads and writes the MS through the table
+  // system, which worker threads cannot use at the same time
+
  private:
   // Local copies of the data and input parameters
   TempImage<Complex> *cImage_p;
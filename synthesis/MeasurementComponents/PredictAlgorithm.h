@@ -90,6 +90,9 @@ class PredictAlgorithm : public Algorithm {
   // Return the name of the algorithm
   String &name();
 
+  // Not cloneable: the task reads and writes the MS through the table
+  // system, which worker threads cannot use at the same time
+
 private:
   // Private data
   Int model_p;
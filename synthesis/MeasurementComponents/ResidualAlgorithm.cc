@@ -88,7 +88,8 @@ void ResidualAlgorithm::get(){
   applicator.get(weight_temp);
 
   if (weight_p) delete weight_p;
-  weight_p = new Matrix<Float> (weight_temp);
+  // The weights are accumulated; do not write into the sender's copy
+  weight_p = new Matrix<Float> (weight_temp.copy());
 
 };
 
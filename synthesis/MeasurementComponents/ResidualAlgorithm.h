@@ -91,6 +91,9 @@ class ResidualAlgorithm : public Algorithm {
   // Return the name of the algorithm
   String &name();
 
+  // Not cloneable: the task reads and writes the MS through the table
+  // system, which worker threads cannot use at the same time
+
  private:
   // Private data
   Int model_p;
@@ -47,8 +47,16 @@
 
 #define VCS_PRTLEV 0
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 namespace casa { //# NAMESPACE CASA - BEGIN
 
+// Below this many (row,chan,corr,par) samples per buffer the chi2 and
+//  grad/hess accumulations are not worth spreading over threads
+static const Int vcsMinParallelSamples=32768;
+
 
 // **********************************************************
 //  UVMod Implementations
@@ -561,78 +569,7 @@ void VisCalSolver::chiSquare() {
   sumWt()=0.0;
   nWt()=0;
 
-  // Shapes for iteration
-  IPosition shR(R().shape());
-  Int nCorr=shR(0);
-  Int nChan=shR(1);
-  Int nRow=shR(2);
-
-  ArrayIterator<Bool>  flag(svb().flag(),1);        // fl(chan) by (row)
-  ArrayIterator<Float> wtMat(svb().weightMat(),1);  // wt(corr) by (row)
-  ArrayIterator<Complex> Rit(R(),1);                // R(corr)  by (chan,row)
-
-  Bool*  flR = svb().flagRow().data();
-  Bool*  fl;
-  Float* wt;
-  Complex *Rp;
-
-  for (Int irow=0;irow<nRow;++irow) { 
-    if (!*flR) {
-      // This row's wt(corr), flag(chan)
-      wt = wtMat.array().data(); 
-      //      wt[1]=wt[2]=0.0;
-      fl = flag.array().data() + svc().focusChan();
-      // Register R for this row, 0th channel
-      for (Int ich=0;ich<nChan;++ich) {
-	if (!*fl) { 
-
-	  Rp = Rit.array().data();
-	  for (Int icorr=0;icorr<nCorr;++icorr) {
-
-   /*
-	    if (svb().weightMat()(icorr,irow)>0.0) {
-	      cout << irow << " " << icorr << " "
-		   << svb().weightMat()(icorr,irow) << " "
-		   << *wt << " "
-		   << R()(icorr,0,irow) << " "
-		   << *Rp << " "
-		   << &R()(icorr,0,irow) << " "
-		   << Rp << " "
-		   << Rp-&R()(icorr,0,irow) << "    "
-		   << &R()(0,0,irow)-&R()(3,0,irow) << " "
-		   << Rit.array().shape()
-		   << endl;
-	    }
-   */
-	    chiSq()+=Double( (*wt)*real((*Rp)*conj(*Rp)) );
-	    //	    chiSq()+=Double( real((*Rp)*conj(*Rp)) );
-	    chiSqV()(icorr)+=Double( (*wt)*real((*Rp)*conj(*Rp)) );
-	    sumWt()+=Double(*wt);   // for each channel?!
-
-	    if (*wt>0.0) nWt()++;
-	    
-	    //Advance to next corr
-	    ++wt;
-	    ++Rp;
-	  }
-	  // Use same wt(corr) vectors for each channel
-	  wt-=nCorr;
-	}
-	// Advance to next channel
-	Rit.next();
-	++fl;
-      }
-    }
-    else 
-      // Advance over flagged row!
-      for (Int ich=0;ich<nChan;++ich) Rit.next();
-    
-    // Advance to next row
-    ++flR;
-    flag.next();
-    wtMat.next();
-  }
-
+  chiSquareRows(R(),svb().flag(),svc().focusChan(),svb().weightMat(),svb().flagRow());
 
 }
 
@@ -662,61 +599,99 @@ void VisCalSolver::chiSquare2() {
 
     R().reference(cvb.residuals());
 
-    // Shapes for iteration
-    IPosition shR(R().shape());
-    Int nCorr=shR(0);
-    Int nChan=shR(1);
-    Int nRow=shR(2);
-    
-    ArrayIterator<Bool>  flag(cvb.residFlag(),1);        // fl(chan) by (row)
-    ArrayIterator<Float> wtMat(cvb.weightMat(),1);  // wt(corr) by (row)
-    ArrayIterator<Complex> Rit(R(),1);                // R(corr)  by (chan,row)
-    
-    Bool*  flR = cvb.flagRow().data();
-    Bool*  fl;
-    Float* wt;
-    Complex *Rp;
-    
+    chiSquareRows(R(),cvb.residFlag(),0,cvb.weightMat(),cvb.flagRow());
+
+  } // ibuf
+}
+
+void VisCalSolver::chiSquareRows(const Cube<Complex>& Res,
+				 const Matrix<Bool>& flag, const Int flagChan0,
+				 const Matrix<Float>& wtMat,
+				 const Vector<Bool>& flagRow) {
+
+  // Shapes for iteration
+  IPosition shR(Res.shape());
+  Int nCorr=shR(0);
+  Int nChan=shR(1);
+  Int nRow=shR(2);
+  Int nFlagChan=flag.nrow();
+
+  Bool delR,delfl,delwt,delflR;
+  const Complex* Rdata=Res.getStorage(delR);
+  const Bool* fldata=flag.getStorage(delfl);
+  const Float* wtdata=wtMat.getStorage(delwt);
+  const Bool* flRdata=flagRow.getStorage(delflR);
+
+  Double& chiSqTot(chiSq());
+  Vector<Double>& chiSqVTot(chiSqV());
+  Double& sumWtTot(sumWt());
+  Int& nWtTot(nWt());
+
+  // Each thread sums its own block of rows into its own partial sums,
+  //  which are added together in thread order at the end, so that the
+  //  totals do not depend on which thread finishes first
+  Int nth(1);
+#ifdef _OPENMP
+  if (nRow*nChan*nCorr>=vcsMinParallelSamples)
+    nth=omp_get_max_threads();
+#endif
+  Vector<Double> cSqP(nth,0.0),sWtP(nth,0.0);
+  Vector<Int> nWP(nth,0);
+  Matrix<Double> cSqVP(nCorr,nth,0.0);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nth)
+#endif
+  {
+    Int ith(0);
+#ifdef _OPENMP
+    ith=omp_get_thread_num();
+#endif
+    Double cSq(0.0),sWt(0.0);
+    Int nW(0);
+    Double* cSqV=cSqVP.data()+ith*nCorr;
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
     for (Int irow=0;irow<nRow;++irow) { 
-      if (!*flR) {
+      if (!flRdata[irow]) {
 	// This row's wt(corr), flag(chan)
-	wt = wtMat.array().data(); 
-	fl = flag.array().data();
+	const Float* wt=wtdata+irow*nCorr;
+	const Bool* fl=fldata+irow*nFlagChan+flagChan0;
 	// Register R for this row, 0th channel
-	for (Int ich=0;ich<nChan;++ich) {
-	  if (!*fl) { 
-	    
-	    Rp = Rit.array().data();
+	const Complex* Rp=Rdata+irow*nChan*nCorr;
+	for (Int ich=0;ich<nChan;++ich,Rp+=nCorr) {
+	  if (!fl[ich]) { 
 	    for (Int icorr=0;icorr<nCorr;++icorr) {
+	      Double chi2=Double( wt[icorr]*real(Rp[icorr]*conj(Rp[icorr])) );
+	      cSq+=chi2;
+	      cSqV[icorr]+=chi2;
+	      sWt+=Double(wt[icorr]);   // for each channel?!
 	      
-	      chiSq()+=Double( (*wt)*real((*Rp)*conj(*Rp)) );
-	      chiSqV()(icorr)+=Double( (*wt)*real((*Rp)*conj(*Rp)) );
-	      sumWt()+=Double(*wt);   // for each channel?!
-	      
-	      if (*wt>0.0) nWt()++;
-	      
-	      //Advance to next corr
-	      ++wt;
-	      ++Rp;
+	      if (wt[icorr]>0.0) nW++;
 	    }
-	    // Use same wt(corr) vectors for each channel
-	    wt-=nCorr;
 	  }
-	  // Advance to next channel
-	  Rit.next();
-	  ++fl;
 	}
       }
-      else 
-	// Advance over flagged row!
-	for (Int ich=0;ich<nChan;++ich) Rit.next();
-      
-      // Advance to next row
-      ++flR;
-      flag.next();
-      wtMat.next();
     }
-  } // ibuf
+    cSqP(ith)=cSq;
+    sWtP(ith)=sWt;
+    nWP(ith)=nW;
+  }
+
+  for (Int ith=0;ith<nth;++ith) {
+    chiSqTot+=cSqP(ith);
+    for (Int icorr=0;icorr<nCorr;++icorr)
+      chiSqVTot(icorr)+=cSqVP(icorr,ith);
+    sumWtTot+=sWtP(ith);
+    nWtTot+=nWP(ith);
+  }
+
+  Res.freeStorage(Rdata,delR);
+  flag.freeStorage(fldata,delfl);
+  wtMat.freeStorage(wtdata,delwt);
+  flagRow.freeStorage(flRdata,delflR);
 }
 
 
@@ -794,186 +769,18 @@ void VisCalSolver::accGradHess() {
   grad()=0.0;
   hess()=0.0;
 
-  IPosition dRip(dR().shape());
-
-  Int nRow(dRip(3));
-  Int nChan(dRip(2));
-  Int nPar(dRip(1));   // pars per antenna
-  Int nCorr(dRip(0));
-
-  ArrayIterator<Bool>  flag(svb().flag(),1);        // fl(chan) by (row)
-  ArrayIterator<Float> wtMat(svb().weightMat(),1);  // wt(corr) by (row)
-
-  ArrayIterator<Complex> Rit(R(),1);       // R(corr)       by (chan,row)
-  
-  Array<Complex> dR0, dR1;
-  {
-    ArrayIterator<Complex> dRit(dR(),4);  // dR(corr,par,chan,row) by (ant)
-    dR0.reference(dRit.array());
-    dRit.next();
-    dR1.reference(dRit.array());
-  }
-  ArrayIterator<Complex> dR0it(dR0,2);   // dR0(corr,par) by (chan,row)
-  ArrayIterator<Complex> dR1it(dR1,2);   // dR1(corr,par) by (chan,row)
-
-  Bool*  flR = svb().flagRow().data();
-  Bool*  fl;
-  Float* wt;
-  Int*   a1 = svb().antenna1().data();
-  Int*   a2 = svb().antenna2().data();
-  Complex *Rp;
-  Complex *dR0p;
-  Complex *dR1p;
-  DComplex *G1;
-  DComplex *G2;
-  Double *H1;
-  Double *H2;
-
-  //  cout << "flag.array().data() = " << flag.array().data() << endl;
   //  cout << "VCS::accGradHess:  svc().focusChan()   = " << svc().focusChan() << endl;
 
-  for (Int irow=0;irow<nRow;++irow) { 
-    if (!*flR) {
-      // Register grad, hess for ants in this baseline
-      Int p1((*a1)*nPar);
-      Int p2((*a2)*nPar);
-      G1 = grad().data() + p1;
-      G2 = grad().data() + p2;
-      H1 = hess().data() + p1;
-      H2 = hess().data() + p2;
-      // This row's wt(corr), flag(chan)
-      wt = wtMat.array().data(); 
-      fl = flag.array().data() + svc().focusChan();
-      for (Int ich=0;ich<nChan;++ich) {
-	if (!*fl) { 
-
-	  // Do source bits, if necessary
-	  if (svc().solvePol()) {
-	    for (Int icorr=0;icorr<nCorr;++icorr) {
-	      Float swt=Vector<Float>(wtMat.array())(icorr);
-
-	      for (Int ispar=0;ispar<nSrcPar();++ispar) {
-		grad()(nCalPar()+ispar) += DComplex((swt)*2.0*real(dSrc()(IPosition(4,icorr,ich,irow,ispar))*
-								   conj(R()(icorr,ich,irow))));
-		hess()(nCalPar()+ispar) += Double((swt)*2.0*real(dSrc()(IPosition(4,icorr,ich,irow,ispar))*
-								 conj(dSrc()(IPosition(4,icorr,ich,irow,ispar)))));
-	      }
-	    }
-	  }
-
-	  // Register R,dR for this channel, row
-	  Rp = Rit.array().data();
-	  dR0p = dR0it.array().data();
-	  dR1p = dR1it.array().data();
-
-   /*
-	  cout << "irow=" << irow << endl;
-	  cout << "R=" << Rit.array() << endl;
-	  cout << "dR0=" << dR0it.array()
-	       << "dR1=" << dR1it.array()
-	       << endl;
-   */
-
-	  for (int ip=0;ip<nPar;++ip) {
-
-	    for (Int icorr=0;icorr<nCorr;++icorr) {
-
-	      (*G1) += DComplex( (*wt)*((*Rp)  *conj(*dR0p)) );
-	      (*G2) += DComplex( (*wt)*((*dR1p)*conj(*Rp)) );
-	      (*H1) +=   Double( (*wt)*real((*dR0p)*conj(*dR0p)) );
-	      (*H2) +=   Double( (*wt)*real((*dR1p)*conj(*dR1p)) );
-     /*
-	      (*G1) += DComplex( (*Rp)  *conj(*dR0p) );
-	      (*G2) += DComplex( (*dR1p)*conj(*Rp) );
-	      (*H1) +=   Double( real((*dR0p)*conj(*dR0p)) );
-	      (*H2) +=   Double( real((*dR1p)*conj(*dR1p)) );
-     */
-    
-
-	      //Advance to next corr
-	      ++wt;
-	      ++Rp;
-	      ++dR0p;++dR1p;
-	    }
-	    // Advance to next par
-	    ++G1; ++G2;
-	    ++H1; ++H2;
-	    // Use same Rp(corr), wt(corr) vectors for each parameter
-	    Rp-=nCorr;
-	    wt-=nCorr;
-	  }
-	  // Accumulate to same grad(par) & hess(par) for each channel
-	  G1-=nPar; G2-=nPar;
-	  H1-=nPar; H2-=nPar;
-	}
-	// Advance to next channel
-	++fl;
-	Rit.next();
-	dR0it.next();
-	dR1it.next();
-      }
-    } // !*flgR
-    else {
-      // Advance over flagged row
-      for (Int ich=0;ich<nChan;++ich) {
-	Rit.next();
-	dR0it.next();
-	dR1it.next();
-      }
-    }
-    // Advance to next row
-    ++flR;
-    ++a1;++a2;
-    flag.next();
-    wtMat.next();
-  }
+  accGradHessRows(R(),dR(),svb().flag(),svc().focusChan(),svb().weightMat(),
+		  svb().flagRow(),svb().antenna1(),svb().antenna2());
 
   if (prtlev()>4) {  // grad, hess
     cout << "      grad= " << grad() << endl;
     cout << "      hess= " << hess() << endl;
   }
 
-
-/*  
-  // This is the slower way with array indexing
-  for (Int irow=0;irow<nRow;++irow,++flR,++a1,++a2) {
-    if (!*flR) {
-      par1=(*a1)*nPar;
-      par2=(*a2)*nPar;
-      for (Int ich=0;ich<nChan;++ich,++fl) {
-	if (!*fl) {
-	  for (int ip=0;ip<nPar;++ip) {
-	    for (Int icorr=0;icorr<nCorr;++icorr) {
-	      grad(par1+ip) += ( Double(wt(icorr,irow))*
-				 Double( R()(icorr,ich,irow  )*
-					 conj(dR()(icorr,ip,ich,irow,0)) ) );
-	      grad(par2+ip) += ( Double(wt(icorr,irow))*
-				 Double( dR()(icorr,ip,ich,irow,1)*
-					 conj(R()(icorr,ich,irow  )) ) );
-	      
-	      hess(par1+ip) += ( Double(wt(icorr,irow))*
-				 Double( dR()(icorr,ip,ich,irow,0)*
-					 conj(dR()(icorr,ip,ich,irow,0)) ) );
-	      hess(par2+ip) += ( Double(wt(icorr,irow))*
-				 Double( dR()(icorr,ip,ich,irow,1)*
-					 conj(dR()(icorr,ip,ich,irow,1)) ) );
-	    }
-	  }
-	}
-      }
-    }
-    else {
-      // Advance over flagged row
-      fl+=nChan;
-    }
-
-  }
-*/
-
-
 }
 
-
 void VisCalSolver::accGradHess2() {
 
   if (prtlev()>2) cout << "     VCS::accGradHess(CVB version)" << endl;
@@ -988,131 +795,150 @@ void VisCalSolver::accGradHess2() {
     R().reference(cvb.residuals());
     dR().reference(cvb.diffResiduals());
 
+    accGradHessRows(R(),dR(),cvb.residFlag(),0,cvb.weightMat(),
+		    cvb.flagRow(),cvb.antenna1(),cvb.antenna2());
     
-    IPosition dRip(dR().shape());
-    
-    Int nRow(dRip(3));
-    Int nChan(dRip(2));
-    Int nPar(dRip(1));   // pars per antenna
-    Int nCorr(dRip(0));
-    
-    ArrayIterator<Bool>  flag(cvb.residFlag(),1);        // fl(chan) by (row)
-    ArrayIterator<Float> wtMat(cvb.weightMat(),1);  // wt(corr) by (row)
-    
-    ArrayIterator<Complex> Rit(R(),1);       // R(corr)       by (chan,row)
-    
-    Array<Complex> dR0, dR1;
-    {
-      ArrayIterator<Complex> dRit(dR(),4);  // dR(corr,par,chan,row) by (ant)
-      dR0.reference(dRit.array());
-      dRit.next();
-      dR1.reference(dRit.array());
-    }
-    ArrayIterator<Complex> dR0it(dR0,2);   // dR0(corr,par) by (chan,row)
-    ArrayIterator<Complex> dR1it(dR1,2);   // dR1(corr,par) by (chan,row)
+    if (prtlev()>4) {  // grad, hess
+      cout << "      grad= " << grad() << endl;
+      cout << "      hess= " << hess() << endl;
+    }    
+
+  } // ibuf
+}
+
+void VisCalSolver::accGradHessRows(const Cube<Complex>& Res,
+				   const Array<Complex>& dRes,
+				   const Matrix<Bool>& flag, const Int flagChan0,
+				   const Matrix<Float>& wtMat,
+				   const Vector<Bool>& flagRow,
+				   const Vector<Int>& antenna1,
+				   const Vector<Int>& antenna2) {
+
+  IPosition dRip(dRes.shape());
     
-    Bool*  flR = cvb.flagRow().data();
-    Bool*  fl;
-    Float* wt;
-    Int*   a1 = cvb.antenna1().data();
-    Int*   a2 = cvb.antenna2().data();
-    Complex *Rp;
-    Complex *dR0p;
-    Complex *dR1p;
-    DComplex *G1;
-    DComplex *G2;
-    Double *H1;
-    Double *H2;
+  Int nRow(dRip(3));
+  Int nChan(dRip(2));
+  Int nPar(dRip(1));   // pars per antenna
+  Int nCorr(dRip(0));
+  Int nFlagChan(flag.nrow());
+
+  // dR(corr,par,chan,row,ant): the second antenna's derivatives follow
+  //  all of the first antenna's
+  Int nPerRow(nCorr*nPar*nChan);
+  Int dR1offset(nPerRow*nRow);
+
+  Bool delR,deldR,delfl,delwt,delflR,dela1,dela2,delsrc(False);
+  const Complex* Rdata=Res.getStorage(delR);
+  const Complex* dRdata=dRes.getStorage(deldR);
+  const Bool* fldata=flag.getStorage(delfl);
+  const Float* wtdata=wtMat.getStorage(delwt);
+  const Bool* flRdata=flagRow.getStorage(delflR);
+  const Int* a1data=antenna1.getStorage(dela1);
+  const Int* a2data=antenna2.getStorage(dela2);
+
+  // Source derivatives dSrc(corr,chan,row,spar), if solving for them
+  const Bool solvePol(svc().solvePol());
+  const Int nSrc(solvePol ? nSrcPar() : 0);
+  const Int nCal(nCalPar());
+  const Array<Complex>& src(dSrc());
+  const Complex* srcdata(solvePol ? src.getStorage(delsrc) : 0);
+  Int nSrcPerPar(0),nSrcPerRow(0),nSrcCorr(0);
+  if (solvePol) {
+    nSrcCorr=src.shape()(0);
+    nSrcPerRow=nSrcCorr*src.shape()(1);
+    nSrcPerPar=nSrcPerRow*src.shape()(2);
+  }
 
+  const uInt nTot(grad().nelements());
+  Vector<DComplex>& gradTot(grad());
+  Vector<Double>& hessTot(hess());
+
+  // Each thread accumulates its own partial grad and hess over a block of
+  //  rows; the partials are added together in thread order at the end, so
+  //  that the totals do not depend on which thread finishes first
+  Int nth(1);
+#ifdef _OPENMP
+  if (nRow*nPerRow>=vcsMinParallelSamples)
+    nth=omp_get_max_threads();
+#endif
+  Matrix<DComplex> gP(nTot,nth,DComplex(0.0));
+  Matrix<Double> hP(nTot,nth,0.0);
+
+#ifdef _OPENMP
+#pragma omp parallel num_threads(nth)
+#endif
+  {
+    Int ith(0);
+#ifdef _OPENMP
+    ith=omp_get_thread_num();
+#endif
+    DComplex* gdata=gP.data()+ith*nTot;
+    Double* hdata=hP.data()+ith*nTot;
+
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
     for (Int irow=0;irow<nRow;++irow) { 
-      if (!*flR) {
+      if (!flRdata[irow]) {
 	// Register grad, hess for ants in this baseline
-	Int p1((*a1)*nPar);
-	Int p2((*a2)*nPar);
-	G1 = grad().data() + p1;
-	G2 = grad().data() + p2;
-	H1 = hess().data() + p1;
-	H2 = hess().data() + p2;
+	DComplex* G1=gdata+a1data[irow]*nPar;
+	DComplex* G2=gdata+a2data[irow]*nPar;
+	Double* H1=hdata+a1data[irow]*nPar;
+	Double* H2=hdata+a2data[irow]*nPar;
 	// This row's wt(corr), flag(chan)
-	wt = wtMat.array().data(); 
-	fl = flag.array().data();
+	const Float* wt=wtdata+irow*nCorr;
+	const Bool* fl=fldata+irow*nFlagChan+flagChan0;
 	for (Int ich=0;ich<nChan;++ich) {
-	  if (!*fl) { 
-	    
+	  if (!fl[ich]) { 
+
+	    // Register R,dR for this channel, row
+	    const Complex* Rp=Rdata+(irow*nChan+ich)*nCorr;
+	    const Complex* dR0p=dRdata+irow*nPerRow+ich*nPar*nCorr;
+	    const Complex* dR1p=dR0p+dR1offset;
+
 	    // Do source bits, if necessary
-	    if (svc().solvePol()) {
-	      for (Int icorr=0;icorr<nCorr;++icorr) {
-		Float swt=Vector<Float>(wtMat.array())(icorr);
-		
-		for (Int ispar=0;ispar<nSrcPar();++ispar) {
-		  grad()(nCalPar()+ispar) += DComplex((swt)*2.0*real(dSrc()(IPosition(4,icorr,ich,irow,ispar))*
-								     conj(R()(icorr,ich,irow))));
-		  hess()(nCalPar()+ispar) += Double((swt)*2.0*real(dSrc()(IPosition(4,icorr,ich,irow,ispar))*
-								   conj(dSrc()(IPosition(4,icorr,ich,irow,ispar)))));
-		}
+	    for (Int icorr=0;icorr<nCorr;++icorr) {
+	      for (Int ispar=0;ispar<nSrc;++ispar) {
+		const Complex& dS(srcdata[ispar*nSrcPerPar+irow*nSrcPerRow+ich*nSrcCorr+icorr]);
+		gdata[nCal+ispar] += DComplex((wt[icorr])*2.0*real(dS*conj(Rp[icorr])));
+		hdata[nCal+ispar] += Double((wt[icorr])*2.0*real(dS*conj(dS)));
 	      }
 	    }
-	    
-	    // Register R,dR for this channel, row
-	    Rp = Rit.array().data();
-	    dR0p = dR0it.array().data();
-	    dR1p = dR1it.array().data();
-	    
+
 	    for (int ip=0;ip<nPar;++ip) {
-	      
 	      for (Int icorr=0;icorr<nCorr;++icorr) {
-		
-		(*G1) += DComplex( (*wt)*((*Rp)  *conj(*dR0p)) );
-		(*G2) += DComplex( (*wt)*((*dR1p)*conj(*Rp)) );
-		(*H1) +=   Double( (*wt)*real((*dR0p)*conj(*dR0p)) );
-		(*H2) +=   Double( (*wt)*real((*dR1p)*conj(*dR1p)) );
-		
-		//Advance to next corr
-		++wt;
-		++Rp;
+		G1[ip] += DComplex( wt[icorr]*(Rp[icorr]*conj(*dR0p)) );
+		G2[ip] += DComplex( wt[icorr]*((*dR1p)*conj(Rp[icorr])) );
+		H1[ip] +=   Double( wt[icorr]*real((*dR0p)*conj(*dR0p)) );
+		H2[ip] +=   Double( wt[icorr]*real((*dR1p)*conj(*dR1p)) );
+
+		//Advance to next corr (and, after the last, par)
 		++dR0p;++dR1p;
 	      }
-	      // Advance to next par
-	      ++G1; ++G2;
-	      ++H1; ++H2;
-	      // Use same Rp(corr), wt(corr) vectors for each parameter
-	      Rp-=nCorr;
-	      wt-=nCorr;
 	    }
-	    // Accumulate to same grad(par) & hess(par) for each channel
-	    G1-=nPar; G2-=nPar;
-	    H1-=nPar; H2-=nPar;
 	  }
-	  // Advance to next channel
-	  ++fl;
-	  Rit.next();
-	  dR0it.next();
-	  dR1it.next();
 	}
-      } // !*flgR
-      else {
-	// Advance over flagged row
-	for (Int ich=0;ich<nChan;++ich) {
-	  Rit.next();
-	  dR0it.next();
-	  dR1it.next();
-	}
-      }
-      // Advance to next row
-      ++flR;
-      ++a1;++a2;
-      flag.next();
-      wtMat.next();
+      } // !flagRow
     }
-    
-    if (prtlev()>4) {  // grad, hess
-      cout << "      grad= " << grad() << endl;
-      cout << "      hess= " << hess() << endl;
-    }    
 
-  } // ibuf
+  }
+
+  for (Int ith=0;ith<nth;++ith) {
+    gradTot+=gP.column(ith);
+    hessTot+=hP.column(ith);
+  }
+
+  Res.freeStorage(Rdata,delR);
+  dRes.freeStorage(dRdata,deldR);
+  flag.freeStorage(fldata,delfl);
+  wtMat.freeStorage(wtdata,delwt);
+  flagRow.freeStorage(flRdata,delflR);
+  antenna1.freeStorage(a1data,dela1);
+  antenna2.freeStorage(a2data,dela2);
+  if (solvePol) src.freeStorage(srcdata,delsrc);
 }
 
+
 void VisCalSolver::revert() {
 
   if (prtlev()>2) cout << "     VCS::revert()" << endl;
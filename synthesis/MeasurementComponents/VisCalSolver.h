@@ -169,6 +169,17 @@ protected:
   // Internal solving methods
   void accGradHess();
   void accGradHess2();
+
+  // Accumulate chi2 (and sum of weights), or grad and hess, over the rows
+  //  of one buffer, in parallel over blocks of rows; flagChan0 is the
+  //  channel of flag that matches the first channel of Res
+  void chiSquareRows(const Cube<Complex>& Res, const Matrix<Bool>& flag,
+		     const Int flagChan0, const Matrix<Float>& wtMat,
+		     const Vector<Bool>& flagRow);
+  void accGradHessRows(const Cube<Complex>& Res, const Array<Complex>& dRes,
+		       const Matrix<Bool>& flag, const Int flagChan0,
+		       const Matrix<Float>& wtMat, const Vector<Bool>& flagRow,
+		       const Vector<Int>& antenna1, const Vector<Int>& antenna2);
   void revert();
   void solveGradHess();
   void updatePar();
@@ -0,0 +1,333 @@
+//# tCalibratingVi2Cache.cc: check that CalibratingVi2 calibrates the same
+//# from its calibration cache as with VisEquation::correct2
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Containers/Record.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <measures/Measures/MDirection.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <msvis/MSVis/IteratingParameters.h>
+#include <msvis/MSVis/ViFrequencySelection.h>
+#include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <synthesis/CalTables/CLPatchPanel.h>
+#include <synthesis/MeasurementComponents/CalibratingVi2.h>
+#include <synthesis/MeasurementComponents/CalibratingVi2Factory.h>
+#include <synthesis/MeasurementComponents/VisCalGlobals.h>
+#include <vector>
+
+#include <casa/namespace.h>
+using namespace std;
+using namespace casa::vi;
+using namespace casa::vi::test;
+
+namespace {
+
+const Int nAnt = 6;
+const Int nChan = 8;
+
+// A CalibratingVi2Factory that keeps the CalibratingVi2 it makes, so that
+// its cache can be set and its counters read
+class CachingFactory : public CalibratingVi2Factory {
+public:
+  CachingFactory(MeasurementSet* ms, const Record& calrec)
+    : CalibratingVi2Factory(ms, calrec), calVi_p(0) {}
+  CalibratingVi2* calVi() const { return calVi_p; }
+protected:
+  using CalibratingVi2Factory::createVi;
+  virtual ViImplementation2* createVi(VisibilityIterator2* vi) const {
+    ViImplementation2* vii = CalibratingVi2Factory::createVi(vi);
+    calVi_p = dynamic_cast<CalibratingVi2*>(vii);
+    return vii;
+  }
+private:
+  mutable CalibratingVi2* calVi_p;
+};
+
+// Flag about one sample in five
+class GenerateSomeFlags : public Generator<Bool> {
+public:
+  Bool operator()(const FillState &fillState, Int channel, Int correlation) const {
+    return (fillState.rowNumber_p + 2 * channel + correlation) % 5 == 0;
+  }
+};
+
+void makeMs(const String& msName, Bool weightSpectrum)
+{
+  MsFactory msFactory(msName);
+  msFactory.setTimeInfo(0, 6.0, 1.0);
+  msFactory.addAntennas(nAnt);
+  msFactory.addFeeds(nAnt);
+  msFactory.addField("field0", MDirection());
+  msFactory.addSpectralWindow("spw0", nChan, 1.0e9, 1.0e6, "RR RL LR LL");
+  msFactory.addWeightSpectrum(weightSpectrum);
+  msFactory.setDataGenerator(MSMainEnums::FLAG, new GenerateSomeFlags);
+  msFactory.setDataGenerator(MSMainEnums::FLAG_ROW, new GenerateConstant<Bool>(False));
+  msFactory.setDataGenerator(MSMainEnums::SIGMA_SPECTRUM, new GenerateConstant<Float>(0.5));
+  pair<MeasurementSet *, Int> made = msFactory.createMs();
+  made.first->flush();
+  delete made.first;
+}
+
+// Parameters of antenna ant and polarization pol of each table
+Complex gainPar(Int ant, Int pol)
+{
+  const Float phase = (20.0 * ant - 15.0 * pol) * C::pi / 180.0;
+  return Complex(1.0 + 0.1 * ant + 0.05 * pol) * Complex(cos(phase), sin(phase));
+}
+Complex delayPar(Int ant, Int pol)
+{
+  return Complex(2.0 + 3.0 * ant - pol);     // nsec
+}
+Complex leakagePar(Int ant, Int pol)
+{
+  return Complex(0.02 * ant, 0.01 * (pol - ant));
+}
+
+// Write a single-spw table of the given type with the parameters of
+// parFunc, the way Calibrater::specifycal does; the first polarization of
+// antenna flagAnt is flagged
+void makeCalTable(const String& type, const String& calTable, const String& msName,
+		  Complex (*parFunc)(Int, Int), Int flagAnt = -1)
+{
+  SolvableVisCal *svc = createSolvableVisCal(type, msName, nAnt, 1);
+  Record specify;
+  specify.define("caltable", calTable);
+  specify.define("spw", Vector<Int>(1, 0));
+  specify.define("antenna", Vector<Int>());
+  specify.define("pol", String(""));
+  specify.define("caltype", type);
+  svc->setSpecify(specify);
+
+  // setSpecify sets the default parameters; specify then scales the
+  // complex ones by 1, or adds 0 to the real ones, and keeps them
+  IPosition shape = (svc->parType() == VisCalEnum::COMPLEX ?
+		     svc->solveAllCPar().shape() : svc->solveAllRPar().shape());
+  for (Int ant = 0; ant < shape(2); ++ant) {
+    for (Int pol = 0; pol < shape(0); ++pol) {
+      for (Int chan = 0; chan < shape(1); ++chan) {
+	if (svc->parType() == VisCalEnum::COMPLEX) {
+	  svc->solveAllCPar()(pol, chan, ant) = parFunc(ant, pol);
+	} else {
+	  svc->solveAllRPar()(pol, chan, ant) = real(parFunc(ant, pol));
+	}
+	svc->solveAllParOK()(pol, chan, ant) = !(ant == flagAnt && pol == 0);
+      }
+    }
+  }
+  specify.define("parameter", Vector<Double>(1, svc->parType() == VisCalEnum::COMPLEX ? 1.0 : 0.0));
+  svc->specify(specify);
+  svc->storeNCT();
+  delete svc;
+}
+
+void addToCallib(Record& callib, const String& calTable)
+{
+  Record tab;
+  tab.define("calwt", True);
+  tab.defineRecord("0", CalLibSlice("", "", "", "", "linear", "linear").asRecord());
+  callib.defineRecord(calTable, tab);
+}
+
+// The calibrated data, weights and flags of every subchunk of a sweep
+struct Calibrated {
+  std::vector<Cube<Complex> > vis;
+  std::vector<Matrix<Float> > weight;
+  std::vector<Cube<Float> > weightSpectrum;
+  std::vector<Cube<Bool> > flag;
+};
+
+void sweep(VisibilityIterator2& vi, Calibrated& out)
+{
+  out = Calibrated();
+  VisBuffer2 *vb = vi.getVisBuffer();
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next()) {
+      out.vis.push_back(vb->visCubeCorrected().copy());
+      out.weight.push_back(vb->weight().copy());
+      out.weightSpectrum.push_back(vi.weightSpectrumExists() ?
+				   vb->weightSpectrum().copy() : Cube<Float>());
+      out.flag.push_back(vb->flagCube().copy());
+    }
+  }
+}
+
+// The flags and weights must agree, and so must the data that are not
+// flagged (correct2 does not calibrate flagged data)
+void compare(const Calibrated& cached, const Calibrated& plain)
+{
+  AlwaysAssert(cached.vis.size() == plain.vis.size() && plain.vis.size() > 0, AipsError);
+  for (uInt k = 0; k < plain.vis.size(); ++k) {
+    AlwaysAssert(allEQ(cached.flag[k], plain.flag[k]), AipsError);
+    AlwaysAssert(allNear(cached.weight[k], plain.weight[k], 1.0e-5), AipsError);
+    AlwaysAssert(allNear(cached.weightSpectrum[k], plain.weightSpectrum[k], 1.0e-5),
+		 AipsError);
+    const Cube<Bool>& flag = plain.flag[k];
+    for (uInt row = 0; row < flag.shape()(2); ++row) {
+      for (uInt chan = 0; chan < flag.shape()(1); ++chan) {
+	for (uInt corr = 0; corr < flag.shape()(0); ++corr) {
+	  if (!flag(corr, chan, row)) {
+	    AlwaysAssert(near(cached.vis[k](corr, chan, row), plain.vis[k](corr, chan, row),
+			      1.0e-5), AipsError);
+	  }
+	}
+      }
+    }
+  }
+}
+
+// Bytes the cache reserves for one subchunk
+Int64 subchunkBytes(const Calibrated& plain)
+{
+  const Int64 nWt = plain.weightSpectrum[0].nelements() > 0 ?
+    plain.weightSpectrum[0].nelements() : plain.weight[0].nelements();
+  return plain.vis[0].nelements() * (sizeof(Complex) + sizeof(Bool)) + nWt * sizeof(Float);
+}
+
+void checkCounts(const CalibratingVi2* calVi, Int64 hits, Int64 misses)
+{
+  AlwaysAssert(calVi->calCacheHits() == hits && calVi->calCacheMisses() == misses,
+	       AipsError);
+}
+
+// Diagonal terms: misses, hits, selections that only differ in their
+// channel stride, and a cache too small for the data
+void checkDiagonal(const String& msName)
+{
+  makeMs(msName, msName.contains("wtsp"));
+  makeCalTable("G", msName + ".G", msName, gainPar, 2);
+  makeCalTable("K", msName + ".K", msName, delayPar);
+  Record callib;
+  addToCallib(callib, msName + ".G");
+  addToCallib(callib, msName + ".K");
+
+  MeasurementSet ms(msName, Table::Update);
+  CachingFactory plainFactory(&ms, callib);
+  VisibilityIterator2 plainVi(plainFactory);
+  AlwaysAssert(plainFactory.calVi() != 0, AipsError);
+  plainFactory.calVi()->setCalCache(0);
+  CachingFactory cachedFactory(&ms, callib);
+  VisibilityIterator2 cachedVi(cachedFactory);
+  CalibratingVi2 *calVi = cachedFactory.calVi();
+  AlwaysAssert(calVi != 0, AipsError);
+  calVi->setCalCache(Int64(64) * 1024 * 1024);
+
+  Calibrated plain, cached;
+  sweep(plainVi, plain);
+  const Int64 nSub = plain.vis.size();
+  checkCounts(plainFactory.calVi(), 0, 0);
+
+  sweep(cachedVi, cached);
+  checkCounts(calVi, 0, nSub);
+  compare(cached, plain);
+  sweep(cachedVi, cached);
+  checkCounts(calVi, nSub, nSub);
+  compare(cached, plain);
+
+  // Four channels from channel 0, contiguous and then every other one:
+  // the delay makes their calibration differ
+  for (Int increment = 1; increment <= 2; ++increment) {
+    FrequencySelectionUsingChannels selection;
+    selection.add(0, 0, 4, increment);
+    plainVi.setFrequencySelection(selection);
+    cachedVi.setFrequencySelection(selection);
+    sweep(plainVi, plain);
+    sweep(cachedVi, cached);
+    checkCounts(calVi, nSub, (1 + increment) * nSub);
+    compare(cached, plain);
+  }
+  FrequencySelectionUsingChannels all;
+  all.add(0, 0, nChan, 1);
+  plainVi.setFrequencySelection(all);
+  cachedVi.setFrequencySelection(all);
+  sweep(plainVi, plain);
+
+  // A cache that holds half the subchunks keeps them: the second sweep
+  // finds the first half, and calibrates the rest with correct2
+  calVi->setCalCache((nSub / 2) * subchunkBytes(plain));
+  const Int64 hits = calVi->calCacheHits();
+  const Int64 misses = calVi->calCacheMisses();
+  sweep(cachedVi, cached);
+  checkCounts(calVi, hits, misses + nSub);
+  compare(cached, plain);
+  sweep(cachedVi, cached);
+  checkCounts(calVi, hits + nSub / 2, misses + 2 * nSub - nSub / 2);
+  compare(cached, plain);
+}
+
+// A non-diagonal term (leakage) keeps the cache out of the way
+void checkNonDiagonal(const String& msName)
+{
+  makeMs(msName, True);
+  makeCalTable("G", msName + ".G", msName, gainPar, 2);
+  makeCalTable("D", msName + ".D", msName, leakagePar);
+  Record callib;
+  addToCallib(callib, msName + ".G");
+  addToCallib(callib, msName + ".D");
+
+  MeasurementSet ms(msName, Table::Update);
+  CachingFactory plainFactory(&ms, callib);
+  VisibilityIterator2 plainVi(plainFactory);
+  plainFactory.calVi()->setCalCache(0);
+  CachingFactory cachedFactory(&ms, callib);
+  VisibilityIterator2 cachedVi(cachedFactory);
+  CalibratingVi2 *calVi = cachedFactory.calVi();
+  calVi->setCalCache(Int64(64) * 1024 * 1024);
+
+  Calibrated plain, cached;
+  sweep(plainVi, plain);
+  sweep(cachedVi, cached);
+  sweep(cachedVi, cached);
+  checkCounts(calVi, 0, 0);
+  compare(cached, plain);
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    checkDiagonal("tCalibratingVi2Cache_wtsp.ms");
+    checkDiagonal("tCalibratingVi2Cache_wt.ms");
+    checkNonDiagonal("tCalibratingVi2Cache_leak.ms");
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -32,7 +32,9 @@
 #include <casa/Arrays/Matrix.h>
 #include <casa/Arrays/ArrayMath.h>
 #include <casa/Arrays/MatrixMath.h>
+#include <casa/Arrays/ArrayLogical.h>
 #include <casa/OS/HostInfo.h>
+#include <casa/System/AipsrcValue.h>
 #include <casa/System/ProgressMeter.h>
 #include <casa/Utilities/CountedPtr.h>
 
@@ -1687,66 +1689,124 @@ CubeSkyEquation::finalizeGetSlice(){
     }
 }
 
-Bool
-CubeSkyEquation::getFreqRange(ROVisibilityIterator& vi,
-                              const CoordinateSystem& coords,
-                              Int slice, Int nslice){
-  //bypass this for now
-  return False;
-    // Enforce that all SPWs are in the same frequency frame.
-    //
-    // If all the SPWs in the MS are in LSRK frame, we can do data
-    // selection (since image is always in LSRK).
-    //
-    // If not all SPWs in the MS are in the same frequency frame and
-    // in LSRK frame, for now, disable data selection since the
-    // mapping between image (in LSRK) and MS channels will be time
-    // variable.
-    VisBufferAutoPtr vb (vi);
-    ROScalarMeasColumn<MFrequency> freqFrame=vb->msColumns().spectralWindow().refFrequencyMeas();
-    uInt nrows=vb->msColumns().spectralWindow().nrow();
-    String firstString = freqFrame(0).getRefString();
-    Bool allFramesSame=True;
-    for (uInt i=0;i<nrows;i++)
-        if (freqFrame(i).getRefString() != firstString)
-        {allFramesSame = False;break;}
-
-    if (!allFramesSame || (firstString!="LSRK"))
-        return False;
-
-    // Only one slice lets keep what the user selected
-    if(nslice==1)
-        return False;
-
-    Double start=0.0; 
-    Double end=0.0;
-    Double chanwidth=1.0;
+MFrequency::Types
+CubeSkyEquation::sliceFreqRange(Double& start, Double& end, Double& chanwidth,
+                                const CoordinateSystem& coords,
+                                Int slice, Int nchanPerSlice){
+    start=0.0;
+    end=0.0;
+    chanwidth=1.0;
     Int specIndex=coords.findCoordinate(Coordinate::SPECTRAL);
     SpectralCoordinate specCoord=coords.spectralCoordinate(specIndex);
-    Vector<Int>spectralPixelAxis=coords.pixelAxes(specIndex);
-    if(nchanPerSlice_p>0){
-        specCoord.toWorld(start,Double(slice*nchanPerSlice_p)-0.5);
-        specCoord.toWorld(end, Double(nchanPerSlice_p*(slice+1))+0.5);
-        chanwidth=fabs(end-start)/Double(nchanPerSlice_p);
+    if(nchanPerSlice>0){
+        specCoord.toWorld(start,Double(slice*nchanPerSlice)-0.5);
+        specCoord.toWorld(end, Double(nchanPerSlice*(slice+1))+0.5);
+        chanwidth=fabs(end-start)/Double(nchanPerSlice);
     }
     if(end < start){
         Double tempoo=start;
         start=end;
         end=tempoo;
     }
+    return specCoord.frequencySystem();
+}
+
+Bool
+CubeSkyEquation::getFreqRange(ROVisibilityIterator& vi,
+                              const CoordinateSystem& coords,
+                              Int slice, Int nslice){
+    // Only one slice lets keep what the user selected
+    if(nslice==1)
+        return False;
+
+    // Restricting the iterator to the channels of each slice means the data
+    // are read about once per major cycle instead of once per slice.  It can
+    // be switched off in the rc file.
+    Bool doSelect=True;
+    AipsrcValue<Bool>::find(doSelect, "CubeSkyEquation.slicechannelselection", True);
+    if(!doSelect)
+        return False;
+
+    // getSpwInFreqRange converts the range from the frame of the image to
+    // the frame of each spw over all the times in the MS and keeps the widest
+    // channel range, so data in other frames are still fully covered.
+    Double start, end, chanwidth;
+    MFrequency::Types freqFrame=sliceFreqRange(start, end, chanwidth, coords,
+                                               slice, nchanPerSlice_p);
 
     Block<Vector<Int> > spwb;
     Block<Vector<Int> > startb;
     Block<Vector<Int> > nchanb;
-    Block<Vector<Int> > incrb=blockChanInc_p;
-    vi.getSpwInFreqRange(spwb, startb, nchanb, start, end, chanwidth);
-    if(spwb.nelements()==0)
-        return False;
+    vi.getSpwInFreqRange(spwb, startb, nchanb, start, end, chanwidth, freqFrame);
+    if(spwb.nelements()==0 || spwb.nelements() > blockSpw_p.nelements()){
+        // Read everything the user selected, whatever an earlier slice chose
+        vi.selectChannel(blockNumChanGroup_p, blockChanStart_p,
+                         blockChanWidth_p, blockChanInc_p, blockSpw_p);
+        return True;
+    }
+
+    // Stay within what the user selected.  Spws with several channel groups
+    // or an increment are kept as selected.
+    uInt nms=spwb.nelements();
+    Block<Vector<Int> > ngroupb(nms), incrb(nms);
+    for (uInt ms=0; ms < nms; ++ms){
+        Bool userSel= (blockSpw_p[ms].nelements() > 0) && !anyLT(blockSpw_p[ms], 0);
+        Vector<Int> spw, ngroup, chanStart, width, incr;
+        for (uInt k=0; k < spwb[ms].nelements(); ++k){
+            Int first=startb[ms][k];
+            Int nchan=nchanb[ms][k];
+            Int ngr=1;
+            Int inc=1;
+            Bool found=False;
+            for (uInt u=0; userSel && u < blockSpw_p[ms].nelements(); ++u){
+                if(blockSpw_p[ms][u] != spwb[ms][k])
+                    continue;
+                found=True;
+                if(blockNumChanGroup_p[ms][u]==1 && blockChanInc_p[ms][u]==1){
+                    Int last=min(first+nchan, blockChanStart_p[ms][u]+blockChanWidth_p[ms][u]);
+                    first=max(first, blockChanStart_p[ms][u]);
+                    nchan=last-first;
+                }
+                else{
+                    first=blockChanStart_p[ms][u];
+                    nchan=blockChanWidth_p[ms][u];
+                    ngr=blockNumChanGroup_p[ms][u];
+                    inc=blockChanInc_p[ms][u];
+                }
+            }
+            if((userSel && !found) || nchan < 1)
+                continue;
+            uInt n=spw.nelements();
+            spw.resize(n+1, True);
+            ngroup.resize(n+1, True);
+            chanStart.resize(n+1, True);
+            width.resize(n+1, True);
+            incr.resize(n+1, True);
+            spw[n]=spwb[ms][k];
+            ngroup[n]=ngr;
+            chanStart[n]=first;
+            width[n]=nchan;
+            incr[n]=inc;
+        }
+        // The iterator cannot take an empty selection for an MS, so one
+        // that does not contribute to this slice gets a single channel of its
+        // first selected spw.  That channel is outside the slice, so the
+        // gridders drop it, and the MS costs one channel instead of all.
+        if(spw.nelements()==0){
+            spw=Vector<Int>(1, userSel ? blockSpw_p[ms][0] : 0);
+            ngroup=Vector<Int>(1, 1);
+            chanStart=Vector<Int>(1, userSel ? blockChanStart_p[ms][0] : 0);
+            width=Vector<Int>(1, 1);
+            incr=Vector<Int>(1, 1);
+        }
+        spwb[ms].reference(spw);
+        ngroupb[ms].reference(ngroup);
+        startb[ms].reference(chanStart);
+        nchanb[ms].reference(width);
+        incrb[ms].reference(incr);
+    }
 
-    //cerr << "Original is " << blockChanStart_p[0] <<  "   " << blockChanWidth_p[0] << "  " <<  blockChanInc_p[0] << "   " 
-    //	 <<  blockSpw_p[0] << endl;
-    //vi.selectChannel(1, startb[0][0], nchanb[0][0], 1, spwb[0][0]); 
-    vi.selectChannel(blockNumChanGroup_p, startb, nchanb, incrb, spwb); 
+    vi.selectChannel(ngroupb, startb, nchanb, incrb, spwb); 
 
     return True;
 
@@ -27,6 +27,7 @@
 #ifndef SYNTHESIS_CUBESKYEQUATION_H
 #define SYNTHESIS_CUBESKYEQUATION_H
 
+#include <measures/Measures/MFrequency.h>
 #include <synthesis/MeasurementEquations/SkyEquation.h>
 //#include <synthesis/Utilities/ThreadTimers.h>
 
@@ -93,6 +94,15 @@ class CubeSkyEquation : public SkyEquation {
 
   Bool isNewFTM();
 
+  // The frequency range of channels [slice*nchanPerSlice,
+  // (slice+1)*nchanPerSlice) of the image with coordinates coords, with
+  // half a channel margin, and the channel width.  Returns the frame of
+  // the range, i.e. that of the spectral axis of the image.
+  static MFrequency::Types sliceFreqRange(Double& start, Double& end,
+                                          Double& chanwidth,
+                                          const CoordinateSystem& coords,
+                                          Int slice, Int nchanPerSlice);
+
  protected:
 
   void configureAsyncIo (ROVisibilityIterator * & oldRvi, VisibilityIterator * & oldWvi);
@@ -111,7 +121,9 @@ class CubeSkyEquation : public SkyEquation {
   // 1 => a subImage referencing cImage ...no image copy
   void sliceCube(CountedPtr<ImageInterface<Complex> >& slice,Int model, Int cubeSlice, Int nCubeSlice, Int typeOfCopy=0); 
   void sliceCube(SubImage<Float>*& slice,ImageInterface<Float>& image, Int cubeSlice, Int nCubeSlice);
-  //frequency range from image
+  // Select in vi only the channels that fall in cube slice slice of the
+  // image (intersected with the original channel selection).  Returns True
+  // if the iterator selection was changed.
   Bool getFreqRange(ROVisibilityIterator& vi, const CoordinateSystem& coords,
 		  Int slice, Int nslice);
 
@@ -31,6 +31,7 @@
 #include <casa/OS/HostInfo.h>
 
 #include <casa/Arrays/Matrix.h>
+#include <casa/Containers/Block.h>
 #include <casa/Arrays/ArrayMath.h>
 #include <casa/Arrays/ArrayLogical.h>
 #include <casa/Arrays/IPosition.h>
@@ -52,6 +53,8 @@
 #include <synthesis/TransformMachines/PBMath.h>
 #include <lattices/LEL/LatticeExpr.h> 
 #include <lattices/LatticeMath/LatticeFFT.h>
+#include <lattices/Lattices/LatticeStepper.h>
+#include <scimath/Mathematics/FFTServer.h>
 #include <coordinates/Coordinates/CoordinateSystem.h>
 #include <coordinates/Coordinates/DirectionCoordinate.h>
 #include <coordinates/Coordinates/SpectralCoordinate.h>
@@ -64,6 +67,9 @@
 #include <casadbus/session/DBusSession.h>
 
 #include <components/ComponentModels/GaussianDeconvolver.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
@@ -74,6 +80,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     lowImOrig_p=NULL;
     cwImage_p=NULL;
     cwHighIm_p=NULL;
+    ftLowIm_p=NULL;
+    ftHighIm_p=NULL;
   }
   Feather::Feather(const ImageInterface<Float>& SDImage, const ImageInterface<Float>& INTImage, Float sdscale) : dishDiam_p(-1.0), cweightCalced_p(False), cweightApplied_p(False), sdScale_p(sdscale){
     
@@ -155,6 +163,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       lowImOrig_p->copyData(*lowIm_p);
       lBeamOrig_p=lBeam_p;
     }   
+    ftLowIm_p=NULL;
     cweightCalced_p=False;
   }
 
@@ -180,6 +189,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     hBeam_p=newHighBeam; 
 
     //need to  redo feather  application
+    ftHighIm_p=NULL;
     cweightApplied_p=False;
   }
 
@@ -227,6 +237,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       Imager::copyMask(*highIm_p, *intcopy, maskname);
 
     }
+    ftHighIm_p=NULL;
     cweightCalced_p=False;
 
   }
@@ -258,6 +269,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       throw(AipsError("Could not convolve SD image for some reason; try a smaller effective diameter may be"));
     }
     lBeam_p=newBeam; 
+    ftLowIm_p=NULL;
     //reset cweight if it was calculated already
     cweightCalced_p=False;
     cweightApplied_p=False;
@@ -287,10 +299,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       return getRadialCut(ux, xamp, *lowIm_p);
     }
     
-    TempImage<Complex> cimagelow(lowIm_p->shape(), lowIm_p->coordinates() );
-    StokesImageUtil::From(cimagelow, *lowIm_p);
-    LatticeFFT::cfft2d( cimagelow );
-    getCutXY(ux, xamp, uy, yamp, cimagelow);
+    calcFTLowImage();
+    getCutXY(ux, xamp, uy, yamp, *ftLowIm_p);
     
   }
   void Feather::getFTCutIntImage(Vector<Float>& ux, Vector<Float>& xamp, Vector<Float>& uy, Vector<Float>& yamp, const Bool radial){
@@ -299,10 +309,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
       yamp.resize();
       return getRadialCut(ux, xamp, *highIm_p);
     }
-    TempImage<Complex> cimagehigh(highIm_p->shape(), highIm_p->coordinates() );
-    StokesImageUtil::From(cimagehigh, *highIm_p);
-    LatticeFFT::cfft2d( cimagehigh );
-    getCutXY(ux, xamp, uy, yamp, cimagehigh);
+    calcFTHighImage();
+    getCutXY(ux, xamp, uy, yamp, *ftHighIm_p);
 
   }
   void Feather::getFeatherINT(Vector<Float>& ux, Vector<Float>& xamp, Vector<Float>& uy, Vector<Float>& yamp, Bool radial){
@@ -377,9 +385,9 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     calcCWeightImage();
     if(highIm_p.null())
       throw(AipsError("No high resolution image set"));
+    calcFTHighImage();
     cwHighIm_p=new TempImage<Complex>(highIm_p->shape(), highIm_p->coordinates() );
-    StokesImageUtil::From(*cwHighIm_p, *highIm_p);
-    LatticeFFT::cfft2d( *cwHighIm_p );
+    cwHighIm_p->copyData(*ftHighIm_p);
     Vector<Int> extraAxes(cwHighIm_p->shape().nelements()-2);
     if(extraAxes.nelements() > 0){
       
@@ -441,6 +449,95 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     cweightApplied_p=False;
   }
 
+  void Feather::calcFTLowImage(){
+    if(!ftLowIm_p.null())
+      return;
+    if(lowIm_p.null())
+      throw(AipsError("No Single dish image was defined"));
+    ftLowIm_p=new TempImage<Complex>(lowIm_p->shape(), lowIm_p->coordinates());
+    StokesImageUtil::From(*ftLowIm_p, *lowIm_p);
+    fftPlanes(*ftLowIm_p);
+  }
+
+  void Feather::calcFTHighImage(){
+    if(!ftHighIm_p.null())
+      return;
+    if(highIm_p.null())
+      throw(AipsError("No Interferometer image was defined"));
+    ftHighIm_p=new TempImage<Complex>(highIm_p->shape(), highIm_p->coordinates());
+    StokesImageUtil::From(*ftHighIm_p, *highIm_p);
+    fftPlanes(*ftHighIm_p);
+  }
+
+  IPosition Feather::planesChunkShape(const IPosition& imshape){
+    //whole planes, up to about 128 MB of Complex at a time
+    IPosition chunk(imshape.nelements(), 1);
+    chunk(0)=imshape(0);
+    chunk(1)=imshape(1);
+    Int64 nplanes=max(Int64(1), Int64(16777216)/(Int64(imshape(0))*imshape(1)));
+    for (uInt k=2; k < imshape.nelements(); ++k){
+      chunk(k)=min(Int64(imshape(k)), nplanes);
+      nplanes /= chunk(k);
+    }
+    return chunk;
+  }
+
+  void Feather::fftPlanes(Array<Complex>& planes, const Bool toFrequency){
+    const IPosition planeShape(2, planes.shape()(0), planes.shape()(1));
+    const Int64 npix=planeShape.product();
+    const Int nplanes=planes.nelements()/npix;
+    Int nth=1;
+#ifdef _OPENMP
+    if(nplanes > 1)
+      nth=min(nplanes, omp_get_max_threads());
+#endif
+    //FFTServer keeps its plan and work space, so each thread has its own.
+    //They are made and planned in both directions here, serially, since
+    //making FFT plans is not thread safe.
+    Block<CountedPtr<FFTServer<Float,Complex> > > servers(nth);
+    for (Int t=0; t < nth; ++t){
+      servers[t]=new FFTServer<Float,Complex>(planeShape, FFTEnums::COMPLEX);
+      Matrix<Complex> warm(planeShape, Complex(0.0));
+      servers[t]->fft(warm, True);
+      servers[t]->fft(warm, False);
+    }
+    Bool del;
+    Complex* data=planes.getStorage(del);
+    String errMsg("");
+#pragma omp parallel num_threads(nth)
+    {
+      Int t=0;
+#ifdef _OPENMP
+      t=omp_get_thread_num();
+#endif
+      FFTServer<Float,Complex>& ffts=*servers[t];
+#pragma omp for schedule(dynamic)
+      for (Int k=0; k < nplanes; ++k){
+	try{
+	  Matrix<Complex> plane(planeShape, data+k*npix, SHARE);
+	  ffts.fft(plane, toFrequency);
+	}
+	catch(const AipsError& x){
+#pragma omp critical(featherFFTPlanes)
+	  errMsg=x.getMesg();
+	}
+      }
+    }
+    planes.putStorage(data, del);
+    if(errMsg != "")
+      throw(AipsError("Error in FFT of image planes: "+errMsg));
+  }
+
+  void Feather::fftPlanes(ImageInterface<Complex>& cimage, const Bool toFrequency){
+    const IPosition imshape=cimage.shape();
+    LatticeStepper ls(imshape, planesChunkShape(imshape), LatticeStepper::RESIZE);
+    for (ls.reset(); !ls.atEnd(); ls++){
+      Array<Complex> planes=cimage.getSlice(ls.position(), ls.cursorShape());
+      fftPlanes(planes, toFrequency);
+      cimage.putSlice(planes, ls.position());
+    }
+  }
+
   void Feather::getCutXY(Vector<Float>& ux, Vector<Float>& xamp, 
 			 Vector<Float>& uy, Vector<Float>& yamp, 
 			 const ImageInterface<Float>& image){
@@ -675,39 +772,44 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 	
 
   Bool Feather::saveFeatheredImage(const String& imagename){
-    applyFeather();
-    Int stokesAxis, spectralAxis;
-    spectralAxis=CoordinateUtil::findSpectralAxis(csysHigh_p);
-    Vector<Stokes::StokesTypes> stokesvec;
-    stokesAxis=CoordinateUtil::findStokesAxis(stokesvec, csysHigh_p);
+    calcCWeightImage();
+    calcFTHighImage();
+    calcFTLowImage();
     Vector<Int> dirAxes=CoordinateUtil::findDirectionAxes(csysHigh_p);
-    Int n3=highIm_p->shape()(stokesAxis);
-    Int n4=highIm_p->shape()(spectralAxis);
-    IPosition blc(highIm_p->shape());
-    IPosition trc(highIm_p->shape());
-    blc(dirAxes(0))=0; blc(dirAxes(1))=0;
-    trc(dirAxes(0))=highIm_p->shape()(dirAxes(0))-1;
-    trc(dirAxes(1))=highIm_p->shape()(dirAxes(1))-1;
-    TempImage<Complex>cimagelow(lowIm_p->shape(), lowIm_p->coordinates());
-    StokesImageUtil::From(cimagelow, *lowIm_p);
-    LatticeFFT::cfft2d( cimagelow);
+    if(dirAxes(0) != 0 || dirAxes(1) != 1)
+      throw(AipsError("The direction axes have to be the first two axes of the image"));
+    const IPosition imshape=highIm_p->shape();
+    const Int64 npix=Int64(imshape(0))*imshape(1);
     Float sdScaling  = sdScale_p*hBeam_p.getArea("arcsec2")/lBeam_p.getArea("arcsec2");
-    for (Int j=0; j < n3; ++j){
-      for (Int k=0; k < n4 ; ++k){
-	blc(stokesAxis)=j; trc(stokesAxis)=j;
-	blc(spectralAxis)=k; trc(spectralAxis)=k;
-	Slicer sl(blc, trc, Slicer::endIsLast);
-	SubImage<Complex> cimagehighSub(*cwHighIm_p, sl, True);
-	SubImage<Complex> cimagelowSub(cimagelow, sl, True);
-	cimagelowSub.copyData(  (LatticeExpr<Complex>)((cimagehighSub + cimagelowSub * sdScaling)));
+    Array<Complex> cweight=cwImage_p->get(True);
+    Bool delW;
+    const Complex* w=cweight.getStorage(delW);
+    PagedImage<Float> featherImage(imshape, highIm_p->coordinates(), imagename );
+    // Combine the cached transforms in the uv-plane, FT back to image plane
+    // and write a chunk of planes at a time.  Both transforms are in the
+    // Stokes representation of the INT image so the real part is the result.
+    LatticeStepper ls(imshape, planesChunkShape(imshape), LatticeStepper::RESIZE);
+    for (ls.reset(); !ls.atEnd(); ls++){
+      Array<Complex> planes=ftHighIm_p->getSlice(ls.position(), ls.cursorShape());
+      Array<Complex> lowPlanes=ftLowIm_p->getSlice(ls.position(), ls.cursorShape());
+      const Int nplanes=planes.nelements()/npix;
+      Bool delH, delL;
+      Complex* h=planes.getStorage(delH);
+      const Complex* l=lowPlanes.getStorage(delL);
+#pragma omp parallel for if(nplanes > 1)
+      for (Int k=0; k < nplanes; ++k){
+	Complex* hk=h+k*npix;
+	const Complex* lk=l+k*npix;
+	for (Int64 i=0; i < npix; ++i)
+	  hk[i]=hk[i]*w[i]+lk[i]*sdScaling;
       }
+      planes.putStorage(h, delH);
+      lowPlanes.freeStorage(l, delL);
+      fftPlanes(planes, False);
+      featherImage.putSlice(real(planes), ls.position());
     }
-    // FT back to image plane
-    LatticeFFT::cfft2d( cimagelow, False);
+    cweight.freeStorage(w, delW);
     
-    // write to output image
-    PagedImage<Float> featherImage(highIm_p->shape(), highIm_p->coordinates(), imagename );
-    StokesImageUtil::To(featherImage, cimagelow);
     ImageUtilities::copyMiscellaneous(featherImage, *highIm_p);
     String maskofHigh=highIm_p->getDefaultMask();
     String maskofLow=lowIm_p->getDefaultMask();
@@ -38,6 +38,7 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   //Forward declaration
   template<class T> class ImageInterface;
   template<class T> class Vector;
+  template<class T> class Array;
   // <summary> Class that contains functions needed for feathering</summary>
 
   class Feather{
@@ -111,13 +112,26 @@ namespace casa { //# NAMESPACE CASA - BEGIN
     CountedPtr<ImageInterface<Float> > highIm_p;
     CountedPtr<ImageInterface<Complex> > cwImage_p;
     CountedPtr<ImageInterface<Complex> > cwHighIm_p;
+    //Fourier transforms of the SD and INT images; kept until the image
+    //they come from changes so that changing the feathering parameters only
+    //redoes the weighting and the inverse transform
+    CountedPtr<ImageInterface<Complex> > ftLowIm_p;
+    CountedPtr<ImageInterface<Complex> > ftHighIm_p;
     static void getCutXY(Vector<Float>& ux, Vector<Float>& xamp, 
 		  Vector<Float>& uy, Vector<Float>& yamp, ImageInterface<Complex>& ftimage);
     static void getRadialCut(Vector<Float>& radialAmp, ImageInterface<Complex>& ftimage);
     //calculate the complex weight image to apply on the interf image
     static void getLowBeam(const ImageInterface<Float>& low0, const String& lowPSF, const Bool useDefaultPB, const String& vpTableStr, GaussianBeam& lBeam);
     void calcCWeightImage();
+    void calcFTLowImage();
+    void calcFTHighImage();
     void applyFeather();
+    //2-D FFT of the planes along the first two axes, done in parallel with
+    //one FFTServer per thread
+    static void fftPlanes(Array<Complex>& planes, const Bool toFrequency=True);
+    static void fftPlanes(ImageInterface<Complex>& cimage, const Bool toFrequency=True);
+    //shape of a chunk of whole planes of an image of shape imshape 
+    static IPosition planesChunkShape(const IPosition& imshape);
     static void getRadialUVval(const Int npix, const IPosition& imshape, const CoordinateSystem& csys, Vector<Float>& radius);
     GaussianBeam hBeam_p;
     GaussianBeam lBeam_p;
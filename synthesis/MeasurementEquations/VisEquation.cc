@@ -241,6 +241,37 @@ void VisEquation::correct2(vi::VisBuffer2& vb, Bool trial, Bool doWtSp) {
 
 }
 
+//----------------------------------------------------------------------
+// Report if all apply terms are scalar or diagonal, multiplicative terms
+Bool VisEquation::diagonalApply() {
+
+  if (napp_==0) return False;
+
+  for (Int iapp=0;iapp<napp_;iapp++) {
+    VisCal *term=vc()[iapp];
+    switch (term->matrixType()) {
+    case VisCalEnum::JONES: {
+      VisJones *vj=dynamic_cast<VisJones*>(term);
+      if (!vj || (vj->jonesType()!=Jones::Scalar && vj->jonesType()!=Jones::Diagonal))
+	return False;
+      break;
+    }
+    case VisCalEnum::MUELLER: {
+      // (AddDiag types are additive)
+      VisMueller *vm=dynamic_cast<VisMueller*>(term);
+      if (!vm || (vm->muellerType()!=Mueller::Scalar &&
+		  vm->muellerType()!=Mueller::Diag2 &&
+		  vm->muellerType()!=Mueller::Diagonal))
+	return False;
+      break;
+    }
+    default:
+      return False;
+    }
+  }
+  return True;
+}
+
 //----------------------------------------------------------------------
 // Report action record info (derived from consituent VisCals
 Record VisEquation::actionRec() {
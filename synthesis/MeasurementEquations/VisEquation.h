@@ -129,6 +129,11 @@ public:
   void correct(VisBuffer& vb, Bool trial=False);
   void correct2(vi::VisBuffer2& vb, Bool trial=False, Bool doWtSp=False);
 
+  // Report if every applied term is a scalar or diagonal, multiplicative
+  //  correction, i.e., if correct2 scales each visibility and weight by
+  //  factors that do not depend on the data
+  Bool diagonalApply();
+
   // Report flag-by-cal statistics
   Record actionRec();
 
@@ -0,0 +1,143 @@
+//# tCubeSkyEquation.cc: test the channel selection of CubeSkyEquation slices
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Vector.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Containers/Block.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <casa/Utilities/GenSort.h>
+#include <coordinates/Coordinates/CoordinateSystem.h>
+#include <coordinates/Coordinates/SpectralCoordinate.h>
+#include <measures/Measures/MeasTable.h>
+#include <measures/Measures/MFrequency.h>
+#include <measures/Measures/MeasConvert.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <ms/MeasurementSets/MSColumns.h>
+#include <msvis/MSVis/VisibilityIterator.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <synthesis/MeasurementEquations/CubeSkyEquation.h>
+
+#include <casa/namespace.h>
+using namespace casa::vi::test;
+
+int main()
+{
+  try {
+    const String msName("tCubeSkyEquation.ms");
+    const Double f0 = 1.0e9;
+    const Double df = 10.0e3;
+    const Int nMsChan = 400;
+    {
+      // Ten minutes of TOPO data in 2010
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(4.8e9, 4.8e9 + 600.0, 60.0);
+      msFactory.addAntennas(4);
+      msFactory.addFeeds(4);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", nMsChan, f0, df, "RR LL");
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+    MeasurementSet ms(msName);
+    ROMSColumns msc(ms);
+
+    // The BARY frequency of every channel at every time, converted the way
+    // the iterator does it
+    const Vector<Double> topoFreq = msc.spectralWindow().chanFreq()(0);
+    Vector<Double> times = msc.time().getColumn();
+    const uInt nTimes = GenSort<Double>::sort(times, Sort::Ascending,
+					      Sort::QuickSort | Sort::NoDuplicates);
+    MPosition obsPos;
+    const String observatory = msc.observation().telescopeName()(0);
+    if (observatory.length() == 0 || !MeasTable::Observatory(obsPos, observatory)) {
+      obsPos = msc.antenna().positionMeas()(0);
+    }
+    MEpoch epoch = msc.timeMeas()(0);
+    MeasFrame frame(epoch, obsPos, msc.field().phaseDirMeas(0));
+    MFrequency::Convert toBary(MFrequency::TOPO,
+			       MFrequency::Ref(MFrequency::BARY, frame));
+    Vector<Double> baryMin(nMsChan, C::dbl_max), baryMax(nMsChan, 0.0);
+    for (uInt t = 0; t < nTimes; ++t) {
+      frame.resetEpoch(MVEpoch(Quantity(times[t], "s")));
+      for (Int chan = 0; chan < nMsChan; ++chan) {
+	const Double f = toBary(topoFreq[chan]).getValue().getValue();
+	baryMin[chan] = min(baryMin[chan], f);
+	baryMax[chan] = max(baryMax[chan], f);
+      }
+    }
+
+    // A BARY cube of 64 channels inside the spw, in slices of 16 channels
+    const Int nImChan = 64;
+    const Int nchanPerSlice = 16;
+    CoordinateSystem coords;
+    coords.addCoordinate(SpectralCoordinate(MFrequency::BARY,
+					    topoFreq[nMsChan/2 - nImChan/2],
+					    df, 0.0, f0));
+
+    ROVisibilityIterator vi(ms, Block<Int>());
+    for (Int slice = 0; slice < nImChan/nchanPerSlice; ++slice) {
+      Double start, end, chanwidth;
+      const MFrequency::Types freqFrame =
+	CubeSkyEquation::sliceFreqRange(start, end, chanwidth, coords, slice,
+					nchanPerSlice);
+      AlwaysAssert(freqFrame == MFrequency::BARY, AipsError);
+      AlwaysAssert(near(chanwidth, df*(nchanPerSlice + 1)/nchanPerSlice, 1e-9),
+		   AipsError);
+
+      Block<Vector<Int> > spwb, startb, nchanb;
+      vi.getSpwInFreqRange(spwb, startb, nchanb, start, end, chanwidth, freqFrame);
+      AlwaysAssert(spwb.nelements() == 1 && spwb[0].nelements() == 1, AipsError);
+      const Int first = startb[0][0];
+      const Int last = first + nchanb[0][0] - 1;
+
+      // Every channel that falls well inside the slice at some time is
+      // selected, and no channel that is always more than two channels away
+      // from it.  Passing the wrong frame would shift the selection by the
+      // velocity difference of the frames, several channels here.
+      for (Int chan = 0; chan < nMsChan; ++chan) {
+	if (baryMax[chan] >= start + df && baryMin[chan] <= end - df) {
+	  AlwaysAssert(chan >= first && chan <= last, AipsError);
+	}
+	if (baryMin[chan] > end + 2*df || baryMax[chan] < start - 2*df) {
+	  AlwaysAssert(chan < first || chan > last, AipsError);
+	}
+      }
+    }
+  } catch (AipsError x) {
+    cout << "Caught exception: " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
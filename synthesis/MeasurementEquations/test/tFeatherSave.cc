@@ -0,0 +1,209 @@
+//# tFeatherSave.cc: compare Feather::saveFeatheredImage with the plane by
+//# plane LatticeFFT feathering it replaced
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/IPosition.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/Arrays/Vector.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Quanta/Quantum.h>
+#include <casa/Utilities/Assert.h>
+#include <coordinates/Coordinates/CoordinateSystem.h>
+#include <coordinates/Coordinates/CoordinateUtil.h>
+#include <coordinates/Coordinates/DirectionCoordinate.h>
+#include <coordinates/Coordinates/Projection.h>
+#include <coordinates/Coordinates/SpectralCoordinate.h>
+#include <coordinates/Coordinates/StokesCoordinate.h>
+#include <images/Images/ImageInfo.h>
+#include <images/Images/ImageRegrid.h>
+#include <images/Images/PagedImage.h>
+#include <images/Images/TempImage.h>
+#include <lattices/LEL/LatticeExpr.h>
+#include <lattices/LEL/LatticeExprNode.h>
+#include <lattices/LatticeMath/LatticeFFT.h>
+#include <scimath/Mathematics/GaussianBeam.h>
+#include <scimath/Mathematics/Interpolate2D.h>
+#include <synthesis/MeasurementEquations/Feather.h>
+#include <synthesis/TransformMachines/StokesImageUtil.h>
+
+#include <casa/namespace.h>
+
+namespace {
+
+const Int nx = 64;
+const Int nchan = 5;
+
+CoordinateSystem makeCoords()
+{
+  CoordinateSystem csys;
+  Matrix<Double> xform(2, 2);
+  xform = 0.0;
+  xform.diagonal() = 1.0;
+  csys.addCoordinate(DirectionCoordinate(MDirection::J2000,
+					 Projection(Projection::SIN),
+					 0.0, 0.5, -C::arcsec, C::arcsec,
+					 xform, nx/2, nx/2));
+  Vector<Int> stokes(1, Stokes::I);
+  csys.addCoordinate(StokesCoordinate(stokes));
+  csys.addCoordinate(SpectralCoordinate(MFrequency::LSRK, 1.0e11, 1.0e6,
+					0.0, 1.0e11));
+  return csys;
+}
+
+// A Gaussian blob that moves with channel plus a ripple, of width scale
+void makeImage(TempImage<Float>& image, Float scale, Float phase,
+	       Float beamArcsec)
+{
+  Array<Float> pix(image.shape());
+  for (Int c = 0; c < nchan; ++c) {
+    for (Int y = 0; y < nx; ++y) {
+      for (Int x = 0; x < nx; ++x) {
+	const Float dx = x - 24 - 2*c;
+	const Float dy = y - 36 + c;
+	pix(IPosition(4, x, y, 0, c)) = exp(-(dx*dx + dy*dy)/(scale*scale))
+	  + 0.3*cos(0.2*x + 0.15*y + phase + c);
+      }
+    }
+  }
+  image.put(pix);
+  ImageInfo info;
+  info.setRestoringBeam(GaussianBeam(Quantity(beamArcsec, "arcsec"),
+				     Quantity(beamArcsec, "arcsec"),
+				     Quantity(0.0, "deg")));
+  image.setImageInfo(info);
+}
+
+// The feathered image as saveFeatheredImage made it before the transforms
+// were cached: LatticeFFT of the whole images, weighting plane by plane
+Array<Float> oldFeather(const ImageInterface<Float>& high,
+			const ImageInterface<Float>& low, Float sdScale)
+{
+  const IPosition shape = high.shape();
+  GaussianBeam hBeam = high.imageInfo().restoringBeam();
+  GaussianBeam lBeam = low.imageInfo().restoringBeam();
+
+  TempImage<Float> lowReg(shape, high.coordinates());
+  ImageRegrid<Float> ir;
+  ir.regrid(lowReg, Interpolate2D::LINEAR, IPosition(3, 0, 1, 3), low);
+
+  IPosition planeShape(4, nx, nx, 1, 1);
+  TempImage<Complex> cweight(planeShape, high.coordinates());
+  {
+    TempImage<Float> lowpsf(planeShape, high.coordinates());
+    lowpsf.set(0.0);
+    lowpsf.putAt(1.0, IPosition(4, (nx/4)*2, (nx/4)*2, 0, 0));
+    StokesImageUtil::Convolve(lowpsf, lBeam, False);
+    StokesImageUtil::From(cweight, lowpsf);
+  }
+  LatticeFFT::cfft2d(cweight);
+  LatticeExprNode node = max(cweight);
+  Float fmax = abs(node.getComplex());
+  cweight.copyData((LatticeExpr<Complex>)(1.0f - cweight/fmax));
+  Matrix<Complex> w = cweight.get(True);
+
+  TempImage<Complex> chigh(shape, high.coordinates());
+  StokesImageUtil::From(chigh, high);
+  LatticeFFT::cfft2d(chigh);
+  TempImage<Complex> clow(shape, high.coordinates());
+  StokesImageUtil::From(clow, lowReg);
+  LatticeFFT::cfft2d(clow);
+
+  const Float sdScaling = sdScale*hBeam.getArea("arcsec2")/lBeam.getArea("arcsec2");
+  Array<Complex> h = chigh.get();
+  Array<Complex> l = clow.get();
+  for (Int c = 0; c < nchan; ++c) {
+    for (Int y = 0; y < nx; ++y) {
+      for (Int x = 0; x < nx; ++x) {
+	IPosition pos(4, x, y, 0, c);
+	l(pos) = h(pos)*w(x, y) + l(pos)*sdScaling;
+      }
+    }
+  }
+  clow.put(l);
+  LatticeFFT::cfft2d(clow, False);
+  TempImage<Float> out(shape, high.coordinates());
+  StokesImageUtil::To(out, clow);
+  return out.get();
+}
+
+void checkSaved(Feather& plume, const String& name,
+		const ImageInterface<Float>& high,
+		const ImageInterface<Float>& low, Float sdScale)
+{
+  // Fill the transform caches first so that a stale one shows up
+  Vector<Float> ux, xamp, uy, yamp;
+  plume.getFTCutSDImage(ux, xamp, uy, yamp);
+  plume.getFTCutIntImage(ux, xamp, uy, yamp);
+  plume.saveFeatheredImage(name);
+  Array<Float> saved = PagedImage<Float>(name).get();
+  Array<Float> expected = oldFeather(high, low, sdScale);
+  AlwaysAssert(saved.shape() == expected.shape(), AipsError);
+  const Float tol = 1.0e-4*max(abs(expected));
+  AlwaysAssert(max(abs(saved - expected)) < tol, AipsError);
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const CoordinateSystem csys = makeCoords();
+    const IPosition shape(4, nx, nx, 1, nchan);
+    TempImage<Float> high(shape, csys), high2(shape, csys);
+    TempImage<Float> low(shape, csys), low2(shape, csys);
+    makeImage(high, 2.0, 0.0, 3.0);
+    makeImage(high2, 3.0, 1.0, 4.0);
+    makeImage(low, 6.0, 0.5, 12.0);
+    makeImage(low2, 8.0, 2.0, 15.0);
+
+    Feather plume;
+    plume.setINTImage(high);
+    plume.setSDImage(low);
+    plume.setSDScale(0.8);
+    checkSaved(plume, "tFeatherSave_1.image", high, low, 0.8);
+
+    // Only the weighting changes; the cached transforms are reused
+    plume.setSDScale(1.2);
+    checkSaved(plume, "tFeatherSave_2.image", high, low, 1.2);
+
+    // A new INT image or SD image has to drop its cached transform
+    plume.setINTImage(high2);
+    checkSaved(plume, "tFeatherSave_3.image", high2, low, 1.2);
+    plume.setSDImage(low2);
+    checkSaved(plume, "tFeatherSave_4.image", high2, low2, 1.2);
+  } catch (AipsError x) {
+    cout << "Caught exception: " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -104,6 +104,11 @@ class Algorithm {
   // Return the name of the algorithm
   virtual String &name() = 0;
 
+  // Return a new instance for another worker thread of the same process,
+  // or 0 if this Algorithm cannot run in several threads at once, in which
+  // case the worker threads take turns. The inputs are set by get().
+  virtual Algorithm *clone() const {return 0;}
+
  protected:
   // Do the work assigned as a parallel task
   virtual void task() = 0;
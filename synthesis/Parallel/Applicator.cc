@@ -35,6 +35,8 @@
 #include <synthesis/MeasurementComponents/ResidualAlgorithm.h>
 #include <casa/BasicMath/Math.h>
 #include <synthesis/Parallel/MPIError.h>
+#include <casa/System/AipsrcValue.h>
+#include <msvis/MSVis/AsynchronousTools.h>
 #ifdef PABLO_IO
 #include <synthesis/Parallel/PabloIO.h>
 #endif
@@ -43,7 +45,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 
 Applicator::Applicator() : comm(0), algorithmIds(0),
   knownAlgorithms((Algorithm*)0), LastID(101), usedAllThreads(False),
-  serial(True), nProcs(0), procStatus(0)
+  serial(True), nProcs(0), threaded(False), sharedAlgorithmMutex(0),
+  procStatus(0)
 {
 // Default constructor; requires later init().
 }
@@ -65,6 +68,7 @@ Applicator::~Applicator()
     }
     delete comm;
   }
+  if (sharedAlgorithmMutex) delete sharedAlgorithmMutex;
 }
 
 void Applicator::initThreads(Int /*argc*/, Char */*argv*/[]){
@@ -105,6 +109,30 @@ void Applicator::initThreads(){
   return;
 }
 
+   // Worker threads in this process.
+void Applicator::initSharedMemory(Int nWorkers){
+  if (comm) {
+    if (!isSerial()) {
+      throw(AipsError("Parallel transport layer already initialized"));
+    }
+    delete comm;
+  }
+  ThreadTransport *transport = new ThreadTransport(nWorkers);
+  comm = transport;
+  threaded = True;
+  if (!sharedAlgorithmMutex) sharedAlgorithmMutex = new async::Mutex;
+  setupProcStatus();
+  // The workers use comm, so it must be set before they start
+  transport->startWorkers(threadLoop, this);
+  return;
+}
+
+void *Applicator::threadLoop(void *applicator)
+{
+  static_cast<Applicator *>(applicator)->loop();
+  return 0;
+}
+
 void Applicator::init(Int /*argc*/, Char */*argv*/[])
 {
 // Initialize the process and parallel transport layer
@@ -118,7 +146,13 @@ void Applicator::init(Int /*argc*/, Char */*argv*/[])
 #ifdef PABLO_IO
      PabloIO::init(argc, argv, 0);
 #endif
-  initThreads();
+  Int nWorkers;
+  AipsrcValue<Int>::find(nWorkers, "Applicator.threads", 0);
+  if (nWorkers > 0) {
+    initSharedMemory(nWorkers);
+  } else {
+    initThreads();
+  }
 #endif
   return;
 }
@@ -155,6 +189,8 @@ void Applicator::loop()
 //
   Bool die(False);
   Int what;
+  // Private copies of the known Algorithms for this worker thread
+  OrderedMap<Int, Algorithm*> clones((Algorithm*)0);
   // Wait for a message from the controller with any Algorithm tag
   while(!die){
     comm->connectToController();
@@ -171,13 +207,28 @@ void Applicator::loop()
 	// Identified algorithm tag; set for subsequent communication
 	comm->setTag(what);
 	// Execute (apply) the algorithm
-	knownAlgorithms(what)->apply();
+	if (threaded) {
+	  if (!clones.isDefined(what)) {
+	    clones.define(what, knownAlgorithms(what)->clone());
+	  }
+	  if (clones(what)) {
+	    clones(what)->apply();
+	  } else {
+	    async::MutexLocker lock(*sharedAlgorithmMutex);
+	    knownAlgorithms(what)->apply();
+	  }
+	} else {
+	  knownAlgorithms(what)->apply();
+	}
       } else {
 	throw(AipsError("Unidentified parallel algorithm code"));
       }
       break;
     }
   }
+  for (uInt i=0; i<clones.ndefined(); i++) {
+    if (clones.getVal(i)) delete clones.getVal(i);
+  }
   return;
 }
 
@@ -42,6 +42,9 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 
 //# Forward Declarations
 class Algorithm;
+namespace async {
+  class Mutex;
+}
 
 // <summary>
 // Class which provides an interface to the parallelization infrastructure
@@ -101,6 +104,10 @@ class Applicator {
   void init(Int argc, Char *argv[]);
   void initThreads(Int argc, Char *argv[]);
   void initThreads();
+  // Run the workers as nWorkers threads of this process (ThreadTransport).
+  // init() does this when the aipsrc variable Applicator.threads is set
+  // and MPI is not in use.
+  void initSharedMemory(Int nWorkers);
 
   // define an Algorithm if we need too;
   void defineAlgorithm(Algorithm *);
@@ -177,12 +184,21 @@ class Applicator {
   // Number of processes
   Int nProcs;
 
+  // True if the workers are threads of this process
+  Bool threaded;
+
+  // Serializes, across worker threads, Algorithms that cannot be cloned
+  async::Mutex *sharedAlgorithmMutex;
+
   // Process status list
   Vector<Int> procStatus;
 
   // Executed by worker process waiting for an assigned task
   void loop();
 
+  // Thread function of the worker threads; runs loop()
+  static void *threadLoop(void *applicator);
+
   // Fill algorithm map
   void defineAlgorithms();
 
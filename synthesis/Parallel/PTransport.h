@@ -32,6 +32,12 @@
 //# Includes
 #include <casa/aips.h>
 #include <casa/Arrays/Array.h>
+#include <casa/Arrays/Vector.h>
+#include <casa/Containers/Block.h>
+#include <pthread.h>
+#include <deque>
+#include <map>
+#include <vector>
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
@@ -84,15 +90,15 @@ class PTransport {
   Int numThreads() {return numprocs;};
 
   // Return the current process rank
-  Int cpu() {return myCpu;}
+  virtual Int cpu() {return myCpu;}
 
   // Set the properties of the current connection including
   // source/destination and message tag.
-  Int connect(Int i) {aWorker=i; return i;}
-  void connectAnySource() {aWorker=anySource(); return;};
-  void connectToController() {aWorker=controllerRank(); return;};
-  void setTag(Int tag) {aTag=tag; return;};
-  void setAnyTag() {aTag=anyTag(); return;};
+  virtual Int connect(Int i) {aWorker=i; return i;}
+  virtual void connectAnySource() {aWorker=anySource(); return;};
+  virtual void connectToController() {aWorker=controllerRank(); return;};
+  virtual void setTag(Int tag) {aTag=tag; return;};
+  virtual void setAnyTag() {aTag=anyTag(); return;};
   
   // Status functions for worker/controller designation
   Bool isController() {return (cpu()==controllerRank());};
@@ -330,9 +336,138 @@ class SerialTransport : public PTransport {
   void *getFromQueue();
 };
 
+// <summary>
+// Shared-memory (thread) data transport model
+// </summary>
 
-} //# NAMESPACE CASA - END
+// <use visibility=local>
 
-#endif
+// <reviewed reviewer="" date="yyyy/mm/dd" tests="" demos="">
+// </reviewed>
 
+// <prerequisite>
+//   <li> PTransport
+//   <li> Applicator
+// </prerequisite>
+//
+// <etymology>
+// Workers are threads rather than processes.
+// </etymology>
+//
+// <synopsis>
+// The controller is the thread that creates the transport (rank 0); each
+// worker (rank 1..nWorkers) is a thread of the same process started by
+// startWorkers(). Messages are queued per destination and matched on
+// source and tag as with MPI, and get returns the rank of the source.
+// An Array is handed over by reference, as a message passing transport
+// hands over its buffer: after put the sender must not write into the
+// Array (it may resize it or reference other data), and a receiver that
+// writes into an Array it got calls Array::unique() first.
+// </synopsis>
+//
+// <motivation>
+// To run the parallel algorithms on the cores of a single node without
+// an MPI launch and without copying the data between processes.
+// </motivation>
+//
+//# <todo asof="yyyy/mm/dd">
+//# </todo>
+
+class ThreadMessage;
+class ThreadTransportWorker;
+namespace async {
+  class Mutex;
+  class Condition;
+}
+
+class ThreadTransport : public PTransport {
+ public:
+  // Set up the transport for a controller and nWorkers worker threads
+  explicit ThreadTransport(Int nWorkers);
+
+  // Joins the worker threads, which must have been told to stop
+  virtual ~ThreadTransport();
+
+  // Start the worker threads; each calls workerFunction(arg) and exits
+  // when it returns
+  void startWorkers(void *(*workerFunction)(void *), void *arg);
+
+  // The rank and connection are those of the calling thread
+  virtual Int cpu();
+  virtual Int connect(Int i);
+  virtual void connectAnySource();
+  virtual void connectToController();
+  virtual void setTag(Int tag);
+  virtual void setAnyTag();
 
+  // Default source and message tag values
+  virtual Int anyTag() {return -1;};
+  virtual Int anySource() {return -1;};
+
+  // Define the rank of the controller thread
+  virtual Int controllerRank() {return 0;};
+
+  // Get and put functions on the data transport layer
+  virtual Int put(const Array<Float> &);
+  virtual Int put(const Array<Double> &);
+  virtual Int put(const Array<Complex> &);
+  virtual Int put(const Array<DComplex> &);
+  virtual Int put(const Array<Int> &);
+  virtual Int put(const Float &);
+  virtual Int put(const Double &);
+  virtual Int put(const Complex &);
+  virtual Int put(const DComplex &);
+  virtual Int put(const Int &);
+  virtual Int put(const String &);
+  virtual Int put(const Bool &);
+  virtual Int put(const Record &);
+
+  virtual Int get(Array<Float> &);
+  virtual Int get(Array<Double> &);
+  virtual Int get(Array<Complex> &);
+  virtual Int get(Array<DComplex> &);
+  virtual Int get(Array<Int> &);
+  virtual Int get(Float &);
+  virtual Int get(Double &);
+  virtual Int get(Complex &);
+  virtual Int get(DComplex &);
+  virtual Int get(Int &);
+  virtual Int get(String &);
+  virtual Int get(Bool &);
+  virtual Int get(Record &);
+
+ private:
+  friend class ThreadTransportWorker;
+
+  // Rank of the calling thread; unregistered threads are the controller
+  Int myRank();
+  void registerRank(Int rank);
+
+  // Queue a message from the calling thread to its current destination
+  Int post(ThreadMessage *message);
+  // Wait for the first message matching the calling thread's current
+  // source and tag, and return it and its source
+  ThreadMessage *receive(Int &source);
+
+  template <class T> Int putValue(const T &value);
+  template <class T> Int getValue(T &value);
+  template <class T> Int getArray(Array<T> &value);
+
+  async::Mutex *mutex_p;
+  async::Condition *arrived_p;
+  std::map<pthread_t, Int> ranks_p;
+  // Current connection (source/destination and tag) of each rank
+  Vector<Int> peer_p;
+  Vector<Int> tag_p;
+  // Pending messages for each rank
+  std::vector<std::deque<ThreadMessage *> > mailbox_p;
+  PtrBlock<ThreadTransportWorker *> workers_p;
+
+  ThreadTransport(const ThreadTransport &);
+  ThreadTransport &operator=(const ThreadTransport &);
+};
+
+
+} //# NAMESPACE CASA - END
+
+#endif
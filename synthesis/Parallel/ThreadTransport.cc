@@ -0,0 +1,324 @@
+//# ThreadTransport.cc: shared-memory transport for the parallel Applicator
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+//# Includes
+
+#include <synthesis/Parallel/PTransport.h>
+#include <casa/Containers/Record.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Logging/LogIO.h>
+#include <msvis/MSVis/AsynchronousTools.h>
+
+namespace casa { //# NAMESPACE CASA - BEGIN
+
+  // Messages are queued for the destination rank, tagged with the source
+  // rank and message tag so that get can match them as MPI would.
+
+class ThreadMessage {
+ public:
+  ThreadMessage(Int source, Int tag) : source_p(source), tag_p(tag) {}
+  virtual ~ThreadMessage() {}
+  Int source_p;
+  Int tag_p;
+};
+
+template <class T> class ThreadMessageValue : public ThreadMessage {
+ public:
+  // For an Array this references the data of the sender's Array
+  ThreadMessageValue(Int source, Int tag, const T &value)
+    : ThreadMessage(source, tag), value_p(value) {}
+  T value_p;
+};
+
+class ThreadTransportWorker : public async::Thread {
+ public:
+  ThreadTransportWorker(ThreadTransport *transport, Int rank,
+			void *(*workerFunction)(void *), void *arg)
+    : transport_p(transport), rank_p(rank), function_p(workerFunction),
+      arg_p(arg) {}
+
+ protected:
+  void *run() {
+    transport_p->registerRank(rank_p);
+    void *result(0);
+    try {
+      result = function_p(arg_p);
+    } catch (AipsError x) {
+      LogIO os(LogOrigin("ThreadTransport", "run", WHERE));
+      os << LogIO::SEVERE << "Worker thread " << rank_p << " terminated: "
+	 << x.getMesg() << LogIO::POST;
+    }
+    return result;
+  }
+
+ private:
+  ThreadTransport *transport_p;
+  Int rank_p;
+  void *(*function_p)(void *);
+  void *arg_p;
+};
+
+ThreadTransport::ThreadTransport(Int nWorkers)
+  : PTransport(), mutex_p(new async::Mutex), arrived_p(new async::Condition),
+    peer_p(nWorkers+1, -1), tag_p(nWorkers+1, -1), mailbox_p(nWorkers+1),
+    workers_p(0)
+{
+  numprocs = nWorkers+1;
+  myCpu = controllerRank();
+}
+
+ThreadTransport::~ThreadTransport()
+{
+  for (uInt i=0; i<workers_p.nelements(); i++) {
+    workers_p[i]->join();
+    delete workers_p[i];
+  }
+  for (uInt i=0; i<mailbox_p.size(); i++) {
+    while (!mailbox_p[i].empty()) {
+      delete mailbox_p[i].front();
+      mailbox_p[i].pop_front();
+    }
+  }
+  delete arrived_p;
+  delete mutex_p;
+}
+
+void ThreadTransport::startWorkers(void *(*workerFunction)(void *), void *arg)
+{
+  if (workers_p.nelements() > 0) {
+    throw(AipsError("ThreadTransport workers already started"));
+  }
+  workers_p.resize(numprocs-1);
+  for (Int rank=1; rank<numprocs; rank++) {
+    workers_p[rank-1] = new ThreadTransportWorker(this, rank, workerFunction, arg);
+  }
+  for (uInt i=0; i<workers_p.nelements(); i++) {
+    workers_p[i]->startThread();
+  }
+}
+
+void ThreadTransport::registerRank(Int rank)
+{
+  async::MutexLocker lock(*mutex_p);
+  ranks_p[pthread_self()] = rank;
+}
+
+Int ThreadTransport::myRank()
+{
+  async::MutexLocker lock(*mutex_p);
+  std::map<pthread_t, Int>::const_iterator it = ranks_p.find(pthread_self());
+  return (it == ranks_p.end()) ? controllerRank() : it->second;
+}
+
+Int ThreadTransport::cpu()
+{
+  return myRank();
+}
+
+Int ThreadTransport::connect(Int i)
+{
+  peer_p[myRank()] = i;
+  return i;
+}
+
+void ThreadTransport::connectAnySource()
+{
+  peer_p[myRank()] = anySource();
+}
+
+void ThreadTransport::connectToController()
+{
+  peer_p[myRank()] = controllerRank();
+}
+
+void ThreadTransport::setTag(Int tag)
+{
+  tag_p[myRank()] = tag;
+}
+
+void ThreadTransport::setAnyTag()
+{
+  tag_p[myRank()] = anyTag();
+}
+
+Int ThreadTransport::post(ThreadMessage *message)
+{
+  const Int rank = myRank();
+  const Int dest = peer_p[rank];
+  if (dest < 0 || dest >= numprocs) {
+    delete message;
+    throw(AipsError("ThreadTransport: no destination for put"));
+  }
+  message->source_p = rank;
+  message->tag_p = tag_p[rank];
+  {
+    async::MutexLocker lock(*mutex_p);
+    mailbox_p[dest].push_back(message);
+  }
+  arrived_p->notify_all();
+  return(0);
+}
+
+ThreadMessage *ThreadTransport::receive(Int &source)
+{
+  const Int rank = myRank();
+  const Int from = peer_p[rank];
+  const Int tag = tag_p[rank];
+  std::deque<ThreadMessage *> &mailbox = mailbox_p[rank];
+  async::UniqueLock lock(*mutex_p);
+  while (True) {
+    for (std::deque<ThreadMessage *>::iterator it = mailbox.begin();
+	 it != mailbox.end(); ++it) {
+      if ((from == anySource() || (*it)->source_p == from) &&
+	  (tag == anyTag() || (*it)->tag_p == tag)) {
+	ThreadMessage *message = *it;
+	mailbox.erase(it);
+	source = message->source_p;
+	return message;
+      }
+    }
+    arrived_p->wait(lock);
+  }
+  return 0;
+}
+
+template <class T> Int ThreadTransport::putValue(const T &value)
+{
+  return post(new ThreadMessageValue<T>(0, 0, value));
+}
+
+template <class T> Int ThreadTransport::getValue(T &value)
+{
+  Int source;
+  ThreadMessage *message = receive(source);
+  ThreadMessageValue<T> *typed = dynamic_cast<ThreadMessageValue<T> *>(message);
+  if (!typed) {
+    delete message;
+    throw(AipsError("ThreadTransport: unexpected message type"));
+  }
+  value = typed->value_p;
+  delete message;
+  return source;
+}
+
+template <class T> Int ThreadTransport::getArray(Array<T> &value)
+{
+  Int source;
+  ThreadMessage *message = receive(source);
+  ThreadMessageValue<Array<T> > *typed =
+    dynamic_cast<ThreadMessageValue<Array<T> > *>(message);
+  if (!typed) {
+    delete message;
+    throw(AipsError("ThreadTransport: unexpected message type"));
+  }
+  // No copy; the receiver shares the data of the sender's Array
+  value.reference(typed->value_p);
+  delete message;
+  return source;
+}
+
+Int ThreadTransport::put(const Array<Float> &af){
+   return putValue(af);
+}
+Int ThreadTransport::put(const Array<Double> &af){
+   return putValue(af);
+}
+Int ThreadTransport::put(const Array<Complex> &af){
+   return putValue(af);
+}
+Int ThreadTransport::put(const Array<DComplex> &af){
+   return putValue(af);
+}
+Int ThreadTransport::put(const Array<Int> &af){
+   return putValue(af);
+}
+Int ThreadTransport::put(const Float &f){
+   return putValue(f);
+}
+Int ThreadTransport::put(const Double &d){
+   return putValue(d);
+}
+Int ThreadTransport::put(const Complex &f){
+   return putValue(f);
+}
+Int ThreadTransport::put(const DComplex &f){
+   return putValue(f);
+}
+Int ThreadTransport::put(const Int &i){
+   return putValue(i);
+}
+Int ThreadTransport::put(const String &s){
+   return putValue(s);
+}
+Int ThreadTransport::put(const Bool &b){
+   return putValue(b);
+}
+Int ThreadTransport::put(const Record &r){
+   return putValue(r);
+}
+
+Int ThreadTransport::get(Array<Float> &af){
+   return getArray(af);
+}
+Int ThreadTransport::get(Array<Double> &af){
+   return getArray(af);
+}
+Int ThreadTransport::get(Array<Complex> &af){
+   return getArray(af);
+}
+Int ThreadTransport::get(Array<DComplex> &af){
+   return getArray(af);
+}
+Int ThreadTransport::get(Array<Int> &af){
+   return getArray(af);
+}
+Int ThreadTransport::get(Float &f){
+   return getValue(f);
+}
+Int ThreadTransport::get(Double &d){
+   return getValue(d);
+}
+Int ThreadTransport::get(Complex &f){
+   return getValue(f);
+}
+Int ThreadTransport::get(DComplex &f){
+   return getValue(f);
+}
+Int ThreadTransport::get(Int &i){
+   return getValue(i);
+}
+Int ThreadTransport::get(String &s){
+   return getValue(s);
+}
+Int ThreadTransport::get(Bool &b){
+   return getValue(b);
+}
+Int ThreadTransport::get(Record &r){
+   return getValue(r);
+}
+
+} //# NAMESPACE CASA - END
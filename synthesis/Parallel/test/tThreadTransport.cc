@@ -0,0 +1,307 @@
+//# tThreadTransport.cc: test the Applicator with worker threads
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+// Usage: tThreadTransport [nplanes [npix [nworkers]]]
+//
+// Smooths the planes of a cube, and Clark cleans the planes of a dirty
+// cube with ClarkCleanAlgorithm, first in the controller and then with
+// worker threads through the ThreadTransport, checks that the results
+// agree and prints the time each took and the speed-up.
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/stdlib.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/Containers/OrderedMap.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/HostInfo.h>
+#include <casa/OS/Timer.h>
+#include <casa/Utilities/Assert.h>
+#include <lattices/Lattices/ArrayLattice.h>
+#include <synthesis/MeasurementComponents/ClarkCleanAlgorithm.h>
+#include <synthesis/MeasurementEquations/ClarkCleanLatModel.h>
+#include <synthesis/MeasurementEquations/LatConvEquation.h>
+#include <synthesis/Parallel/Algorithm.h>
+#include <synthesis/Parallel/Applicator.h>
+#include <vector>
+
+#include <casa/namespace.h>
+
+// Repeatedly box-smooths a plane
+class SmoothAlgorithm : public Algorithm {
+ public:
+  SmoothAlgorithm() : npass(0), myName("Smooth") {}
+  ~SmoothAlgorithm() {}
+  void get() {
+    applicator.get(plane);
+    applicator.get(npass);
+  }
+  void put() {
+    applicator.put(result);
+  }
+  String &name() {return myName;}
+  Algorithm *clone() const {return new SmoothAlgorithm;}
+  static Matrix<Float> smoothed(const Matrix<Float> &plane, Int npass) {
+    Matrix<Float> in(plane.copy());
+    Matrix<Float> out(in.shape(), 0.0f);
+    const Int nx = in.nrow();
+    const Int ny = in.ncolumn();
+    for (Int pass = 0; pass < npass; pass++) {
+      for (Int j = 1; j < ny-1; j++) {
+	for (Int i = 1; i < nx-1; i++) {
+	  out(i, j) = (in(i-1, j) + in(i+1, j) + in(i, j-1) + in(i, j+1)
+		       + 4*in(i, j))/8.0f;
+	}
+      }
+      in = out;
+    }
+    return out;
+  }
+ private:
+  Array<Float> plane;
+  Array<Float> result;
+  Int npass;
+  String myName;
+  void task() {
+    // A new result each time; the controller may still hold the last one
+    Matrix<Float> out(smoothed(Matrix<Float>(plane), npass));
+    result.reference(out);
+  }
+};
+
+// Smooth every plane of cube with the workers of the applicator, in the
+// manner of PClarkCleanImageSkyModel
+Cube<Float> smoothPlanes(SmoothAlgorithm &smooth, const Cube<Float> &cube,
+			 Int npass)
+{
+  Cube<Float> out(cube.shape());
+  OrderedMap<Int, Int> planeNo(0);
+  Bool allDone, assigned;
+  Int rank;
+  for (uInt k = 0; k < cube.nplane(); k++) {
+    assigned = applicator.nextAvailProcess(smooth, rank);
+    while (!assigned) {
+      rank = applicator.nextProcessDone(smooth, allDone);
+      Array<Float> af;
+      applicator.get(af);
+      out.xyPlane(planeNo(rank)) = af;
+      assigned = applicator.nextAvailProcess(smooth, rank);
+    }
+    // A new Array for each plane; the worker references it
+    Array<Float> plane(cube.xyPlane(k).copy());
+    applicator.put(plane);
+    applicator.put(npass);
+    planeNo.define(rank, k);
+    applicator.apply(smooth);
+  }
+  rank = applicator.nextProcessDone(smooth, allDone);
+  while (!allDone) {
+    Array<Float> af;
+    applicator.get(af);
+    out.xyPlane(planeNo(rank)) = af;
+    rank = applicator.nextProcessDone(smooth, allDone);
+  }
+  return out;
+}
+
+const Float cleanGain = 0.1f;
+const Float cleanThreshold = 0.0f;
+const Int cleanIterations = 500;
+
+// A Gaussian beam of 2*npix by 2*npix pixels peaking at (npix, npix), with
+// the degenerate polarization and channel axes of the planes that
+// PClarkCleanImageSkyModel sends
+Array<Float> makePsf(Int npix)
+{
+  Array<Float> psf(IPosition(4, 2*npix, 2*npix, 1, 1));
+  for (Int j = 0; j < 2*npix; j++) {
+    for (Int i = 0; i < 2*npix; i++) {
+      const Float r2 = (i-npix)*(i-npix) + 0.5f*(j-npix)*(j-npix);
+      psf(IPosition(4, i, j, 0, 0)) = exp(-r2/8.0f);
+    }
+  }
+  return psf;
+}
+
+// Plane k of a dirty cube: a few point sources, different in every
+// plane, convolved with psf
+Array<Float> makeDirty(const Array<Float> &psf, Int npix, Int k)
+{
+  Array<Float> dirty(IPosition(4, npix, npix, 1, 1), 0.0f);
+  for (Int source = 0; source < 4; source++) {
+    const Int x = (npix/4 + 17*source + 5*k) % npix;
+    const Int y = (npix/3 + 29*source + 3*k) % npix;
+    const Float flux = 1.0f + 0.5f*source + 0.1f*k;
+    for (Int j = 0; j < npix; j++) {
+      for (Int i = 0; i < npix; i++) {
+	dirty(IPosition(4, i, j, 0, 0)) +=
+	  flux*psf(IPosition(4, i-x+npix, j-y+npix, 0, 0));
+      }
+    }
+  }
+  return dirty;
+}
+
+// The clean of ClarkCleanAlgorithm::task, on in-memory lattices
+Array<Float> cleanPlane(const Array<Float> &dirty, const Array<Float> &psf)
+{
+  Array<Float> psfCopy(psf.copy());
+  ArrayLattice<Float> psfLattice(psfCopy);
+  ArrayLattice<Float> dirtyLattice(dirty.shape());
+  dirtyLattice.put(dirty);
+  ArrayLattice<Float> model(dirty.shape());
+  model.set(0.0f);
+  LatConvEquation eqn(psfLattice, dirtyLattice);
+  ClarkCleanLatModel cleaner(model);
+  cleaner.setGain(cleanGain);
+  cleaner.setNumberIterations(cleanIterations);
+  cleaner.setThreshold(cleanThreshold);
+  cleaner.setPsfPatchSize(IPosition(2,51));
+  cleaner.setHistLength(1024);
+  cleaner.setMaxNumPix(32*1024);
+  cleaner.solve(eqn);
+  return model.get();
+}
+
+// Clean every plane with the workers of the applicator, as
+// PClarkCleanImageSkyModel does
+std::vector<Array<Float> > cleanPlanes(ClarkCleanAlgorithm &clarkClean,
+				       const Array<Float> &psf, Int npix,
+				       Int nplanes)
+{
+  std::vector<Array<Float> > models(nplanes);
+  Array<Float> noMask;
+  OrderedMap<Int, Int> planeNo(0);
+  Bool allDone, assigned;
+  Int rank;
+  for (Int k = 0; k < nplanes; k++) {
+    assigned = applicator.nextAvailProcess(clarkClean, rank);
+    while (!assigned) {
+      rank = applicator.nextProcessDone(clarkClean, allDone);
+      applicator.get(models[planeNo(rank)]);
+      assigned = applicator.nextAvailProcess(clarkClean, rank);
+    }
+    Array<Float> dirty(makeDirty(psf, npix, k));
+    applicator.put(dirty);
+    applicator.put(psf);
+    applicator.put(noMask);
+    applicator.put(cleanGain);
+    applicator.put(cleanThreshold);
+    applicator.put(cleanIterations);
+    applicator.put(k);
+    applicator.put(nplanes);
+    planeNo.define(rank, k);
+    applicator.apply(clarkClean);
+  }
+  rank = applicator.nextProcessDone(clarkClean, allDone);
+  while (!allDone) {
+    applicator.get(models[planeNo(rank)]);
+    rank = applicator.nextProcessDone(clarkClean, allDone);
+  }
+  return models;
+}
+
+int main(int argc, char **argv)
+{
+  try {
+    Int nplanes = 16;
+    Int npix = 128;
+    Int nworkers = min(max(HostInfo::numCPUs(), 2), 8);
+    if (argc > 1) nplanes = atoi(argv[1]);
+    if (argc > 2) npix = atoi(argv[2]);
+    if (argc > 3) nworkers = atoi(argv[3]);
+    const Int npass = 20;
+
+    Cube<Float> cube(npix, npix, nplanes);
+    for (Int k = 0; k < nplanes; k++) {
+      for (Int j = 0; j < npix; j++) {
+	for (Int i = 0; i < npix; i++) {
+	  cube(i, j, k) = ((i*7 + j*13 + k*17) % 29) - 14.0f;
+	}
+      }
+    }
+
+    SmoothAlgorithm smooth;
+    applicator.defineAlgorithm(&smooth);
+    ClarkCleanAlgorithm clarkClean;
+    applicator.defineAlgorithm(&clarkClean);
+    Timer timer;
+
+    timer.mark();
+    Cube<Float> serial(cube.shape());
+    for (Int k = 0; k < nplanes; k++) {
+      serial.xyPlane(k) = SmoothAlgorithm::smoothed(cube.xyPlane(k), npass);
+    }
+    const Double tSerial = timer.real();
+    cout << "smooth, controller only: " << tSerial << " s" << endl;
+
+    const Array<Float> psf(makePsf(npix));
+    timer.mark();
+    std::vector<Array<Float> > serialModels(nplanes);
+    for (Int k = 0; k < nplanes; k++) {
+      serialModels[k] = cleanPlane(makeDirty(psf, npix, k), psf);
+    }
+    const Double tSerialClean = timer.real();
+    cout << "Clark clean, controller only: " << tSerialClean << " s" << endl;
+
+    applicator.initSharedMemory(nworkers);
+    AlwaysAssert(!applicator.isSerial(), AipsError);
+    AlwaysAssert(applicator.numProcs() == nworkers+1, AipsError);
+    AlwaysAssert(applicator.isController(), AipsError);
+    timer.mark();
+    Cube<Float> threaded = smoothPlanes(smooth, cube, npass);
+    const Double tThreads = timer.real();
+    cout << "smooth, " << nworkers << " worker threads: " << tThreads
+	 << " s, speed-up " << tSerial/max(tThreads, 1e-6) << endl;
+    AlwaysAssert(allEQ(serial, threaded), AipsError);
+
+    // Each worker thread cleans with its own clone of clarkClean
+    timer.mark();
+    std::vector<Array<Float> > threadedModels =
+      cleanPlanes(clarkClean, psf, npix, nplanes);
+    const Double tThreadsClean = timer.real();
+    cout << "Clark clean, " << nworkers << " worker threads: " << tThreadsClean
+	 << " s, speed-up " << tSerialClean/max(tThreadsClean, 1e-6) << endl;
+    for (Int k = 0; k < nplanes; k++) {
+      AlwaysAssert(max(abs(serialModels[k])) > 0.0f, AipsError);
+      AlwaysAssert(serialModels[k].shape().isEqual(threadedModels[k].shape()),
+		   AipsError);
+      AlwaysAssert(allEQ(serialModels[k], threadedModels[k]), AipsError);
+    }
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,332 @@
+//# ModelVisCache.cc: process-wide cache of predicted model visibilities
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be adressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//#
+//# $Id$
+
+#include <casa/Containers/Block.h>
+#include <casa/Containers/Record.h>
+#include <casa/Logging/LogIO.h>
+#include <casa/IO/AipsIO.h>
+#include <casa/IO/MemoryIO.h>
+#include <casa/OS/File.h>
+#include <casa/OS/RegularFile.h>
+#include <casa/OS/Directory.h>
+#include <casa/OS/DirectoryIterator.h>
+#include <casa/System/Aipsrc.h>
+#include <casa/System/AipsrcValue.h>
+#include <casa/Utilities/Regex.h>
+#include <casa/sstream.h>
+#include <casa/iomanip.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <synthesis/TransformMachines/ModelVisCache.h>
+
+#include <unistd.h>
+
+namespace {
+
+  //FNV-1a, 64 bit
+  void hashBytes(casa::uInt64& hash, const void* data, const size_t nbytes){
+    const casa::uChar* bytes=static_cast<const casa::uChar*>(data);
+    for (size_t k=0; k < nbytes; ++k){
+      hash^=bytes[k];
+      hash*=1099511628211ULL;
+    }
+  }
+
+}
+
+namespace casa { //# NAMESPACE CASA - BEGIN
+
+Mutex ModelVisCache::mutex_p;
+Bool ModelVisCache::initialized_p=False;
+Int64 ModelVisCache::maxBytes_p=0;
+Int64 ModelVisCache::bytes_p=0;
+String ModelVisCache::cacheDir_p("");
+std::set<String> ModelVisCache::cacheDirs_p;
+std::map<String, std::map<String, Cube<Complex> > > ModelVisCache::registry_p;
+std::list<std::pair<String, String> > ModelVisCache::order_p;
+Int64 ModelVisCache::hits_p=0;
+Int64 ModelVisCache::misses_p=0;
+String ModelVisCache::rowsTable_p("");
+Vector<uInt> ModelVisCache::rowsRoot_p;
+
+void ModelVisCache::init(){
+  //called with mutex_p held
+  if(initialized_p)
+    return;
+  Int cacheMB;
+  AipsrcValue<Int>::find(cacheMB, "VisModelData.cachesize", 0);
+  maxBytes_p=Int64(cacheMB)*1024*1024;
+  Aipsrc::find(cacheDir_p, "VisModelData.cachedir", "");
+  if(cacheDir_p != "")
+    cacheDirs_p.insert(cacheDir_p);
+  initialized_p=True;
+}
+
+Bool ModelVisCache::enabled(){
+  ScopedMutexLock locker(mutex_p);
+  init();
+  return maxBytes_p > 0 || cacheDir_p != "";
+}
+
+void ModelVisCache::setCache(const Int64 maxBytes, const String& cacheDir){
+  ScopedMutexLock locker(mutex_p);
+  init();
+  maxBytes_p=maxBytes;
+  cacheDir_p=cacheDir;
+  if(cacheDir_p != "")
+    cacheDirs_p.insert(cacheDir_p);
+  registry_p.clear();
+  order_p.clear();
+  bytes_p=0;
+}
+
+String ModelVisCache::msKey(const MeasurementSet& ms){
+  Block<String> parts=ms.getPartNames(True);
+  return parts.nelements() > 0 ? parts[0] : ms.tableName();
+}
+
+Vector<uInt> ModelVisCache::rootRows(const MeasurementSet& ms, const Vector<uInt>& rowIds){
+  if(ms.isRootTable())
+    return rowIds;
+  ScopedMutexLock locker(mutex_p);
+  //successive chunks come from the same selection; only map its rows once
+  if(ms.tableName() != rowsTable_p || rowsRoot_p.nelements() != ms.nrow()){
+    rowsRoot_p.resize();
+    rowsRoot_p=ms.rowNumbers();
+    rowsTable_p=ms.tableName();
+  }
+  Vector<uInt> rows(rowIds.nelements());
+  for (uInt k=0; k < rowIds.nelements(); ++k)
+    rows(k)=rowsRoot_p(rowIds(k));
+  return rows;
+}
+
+uInt ModelVisCache::recordHash(const RecordInterface& rec){
+  //FNV-1a over the serialized record
+  MemoryIO buffer;
+  AipsIO aio(&buffer);
+  aio << Record(rec);
+  aio.close();
+  const uChar* bytes=buffer.getBuffer();
+  const Int64 nbytes=buffer.length();
+  uInt hash=2166136261u;
+  for (Int64 k=0; k < nbytes; ++k){
+    hash^=bytes[k];
+    hash*=16777619u;
+  }
+  return hash;
+}
+
+uInt ModelVisCache::combineHash(const uInt hash, const uInt rechash){
+  //A sum of mixed hashes does not depend on the order the records of a
+  //(field, spw) are added in
+  return hash+rechash*2654435761u+0x9e3779b9u;
+}
+
+String ModelVisCache::chunkKey(const uInt modelHash, const Int field, const Int spw,
+			       const IPosition& shape, const Vector<Int>& chans,
+			       const Vector<uInt>& rowIds, const Vector<Double>& times){
+  uInt64 hash=14695981039346656037ULL;
+  for (uInt k=0; k < chans.nelements(); ++k){
+    const Int chan=chans(k);
+    hashBytes(hash, &chan, sizeof(chan));
+  }
+  for (uInt k=0; k < rowIds.nelements(); ++k){
+    const uInt row=rowIds(k);
+    hashBytes(hash, &row, sizeof(row));
+  }
+  for (uInt k=0; k < times.nelements(); ++k){
+    const Double t=times(k);
+    hashBytes(hash, &t, sizeof(t));
+  }
+  ostringstream oos;
+  oos << modelHash << "_" << field << "_" << spw;
+  for (uInt k=0; k < shape.nelements(); ++k)
+    oos << "_" << shape(k);
+  oos << "_" << hex << setfill('0') << setw(16) << hash;
+  return String(oos);
+}
+
+String ModelVisCache::filePrefix(const String& msName){
+  uInt hash=2166136261u;
+  for (uInt k=0; k < msName.length(); ++k){
+    hash^=uChar(msName[k]);
+    hash*=16777619u;
+  }
+  return "VisModelData_"+String::toString(hash);
+}
+
+Bool ModelVisCache::get(const String& msName, const String& key, const IPosition& shape,
+			Cube<Complex>& mod){
+  ScopedMutexLock locker(mutex_p);
+  init();
+  std::map<String, std::map<String, Cube<Complex> > >::const_iterator ms=registry_p.find(msName);
+  if(ms != registry_p.end()){
+    std::map<String, Cube<Complex> >::const_iterator it=ms->second.find(key);
+    if(it != ms->second.end() && it->second.shape().isEqual(shape)){
+      mod.assign(it->second);
+      ++hits_p;
+      return True;
+    }
+  }
+  const String name=cacheDir_p+"/"+filePrefix(msName)+"_"+key;
+  if(cacheDir_p == "" || !File(name).exists()){
+    ++misses_p;
+    return False;
+  }
+  try{
+    Cube<Complex> ondisk;
+    AipsIO aio(name);
+    aio >> ondisk;
+    if(!ondisk.shape().isEqual(shape)){
+      ++misses_p;
+      return False;
+    }
+    mod.assign(ondisk);
+    putMemory(msName, key, ondisk);
+  }
+  catch(AipsError x){
+    LogIO os(LogOrigin("ModelVisCache", "get"));
+    os << LogIO::WARN << "Could not read model visibility cache " << name
+       << ": " << x.getMesg() << LogIO::POST;
+    ++misses_p;
+    return False;
+  }
+  ++hits_p;
+  return True;
+}
+
+void ModelVisCache::putMemory(const String& msName, const String& key, const Cube<Complex>& mod){
+  //called with mutex_p held
+  if(maxBytes_p <= 0)
+    return;
+  std::map<String, Cube<Complex> >& entries=registry_p[msName];
+  if(entries.find(key) != entries.end())
+    return;
+  const Int64 nbytes=mod.nelements()*sizeof(Complex);
+  if(nbytes > maxBytes_p)
+    return;
+  //Drop the oldest predictions, of any MS, until this one fits
+  while(!order_p.empty() && (bytes_p+nbytes) > maxBytes_p){
+    std::map<String, Cube<Complex> >& oldms=registry_p[order_p.front().first];
+    std::map<String, Cube<Complex> >::iterator old=oldms.find(order_p.front().second);
+    bytes_p-=old->second.nelements()*sizeof(Complex);
+    oldms.erase(old);
+    order_p.pop_front();
+  }
+  entries[key]=mod.copy();
+  order_p.push_back(std::make_pair(msName, key));
+  bytes_p+=nbytes;
+}
+
+void ModelVisCache::put(const String& msName, const String& key, const Cube<Complex>& mod){
+  ScopedMutexLock locker(mutex_p);
+  init();
+  putMemory(msName, key, mod);
+  if(cacheDir_p == "")
+    return;
+  const String name=cacheDir_p+"/"+filePrefix(msName)+"_"+key;
+  if(File(name).exists())
+    return;
+  try{
+    //Write to a temporary file first so that another process never reads
+    //a partial cache
+    const String tmpName=name+".tmp"+String::toString(Int(getpid()));
+    {
+      AipsIO aio(tmpName, ByteIO::New);
+      aio << mod;
+    }
+    RegularFile(tmpName).move(name);
+  }
+  catch(AipsError x){
+    LogIO os(LogOrigin("ModelVisCache", "put"));
+    os << LogIO::WARN << "Could not write model visibility cache " << name
+       << ": " << x.getMesg() << LogIO::POST;
+  }
+}
+
+void ModelVisCache::invalidate(const MeasurementSet& ms){
+  ScopedMutexLock locker(mutex_p);
+  init();
+  Block<String> parts=ms.getPartNames(True);
+  invalidateLocked(ms.tableName());
+  for (uInt k=0; k < parts.nelements(); ++k)
+    if(parts[k] != ms.tableName())
+      invalidateLocked(parts[k]);
+}
+
+void ModelVisCache::invalidateLocked(const String& msName){
+  std::map<String, std::map<String, Cube<Complex> > >::iterator ms=registry_p.find(msName);
+  if(ms != registry_p.end()){
+    std::list<std::pair<String, String> >::iterator it=order_p.begin();
+    while(it != order_p.end()){
+      if(it->first == msName)
+	it=order_p.erase(it);
+      else
+	++it;
+    }
+    std::map<String, Cube<Complex> >::const_iterator entry;
+    for (entry=ms->second.begin(); entry != ms->second.end(); ++entry)
+      bytes_p-=entry->second.nelements()*sizeof(Complex);
+    registry_p.erase(ms);
+  }
+  std::set<String>::const_iterator dir;
+  for (dir=cacheDirs_p.begin(); dir != cacheDirs_p.end(); ++dir){
+    if(!File(*dir).isDirectory())
+      continue;
+    try{
+      DirectoryIterator iter(Directory(*dir),
+			     Regex(Regex::fromString(filePrefix(msName)+"_")+".*"));
+      Vector<String> names(0);
+      for (; !iter.pastEnd(); iter++){
+	names.resize(names.nelements()+1, True);
+	names[names.nelements()-1]=iter.name();
+      }
+      for (uInt k=0; k < names.nelements(); ++k)
+	RegularFile(*dir+"/"+names[k]).remove();
+    }
+    catch(AipsError x){
+      LogIO os(LogOrigin("ModelVisCache", "invalidate"));
+      os << LogIO::WARN << "Could not clear model visibility cache in " << *dir
+	 << ": " << x.getMesg() << LogIO::POST;
+    }
+  }
+}
+
+void ModelVisCache::statistics(Int64& hits, Int64& misses){
+  ScopedMutexLock locker(mutex_p);
+  hits=hits_p;
+  misses=misses_p;
+}
+
+void ModelVisCache::resetStatistics(){
+  ScopedMutexLock locker(mutex_p);
+  hits_p=0;
+  misses_p=0;
+}
+
+} //# NAMESPACE CASA - END
@@ -0,0 +1,138 @@
+//# ModelVisCache.h: process-wide cache of predicted model visibilities
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This library is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU Library General Public License as published by
+//# the Free Software Foundation; either version 2 of the License, or (at your
+//# option) any later version.
+//#
+//# This library is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU Library General Public
+//# License for more details.
+//#
+//# You should have received a copy of the GNU Library General Public License
+//# along with this library; if not, write to the Free Software Foundation,
+//# Inc., 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be adressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//#
+//# $Id$
+#ifndef SYNTHESIS_MODELVISCACHE_H
+#define SYNTHESIS_MODELVISCACHE_H
+#include <casa/aips.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Arrays/IPosition.h>
+#include <casa/Arrays/Vector.h>
+#include <casa/BasicSL/String.h>
+#include <casa/OS/Mutex.h>
+#include <list>
+#include <map>
+#include <set>
+
+namespace casa { //# NAMESPACE CASA - BEGIN
+//#forward
+  class MeasurementSet;
+  class RecordInterface;
+
+// <summary>
+// Process-wide cache of the model visibilities predicted by VisModelData
+// </summary>
+
+// <use visibility=local>
+
+// <synopsis>
+// Both VisModelData classes (the one serving VisBuffer and the one serving
+// VisBuffer2) predict the model visibilities of a chunk from the model
+// records of the MS. The predictions are kept here, keyed by the MS and a
+// hash of the model records, field, spw, shape, channels, rows and times of
+// the chunk, so that every VisModelData of the process (e.g. the ones
+// of successive calibration solves or of successive iterators over the
+// same MS) finds them again.
+//
+// The aipsrc variable VisModelData.cachesize sets the size in MB of the
+// in-memory cache and VisModelData.cachedir names a directory where the
+// predictions are also kept on disk; both are off by default and can be
+// changed with setCache. The entries of an MS are dropped, in memory and
+// in every directory used by the process, when putModel or clearModel
+// change the models of the MS.
+// </synopsis>
+
+class ModelVisCache {
+ public:
+  // Is the in-memory or the on-disk cache in use?
+  static Bool enabled();
+
+  // Set the size in bytes of the in-memory cache (0 disables it) and the
+  // directory of the on-disk cache ("" disables it). Entries already held
+  // in memory are dropped.
+  static void setCache(const Int64 maxBytes, const String& cacheDir=String(""));
+
+  // The name the entries of the MS are registered under: the MS a
+  // selection or reference table was made from
+  static String msKey(const MeasurementSet& ms);
+
+  // The rows of the MS msKey names for rows rowIds of the selection ms;
+  // the chunks of two selections of an MS are told apart by these
+  static Vector<uInt> rootRows(const MeasurementSet& ms, const Vector<uInt>& rowIds);
+
+  // Hash of a model record, and the order independent combination of the
+  // hashes of all the records serving a (field, spw)
+  // <group>
+  static uInt recordHash(const RecordInterface& rec);
+  static uInt combineHash(const uInt hash, const uInt rechash);
+  // </group>
+
+  // Key of the prediction for a chunk; rowIds are rows of the MS msKey
+  // names, see rootRows
+  static String chunkKey(const uInt modelHash, const Int field, const Int spw,
+			 const IPosition& shape, const Vector<Int>& chans,
+			 const Vector<uInt>& rowIds, const Vector<Double>& times);
+
+  // Get the prediction of key for the MS msName into mod, from memory or
+  // else from disk; False if there is none of the given shape
+  static Bool get(const String& msName, const String& key, const IPosition& shape,
+		  Cube<Complex>& mod);
+
+  // Keep the prediction of key for the MS msName
+  static void put(const String& msName, const String& key, const Cube<Complex>& mod);
+
+  // Drop all the entries of the MS
+  static void invalidate(const MeasurementSet& ms);
+
+  // Number of get calls that found and did not find a prediction
+  // <group>
+  static void statistics(Int64& hits, Int64& misses);
+  static void resetStatistics();
+  // </group>
+
+ private:
+  static void init();
+  static void invalidateLocked(const String& msName);
+  static String filePrefix(const String& msName);
+  static void putMemory(const String& msName, const String& key, const Cube<Complex>& mod);
+
+  static Mutex mutex_p;
+  static Bool initialized_p;
+  static Int64 maxBytes_p, bytes_p;
+  static String cacheDir_p;
+  //every cache directory used by this process
+  static std::set<String> cacheDirs_p;
+  //predictions of each MS by key, and the order they were made in
+  static std::map<String, std::map<String, Cube<Complex> > > registry_p;
+  static std::list<std::pair<String, String> > order_p;
+  static Int64 hits_p, misses_p;
+  //row numbers of the last selection given to rootRows in its root table
+  static String rowsTable_p;
+  static Vector<uInt> rowsRoot_p;
+};
+
+} //# NAMESPACE CASA - END
+#endif // SYNTHESIS_MODELVISCACHE_H
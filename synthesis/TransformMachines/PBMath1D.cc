@@ -54,14 +54,75 @@
 #include <coordinates/Coordinates/Projection.h>
  #include <coordinates/Coordinates/CoordinateUtil.h>
 
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Containers/Block.h>
 #include <casa/BasicSL/String.h>
 #include <casa/Utilities/Assert.h>
 #include <casa/Exceptions/Error.h>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 
+// Number of pixels PBMath1D::apply handles in one sweep
+static const Double maxApplyChunkPixels = 33554432.0;
+
+// The taper applied at each entry of the voltage pattern, so that the
+// pixel loops are reduced to a table lookup and a multiply
+static void complexTaperTable(Vector<Complex>& table, const Vector<Complex>& vp,
+			      const Int iPower, const Bool conjugate, const Bool inverse,
+			      const Bool forward, const Float cutoff)
+{
+  const uInt n = vp.nelements();
+  table.resize(n);
+  for (uInt i=0; i<n; i++) {
+    Complex taper;
+    if (norm(vp(i)) > 0.0) {
+      if(iPower==2) {
+	taper = vp(i) * conj(vp(i));
+      }
+      else {
+	taper = vp(i);
+      }
+    } else {
+      taper = 0.0;
+    }
+    if (conjugate) {
+      taper =  conj(taper);
+    }
+    // Differentiate between forward (Sky->UV) and
+    // inverse (UV->Sky) - these need different
+    // applications of the PB
+    if(!forward) {
+      taper =  conj(taper);
+    }
+    if (inverse) {
+      table(i) = (abs(taper) < cutoff) ? Complex(0.0) : Complex(1.0)/taper;
+    } else {
+      table(i) = taper;
+    }
+  }
+}
+
+static void floatTaperTable(Vector<Float>& table, const Vector<Complex>& vp,
+			    const Int ipower)
+{
+  const uInt n = vp.nelements();
+  table.resize(n);
+  for (uInt i=0; i<n; i++) {
+    Float taper = 0.0;
+    if (norm(vp(i)) > 0.0) {
+      taper = real(vp(i) * conj(vp(i)));
+      if(ipower==4)
+	taper *= taper;
+    }
+    table(i) = taper;
+  }
+}
+
 PBMath1D::PBMath1D()
   : composite_p(2048)
 {
@@ -494,214 +555,187 @@ PBMath1D::apply(const ImageInterface<Complex>& in,
        << ySquintPixCache(1, 0) << endl;
   */
 
-  // Iterate through in minimum IO/Memory chunks
-  //IPosition ncs = in.niceCursorShape();
-  IPosition ncs=in.shape();
-  ncs(2) = 1; ncs(3) = 1;
-  RO_LatticeIterator<Complex> li(in, LatticeStepper(in.shape(), ncs, IPosition(4,0,1,2,3) )  );
-  LatticeIterator<Complex> oli(out, LatticeStepper(in.shape(), ncs, IPosition(4,0,1,2,3)) );
-
-  Complex taper;
-  //Float r2=0.0;
-  //Float r=0.0;
-
   Vector<Double> increment = directionCoord.increment();
   Int rrplane = -1;
   Int llplane = -1;
   stokesCoord.toPixel( rrplane, Stokes::RR );
   stokesCoord.toPixel( llplane, Stokes::LL );
 
-  /*
-  cout << "stokes types in image = " << stokesCoord.stokes() << endl;
-  cout << "rr plane = " << rrplane << "   ll plane = " << llplane << endl;
+  // Radii from the unsquinted pointing, shared by all the planes that
+  // are not squinted.  The grid is as large as a plane of the image, so
+  // it is only kept for this call.
+  const IPosition shape = in.shape();
+  const Int nx = shape(0);
+  const Int ny = shape(1);
+  const Int npol = shape(2);
+  Matrix<Float> grid;
+  radiusGrid(grid, nx, ny, nonSquintedPointingPixel(0),
+	     nonSquintedPointingPixel(1), increment);
+
+  // Without a wideband fit one taper table serves every channel
+  Block<Vector<Complex> > tables(1);
+  if (!wideFit_p) {
+    complexTaperTable(tables[0], vp_p, iPower, conjugate, inverse, forward, cutoff);
+  }
 
-  */
-  Double xPixel;  Double yPixel;
-
-  Int laststokes = -1;
-  Int lastChan = -1;
-  Int ichan;
-  Int istokes;
-  Int ix0, iy0;
-  //Int indx;
+  // Work through the image in chunks of whole channels, all the planes of
+  // a chunk being done in one parallel sweep
+  const Int nchanChunk = max(1, min(nchan, Int(maxApplyChunkPixels/(Double(nx)*ny*npol))));
+  LatticeStepper stepper(shape, IPosition(4, nx, ny, npol, nchanChunk),
+			 IPosition(4, 0, 1, 2, 3), LatticeStepper::RESIZE);
+  RO_LatticeIterator<Complex> li(in, stepper);
+  LatticeIterator<Complex> oli(out, stepper);
   for(li.reset(),oli.reset();!li.atEnd();li++,oli++) {
-
-    IPosition itsShape(li.matrixCursor().shape());
-    IPosition loc(li.position());
-
-    ichan = loc(3);
-    istokes = loc(2);
-    iy0 = loc(1);
-    ix0 = loc(0);
-
-    // determine the pointing: RR, LL, or Center? We make a slight mistake
-    // here since we ignore the difference between the RR beam and the
-    // RL beam, say. The latter is slightly smaller because of the
-    // squint. Hence this code should be deprecated in favor of the
-    // correct 2D version (when mosaicing in polarization)
-    if ((doSquint == BeamSquint::RR) ||
-	((doSquint == BeamSquint::GOFIGURE) && (istokes == rrplane)) ) {
-      xPixel = xSquintPixCache(0, ichan);
-      yPixel = ySquintPixCache(0, ichan);
-    } else if ((doSquint == BeamSquint::LL) ||
-	       ((doSquint == BeamSquint::GOFIGURE) && (istokes == llplane)) ) {
-      xPixel = xSquintPixCache(1, ichan);
-      yPixel = ySquintPixCache(1, ichan);
-    } else {
-      xPixel = nonSquintedPointingPixel(0);
-      yPixel = nonSquintedPointingPixel(1);
-    }
-
-    if (istokes != laststokes) {
-      // cout << "Stokes = " << istokes << " pix = " << xPixel << ", " << yPixel << endl;
-      laststokes = istokes;
-    }
-
-    Double factor = 60.0 * spectralCache(ichan)/1.0e+9 ;  // arcminutes * GHz
-    Double rmax2 = square( maximumRadius_p.getValue("'") / factor );
+    const Int chan0 = li.position()(3);
+    const Int nc = li.cursorShape()(3);
+    const Int nplanes = npol*nc;
     if (wideFit_p) {
-      // fill vp with interpolated values for current frequency
-      if (ichan!=lastChan) {
-        Int nFreq = wFreqs_p.nelements();
-	Int ifit;
-        for (ifit=0; ifit<nFreq; ifit++) {
-	  if (spectralCache(ichan)<=wFreqs_p(ifit)) break;
-	}
-	if (ifit==0) {
-	  vp_p = wbvp_p.column(0);
-	} else if (ifit==nFreq) {
-	  vp_p = wbvp_p.column(nFreq-1);
-	} else {
-	  Float l = (spectralCache(ichan) - wFreqs_p(ifit-1))/
-	    (wFreqs_p(ifit)-wFreqs_p(ifit-1));
-	  vp_p = wbvp_p.column(ifit-1)*(1-l) + wbvp_p.column(ifit)*l;
-	}
-      }
+      tables.resize(nc, True, False);
     }
-		       
-    Vector<Float> rx2(itsShape(0));
-    Vector<Float> ry2(itsShape(1));
-    for(Int ix=0;ix<itsShape(0);ix++) {
-      rx2(ix) =  square( increment(0)*((Double)(ix+ix0) - xPixel) );
-    }
-    for(Int iy=0;iy<itsShape(1);iy++) {
-      ry2(iy) =  square( increment(1)*((Double)(iy+iy0) - yPixel) );
-    }
-    const Matrix<Complex>& inmat = li.matrixCursor();
-    Matrix<Complex>& outmat=oli.rwMatrixCursor();
-
-    Bool incopy, outcopy, del;
-    const Complex * inpoint = inmat.getStorage(incopy);
-    Complex *outpoint =outmat.getStorage(outcopy);
-    Float * rx2point = rx2.getStorage(del);
-    Float * ry2point= ry2.getStorage(del);
-    Complex* vppoint=vp_p.getStorage(del);
-    Int nx=itsShape(0);
-    Int ny=itsShape(1);
-    Double inverseIncrementRadius=inverseIncrementRadius_p;
-#pragma omp parallel default(none) firstprivate(inpoint, outpoint, rx2point, ry2point, vppoint, iPower, conjugate, inverse, forward, nx, ny, rmax2, factor, inverseIncrementRadius, cutoff)
-    {
-#pragma omp for   
-    for(Int iy=0;iy<ny;iy++) {
-      Float ry2val=ry2point[iy];
-      applyXLine(inpoint, outpoint , rx2point , vppoint , ry2val, iPower, conjugate, inverse, forward, nx, iy, rmax2, 
-		 factor, inverseIncrementRadius, cutoff);
-      /*for(Int ix=0;ix<itsShape(0);ix++) {
-
-	r2 =  rx2(ix) +  ry2(iy);
-	
-	if (r2 > rmax2) {
-	  oli.rwMatrixCursor()(ix, iy) = 0.0;
+    Vector<Int> planeTable(nplanes, 0);
+    Vector<Double> planeX(nplanes), planeY(nplanes), planeScale(nplanes);
+    Vector<Float> planeRmax(nplanes);
+    for (Int c=0; c<nc; c++) {
+      const Int ichan = chan0 + c;
+      const Double factor = 60.0 * spectralCache(ichan)/1.0e+9 ;  // arcminutes * GHz
+      if (wideFit_p) {
+	interpolateWideBandVP(spectralCache(ichan));
+	complexTaperTable(tables[c], vp_p, iPower, conjugate, inverse, forward, cutoff);
+      }
+      for (Int istokes=0; istokes<npol; istokes++) {
+	const Int p = istokes + c*npol;
+	// determine the pointing: RR, LL, or Center? We make a slight mistake
+	// here since we ignore the difference between the RR beam and the
+	// RL beam, say. The latter is slightly smaller because of the
+	// squint. Hence this code should be deprecated in favor of the
+	// correct 2D version (when mosaicing in polarization)
+	if ((doSquint == BeamSquint::RR) ||
+	    ((doSquint == BeamSquint::GOFIGURE) && (istokes == rrplane)) ) {
+	  planeX(p) = xSquintPixCache(0, ichan);
+	  planeY(p) = ySquintPixCache(0, ichan);
+	} else if ((doSquint == BeamSquint::LL) ||
+		   ((doSquint == BeamSquint::GOFIGURE) && (istokes == llplane)) ) {
+	  planeX(p) = xSquintPixCache(1, ichan);
+	  planeY(p) = ySquintPixCache(1, ichan);
 	} else {
-	  r = sqrt(r2) * factor;
-	  indx = Int(r*inverseIncrementRadius_p);
-	  if (norm(vp_p(indx)) > 0.0) {
-	    if(iPower==2) {
-	      taper = vp_p(indx) * conj(vp_p(indx));
-	    }
-	    else {
-	      taper = vp_p(indx);
-	    }
-	  } else {
-	    taper = 0.0;
-	  }
-	  if (conjugate) {
-	    taper =  conj(taper);
-	  }
-	  // Differentiate between forward (Sky->UV) and
-	  // inverse (UV->Sky) - these need different
-	  // applications of the PB
-	  if(!forward) {
-	    taper =  conj(taper);
-	  }
-	  if (inverse) {
-	    if (abs(taper) < cutoff ) {
-	      oli.rwMatrixCursor()(ix, iy) = 0.0;
-	    } else {
-	      oli.rwMatrixCursor()(ix, iy) = li.matrixCursor()(ix, iy) / taper ;
-	    }
-	  } else {  // not inverse!
-	    oli.rwMatrixCursor()(ix, iy) = li.matrixCursor()(ix, iy) * taper;
-	  }
+	  planeX(p) = nonSquintedPointingPixel(0);
+	  planeY(p) = nonSquintedPointingPixel(1);
 	}
+	if (wideFit_p) planeTable(p) = c;
+	planeScale(p) = factor*inverseIncrementRadius_p;
+	planeRmax(p) = maximumRadius_p.getValue("'") / factor;
       }
-      */
     }
-    } //end pragma
-    outmat.putStorage(outpoint, outcopy);
-    inmat.freeStorage(inpoint, incopy);
+    applyPlanes(li.cursor(), oli.rwCursor(), tables, planeTable, planeX, planeY,
+		planeScale, planeRmax, grid, nonSquintedPointingPixel(0),
+		nonSquintedPointingPixel(1), increment);
   }
 
   return out;
 
 };
 
-  void PBMath1D::applyXLine(const Complex*& in, Complex*& out, Float*& rx2, Complex*& vp, const Float ry2, const Int ipower, const Bool conjugate, const Bool inverse, const Bool forward, const Int nx, const Int iy, const Double rmax2, const Double factor, const Double inverseIncrementRadius, const Float cutoff)
-{ 
-  Float r;
-  Int indx;
-  Complex taper;
+void PBMath1D::interpolateWideBandVP(const Double freq)
+{
+  Int nFreq = wFreqs_p.nelements();
+  Int ifit;
+  for (ifit=0; ifit<nFreq; ifit++) {
+    if (freq<=wFreqs_p(ifit)) break;
+  }
+  if (ifit==0) {
+    vp_p = wbvp_p.column(0);
+  } else if (ifit==nFreq) {
+    vp_p = wbvp_p.column(nFreq-1);
+  } else {
+    Float l = (freq - wFreqs_p(ifit-1))/
+      (wFreqs_p(ifit)-wFreqs_p(ifit-1));
+    vp_p = wbvp_p.column(ifit-1)*(1-l) + wbvp_p.column(ifit)*l;
+  }
+}
+
+void PBMath1D::radiusGrid(Matrix<Float>& grid, const Int nx, const Int ny,
+			  const Double xPixel, const Double yPixel,
+			  const Vector<Double>& increment)
+{
+  grid.resize(nx, ny);
+  Vector<Float> rx2(nx);
   for(Int ix=0;ix<nx;ix++) {
-    
-    Float r2 =  rx2[ix] +  ry2;
-	
-    if (r2 > rmax2){
-      out[ix+iy*nx] = 0.0;
-    } 
-    else {
-      r = sqrt(r2) * factor;
-      indx = Int(r*inverseIncrementRadius);
-      if (norm(vp[indx]) > 0.0) {
-	if(ipower==2) {
-	  taper = vp[indx] * conj(vp[indx]);
-	}
-	else {
-	  taper = vp[indx];
-	}
-      } else {
-	taper = 0.0;
+    rx2(ix) = square( increment(0)*((Double)ix - xPixel) );
+  }
+  Bool del;
+  Float* gridStor = grid.getStorage(del);
+  const Float* rx2Stor = rx2.getStorage(del);
+  const Double dy = increment(1);
+#pragma omp parallel for default(none) firstprivate(gridStor, rx2Stor, nx, ny, dy, yPixel)
+  for(Int iy=0;iy<ny;iy++) {
+    const Float ry2 = square( dy*((Double)iy - yPixel) );
+    for(Int ix=0;ix<nx;ix++) {
+      gridStor[ix+iy*nx] = sqrt(rx2Stor[ix] + ry2);
+    }
+  }
+  grid.putStorage(gridStor, del);
+  rx2.freeStorage(rx2Stor, del);
+}
+
+template <class T>
+void PBMath1D::applyPlanes(const Array<T>& in, Array<T>& out,
+			   const Block<Vector<T> >& tables, const Vector<Int>& planeTable,
+			   const Vector<Double>& planeX, const Vector<Double>& planeY,
+			   const Vector<Double>& planeScale, const Vector<Float>& planeRmax,
+			   const Matrix<Float>& grid, const Double gridX, const Double gridY,
+			   const Vector<Double>& increment)
+{
+  const Int nx = in.shape()(0);
+  const Int ny = in.shape()(1);
+  const Int nplanes = planeTable.nelements();
+
+  // Squinted planes are not centred on the grid and get their own offsets
+  Block<Vector<Float> > rx2(nplanes), ry2(nplanes);
+  for (Int p=0; p<nplanes; p++) {
+    if (planeX(p) != gridX || planeY(p) != gridY) {
+      rx2[p].resize(nx);
+      ry2[p].resize(ny);
+      for(Int ix=0;ix<nx;ix++) {
+	rx2[p](ix) = square( increment(0)*((Double)ix - planeX(p)) );
       }
-      if (conjugate) {
-	taper =  conj(taper);
+      for(Int iy=0;iy<ny;iy++) {
+	ry2[p](iy) = square( increment(1)*((Double)iy - planeY(p)) );
       }
-      // Differentiate between forward (Sky->UV) and
-      // inverse (UV->Sky) - these need different
-      // applications of the PB
-      if(!forward) {
-	taper =  conj(taper);
+    }
+  }
+
+  Bool incopy, outcopy, del;
+  const T* inStor = in.getStorage(incopy);
+  T* outStor = out.getStorage(outcopy);
+  const Float* gridStor = grid.getStorage(del);
+  const Int nlines = nplanes*ny;
+#pragma omp parallel for schedule(static)
+  for (Int line=0; line<nlines; line++) {
+    const Int p = line / ny;
+    const Int iy = line % ny;
+    const T* table = tables[planeTable(p)].data();
+    const Double scale = planeScale(p);
+    const Float rmax = planeRmax(p);
+    const T* inLine = inStor + Int64(line)*nx;
+    T* outLine = outStor + Int64(line)*nx;
+    if (rx2[p].nelements() == 0) {
+      const Float* radius = gridStor + Int64(iy)*nx;
+      for (Int ix=0; ix<nx; ix++) {
+	outLine[ix] = (radius[ix] > rmax) ? T(0) : inLine[ix] * table[Int(radius[ix]*scale)];
       }
-      if (inverse) {
-	if (abs(taper) < cutoff ) {
-	  out[ix+iy*nx] = 0.0;
-	} else {
-	  out[ix+iy*nx]  = (in[ix+iy*nx]) / taper ;
-	}
-      } else {  // not inverse!
-	out[ix+iy*nx]  = (in[ix+iy*nx]) * taper ;
+    } else {
+      const Float* rx2p = rx2[p].data();
+      const Float ry2p = ry2[p](iy);
+      for (Int ix=0; ix<nx; ix++) {
+	const Float r = sqrt(rx2p[ix] + ry2p);
+	outLine[ix] = (r > rmax) ? T(0) : inLine[ix] * table[Int(r*scale)];
       }
     }
   }
-};
+  in.freeStorage(inStor, incopy);
+  out.putStorage(outStor, outcopy);
+  grid.freeStorage(gridStor, del);
+}
 
 ImageInterface<Float>& 
 PBMath1D::apply(const ImageInterface<Float>& in,
@@ -821,112 +855,76 @@ PBMath1D::apply(const ImageInterface<Float>& in,
   }
 
 
-  // Iterate through in minimum IO/Memory chunks
-  IPosition ncs = in.niceCursorShape();
-  ncs(2) = 1; ncs(3) = 1;
-  RO_LatticeIterator<Float> li(in, LatticeStepper(in.shape(), ncs, IPosition(4,0,1,2,3) )  );
-  LatticeIterator<Float> oli(out, LatticeStepper(in.shape(), ncs, IPosition(4,0,1,2,3)) );
-
-  Float taper;
-  Float r2=0.0;
-  Float r=0.0;
-
   Vector<Double> increment = directionCoord.increment();
   Int rrplane = -1;
   Int llplane = -1;
   stokesCoord.toPixel( rrplane, Stokes::RR );
   stokesCoord.toPixel( llplane, Stokes::LL );
 
-  Double xPixel;  Double yPixel;
-
-  Int laststokes = -1;
-  Int lastChan   = -1;
-  Int ichan;
-  Int istokes;
-  Int ix0, iy0;
-  Int indx;
+  // Radii from the unsquinted pointing, shared by all the planes that
+  // are not squinted.  The grid is as large as a plane of the image, so
+  // it is only kept for this call.
+  const IPosition shape = in.shape();
+  const Int nx = shape(0);
+  const Int ny = shape(1);
+  const Int npol = shape(2);
+  Matrix<Float> grid;
+  radiusGrid(grid, nx, ny, nonSquintedPointingPixel(0),
+	     nonSquintedPointingPixel(1), increment);
+
+  // Without a wideband fit one taper table serves every channel
+  Block<Vector<Float> > tables(1);
+  if (!wideFit_p) {
+    floatTaperTable(tables[0], vp_p, ipower);
+  }
 
+  // Work through the image in chunks of whole channels, all the planes of
+  // a chunk being done in one parallel sweep
+  const Int nchanChunk = max(1, min(nchan, Int(maxApplyChunkPixels/(Double(nx)*ny*npol))));
+  LatticeStepper stepper(shape, IPosition(4, nx, ny, npol, nchanChunk),
+			 IPosition(4, 0, 1, 2, 3), LatticeStepper::RESIZE);
+  RO_LatticeIterator<Float> li(in, stepper);
+  LatticeIterator<Float> oli(out, stepper);
   for(li.reset(),oli.reset();!li.atEnd();li++,oli++) {
-
-    IPosition itsShape(li.matrixCursor().shape());
-    IPosition loc(li.position());
-
-    ichan = loc(3);
-    istokes = loc(2);
-    iy0 = loc(1);
-    ix0 = loc(0);
-
-    // determine the pointing: RR, LL, or Center?
-    if ((doSquint == BeamSquint::RR) ||
-	((doSquint == BeamSquint::GOFIGURE) && (istokes == rrplane)) ) {
-      xPixel = xSquintPixCache(0, ichan);
-      yPixel = ySquintPixCache(0, ichan);
-    } else if ((doSquint == BeamSquint::LL) ||
-	       ((doSquint == BeamSquint::GOFIGURE) && (istokes == llplane ))) {
-      xPixel = xSquintPixCache(1, ichan);
-      yPixel = ySquintPixCache(1, ichan);
-    } else {
-      xPixel = nonSquintedPointingPixel(0);
-      yPixel = nonSquintedPointingPixel(1);
-    }
-  
-    if (istokes != laststokes) {
-      //      cout << "Stokes = " << istokes << " pix = " << xPixel << ", " << yPixel << endl;
-      laststokes = istokes;
-    }
-
-    Double factor = 60.0 * spectralCache(ichan)/1.0e+9 ;  // arcminutes * GHz
-    Double rmax2 = square( maximumRadius_p.getValue("'") / factor );
+    const Int chan0 = li.position()(3);
+    const Int nc = li.cursorShape()(3);
+    const Int nplanes = npol*nc;
     if (wideFit_p) {
-      // fill vp with interpolated values for current frequency
-      if (ichan!=lastChan) {
-	Int ifit=0;
-	Int nFreq=wFreqs_p.nelements();
-        for (ifit=0; ifit<nFreq; ifit++) {
-	  if (spectralCache(ichan)<=wFreqs_p(ifit)) break;
-	}
-	if (ifit==0) {
-	  vp_p = wbvp_p.column(0);
-	} else if (ifit==nFreq) {
-	  vp_p = wbvp_p.column(nFreq-1);
-	} else {
-	  Float l = (spectralCache(ichan) - wFreqs_p(ifit-1))/
-	    (wFreqs_p(ifit)-wFreqs_p(ifit-1));
-	  vp_p = wbvp_p.column(ifit-1)*(1-l) + wbvp_p.column(ifit)*l;
-	}
-	lastChan = ichan;
-      }
+      tables.resize(nc, True, False);
     }
-
-    Vector<Float> rx2(itsShape(0));
-    Vector<Float> ry2(itsShape(1));
-    for(Int ix=0;ix<itsShape(0);ix++) {
-      rx2(ix) =  square( increment(0)*((Double)(ix+ix0) - xPixel) );
-    }
-    for(Int iy=0;iy<itsShape(1);iy++) {
-      ry2(iy) =  square( increment(1)*((Double)(iy+iy0) - yPixel) );
-    }
-
-    for(Int iy=0;iy<itsShape(1);iy++) {
-      for(Int ix=0;ix<itsShape(0);ix++) {
-
-	r2 =  rx2(ix) +  ry2(iy);
-	if (r2 > rmax2) {
-	  oli.rwMatrixCursor()(ix, iy) = 0.0;
+    Vector<Int> planeTable(nplanes, 0);
+    Vector<Double> planeX(nplanes), planeY(nplanes), planeScale(nplanes);
+    Vector<Float> planeRmax(nplanes);
+    for (Int c=0; c<nc; c++) {
+      const Int ichan = chan0 + c;
+      const Double factor = 60.0 * spectralCache(ichan)/1.0e+9 ;  // arcminutes * GHz
+      if (wideFit_p) {
+	interpolateWideBandVP(spectralCache(ichan));
+	floatTaperTable(tables[c], vp_p, ipower);
+      }
+      for (Int istokes=0; istokes<npol; istokes++) {
+	const Int p = istokes + c*npol;
+	// determine the pointing: RR, LL, or Center?
+	if ((doSquint == BeamSquint::RR) ||
+	    ((doSquint == BeamSquint::GOFIGURE) && (istokes == rrplane)) ) {
+	  planeX(p) = xSquintPixCache(0, ichan);
+	  planeY(p) = ySquintPixCache(0, ichan);
+	} else if ((doSquint == BeamSquint::LL) ||
+		   ((doSquint == BeamSquint::GOFIGURE) && (istokes == llplane ))) {
+	  planeX(p) = xSquintPixCache(1, ichan);
+	  planeY(p) = ySquintPixCache(1, ichan);
 	} else {
-	  r = sqrt(r2) * factor;
-	  indx = Int(r*inverseIncrementRadius_p);
-	  if (norm(vp_p(indx)) > 0.0) {
-	    taper = real(vp_p(indx) * conj(vp_p(indx)));
-	    if(ipower==4)
-	      taper *= taper;
-	  } else {
-	    taper = 0.0;
-	  }
-	  oli.rwMatrixCursor()(ix, iy) = li.matrixCursor()(ix, iy) * taper;
+	  planeX(p) = nonSquintedPointingPixel(0);
+	  planeY(p) = nonSquintedPointingPixel(1);
 	}
+	if (wideFit_p) planeTable(p) = c;
+	planeScale(p) = factor*inverseIncrementRadius_p;
+	planeRmax(p) = maximumRadius_p.getValue("'") / factor;
       }
     }
+    applyPlanes(li.cursor(), oli.rwCursor(), tables, planeTable, planeX, planeY,
+		planeScale, planeRmax, grid, nonSquintedPointingPixel(0),
+		nonSquintedPointingPixel(1), increment);
   }
   return out;
 
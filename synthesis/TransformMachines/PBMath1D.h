@@ -30,6 +30,7 @@
 #define SYNTHESIS_PBMATH1D_H
 
 #include <casa/aips.h>
+#include <casa/Containers/Block.h>
 #include <synthesis/TransformMachines/PBMathInterface.h>
 
 namespace casa { //# NAMESPACE CASA - BEGIN
@@ -268,8 +269,30 @@ protected:
   // PB' = azimuthal fit to: ( VP(x+s)**2 + VP(x-s)**2 )/2
   // VP' = sqrt(PB')
   void symmetrizeSquintedBeam();
-  
-  void applyXLine(const Complex*& in, Complex*& out, Float*& rx2, Complex*& vp, const Float ry2, const Int ipower, const Bool conjugate, const Bool inverse, const Bool forward, const Int nx, const Int iy, const Double rmax2, const Double factor, const Double inverseIncrementRadius, const Float cutoff);
+
+  // Set vp_p to the wideband voltage pattern interpolated to freq (Hz)
+  void interpolateWideBandVP(const Double freq);
+
+  // Fill grid with the radius (in the units of increment) of every pixel
+  // of an nx by ny plane from the pixel position (xPixel, yPixel)
+  static void radiusGrid(Matrix<Float>& grid, const Int nx, const Int ny,
+			 const Double xPixel, const Double yPixel,
+			 const Vector<Double>& increment);
+
+  // Multiply (or divide) a chunk of whole (x, y, stokes, chan) planes by
+  // the beam in one parallel sweep. Each plane p is centred on
+  // (planeX(p), planeY(p)), uses the taper lookup table
+  // tables[planeTable(p)] indexed by radius*planeScale(p), and is zero
+  // beyond planeRmax(p). Planes centred on (gridX, gridY) use grid
+  // instead of computing their radii.
+  template <class T>
+  void applyPlanes(const Array<T>& in, Array<T>& out,
+		   const Block<Vector<T> >& tables, const Vector<Int>& planeTable,
+		   const Vector<Double>& planeX, const Vector<Double>& planeY,
+		   const Vector<Double>& planeScale, const Vector<Float>& planeRmax,
+		   const Matrix<Float>& grid, const Double gridX, const Double gridY,
+		   const Vector<Double>& increment);
+
   // The parameterized representation is for the VP, not the PB.
   // Internally, a reference frequency of 1 GHz is used, and the
   // radius is in units of arcminutes.
@@ -45,6 +45,7 @@
 #include <msvis/MSVis/VisBuffer2.h>
 #include <msvis/MSVis/VisBuffer2Adapter.h>
 #include <synthesis/TransformMachines/VisModelData.h>
+#include <synthesis/TransformMachines/ModelVisCache.h>
 #include <synthesis/TransformMachines/FTMachine.h>
 #include <synthesis/TransformMachines/SimpleComponentFTMachine.h>
 #include <synthesis/TransformMachines/GridFT.h>
@@ -165,6 +166,7 @@ void VisModelData::removeRecordByKey(MeasurementSet& theMS, const String& theKey
 
 void VisModelData::clearModel(const MeasurementSet& thems){
   //  Table newTab(thems);
+  ModelVisCache::invalidate(thems);
   MeasurementSet& newTab=const_cast<MeasurementSet& >(thems);
   if(!newTab.isWritable())
     return;
@@ -233,6 +235,7 @@ void VisModelData::clearModel(const MeasurementSet& thems){
   }
 }
   void VisModelData::clearModel(const MeasurementSet& thems, const String field, const String specwindows){
+    ModelVisCache::invalidate(thems);
     MeasurementSet& newTab=const_cast<MeasurementSet& >(thems);
   Vector<String> theParts(newTab.getPartNames(True));
   if(theParts.nelements() > 1){
@@ -656,6 +659,7 @@ Bool VisModelData::isModelDefined(const Int fieldId, const MeasurementSet& thems
 void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface& rec, const Vector<Int>& validfieldids, const Vector<Int>& spws, const Vector<Int>& starts, const Vector<Int>& nchan,  const Vector<Int>& incr, Bool iscomponentlist, Bool incremental){
 
   LogIO logio;
+  ModelVisCache::invalidate(thems);
 
   try{
     //A field can have multiple FTmachines and ComponentList associated with it 
@@ -780,6 +784,8 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 	  ftrec.get("fields", fields);
 	  ftrec.get("spws", spws);
 	  if(anyEQ(spws, vb.spectralWindow())){
+	    //Keys the model visibility cache
+	    const uInt rechash=ModelVisCache::recordHash(ftrec);
 	    indexft=ftholder_p.nelements();
 	    ftholder_p.resize(indexft+1, False, True);
 	    ftholder_p[indexft].resize(1);
@@ -806,6 +812,8 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 		else{
 		  ftindex_p(spws[spi], fields[fi], vb.msId())=indexft;
 		}
+		modelhash_p(spws[spi], fields[fi], vb.msId())=
+		  ModelVisCache::combineHash(modelhash_p(spws[spi], fields[fi], vb.msId()), rechash);
 	      }
 	    }
 	  }
@@ -829,6 +837,8 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 	  clrec.get("fields", fields);
 	  clrec.get("spws", spws);
 	  if(anyEQ(spws, vb.spectralWindow())){
+	    //Keys the model visibility cache
+	    const uInt rechash=ModelVisCache::recordHash(clrec);
 	    indexcl=clholder_p.nelements();
 	    clholder_p.resize(indexcl+1, False, True);
 	    clholder_p[indexcl].resize(1);
@@ -855,6 +865,8 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 		else{
 		  clindex_p(spws[spi], fields[fi], vb.msId())=indexcl;
 		}
+		modelhash_p(spws[spi], fields[fi], vb.msId())=
+		  ModelVisCache::combineHash(modelhash_p(spws[spi], fields[fi], vb.msId()), rechash);
 	      }
 	    }
 	  }
@@ -907,6 +919,9 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
       newind.set(-1);
       newind(IPosition(3, 0,0,0), (oldcubeShape-1))=clindex_p;
       clindex_p.assign(newind);
+      Cube<uInt> newhash(newind.shape(), 0u);
+      newhash(IPosition(3, 0,0,0), (oldcubeShape-1))=modelhash_p;
+      modelhash_p.assign(newhash);
     }
 
     if( (clindex_p(spw, field, msid) + ftindex_p(spw, field, msid)) < -2)
@@ -932,6 +947,27 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 
     Vector<CountedPtr<ComponentList> >cl=getCL(vb.msId(), vb.fieldId(), vb.spectralWindow());
     Vector<CountedPtr<FTMachine> > ft=getFT(vb.msId(), vb.fieldId(), vb.spectralWindow());
+    //The VisBuffer2Adapter cannot give the channels of the chunk
+    String cachems("");
+    String cachekey("");
+    if((cl.nelements() > 0 || ft.nelements() > 0) && ModelVisCache::enabled()
+       && dynamic_cast<vi::VisBuffer2Adapter*>(&vb) == 0){
+      const VisBuffer& cvb=vb;
+      cachems=cvb.msName();
+      const IPosition shape(3, cvb.nCorr(), cvb.nChannel(), cvb.nRow());
+      cachekey=ModelVisCache::chunkKey(modelhash_p(cvb.spectralWindow(), cvb.fieldId(), cvb.msId()),
+				       cvb.fieldId(), cvb.spectralWindow(), shape,
+				       cvb.channel(),
+				       (cvb.getVisibilityIterator() != 0) ?
+				       ModelVisCache::rootRows(cvb.getVisibilityIterator()->ms(), cvb.rowIds()) :
+				       cvb.rowIds(),
+				       cvb.time());
+      Cube<Complex> cached;
+      if(ModelVisCache::get(cachems, cachekey, shape, cached)){
+	vb.setModelVisCube(cached);
+	return True;
+      }
+    }
     //Fill the buffer with 0.0; also prevents reading from disk if MODEL_DATA exists
     ///Oh boy this is really dangerous...
     //nCorr etc are public..who know who changed these values before reaching here.
@@ -970,6 +1006,8 @@ void VisModelData::addModel(const RecordInterface& rec,  const Vector<Int>& /*ms
 	incremental=True;
       }      
     }
+    if(incremental && cachekey != "")
+      ModelVisCache::put(cachems, cachekey, vb.modelVisCube());
     if(!incremental){
       //No model was set so....
       ///Set the Model to 1.0 for parallel hand and 0.0 for x-hand
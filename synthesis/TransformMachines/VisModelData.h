@@ -135,6 +135,11 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 // <motivation>
 // </motivation>
 //
+// Predicted model visibilities are kept in the process-wide
+// <linkto class=ModelVisCache>ModelVisCache</linkto> when it is turned on,
+// so that repeated passes over the data (e.g. successive calibration
+// solves) do not predict the model again.
+//
 // <todo asof="2013/05/24">
 // Allow validity of models for a given section of time only
 //
@@ -231,6 +236,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   CountedPtr<ComponentFTMachine> cft_p;
   Cube<Int> ftindex_p;
   Cube<Int> clindex_p;
+  //combined hash of the model records serving each (spw, field, msid)
+  Cube<uInt> modelhash_p;
   static Bool initialize;
 };
 
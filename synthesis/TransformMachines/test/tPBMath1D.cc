@@ -0,0 +1,208 @@
+//# tPBMath1D.cc: check PBMath1D::applyPB and applyPB2 on a cube against
+//# the beam applied plane by plane
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <coordinates/Coordinates.h>
+#include <images/Images/TempImage.h>
+#include <lattices/Lattices/TiledShape.h>
+#include <measures/Measures/MDirection.h>
+#include <measures/Measures/Stokes.h>
+#include <synthesis/TransformMachines/PBMath1DGauss.h>
+
+#include <casa/namespace.h>
+
+namespace {
+
+const Int nx = 256;
+const Int ny = 200;
+const Int npol = 2;
+const Int nchan = 8;
+
+// A Gaussian beam that can also be applied the way PBMath1D::apply did
+// before it handled whole channel chunks: one (x, y) plane at a time,
+// with the radii and the taper of every pixel computed afresh.
+class PerPlanePBMath : public PBMath1DGauss {
+public:
+  PerPlanePBMath(Quantity halfWidth, Quantity maxRad, Quantity refFreq)
+    : PBMath1DGauss(halfWidth, maxRad, refFreq) {}
+
+  // Multiply in by the primary beam (ipower 2) or its square (ipower 4)
+  // pointing at pointDir, which must be in the frame of in.
+  template <class T>
+  void applyPerPlane(const ImageInterface<T>& in, ImageInterface<T>& out,
+                     const MDirection& pointDir, const Int ipower)
+  {
+    CoordinateSystem coords = in.coordinates();
+    DirectionCoordinate directionCoord =
+      coords.directionCoordinate(coords.findCoordinate(Coordinate::DIRECTION));
+    Vector<String> units(2);
+    units = "deg";
+    directionCoord.setWorldAxisUnits(units);
+    SpectralCoordinate spectralCoord =
+      coords.spectralCoordinate(coords.findCoordinate(Coordinate::SPECTRAL));
+    units.resize(1);
+    units = "Hz";
+    spectralCoord.setWorldAxisUnits(units);
+
+    Vector<Double> pointingPixel(2);
+    directionCoord.toPixel(pointingPixel, pointDir.getAngle().getValue("deg"));
+    const Vector<Double> increment = directionCoord.increment();
+    const Double xPixel = pointingPixel(0);
+    const Double yPixel = pointingPixel(1);
+
+    Vector<Double> spectralWorld(1), spectralPixel(1);
+    for (Int chan=0; chan<nchan; chan++) {
+      spectralPixel(0) = chan;
+      AlwaysAssert(spectralCoord.toWorld(spectralWorld, spectralPixel), AipsError);
+      const Double factor = 60.0 * spectralWorld(0)/1.0e+9;  // arcminutes * GHz
+      const Double rmax2 = square( maximumRadius_p.getValue("'") / factor );
+      for (Int pol=0; pol<npol; pol++) {
+        const IPosition start(4, 0, 0, pol, chan);
+        const IPosition shape(4, nx, ny, 1, 1);
+        const Matrix<T> inPlane(in.getSlice(start, shape, True));
+        Matrix<T> outPlane(nx, ny);
+        for (Int iy=0; iy<ny; iy++) {
+          const Float ry2 = square( increment(1)*((Double)iy - yPixel) );
+          for (Int ix=0; ix<nx; ix++) {
+            const Float r2 = square( increment(0)*((Double)ix - xPixel) ) + ry2;
+            if (r2 > rmax2) {
+              outPlane(ix, iy) = 0.0;
+              continue;
+            }
+            const Int indx = Int(sqrt(r2) * factor * inverseIncrementRadius_p);
+            Float taper = 0.0;
+            if (norm(vp_p(indx)) > 0.0) {
+              taper = real(vp_p(indx) * conj(vp_p(indx)));
+              if (ipower == 4) taper *= taper;
+            }
+            outPlane(ix, iy) = inPlane(ix, iy) * taper;
+          }
+        }
+        out.putSlice(outPlane, start);
+      }
+    }
+  }
+};
+
+CoordinateSystem cubeCoordinates()
+{
+  Matrix<Double> xform(2, 2);
+  xform = 0.0;
+  xform.diagonal() = 1.0;
+  DirectionCoordinate dirCoords(MDirection::J2000, Projection(Projection::SIN),
+                                135*C::pi/180.0, 60*C::pi/180.0,
+                                -10*C::pi/180.0/3600.0, 10*C::pi/180.0/3600.0,
+                                xform, nx/2, ny/2);
+  Vector<Int> stokes(npol);
+  stokes(0) = Stokes::RR;
+  stokes(1) = Stokes::LL;
+  StokesCoordinate stokesCoords(stokes);
+  // The beam shrinks by a third over the channels
+  SpectralCoordinate spectralCoords(MFrequency::TOPO, 1.0e9, 0.1e9, 0, 1.0e9);
+  CoordinateSystem coords;
+  coords.addCoordinate(dirCoords);
+  coords.addCoordinate(stokesCoords);
+  coords.addCoordinate(spectralCoords);
+  return coords;
+}
+
+// A different value in every pixel of every plane
+Array<Float> cubeValues()
+{
+  Array<Float> values(IPosition(4, nx, ny, npol, nchan));
+  IPosition pos(4);
+  for (pos(3)=0; pos(3)<nchan; pos(3)++)
+    for (pos(2)=0; pos(2)<npol; pos(2)++)
+      for (pos(1)=0; pos(1)<ny; pos(1)++)
+        for (pos(0)=0; pos(0)<nx; pos(0)++)
+          values(pos) = 1.0 + 0.01*((7*pos(0) + 3*pos(1) + pos(2) + 5*pos(3)) % 17);
+  return values;
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const CoordinateSystem coords = cubeCoordinates();
+    const TiledShape shape(IPosition(4, nx, ny, npol, nchan));
+    // A 4' half-width beam cut off at 12' / (frequency in GHz), which is
+    // inside the image at every channel.  It points between pixels, away
+    // from the image centre.
+    PerPlanePBMath pb(Quantity(4.0, "'"), Quantity(12.0, "'"), Quantity(1.0, "GHz"));
+    const MDirection pointing(Quantity(135.04, "deg"), Quantity(60.013, "deg"),
+                              MDirection::J2000);
+    const Array<Float> values = cubeValues();
+
+    // Tolerance for a pixel whose radius lands on the neighbouring
+    // entry of the 10000 entry beam table
+    const Float tol = 1.0e-3;
+
+    {
+      TempImage<Complex> in(shape, coords), out(shape, coords), expected(shape, coords);
+      Array<Complex> cvalues(values.shape());
+      convertArray(cvalues, values);
+      cvalues *= Complex(1.0, -0.5);
+      in.put(cvalues);
+      pb.applyPB(in, out, pointing);
+      pb.applyPerPlane(in, expected, pointing, 2);
+      AlwaysAssert(max(amplitude(expected.get())) > 0.5, AipsError);
+      AlwaysAssert(allNearAbs(out.get(), expected.get(), tol), AipsError);
+    }
+
+    TempImage<Float> in(shape, coords), out(shape, coords), expected(shape, coords);
+    in.put(values);
+    pb.applyPB(in, out, pointing);
+    pb.applyPerPlane(in, expected, pointing, 2);
+    AlwaysAssert(max(expected.get()) > 0.5, AipsError);
+    AlwaysAssert(allNearAbs(out.get(), expected.get(), tol), AipsError);
+
+    pb.applyPB2(in, out, pointing);
+    pb.applyPerPlane(in, expected, pointing, 4);
+    AlwaysAssert(max(expected.get()) > 0.5, AipsError);
+    AlwaysAssert(allNearAbs(out.get(), expected.get(), tol), AipsError);
+
+    // The corners of the image are beyond the beam's cut-off
+    AlwaysAssert(anyEQ(out.get(), Float(0.0)), AipsError);
+    AlwaysAssert(anyGT(out.get(), Float(0.0)), AipsError);
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
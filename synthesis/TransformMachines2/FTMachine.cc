@@ -77,6 +77,9 @@
 #include <casa/OS/Timer.h>
 #include <casa/sstream.h>
 #include <casa/iostream.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa{//# CASA namespace
 namespace refim {//# namespace refactor imaging
@@ -886,6 +889,116 @@ using namespace casa::vi;
     return numthreads_p;
   }
 
+  Int FTMachine::fftThreads() const {
+    Int nth=1;
+#ifdef _OPENMP
+    nth=omp_get_max_threads();
+    if(numthreads_p >0)
+      nth=min(numthreads_p, nth);
+#endif
+    return nth;
+  }
+
+  // Make sure there is an FFTServer per axis and thread, planned for
+  // lengths nx and ny in both directions. This is done serially since
+  // making FFT plans is not thread safe.
+  template <class T, class S>
+  static void fft2dServers(Block<CountedPtr<FFTServer<T, S> > >& servers,
+			   Block<Int>& lengths, Int nx, Int ny, Int nth)
+  {
+    if(servers.nelements() < uInt(2*nth)){
+      servers.resize(2*nth, False, True);
+      lengths.resize(2*nth, False, True);
+    }
+    for (Int k=0; k<2*nth; ++k){
+      Int len=(k%2==0) ? nx : ny;
+      if(servers[k].null() || lengths[k] != len){
+	servers[k]=new FFTServer<T, S>(IPosition(1, len), FFTEnums::COMPLEX);
+	Vector<S> warm(len, S(0.0));
+	servers[k]->fft(warm, True);
+	servers[k]->fft(warm, False);
+	lengths[k]=len;
+      }
+    }
+  }
+
+  template <class T, class S>
+  static void fft2dPlanes(Array<S>& grid, Bool toFrequency,
+			  Block<CountedPtr<FFTServer<T, S> > >& servers,
+			  Block<Int>& lengths, Int nth)
+  {
+    const Int nx=grid.shape()(0);
+    const Int ny=grid.shape()(1);
+    if(nx==0 || ny==0)
+      return;
+    const Int64 nplanes=grid.nelements()/(Int64(nx)*ny);
+    fft2dServers(servers, lengths, nx, ny, nth);
+
+    // The columns are copied a block at a time into contiguous buffers
+    const Int colBlock=16;
+    const Int64 nColBlocksPerPlane=(nx+colBlock-1)/colBlock;
+    const Int64 nColBlocks=nplanes*nColBlocksPerPlane;
+    Bool del;
+    S* data=grid.getStorage(del);
+    String errMsg("");
+#pragma omp parallel num_threads(nth)
+    {
+      Int t=0;
+#ifdef _OPENMP
+      t=omp_get_thread_num();
+#endif
+      FFTServer<T, S>& xfft=*servers[2*t];
+      FFTServer<T, S>& yfft=*servers[2*t+1];
+      Matrix<S> columns(ny, colBlock);
+      S* cols=columns.data();
+#pragma omp for schedule(static)
+      for (Int64 row=0; row<nplanes*ny; ++row){
+	try {
+	  Vector<S> xrow(IPosition(1, nx), data+row*nx, SHARE);
+	  xfft.fft(xrow, toFrequency);
+	}
+	catch (const AipsError& x) {
+#pragma omp critical(fft2dError)
+	  errMsg=x.getMesg();
+	}
+      }
+#pragma omp for schedule(static)
+      for (Int64 b=0; b<nColBlocks; ++b){
+	const Int64 plane=b/nColBlocksPerPlane;
+	const Int x0=Int(b%nColBlocksPerPlane)*colBlock;
+	const Int ncol=min(colBlock, nx-x0);
+	S* base=data+plane*nx*ny+x0;
+	for (Int y=0; y<ny; ++y)
+	  for (Int j=0; j<ncol; ++j)
+	    cols[j*ny+y]=base[Int64(y)*nx+j];
+	try {
+	  for (Int j=0; j<ncol; ++j){
+	    Vector<S> ycol(IPosition(1, ny), cols+j*ny, SHARE);
+	    yfft.fft(ycol, toFrequency);
+	  }
+	}
+	catch (const AipsError& x) {
+#pragma omp critical(fft2dError)
+	  errMsg=x.getMesg();
+	}
+	for (Int y=0; y<ny; ++y)
+	  for (Int j=0; j<ncol; ++j)
+	    base[Int64(y)*nx+j]=cols[j*ny+y];
+      }
+    }
+    grid.putStorage(data, del);
+    if(errMsg != "")
+      throw(AipsError("FTMachine::fft2d: "+errMsg));
+  }
+
+  void FTMachine::fft2d(Array<Complex>& grid, Bool toFrequency){
+    fft2dPlanes(grid, toFrequency, fftServers_p, fftLengths_p, fftThreads());
+  }
+
+  void FTMachine::fft2d(Array<DComplex>& grid, Bool toFrequency){
+    fft2dPlanes(grid, toFrequency, dfftServers_p, dfftLengths_p, fftThreads());
+  }
+
   //
   // Refocus the array on a point at finite distance
   //
@@ -43,6 +43,7 @@
 #include <images/Images/TempImage.h>
 #include <coordinates/Coordinates/SpectralCoordinate.h>
 #include <scimath/Mathematics/InterpolateArray1D.h>
+#include <scimath/Mathematics/FFTServer.h>
 #include <synthesis/TransformMachines/CFCache.h>
 #include <synthesis/TransformMachines/CFStore2.h>
 
@@ -464,6 +465,26 @@ protected:
   Array<Complex> griddedData;
   Array<DComplex> griddedData2;
 
+  // Transform every (x, y) plane of a grid shaped (nx, ny, npol, nchan) in
+  // place, with the origin at the centre as LatticeFFT::cfft2d does. The
+  // rows and then the columns of all the planes are shared out among
+  // fftThreads() threads.
+  // <group>
+  void fft2d(Array<Complex>& grid, Bool toFrequency);
+  void fft2d(Array<DComplex>& grid, Bool toFrequency);
+  // </group>
+
+  // The number of threads for fft2d and the grid correction that goes with
+  // it: numthreads_p if set, else all those OpenMP allows.
+  Int fftThreads() const;
+
+  // The FFTServers of fft2d, one per axis and thread, with the axis length
+  // each was planned for. They are kept so that the plans are made once.
+  Block<CountedPtr<FFTServer<Float, Complex> > > fftServers_p;
+  Block<Int> fftLengths_p;
+  Block<CountedPtr<FFTServer<Double, DComplex> > > dfftServers_p;
+  Block<Int> dfftLengths_p;
+
 
   Float pbLimit_p;
   //  Vector<SkyJones *> sj_p;
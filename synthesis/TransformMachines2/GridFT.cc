@@ -68,7 +68,12 @@
 #include <scimath/Mathematics/ConvolveGridder.h>
 #include <casa/Utilities/CompositeNumber.h>
 #include <casa/OS/Timer.h>
+#include <casa/System/AipsrcValue.h>
 #include <casa/sstream.h>
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
 #ifdef _OPENMP
 #include <omp.h>
 #endif
@@ -335,6 +340,46 @@ void GridFT::initializeToVis(ImageInterface<Complex>& iimage,
     
 }
 
+// Copy a window of width x height pixels of every plane from src to dst,
+// dividing by the gridding correction and multiplying by the factor of the
+// plane; gx0 and gy0 are the grid coordinates of the window. The
+// corrections of a block of rows are computed serially, since the gridder
+// is not to be shared among threads, and then applied by nth threads.
+template <class S>
+static void copyCorrected(const S* src, Int64 srcRow, Int64 srcPlane,
+			  Complex* dst, Int64 dstRow, Int64 dstPlane,
+			  Int width, Int height, Int nplanes, Int gx0, Int gy0,
+			  Int nx, ConvolveGridder<Double, Complex>& gridder,
+			  const Vector<Complex>& factor, Int nth)
+{
+  const Int rowBlock=max(64, 4*nth);
+  Matrix<Complex> corrections(nx, rowBlock);
+  Vector<Complex> correction(nx);
+  for (Int y0=0; y0<height; y0+=rowBlock) {
+    const Int nrows=min(rowBlock, height-y0);
+    for (Int j=0; j<nrows; ++j) {
+      gridder.correctX1D(correction, gy0+y0+j);
+      corrections.column(j)=correction;
+    }
+    const Complex* corr=corrections.data();
+#pragma omp parallel for num_threads(nth) schedule(static)
+    for (Int64 k=0; k<Int64(nrows)*nplanes; ++k) {
+      const Int j=Int(k%nrows);
+      const Int p=Int(k/nrows);
+      Complex* d=dst+p*dstPlane+(y0+j)*dstRow;
+      if(factor[p]==Complex(0.0)) {
+	for (Int x=0; x<width; ++x)
+	  d[x]=Complex(0.0);
+	continue;
+      }
+      const S* sr=src+p*srcPlane+(y0+j)*srcRow;
+      const Complex* c=corr+Int64(j)*nx+gx0;
+      for (Int x=0; x<width; ++x)
+	d[x]=(Complex(sr[x])/c[x])*factor[p];
+    }
+  }
+}
+
 void GridFT::prepGridForDegrid(){
   IPosition gridShape(4, nx, ny, npol, nchan);
   griddedData.resize(gridShape);
@@ -344,40 +389,27 @@ void GridFT::prepGridForDegrid(){
   //if(!usePut2_p) griddedData.set(0);
   griddedData.set(Complex(0.0));
 
-  IPosition stride(4, 1);
   IPosition blc(4, (nx-image->shape()(0)+(nx%2==0))/2, (ny-image->shape()(1)+(ny%2==0))/2, 0, 0);
-  IPosition trc(blc+image->shape()-stride);
-  
   IPosition start(4, 0);
-  griddedData(blc, trc) = image->getSlice(start, image->shape());
-  
-  //if(arrayLattice) delete arrayLattice; arrayLattice=0;
-  arrayLattice = new ArrayLattice<Complex>(griddedData);
-  lattice=arrayLattice;
-  //logIO() << LogIO::DEBUGGING
-  //	  << "Starting grid correction and FFT of image" << LogIO::POST;
-
-   // Do the Grid-correction. 
-   {
-     Vector<Complex> correction(nx);
-     correction=Complex(1.0, 0.0);
-     // Do the Grid-correction
-     IPosition cursorShape(4, nx, 1, 1, 1);
-     IPosition axisPath(4, 0, 1, 2, 3);
-     LatticeStepper lsx(lattice->shape(), cursorShape, axisPath);
-     LatticeIterator<Complex> lix(*lattice, lsx);
-     for(lix.reset();!lix.atEnd();lix++) {
-       gridder->correctX1D(correction, lix.position()(1));
-       lix.rwVectorCursor()/=correction;
-     }
-   }
-   image->clearCache();
-   // Now do the FFT2D in place
-   LatticeFFT::cfft2d(*lattice);
-   
-   //logIO() << LogIO::DEBUGGING
-   //	    << "Finished grid correction and FFT of image" << LogIO::POST;
-    
+  Array<Complex> model(image->getSlice(start, image->shape()));
+  image->clearCache();
+
+  // Grid-correct the image on its way into the centre of the grid; the
+  // rest of the grid is zero and needs no correction
+  const Int inx=image->shape()(0);
+  const Int iny=image->shape()(1);
+  Bool delModel, delGrid;
+  const Complex* modelStor=model.getStorage(delModel);
+  Complex* gridStor=griddedData.getStorage(delGrid);
+  copyCorrected(modelStor, inx, Int64(inx)*iny,
+		gridStor+blc(0)+Int64(blc(1))*nx, nx, Int64(nx)*ny,
+		inx, iny, npol*nchan, blc(0), blc(1), nx, *gridder,
+		Vector<Complex>(npol*nchan, Complex(1.0)), fftThreads());
+  model.freeStorage(modelStor, delModel);
+  griddedData.putStorage(gridStor, delGrid);
+
+  // Now do the FFT2D in place
+  fft2d(griddedData, True);
 }
 
 
@@ -658,6 +690,97 @@ extern "C" {
 		 const Int*,
 		 const Complex*);
 }
+
+// Whether get() uses the Fortran sectdgrid instead of degridRows
+static Bool useFortranDegrid()
+{
+  Bool fortranDegrid;
+  AipsrcValue<Bool>::find(fortranDegrid, "GridFT.fortrandegrid", False);
+  return fortranDegrid;
+}
+
+// Side of the grid tiles by which degridRows orders the samples
+static const Int degridTile=32;
+
+void GridFT::degridRows(Complex* values, Int nvispol, Int nvischan,
+			const Int* flag, const Int* rflag,
+			const Complex* grid, Int nx, Int ny, Int npol, Int nchan,
+			Int support, Int sampling, const Double* convFunc,
+			const Int* chanmap, const Int* polmap,
+			Int rbeg, Int rend, const Int* loc, const Int* off,
+			const Complex* phasor, Int nth)
+{
+  // Collect the samples whose convolution support lies on the grid, keyed
+  // by channel plane and grid tile, so that each thread gets a compact
+  // region of the grid and consecutive samples reuse the same cache lines
+  const Int ntx=(nx+degridTile-1)/degridTile;
+  const Int nty=(ny+degridTile-1)/degridTile;
+  std::vector<std::pair<Int64, Int64> > samples;
+  samples.reserve(size_t(max(rend-rbeg+1, 0))*nvischan);
+  for (Int irow=rbeg; irow<=rend; ++irow) {
+    if(rflag[irow]!=0)
+      continue;
+    for (Int ichan=0; ichan<nvischan; ++ichan) {
+      const Int achan=chanmap[ichan];
+      if(achan<0 || achan>=nchan)
+	continue;
+      const Int64 k=Int64(irow)*nvischan+ichan;
+      const Int lx=loc[2*k]-1;
+      const Int ly=loc[2*k+1]-1;
+      if(lx-support<0 || lx+support>=nx || ly-support<0 || ly+support>=ny)
+	continue;
+      samples.push_back(std::make_pair((Int64(achan)*nty+ly/degridTile)*ntx
+				       +lx/degridTile, k));
+    }
+  }
+  std::sort(samples.begin(), samples.end());
+
+  // The convolution function is separable: each grid row is summed with
+  // the x weights, which the compiler can vectorise, and then weighted by
+  // the y weight of the row
+  const Int nsupp=2*support+1;
+  const Int64 nsamples=samples.size();
+  const Int64 planeSize=Int64(nx)*ny;
+#pragma omp parallel num_threads(nth)
+  {
+    std::vector<Float> wtx(nsupp), wty(nsupp);
+#pragma omp for schedule(static)
+    for (Int64 i=0; i<nsamples; ++i) {
+      const Int64 k=samples[i].second;
+      const Int achan=chanmap[k%nvischan];
+      const Int x0=loc[2*k]-1-support;
+      const Int y0=loc[2*k+1]-1-support;
+      Float sumx=0.0, sumy=0.0;
+      for (Int j=0; j<nsupp; ++j) {
+	wtx[j]=Float(convFunc[std::abs(sampling*(j-support)+off[2*k])]);
+	wty[j]=Float(convFunc[std::abs(sampling*(j-support)+off[2*k+1])]);
+	sumx+=wtx[j];
+	sumy+=wty[j];
+      }
+      const Float norm=sumx*sumy;
+      const Complex phase=conj(phasor[k]);
+      for (Int ipol=0; ipol<nvispol; ++ipol) {
+	const Int apol=polmap[ipol];
+	if(flag[k*nvispol+ipol]==1 || apol<0 || apol>=npol)
+	  continue;
+	const Complex* plane=grid+(Int64(achan)*npol+apol)*planeSize;
+	Float re=0.0, im=0.0;
+	for (Int iy=0; iy<nsupp; ++iy) {
+	  const Complex* g=plane+Int64(y0+iy)*nx+x0;
+	  Float rowre=0.0, rowim=0.0;
+	  for (Int ix=0; ix<nsupp; ++ix) {
+	    rowre+=wtx[ix]*g[ix].real();
+	    rowim+=wtx[ix]*g[ix].imag();
+	  }
+	  re+=wty[iy]*rowre;
+	  im+=wty[iy]*rowim;
+	}
+	values[k*nvispol+ipol]=(Complex(re, im)*phase)/norm;
+      }
+    }
+  }
+}
+
 void GridFT::put(const vi::VisBuffer2& vb, Int row, Bool dopsf,
 		 FTMachine::Type type)
 {
@@ -1067,7 +1190,6 @@ void GridFT::get(vi::VisBuffer2& vb, Int row)
   else{   
     nth= omp_get_max_threads();
   }
-  nth=min(4,nth);
 #endif
 
 
@@ -1118,41 +1240,48 @@ void GridFT::get(vi::VisBuffer2& vb, Int row)
     const Int * rowflagstor=rowFlags.getStorage(del);
 
 
-    Int npart=1;
-    if (nth >3){
-      npart=4;
-    }
-    else if(nth >1){
-     npart=2; 
-    }
+    static Bool fortranDegrid=useFortranDegrid();
+    if(fortranDegrid) {
+      Int npart=1;
+      if (nth >3){
+	npart=4;
+      }
+      else if(nth >1){
+	npart=2;
+      }
 
-    Int ix=0;
+      Int ix=0;
 #pragma omp parallel default(none) private(ix, rbeg, rend) firstprivate(datStorage, flagstor, rowflagstor, convfuncstor, pmapstor, cmapstor, gridstor, nxp, nyp, np, nc, csamp, csupp, nvp, nvc, nvisrow, phasorstor, locstor, offstor) shared(npart) num_threads(npart)
-    { 
-#pragma omp for 
-      for (ix=0; ix< npart; ++ix){
-	rbeg=ix*(nvisrow/npart)+1;
-	rend=(ix != (npart-1)) ? (rbeg+(nvisrow/npart)-1) : (rbeg+(nvisrow/npart)+nvisrow%npart-1) ;
-	//cerr << "rbeg " << rbeg << " rend " << rend << "  " << nvisrow << endl;
-	
-	sectdgrid(datStorage,
-		  &nvp,
-		  &nvc,
-		  flagstor,
-		  rowflagstor,
-		  &nvisrow,
-		  gridstor,
-		  &nxp,
-		  &nyp,
-		  &np,
-		  &nc,
-		  &csupp,
-		  &csamp,
-		  convfuncstor,
-		  cmapstor,
-		  pmapstor,
-		  &rbeg, &rend, locstor, offstor, phasorstor);
-      }//end pragma parallel
+      {
+#pragma omp for
+	for (ix=0; ix< npart; ++ix){
+	  rbeg=ix*(nvisrow/npart)+1;
+	  rend=(ix != (npart-1)) ? (rbeg+(nvisrow/npart)-1) : (rbeg+(nvisrow/npart)+nvisrow%npart-1) ;
+
+	  sectdgrid(datStorage,
+		    &nvp,
+		    &nvc,
+		    flagstor,
+		    rowflagstor,
+		    &nvisrow,
+		    gridstor,
+		    &nxp,
+		    &nyp,
+		    &np,
+		    &nc,
+		    &csupp,
+		    &csamp,
+		    convfuncstor,
+		    cmapstor,
+		    pmapstor,
+		    &rbeg, &rend, locstor, offstor, phasorstor);
+	}//end pragma parallel
+      }
+    }
+    else {
+      degridRows(datStorage, nvp, nvc, flagstor, rowflagstor, gridstor,
+		 nxp, nyp, np, nc, csupp, csamp, convfuncstor, cmapstor, pmapstor,
+		 0, nvisrow-1, locstor, offstor, phasorstor, nth);
     }
     data.putStorage(datStorage, isCopy);
     griddedData.freeStorage(gridstor, delgrid);
@@ -1187,86 +1316,53 @@ ImageInterface<Complex>& GridFT::getImage(Matrix<Float>& weights, Bool normalize
   }
   else {
 
-    //const IPosition latticeShape = lattice->shape();
-    
-    //logIO() << LogIO::DEBUGGING
-    //	    << "Starting FFT and scaling of image" << LogIO::POST;
-    
-
-  
-    // if(useDoubleGrid_p){
-    //   convertArray(griddedData, griddedData2);
-    //   //Don't need the double-prec grid anymore...
-    //   griddedData2.resize();
-    // }
+    // The grid correction, and normalization, of each plane
+    Vector<Complex> factor(npol*nchan);
+    for (Int chan=0; chan<nchan; ++chan) {
+      for (Int pol=0; pol<npol; ++pol) {
+	Float norm=Float(nx)*Float(ny);
+	if(normalize)
+	  norm/=weights(pol, chan);
+	factor[pol+chan*npol]=(weights(pol, chan)!=0.0) ? Complex(norm) : Complex(0.0);
+      }
+    }
 
-    // x and y transforms
-    //    LatticeFFT::cfft2d(*lattice,False);
+    // x and y transforms in place, then the grid correction on the way
+    // out of the section of the grid that is the image.
     //
     // Retain the double precision grid for FFT as well.  Convert it
-    // to single precision just after (since images are still single
-    // precision).
+    // to single precision only for the image.
     //
-    if(useDoubleGrid_p)
-      {
-	ArrayLattice<DComplex> darrayLattice(griddedData2);
-	LatticeFFT::cfft2d(darrayLattice,False);
-	griddedData.resize(griddedData2.shape());
-	convertArray(griddedData, griddedData2);
-	
-	//Don't need the double-prec grid anymore...
-	griddedData2.resize();
-	arrayLattice = new ArrayLattice<Complex>(griddedData);
-	lattice=arrayLattice;
-      }
-    else{
-      arrayLattice = new ArrayLattice<Complex>(griddedData);
-      lattice=arrayLattice;
-      LatticeFFT::cfft2d(*lattice,False);
+    IPosition blc(4, (nx-image->shape()(0)+(nx%2==0))/2, (ny-image->shape()(1)+(ny%2==0))/2, 0, 0);
+    const Int inx=image->shape()(0);
+    const Int iny=image->shape()(1);
+    Array<Complex> sky(image->shape());
+    Bool delSky;
+    Complex* skyStor=sky.getStorage(delSky);
+    if(useDoubleGrid_p) {
+      fft2d(griddedData2, False);
+      Bool delGrid;
+      const DComplex* gridStor=griddedData2.getStorage(delGrid);
+      copyCorrected(gridStor+blc(0)+Int64(blc(1))*nx, nx, Int64(nx)*ny,
+		    skyStor, inx, Int64(inx)*iny,
+		    inx, iny, npol*nchan, blc(0), blc(1), nx, *gridder,
+		    factor, fftThreads());
+      griddedData2.freeStorage(gridStor, delGrid);
+      //Don't need the double-prec grid anymore...
+      griddedData2.resize();
     }
-
-    
-    
-    {
-      Int inx = lattice->shape()(0);
-      Int iny = lattice->shape()(1);
-      Vector<Complex> correction(inx);
-      correction=Complex(1.0, 0.0);
-      // Do the Grid-correction
-      IPosition cursorShape(4, inx, 1, 1, 1);
-      IPosition axisPath(4, 0, 1, 2, 3);
-      LatticeStepper lsx(lattice->shape(), cursorShape, axisPath);
-      LatticeIterator<Complex> lix(*lattice, lsx);
-      for(lix.reset();!lix.atEnd();lix++) {
-	Int pol=lix.position()(2);
-	Int chan=lix.position()(3);
-	if(weights(pol, chan)!=0.0) {
-	  gridder->correctX1D(correction, lix.position()(1));
-	  lix.rwVectorCursor()/=correction;
-	  if(normalize) {
-	    Complex rnorm(Float(inx)*Float(iny)/weights(pol,chan));
-	    lix.rwCursor()*=rnorm;
-	  }
-	  else {
-	    Complex rnorm(Float(inx)*Float(iny));
-	    lix.rwCursor()*=rnorm;
-	  }
-	}
-	else {
-	  lix.woCursor()=0.0;
-	}
-      }
-    }
-
-    if(!isTiled) {
-      // Check the section from the image BEFORE converting to a lattice 
-      IPosition blc(4, (nx-image->shape()(0)+(nx%2==0))/2, (ny-image->shape()(1)+(ny%2==0))/2, 0, 0);
-      IPosition stride(4, 1);
-      IPosition trc(blc+image->shape()-stride);
-      // Do the copy
-      IPosition start(4, 0);
-      image->put(griddedData(blc, trc));
+    else {
+      fft2d(griddedData, False);
+      Bool delGrid;
+      const Complex* gridStor=griddedData.getStorage(delGrid);
+      copyCorrected(gridStor+blc(0)+Int64(blc(1))*nx, nx, Int64(nx)*ny,
+		    skyStor, inx, Int64(inx)*iny,
+		    inx, iny, npol*nchan, blc(0), blc(1), nx, *gridder,
+		    factor, fftThreads());
+      griddedData.freeStorage(gridStor, delGrid);
     }
+    sky.putStorage(skyStor, delSky);
+    image->put(sky);
   }
   griddedData.resize();
   return *image;
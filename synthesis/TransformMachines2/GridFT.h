@@ -98,14 +98,21 @@ namespace refim { //#namespace for imaging refactor
 // quite favorable. For the VLA, one requires images of greater than
 // about 200 pixels on a side to make it worthwhile.
 //
-// The FFT step is done plane by plane for images having less than
-// 1024 * 1024 pixels on each plane, and line by line otherwise.
+// The FFT step transforms the whole grid in place with
+// FTMachine::fft2d: the rows of every plane are transformed first, then
+// the columns, copied a block of adjacent columns at a time. Both passes
+// are shared out among fftThreads() threads, each with its own FFTServer
+// kept in fftServers_p (dfftServers_p for the double precision grid). The
+// grid correction is applied while the image is copied into, or out of,
+// the centre of the grid.
 //
-// The gridding and degridding steps are implemented in Fortran
-// for speed. In gridding, the visibilities are added onto the
-// grid points in the neighborhood using a weighting function.
-// In degridding, the value is derived by a weight summ of the
-// same points, using the same weighting function.
+// The gridding step is implemented in Fortran for speed. In gridding,
+// the visibilities are added onto the grid points in the neighborhood
+// using a weighting function. In degridding, the value is derived by a
+// weight summ of the same points, using the same weighting function;
+// this is done in C++ by all the threads, since the grid is only read.
+// The Fortran degridder can be selected with the aipsrc variable
+// GridFT.fortrandegrid for comparison.
 // </synopsis> 
 //
 // <example>
@@ -190,7 +197,20 @@ public:
 
   virtual void put(const vi::VisBuffer2& vb, Int row=-1, Bool dopsf=False,
   	   FTMachine::Type type=FTMachine::OBSERVED);
-  
+
+  // Degrid the rows rbeg to rend (0-based, inclusive) of values from
+  // grid. This is the C++ equivalent of the Fortran sectdgrid, with the
+  // same array layouts and the 1-based grid locations of locuvw in loc.
+  // The unflagged (row, channel) samples are sorted by the grid tile they
+  // read and the sorted list is shared among nth threads.
+  static void degridRows(Complex* values, Int nvispol, Int nvischan,
+			 const Int* flag, const Int* rflag,
+			 const Complex* grid, Int nx, Int ny, Int npol, Int nchan,
+			 Int support, Int sampling, const Double* convFunc,
+			 const Int* chanmap, const Int* polmap,
+			 Int rbeg, Int rend, const Int* loc, const Int* off,
+			 const Complex* phasor, Int nth);
+
   // Make the entire image
   void makeImage(FTMachine::Type type,
 		 vi::VisibilityIterator2& vi,
@@ -33,6 +33,7 @@
 #include <components/ComponentModels/Flux.h>
 #include <components/ComponentModels/SkyComponent.h>
 #include <components/ComponentModels/SpectralModel.h>
+#include <components/ComponentModels/TwoSidedShape.h>
 #include <msvis/MSVis/VisBuffer2.h>
 #include <ms/MeasurementSets/MSColumns.h>
 #include <ms/MeasurementSets/MSIter.h>
@@ -44,7 +45,11 @@
 #include <casa/Arrays/IPosition.h>
 #include <casa/BasicSL/Complex.h>
 #include <casa/BasicSL/Constants.h>
+#include <casa/BasicMath/Math.h>
+#include <casa/Quanta/MVFrequency.h>
+#include <measures/Measures/MeasRef.h>
 #include <measures/Measures/UVWMachine.h>
+#include <cmath>
 #ifdef HAS_OMP
 #include <omp.h>
 #endif
@@ -237,9 +242,7 @@ void SimpleComponentFTMachine::get(VisBuffer2& vb, const ComponentList& compList
   const uInt nRow = endRow - startRow + 1;
    
    // Rotate the uvw
-  Matrix<Double> uvw0(3, nRow);
   Matrix<Double> uvw(3, nRow); 
-  Vector<Double> dphase(nRow);
 
   //const Vector<RigidVector<Double,3> >& uvwBuff = vb.uvw();
   for (uInt i = startRow, n = 0; i <= endRow; i++, n++) {
@@ -250,21 +253,15 @@ void SimpleComponentFTMachine::get(VisBuffer2& vb, const ComponentList& compList
     }
     uvw(2, n) = vb.uvw()(2,n);
   }
-  uvw0=uvw.copy();
   
-  uInt ncomponents=compList.nelements();
   uInt npol=vb.nCorrelations();
   uInt nChan=vb.nChannels();
   Cube<Complex> modelData;
   modelData.reference(vb.visCubeModel());
   modelData=0.0;
 
-  Vector<Complex> visibility(4);
-  //UNUSED: Double phase;
-  //UNUSED: Double phaseMult;
   Vector<Double> frequency;
   frequency= vb.getFrequencies(0);
-  Vector<Double> invLambda = frequency/C::c;
   // Find the offsets in polarization. 
 
   Vector<Int> corrTypeL = getSelectedCorrelationTypes (vb).copy();
@@ -272,7 +269,7 @@ void SimpleComponentFTMachine::get(VisBuffer2& vb, const ComponentList& compList
   Vector<Int> corrType = getSelectedCorrelationTypes (vb).copy();
   corrTypeL -= 9;
   corrTypeC -= 5;
-  Cube<DComplex> dVis(4, nChan, nRow);
+
   ComponentType::Polarisation poltype=ComponentType::CIRCULAR;
   if(anyGT(Int(Stokes::RR), vb.correlationTypes())){
     poltype=ComponentType::STOKES;
@@ -286,126 +283,183 @@ void SimpleComponentFTMachine::get(VisBuffer2& vb, const ComponentList& compList
     corrType = corrTypeC;
   }
 
- uInt npart=1;
+  Int nthreads=1;
 #ifdef HAS_OMP
- npart= numthreads_p <0 ? omp_get_max_threads() : min(numthreads_p, omp_get_max_threads());
+  nthreads= numthreads_p <0 ? omp_get_max_threads() : min(numthreads_p, omp_get_max_threads());
 #endif
 
+  PackedComponents packed;
+  packComponents(packed, vb, compList, uvw, frequency, poltype, corrType);
 
+  Bool isCopy;
+  Complex *modData=modelData.getStorage(isCopy);
+  predictVis(modData, packed, frequency, nRow, nChan, npol, nthreads);
+  modelData.putStorage(modData, isCopy);
+ 
+}
 
-  if((nRow/npart)==0) npart=1;
-  Block<Cube<DComplex> > dVisp(npart);
-  Vector<uInt> nRowp(npart);
-  Block<Matrix<Double> > uvwp(npart);
-  Block<ComponentList> compp(npart);
-  Block<MeasFrame> mFramep(npart);
-  Block<MDirection> mDir(npart);
-  Block<uInt> startrow(npart);
-
-  nRowp.set(nRow/npart);
-  nRowp(npart-1) += nRow%npart;
+void SimpleComponentFTMachine::packComponents(PackedComponents& packed, VisBuffer2& vb,
+					      const ComponentList& compList, const Matrix<Double>& uvw,
+					      const Vector<Double>& frequency,
+					      ComponentType::Polarisation poltype,
+					      const Vector<Int>& corrType){
+  const uInt ncomponents=compList.nelements();
+  const uInt nRow=uvw.ncolumn();
+  const uInt nChan=frequency.nelements();
+  const uInt npol=corrType.nelements();
+  packed.shape.resize(ncomponents);
+  packed.major.resize(ncomponents);
+  packed.minor.resize(ncomponents);
+  packed.cpa.resize(ncomponents);
+  packed.spa.resize(ncomponents);
+  packed.u.resize(ncomponents, nRow);
+  packed.v.resize(ncomponents, nRow);
+  packed.dphase.resize(ncomponents, nRow);
+  packed.flux.resize(npol, nChan, ncomponents);
+  packed.otherScale.resize(ncomponents);
+
+  Vector<MVFrequency> mvFreq(nChan);
+  for (uInt chn=0; chn < nChan; ++chn)
+    mvFreq(chn)=MVFrequency(frequency(chn));
 
-  
-  Block<Vector<Double> > dphasecomp(ncomponents);
-  Block<Matrix<Double> > uvwcomp(ncomponents);
-  Block<Block<Vector<Double> > > dphasecomps(npart);
-  Block<Block<Matrix<Double> > > uvwcomps(npart);
-  for (uInt jj=0; jj < npart; ++jj){
-    dphasecomps[jj].resize(ncomponents);
-    uvwcomps[jj].resize(ncomponents);
-  }
   ///Have to do this in one thread as MeasFrame and thus uvwmachine is not thread safe
+  Matrix<Double> uvwcomp;
+  Vector<Double> dphasecomp(nRow);
+  Vector<Double> iquv(4);
   for (uInt k=0; k < ncomponents; ++k){
-    uvwcomp[k]=uvw;
-    dphasecomp[k].resize(nRow);
-    rotateUVW(uvwcomp[k], dphasecomp[k],  vb, compList.component(k).shape().refDirection());
-    dphasecomp[k] *= -C::_2pi;
-    Int sumrow=0;
-    for (uInt jj=0; jj < npart; ++jj){
-      dphasecomps[jj][k]=dphasecomp[k](IPosition(1,sumrow), IPosition(1, sumrow+nRowp(jj)-1));
-      uvwcomps[jj][k]=uvwcomp[k](IPosition(2,0, sumrow  ), IPosition(2, 2, sumrow+nRowp(jj)-1));
-      sumrow+=nRowp(jj);
+    const SkyComponent& component=compList.component(k);
+    const ComponentShape& shape=component.shape();
+    uvwcomp=uvw;
+    rotateUVW(uvwcomp, dphasecomp,  vb, shape.refDirection());
+    for (uInt r=0; r < nRow; ++r){
+      packed.u(k,r)=uvwcomp(0,r);
+      packed.v(k,r)=uvwcomp(1,r);
+      packed.dphase(k,r)=-C::_2pi*dphasecomp(r);
     }
-   
-  }
-
-
 
-  //UNUSED: Int sumrow=0;
-  Record lala;
-  String err;
-  compList.toRecord(err, lala);
-  for (uInt k=0; k < npart; ++k){
-    compp[k].fromRecord(err, lala);
-    startrow[k]=0;
-    for (uInt j=0; j < k; ++j) startrow[k]+=nRowp(j);
-  }
-  Bool isCopy;
-  Complex *modData=modelData.getStorage(isCopy);
-  MDirection dataMDir=vb.phaseCenter();
-
-#pragma omp parallel default(none)  firstprivate(npart, npol, nChan, modData, corrType, nRowp,  invLambda, frequency, poltype) shared(startrow, compp, uvwcomps, dphasecomps) num_threads(npart)
-  {
-#pragma omp for
-
-    for (Int k=0; k < Int(npart); ++k){
-
-    predictVis(modData, invLambda, frequency, compp[k],  poltype, corrType, 
-	       startrow[k], nRowp[k], nChan, npol, uvwcomps[k], dphasecomps[k]);
-
-  }
+    packed.shape(k)=shape.type();
+    packed.major(k)=packed.minor(k)=0.0;
+    packed.cpa(k)=1.0;
+    packed.spa(k)=0.0;
+    if(shape.type()==ComponentType::GAUSSIAN || shape.type()==ComponentType::DISK){
+      const TwoSidedShape& twoSided=dynamic_cast<const TwoSidedShape&>(shape);
+      packed.major(k)=twoSided.majorAxisInRad();
+      packed.minor(k)=twoSided.minorAxisInRad();
+      packed.cpa(k)=cos(twoSided.positionAngleInRad());
+      packed.spa(k)=sin(twoSided.positionAngleInRad());
+    }
+    else if(shape.type()!=ComponentType::POINT){
+      packed.otherScale[k].resize(nRow, nChan);
+      shape.visibility(packed.otherScale[k], uvwcomp, frequency);
+    }
 
-  
+    // The spectral model is sampled once per channel, in the frame of the
+    // component, as SkyCompRep::visibility does
+    Flux<Double> flux=component.flux().copy();
+    flux.convertUnit(Unit("Jy"));
+    flux.value(iquv);
+    Vector<Vector<Double> > fIQUV(nChan);
+    fIQUV.set(iquv);
+    MeasRef<MFrequency> measRef(component.spectrum().refFrequency().getRef());
+    component.spectrum().sampleStokes(fIQUV, mvFreq, measRef);
+    for (uInt chn=0; chn < nChan; ++chn){
+      Flux<Double> chanFlux(fIQUV(chn));
+      chanFlux.convertPol(poltype);
+      for (uInt pol=0; pol < npol; ++pol)
+	packed.flux(pol, chn, k)=chanFlux.value(corrType(pol));
+    }
   }
-  modelData.putStorage(modData, isCopy);
- 
 }
 
-
-  void SimpleComponentFTMachine::predictVis(Complex*& modData, const Vector<Double>& invLambda, 
-					    const Vector<Double>& frequency, const ComponentList& compList,   
-					    ComponentType::Polarisation poltype, const Vector<Int>& corrType, 
-					    const uInt startrow, const uInt nrows, const uInt nchan, const uInt npol, const Block<Matrix<Double> > & uvwcomp, const Block<Vector<Double> > & dphasecomp){
-    Cube<DComplex> dVis(4, nchan, nrows);
-    uInt ncomponents=compList.nelements();
-    Vector<Double> dphase(nrows);
-    
-    for (uInt icomp=0;icomp<ncomponents; ++icomp) {
-      SkyComponent component=compList.component(icomp);
-      component.flux().convertUnit(Unit("Jy"));
-      component.flux().convertPol(poltype);
-      MDirection compdir=component.shape().refDirection();
-      Vector<Double> thisRow(3);
-      thisRow=0.0;
-      //UNUSED: uInt i;
-      Matrix<Double> uvw;
-      uvw=uvwcomp[icomp];
-      Vector<Double> dphase;
-      dphase=dphasecomp[icomp];
-      component.visibility(dVis, uvw, frequency);
-      Double phaseMult;
-      Double phase;
-      uInt realrow;
-      //// Loop over all rows
-      for (uInt r = 0; r < nrows ; r++) {
-	phaseMult = dphase(r);
-	realrow=r+startrow;
-	for (uInt chn = 0; chn < nchan; chn++) {
-	  phase = phaseMult * invLambda(chn);	
-	  Complex phasor(cos(phase), sin(phase));
-	  for (uInt pol=0; pol < npol; pol++) {
-	    const DComplex& val = dVis(corrType(pol), chn, r);
-	    modData[realrow*npol*nchan+chn*npol + pol] += Complex(val.real(), val.imag()) * conj(phasor);
+void SimpleComponentFTMachine::predictVis(Complex* modData, const PackedComponents& packed,
+					  const Vector<Double>& frequency, const uInt nrows,
+					  const uInt nchan, const uInt npol, const Int nthreads){
+  const Int ncomponents=packed.shape.nelements();
+  // exp(-gaussFactor*f^2*(maj^2 qmaj^2 + min^2 qmin^2)) is the transform of
+  // a Gaussian of unit flux with FWHM maj and min at frequency f
+  const Double gaussFactor=C::pi*C::pi/(4.0*C::ln2)/(C::c*C::c);
+  const Double diskFactor=C::pi/C::c;
+  Bool delfreq, delu, delv, deldph, delflux;
+  const Double* freqstor=frequency.getStorage(delfreq);
+  const Double* ustor=packed.u.getStorage(delu);
+  const Double* vstor=packed.v.getStorage(delv);
+  const Double* dphstor=packed.dphase.getStorage(deldph);
+  const DComplex* fluxstor=packed.flux.getStorage(delflux);
+
+  // Rows are independent so they are shared out in blocks between the
+  // threads, each of which sums all the components for its rows
+#pragma omp parallel num_threads(nthreads)
+  {
+    Vector<Double> freq2(nchan), scale(nchan), cosph(nchan), sinph(nchan);
+    Vector<DComplex> vis(nchan*npol);
+    for (uInt chn=0; chn < nchan; ++chn)
+      freq2(chn)=freqstor[chn]*freqstor[chn];
+#pragma omp for schedule(static)
+    for (Int r=0; r < Int(nrows); ++r){
+      vis=DComplex(0.0);
+      for (Int k=0; k < ncomponents; ++k){
+	const Double u=ustor[k+r*ncomponents];
+	const Double v=vstor[k+r*ncomponents];
+	const Double phaseMult=dphstor[k+r*ncomponents]/C::c;
+	for (uInt chn=0; chn < nchan; ++chn){
+	  const Double phase=phaseMult*freqstor[chn];
+	  cosph(chn)=cos(phase);
+	  sinph(chn)=-sin(phase);
+	}
+	const Int shapeType=packed.shape(k);
+	if(shapeType==ComponentType::POINT){
+	  scale=1.0;
+	}
+	else if(shapeType==ComponentType::GAUSSIAN){
+	  const Double qmaj=packed.major(k)*(u*packed.spa(k)+v*packed.cpa(k));
+	  const Double qmin=packed.minor(k)*(u*packed.cpa(k)-v*packed.spa(k));
+	  const Double a2=gaussFactor*(qmaj*qmaj+qmin*qmin);
+	  for (uInt chn=0; chn < nchan; ++chn)
+	    scale(chn)=exp(-a2*freq2(chn));
+	}
+	else if(shapeType==ComponentType::DISK){
+	  if(near(u+v, 0.0)){
+	    scale=1.0;
+	  }
+	  else{
+	    // As DiskShape::calcVis
+	    const Double r0=diskFactor*hypot((u*packed.cpa(k)-v*packed.spa(k))*packed.minor(k),
+					     (u*packed.spa(k)+v*packed.cpa(k))*packed.major(k));
+	    for (uInt chn=0; chn < nchan; ++chn){
+	      const Double x=r0*freqstor[chn];
+	      scale(chn)=2.0*j1(x)/x;
+	    }
+	  }
+	}
+	const DComplex* compFlux=fluxstor+k*nchan*npol;
+	if(packed.otherScale[k].nelements()==0){
+	  for (uInt chn=0; chn < nchan; ++chn){
+	    const DComplex phasor(scale(chn)*cosph(chn), scale(chn)*sinph(chn));
+	    for (uInt pol=0; pol < npol; ++pol)
+	      vis(chn*npol+pol) += compFlux[chn*npol+pol]*phasor;
+	  }
+	}
+	else{
+	  const Matrix<DComplex>& other=packed.otherScale[k];
+	  for (uInt chn=0; chn < nchan; ++chn){
+	    const DComplex phasor=other(r, chn)*DComplex(cosph(chn), sinph(chn));
+	    for (uInt pol=0; pol < npol; ++pol)
+	      vis(chn*npol+pol) += compFlux[chn*npol+pol]*phasor;
 	  }
 	}
       }
-
-
+      Complex* rowData=modData+r*nchan*npol;
+      for (uInt i=0; i < nchan*npol; ++i)
+	rowData[i]=Complex(vis(i).real(), vis(i).imag());
     }
-    
-  }  
+  }
+  frequency.freeStorage(freqstor, delfreq);
+  packed.u.freeStorage(ustor, delu);
+  packed.v.freeStorage(vstor, delv);
+  packed.dphase.freeStorage(dphstor, deldph);
+  packed.flux.freeStorage(fluxstor, delflux);
+}
 
 
 }// end namespace refim
 } //# NAMESPACE CASA - END
-
@@ -36,6 +36,8 @@
 #include <casa/Arrays/Array.h>
 #include <casa/Arrays/Vector.h>
 #include <casa/Arrays/Matrix.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Containers/Block.h>
 #include <casa/Logging/LogIO.h>
 #include <casa/Logging/LogSink.h>
 #include <casa/Logging/LogMessage.h>
@@ -101,14 +103,34 @@ protected:
 		   const Vector<Int>& corrType, 
 		   const Cube<DComplex>& dVis, Complex*& modData);
   
-  void predictVis(Complex*& modData, const Vector<Double>& invLambda, 
-		  const Vector<Double>& frequency, 
-		  const ComponentList& compList, 
-		  ComponentType::Polarisation poltype, const Vector<Int>& corrType, 
-		  const uInt startrow, const uInt nrows, 
-		  const uInt nchan, const uInt npol, 
-		  const Block<Matrix<Double> > & uvwcomp, 
-		  const Block<Vector<Double> > & dphasecomp);
+  // A ComponentList unpacked into flat arrays, so that all the components
+  // can be predicted together for a block of rows without touching the
+  // SkyComponent objects (and their non thread-safe shapes and fluxes).
+  // Components with a shape that has no closed form here (e.g. a limb
+  // darkened disk) keep their shape values in <src>otherScale</src>.
+  struct PackedComponents {
+    // ComponentType::Shape of each component
+    Vector<Int> shape;
+    // Major and minor axis widths (rad) and cos/sin of the position angle
+    Vector<Double> major, minor, cpa, spa;
+    // Rotated u and v and the phase (per unit wavelength) of each
+    // component, indexed (component, row)
+    Matrix<Double> u, v, dphase;
+    // Flux in Jy of each selected correlation, indexed (pol, chan, component)
+    Cube<DComplex> flux;
+    // Shape values, indexed (row, chan), for the other shapes
+    Block<Matrix<DComplex> > otherScale;
+  };
+
+  void packComponents(PackedComponents& packed, vi::VisBuffer2& vb,
+		      const ComponentList& compList, const Matrix<Double>& uvw,
+		      const Vector<Double>& frequency,
+		      ComponentType::Polarisation poltype,
+		      const Vector<Int>& corrType);
+
+  void predictVis(Complex* modData, const PackedComponents& packed,
+		  const Vector<Double>& frequency, const uInt nrows,
+		  const uInt nchan, const uInt npol, const Int nthreads);
 
 };
 
@@ -42,6 +42,8 @@
 #include <ms/MeasurementSets/MSSourceColumns.h>
 
 #include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <synthesis/TransformMachines/ModelVisCache.h>
 #include <synthesis/TransformMachines2/VisModelData.h>
 #include <synthesis/TransformMachines2/FTMachine.h>
 #include <synthesis/TransformMachines2/SimpleComponentFTMachine.h>
@@ -168,6 +170,7 @@ void VisModelData::removeRecordByKey(MeasurementSet& theMS, const String& theKey
 
 void VisModelData::clearModel(const MeasurementSet& thems){
   //  Table newTab(thems);
+  ModelVisCache::invalidate(thems);
   MeasurementSet& newTab=const_cast<MeasurementSet& >(thems);
   if(!newTab.isWritable())
     return;
@@ -223,6 +226,7 @@ void VisModelData::clearModel(const MeasurementSet& thems){
 
 }
   void VisModelData::clearModel(const MeasurementSet& thems, const String field, const String specwindows){
+    ModelVisCache::invalidate(thems);
     MeasurementSet& newTab=const_cast<MeasurementSet& >(thems);
   Vector<String> theParts(newTab.getPartNames(True));
   if(theParts.nelements() > 1){
@@ -646,6 +650,7 @@ Bool VisModelData::isModelDefined(const Int fieldId, const MeasurementSet& thems
 void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface& rec, const Vector<Int>& validfieldids, const Vector<Int>& spws, const Vector<Int>& starts, const Vector<Int>& nchan,  const Vector<Int>& incr, Bool iscomponentlist, Bool incremental){
 
   LogIO logio;
+  ModelVisCache::invalidate(thems);
 
   try{
     //A field can have multiple FTmachines and ComponentList associated with it 
@@ -763,6 +768,8 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 	  ftrec.get("fields", fields);
 	  ftrec.get("spws", spws);
 	  if(anyEQ(spws, vb.spectralWindows()(0))){
+	    //Keys the model visibility cache
+	    const uInt rechash=ModelVisCache::recordHash(ftrec);
 	    indexft=ftholder_p.nelements();
 	    ftholder_p.resize(indexft+1, False, True);
 	    ftholder_p[indexft].resize(1);
@@ -791,6 +798,8 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 		else{
 		  ftindex_p(spws[spi], fields[fi], vb.msId())=indexft;
 		}
+		modelhash_p(spws[spi], fields[fi], vb.msId())=
+		  ModelVisCache::combineHash(modelhash_p(spws[spi], fields[fi], vb.msId()), rechash);
 	      }
 	    }
 	  }
@@ -814,6 +823,8 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 	  clrec.get("fields", fields);
 	  clrec.get("spws", spws);
 	  if(anyEQ(spws, vb.spectralWindows()(0))){
+	    //Keys the model visibility cache
+	    const uInt rechash=ModelVisCache::recordHash(clrec);
 	    indexcl=clholder_p.nelements();
 	    clholder_p.resize(indexcl+1, False, True);
 	    clholder_p[indexcl].resize(1);
@@ -840,6 +851,8 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 		else{
 		  clindex_p(spws[spi], fields[fi], vb.msId())=indexcl;
 		}
+		modelhash_p(spws[spi], fields[fi], vb.msId())=
+		  ModelVisCache::combineHash(modelhash_p(spws[spi], fields[fi], vb.msId()), rechash);
 	      }
 	    }
 	  }
@@ -892,6 +905,9 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
       newind.set(-1);
       newind(IPosition(3, 0,0,0), (oldcubeShape-1))=clindex_p;
       clindex_p.assign(newind);
+      Cube<uInt> newhash(newind.shape(), 0u);
+      newhash(IPosition(3, 0,0,0), (oldcubeShape-1))=modelhash_p;
+      modelhash_p.assign(newhash);
     }
 
     if( (clindex_p(spw, field, msid) + ftindex_p(spw, field, msid)) < -2)
@@ -911,6 +927,22 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 
     Vector<CountedPtr<ComponentList> >cl=getCL(vb.msId(), vb.fieldId()(0), vb.spectralWindows()(0));
     Vector<CountedPtr<FTMachine> > ft=getFT(vb.msId(), vb.fieldId()(0), vb.spectralWindows()(0));
+    String cachems("");
+    String cachekey("");
+    if((cl.nelements() > 0 || ft.nelements() > 0) && ModelVisCache::enabled()){
+      cachems=(vb.getVi() != 0) ? ModelVisCache::msKey(vb.getVi()->ms()) : vb.msName();
+      const IPosition shape(3, vb.nCorrelations(), vb.nChannels(), vb.nRows());
+      cachekey=ModelVisCache::chunkKey(modelhash_p(vb.spectralWindows()(0), vb.fieldId()(0), vb.msId()),
+				       vb.fieldId()(0), vb.spectralWindows()(0), shape,
+				       vb.nRows() > 0 ? vb.getChannelNumbers(0) : Vector<Int>(0),
+				       (vb.getVi() != 0) ? ModelVisCache::rootRows(vb.getVi()->ms(), vb.rowIds()) : vb.rowIds(),
+				       vb.time());
+      Cube<Complex> cached;
+      if(ModelVisCache::get(cachems, cachekey, shape, cached)){
+	vb.setVisCubeModel(cached);
+	return True;
+      }
+    }
     //Fill the buffer with 0.0; also prevents reading from disk if MODEL_DATA exists
     ///Oh boy this is really dangerous...
     //nCorr etc are public..who know who changed these values before reaching here.
@@ -949,6 +981,8 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
 	incremental=True;
       }      
     }
+    if(incremental && cachekey != "")
+      ModelVisCache::put(cachems, cachekey, vb.visCubeModel());
     if(!incremental){
       //No model was set so....
       ///Set the Model to 1.0 for parallel hand and 0.0 for x-hand
@@ -970,6 +1004,10 @@ void VisModelData::putModel(const MeasurementSet& thems, const RecordInterface&
   }
 
 
+  void VisModelData::setModelCache(const Int64 maxBytes, const String& cacheDir){
+    ModelVisCache::setCache(maxBytes, cacheDir);
+  }
+
   Vector<CountedPtr<ComponentList> > VisModelData::getCL(const Int msId, const Int fieldId, const Int spwId){
     if(!hasModel(msId, fieldId, spwId))
       return Vector<CountedPtr<ComponentList> >(0);
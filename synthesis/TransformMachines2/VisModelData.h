@@ -136,6 +136,15 @@ namespace casa { //# NAMESPACE CASA - BEGIN
 // <motivation>
 // </motivation>
 //
+// Predicted model visibilities can be cached so that repeated passes over
+// the data (e.g. successive calibration solves) do not predict the model
+// again. The cache is shared by every VisModelData of the process; see
+// <linkto class=ModelVisCache>ModelVisCache</linkto> for the aipsrc
+// variables VisModelData.cachesize and VisModelData.cachedir that turn it
+// on. Entries are keyed by a hash of all the model records of the field
+// and spw and by the rows and channels of the chunk, and are dropped when
+// putModel or clearModel change the models of the MS.
+//
 // <todo asof="2013/05/24">
 // Allow validity of models for a given section of time only
 //
@@ -212,6 +221,9 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   //returns a -2 if it has been tested before but does have it.
   //returns a 1 if it has a model stored 
   Int hasModel(Int msid, Int field, Int spw); 
+  //Set the size in bytes of the process-wide in-memory model visibility
+  //cache (0 disables it) and the directory of the on-disk cache ("" disables it)
+  void setModelCache(const Int64 maxBytes, const String& cacheDir=String(""));
  private:
   void initializeToVis();
   Vector<CountedPtr<ComponentList> >getCL(const Int msId, const Int fieldId, Int spw);
@@ -233,6 +245,8 @@ namespace casa { //# NAMESPACE CASA - BEGIN
   CountedPtr<ComponentFTMachine> cft_p;
   Cube<Int> ftindex_p;
   Cube<Int> clindex_p;
+  //combined hash of the model records serving each (spw, field, msid)
+  Cube<uInt> modelhash_p;
   static Bool initialize;
 };
 
@@ -38,6 +38,12 @@
 #include <casa/OS/HostInfo.h>
 #include <casa/Utilities/Assert.h>
 #include <casa/Utilities/CompositeNumber.h>
+#include <casa/System/Aipsrc.h>
+#include <casa/IO/AipsIO.h>
+#include <casa/OS/File.h>
+#include <casa/OS/RegularFile.h>
+#include <casa/Containers/Record.h>
+#include <casa/Containers/Block.h>
 #include <coordinates/Coordinates/CoordinateSystem.h>
 #include <coordinates/Coordinates/DirectionCoordinate.h>
 
@@ -55,12 +61,18 @@
 #include <lattices/Lattices/LatticeCache.h>
 #include <lattices/LatticeMath/LatticeFFT.h>
 #include <scimath/Mathematics/ConvolveGridder.h>
+#include <scimath/Mathematics/FFTServer.h>
 #include <msvis/MSVis/VisBuffer2.h>
 #include <msvis/MSVis/VisibilityIterator2.h>
 
 
 #include <synthesis/TransformMachines2/WPConvFunc.h>
 
+#include <unistd.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 namespace casa { //# NAMESPACE CASA - BEGIN
 namespace refim{ //namespace for refactoring imager
@@ -195,116 +207,126 @@ using namespace casa::refim;
   //sampling*=Double(max(nx,ny))/Double(convSize);
   sampling[0]*=Double(cn.nextLargerEven(Int(padding*Float(nx_p)-0.5)))/Double(convSize);
   sampling[1]*=Double(cn.nextLargerEven(Int(padding*Float(ny_p)-0.5)))/Double(convSize);
-  dc.setIncrement(sampling);
-  
-  Vector<Double> unitVec(2);
-  unitVec=convSize/2;
-  dc.setReferencePixel(unitVec);
-  
-  // Set the reference value to that of the image center for sure.
-  {
-    // dc.setReferenceValue(mTangent_p.getAngle().getValue());
-    MDirection wcenter;  
-    Vector<Double> pcenter(2);
-    pcenter(0) = nx_p/2;
-    pcenter(1) = ny_p/2;    
-    coords.directionCoordinate(directionIndex).toWorld( wcenter, pcenter );
-    dc.setReferenceValue(wcenter.getAngle().getValue());
-  }
-  coords.replaceCoordinate(dc, directionIndex);
-  //  coords.list(os, MDoppler::RADIO, IPosition(), IPosition());
   
-  IPosition pbShape(4, convSize, convSize, 1, 1);
-  TempImage<Complex> twoDPB(pbShape, coords);
+  // The kernels only depend on these parameters, so a previous run may have
+  // left them in the disk cache
+  const String cacheName=diskCacheName(convSize, wConvSize, sampling);
+  const Bool cached=readDiskCache(cacheName, convFunc, convSupport, convSize);
+  if(cached){
+    os << "Using convolution functions cached in " << cacheName << LogIO::POST;
+  }
+  else{
 
   Int inner=convSize/convSampling_p;
-  ConvolveGridder<Double, Complex>
-    ggridder(IPosition(2, inner, inner), uvScale, uvOffset, "SF");
-  /*
-  ConvolveGridder<Double, Complex>
-    ggridder(IPosition(2, cn.nextLargerEven(Int(padding*Float(nx_p)-0.5)), 
+  // The spheroidal function correction is the same for all the planes
+  Matrix<Complex> spheroid(inner, inner);
+  {
+    ConvolveGridder<Double, Complex>
+      ggridder(IPosition(2, inner, inner), uvScale, uvOffset, "SF");
+    /*
+    ConvolveGridder<Double, Complex>
+      ggridder(IPosition(2, cn.nextLargerEven(Int(padding*Float(nx_p)-0.5)), 
 		       cn.nextLargerEven(Int(padding*Float(ny_p)-0.5))), uvScale, 
 	     uvOffset, "SF");
-  */
+    */
+    Vector<Complex> correction(inner);
+    for (Int iy=0;iy<inner;iy++) {
+      ggridder.correctX1D(correction, iy);
+      spheroid.column(iy)=correction;
+    }
+  }
   convFunc.resize(); // break any reference 
   convFunc.resize(convSize/2-1, convSize/2-1, wConvSize);
   convFunc.set(0.0);
 
-  IPosition start(4, 0, 0, 0, 0);
-  IPosition pbSlice(4, convSize, convSize, 1, 1);
-  
-  Bool writeResults=False;
   Int warner=0;
 
-
-  // Accumulate terms 
-  Matrix<Complex> screen(convSize, convSize);
-  for (Int iw=0;iw<wConvSize;iw++) {
-    // First the w term
-    screen=0.0;
-    if(wConvSize>1) {
-      //      Double twoPiW=2.0*C::pi*sqrt(Double(iw))/uvScale(2);
-      //      Double twoPiW=2.0*C::pi*Double(iw)/uvScale(2);
-      Double twoPiW=2.0*C::pi*Double(iw*iw)/wScale_p;
-      for (Int iy=-inner/2;iy<inner/2;iy++) {
-	Double m=sampling(1)*Double(iy);
-	Double msq=m*m;
-	for (Int ix=-inner/2;ix<inner/2;ix++) {
-	  Double l=sampling(0)*Double(ix);
-	  Double rsq=l*l+msq;
-	  if(rsq<1.0) {
-	    Double phase=twoPiW*(sqrt(1.0-rsq)-1.0);
-	    screen(ix+convSize/2,iy+convSize/2)=Complex(cos(phase),sin(phase));
+  // Compute the w planes concurrently; each thread has its own screen and
+  // FFTServer (plan and work space), so limit the threads to what fits in
+  // a quarter of the memory
+  Int nThreads=1;
+#ifdef _OPENMP
+  {
+    Double threadMB=4.0*Double(convSize)*Double(convSize)*sizeof(Complex)/1024.0/1024.0;
+    Double memMB=Double(HostInfo::memoryTotal(true))/1024.0;
+    nThreads=max(1, min(min(omp_get_max_threads(), wConvSize), Int(memMB/4.0/threadMB)));
+  }
+#endif
+  const Int nOut=convSize/2-1;
+  const Double sampX=sampling(0);
+  const Double sampY=sampling(1);
+  Bool delCF, delSph;
+  Complex* cfData=convFunc.getStorage(delCF);
+  const Complex* sph=spheroid.getStorage(delSph);
+  // Making FFT plans is not thread safe, so the servers are made and
+  // planned here, one per thread, before the planes are computed
+  Block<CountedPtr<FFTServer<Float,Complex> > > servers(nThreads);
+  for (Int k=0;k<nThreads;k++) {
+    servers[k]=new FFTServer<Float,Complex>(IPosition(2, convSize, convSize), FFTEnums::COMPLEX);
+    Matrix<Complex> warm(convSize, convSize, Complex(0.0));
+    servers[k]->fft(warm, True);
+  }
+  String errMsg("");
+#pragma omp parallel num_threads(nThreads)
+  {
+    Int thread=0;
+#ifdef _OPENMP
+    thread=omp_get_thread_num();
+#endif
+    Matrix<Complex> screen(convSize, convSize);
+    FFTServer<Float,Complex>& ffts=*servers[thread];
+#pragma omp for schedule(dynamic)
+    for (Int iw=0;iw<wConvSize;iw++) {
+      try {
+	// First the w term
+	if(wConvSize>1) {
+	  screen=0.0;
+	  //      Double twoPiW=2.0*C::pi*sqrt(Double(iw))/uvScale(2);
+	  //      Double twoPiW=2.0*C::pi*Double(iw)/uvScale(2);
+	  Double twoPiW=2.0*C::pi*Double(iw*iw)/wScale_p;
+	  for (Int iy=-inner/2;iy<inner/2;iy++) {
+	    Double m=sampY*Double(iy);
+	    Double msq=m*m;
+	    for (Int ix=-inner/2;ix<inner/2;ix++) {
+	      Double l=sampX*Double(ix);
+	      Double rsq=l*l+msq;
+	      if(rsq<1.0) {
+		Double phase=twoPiW*(sqrt(1.0-rsq)-1.0);
+		screen(ix+convSize/2,iy+convSize/2)=Complex(cos(phase),sin(phase));
+	      }
+	    }
+	  }
+	}
+	else {
+	  screen=1.0;
+	}
+	// spheroidal function
+	for (Int iy=-inner/2;iy<inner/2;iy++) {
+	  const Complex* correction=sph+(iy+inner/2)*inner;
+	  for (Int ix=-inner/2;ix<inner/2;ix++) {
+	    screen(ix+convSize/2,iy+convSize/2)*=correction[ix+inner/2];
+	  }
+	}
+	// Now FFT and keep the first quadrant
+	ffts.fft(screen, True);
+	Complex* plane=cfData+size_t(iw)*nOut*nOut;
+	for (Int iy=0;iy<nOut;iy++) {
+	  for (Int ix=0;ix<nOut;ix++) {
+	    plane[ix+iy*nOut]=screen(ix+convSize/2,iy+convSize/2);
 	  }
 	}
       }
-    }
-    else {
-      screen=1.0;
-    }
-    // spheroidal function
-    Vector<Complex> correction(inner);
-    for (Int iy=-inner/2;iy<inner/2;iy++) {
-      ggridder.correctX1D(correction, iy+inner/2);
-      for (Int ix=-inner/2;ix<inner/2;ix++) {
-	screen(ix+convSize/2,iy+convSize/2)*=correction(ix+inner/2);
+      catch (const AipsError& x) {
+#pragma omp critical(wpConvFuncError)
+	errMsg=x.getMesg();
       }
     }
-    twoDPB.putSlice(screen, IPosition(4, 0));
-    // Write out screen as an image
-    if(writeResults) {
-      ostringstream name;
-      name << "Screen" << iw+1;
-      if(Table::canDeleteTable(name)) Table::deleteTable(name);
-      PagedImage<Float> thisScreen(pbShape, coords, name);
-      LatticeExpr<Float> le(real(twoDPB));
-      thisScreen.copyData(le);
-    }
-
-    // Now FFT and get the result back
-    LatticeFFT::cfft2d(twoDPB);
-
-    // Write out FT of screen as an image
-    if(writeResults) {
-      CoordinateSystem ftCoords(coords);
-      directionIndex=ftCoords.findCoordinate(Coordinate::DIRECTION);
-      AlwaysAssert(directionIndex>=0, AipsError);
-      dc=coords.directionCoordinate(directionIndex);
-      Vector<Bool> axes(2); axes(0)=True;axes(1)=True;
-      Vector<Int> shape(2); shape(0)=convSize;shape(1)=convSize;
-      Coordinate* ftdc=dc.makeFourierCoordinate(axes,shape);
-      ftCoords.replaceCoordinate(*ftdc, directionIndex);
-      delete ftdc; ftdc=0;
-      ostringstream name;
-      name << "FTScreen" << iw+1;
-      if(Table::canDeleteTable(name)) Table::deleteTable(name);
-      PagedImage<Float> thisScreen(pbShape, ftCoords, name);
-      LatticeExpr<Float> le(real(twoDPB));
-      thisScreen.copyData(le);
-    }
-    IPosition start(4, convSize/2, convSize/2, 0, 0);
-    IPosition pbSlice(4, convSize/2-1, convSize/2-1, 1, 1);
-    convFunc.xyPlane(iw)=twoDPB.getSlice(start, pbSlice, True);
+  }
+  convFunc.putStorage(cfData, delCF);
+  spheroid.freeStorage(sph, delSph);
+  if(errMsg != "") {
+    os << "Error computing the W-projection convolution functions: "
+       << errMsg << LogIO::EXCEPTION;
   }
 
   Complex maxconv=max(abs(convFunc));
@@ -367,6 +389,8 @@ using namespace casa::refim;
 	  << LogIO::POST;
 
 
+  }
+
   convSupportBlock_p.resize(actualConvIndex_p+1);
   convSupportBlock_p[actualConvIndex_p]= new Vector<Int>();
   convSupportBlock_p[actualConvIndex_p]->assign(convSupport);
@@ -394,6 +418,9 @@ using namespace casa::refim;
   os << "Memory used in gridding function = "
 	  << memoryMB << " MB from maximum "
 	  << maxMemoryMB << " MB" << LogIO::POST;
+  if(!cached) {
+    writeDiskCache(cacheName, *convFunctions_p[actualConvIndex_p], convSupport, convSize);
+  }
   convFunc.resize();
   convFunc.reference(*convFunctions_p[actualConvIndex_p]);
   convSizes_p.resize(actualConvIndex_p+1, True);
@@ -451,6 +478,73 @@ Bool WPConvFunc::checkCenterPix(const ImageInterface<Complex>& image){
   return True;
 }
 
+String WPConvFunc::diskCacheName(const Int convSize, const Int wConvSize,
+				  const Vector<Double>& sampling) const{
+  String cacheDir;
+  Aipsrc::find(cacheDir, "WPConvFunc.cachedir", "");
+  if(cacheDir == "")
+    return "";
+  ostringstream oos;
+  oos << setprecision(15);
+  oos << cacheDir << "/WPConvFunc_" << convSize << "_" << wConvSize << "_"
+      << convSampling_p << "_" << fabs(sampling(0)) << "_" << fabs(sampling(1));
+  if(wConvSize > 1)
+    oos << "_" << wScale_p;
+  return String(oos);
+}
+
+Bool WPConvFunc::readDiskCache(const String& name, Cube<Complex>& convFunc,
+			       Vector<Int>& convSupport, Int& convSize){
+  if(name == "" || !File(name).exists())
+    return False;
+  try{
+    Record rec;
+    AipsIO aio(name);
+    aio >> rec;
+    Cube<Complex> cf;
+    Vector<Int> support;
+    rec.get("convfunc", cf);
+    rec.get("convsupport", support);
+    rec.get("convsize", convSize);
+    convFunc.resize();
+    convFunc.reference(cf);
+    convSupport.resize();
+    convSupport.reference(support);
+  }
+  catch(AipsError x) {
+    LogIO os(LogOrigin("WPConvFunc", "readDiskCache"));
+    os << LogIO::WARN << "Could not read convolution function cache " << name
+       << ": " << x.getMesg() << LogIO::POST;
+    return False;
+  }
+  return True;
+}
+
+void WPConvFunc::writeDiskCache(const String& name, const Cube<Complex>& convFunc,
+				const Vector<Int>& convSupport, const Int convSize){
+  if(name == "")
+    return;
+  try{
+    Record rec;
+    rec.define("convfunc", convFunc);
+    rec.define("convsupport", convSupport);
+    rec.define("convsize", convSize);
+    // Write to a temporary file first so that another process never reads
+    // a partial cache
+    const String tmpName=name+".tmp"+String::toString(Int(getpid()));
+    {
+      AipsIO aio(tmpName, ByteIO::New);
+      aio << rec;
+    }
+    RegularFile(tmpName).move(name);
+  }
+  catch(AipsError x) {
+    LogIO os(LogOrigin("WPConvFunc", "writeDiskCache"));
+    os << LogIO::WARN << "Could not write convolution function cache " << name
+       << ": " << x.getMesg() << LogIO::POST;
+  }
+}
+
 Bool WPConvFunc::toRecord(RecordInterface& rec){
 
   Int numConv=convFunctions_p.nelements();
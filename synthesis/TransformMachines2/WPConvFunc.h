@@ -93,6 +93,18 @@ namespace refim{// namespace for imaging refactoring
       Bool fromRecord(String& err, const RecordInterface& rec);
     private:
       Bool checkCenterPix(const ImageInterface<Complex>& image);
+      // The convolution functions can be kept on disk, in the directory given
+      // by the aipsrc variable WPConvFunc.cachedir, so that later runs with
+      // the same kernel size, sampling and w scale reuse them.
+      // diskCacheName returns "" if there is no cache directory.
+      // <group>
+      String diskCacheName(const Int convSize, const Int wConvSize,
+			   const Vector<Double>& sampling) const;
+      static Bool readDiskCache(const String& name, Cube<Complex>& convFunc,
+				Vector<Int>& convSupport, Int& convSize);
+      static void writeDiskCache(const String& name, const Cube<Complex>& convFunc,
+				 const Vector<Int>& convSupport, const Int convSize);
+      // </group>
       Block <CountedPtr<Cube<Complex> > > convFunctions_p;
       Block <CountedPtr<Vector<Int> > > convSupportBlock_p;
       SimpleOrderedMap <String, Int> convFunctionMap_p;
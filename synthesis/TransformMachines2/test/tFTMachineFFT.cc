@@ -0,0 +1,98 @@
+//# tFTMachineFFT.cc: test the threaded in-place FFT of the refim FTMachines
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <lattices/Lattices/ArrayLattice.h>
+#include <lattices/LatticeMath/LatticeFFT.h>
+#include <synthesis/TransformMachines2/GridFT.h>
+
+#include <casa/namespace.h>
+
+// Gives the test access to the protected FFT of the FTMachine
+class TestGridFT : public refim::GridFT {
+public:
+  TestGridFT() : refim::GridFT(1000000, 16) {}
+  template <class T> void transform(Array<T> &grid, Bool toFrequency) {
+    fft2d(grid, toFrequency);
+  }
+};
+
+template <class T>
+Array<T> testGrid(const IPosition &shape)
+{
+  Array<T> grid(shape);
+  Int64 k = 0;
+  for (typename Array<T>::iterator it = grid.begin(); it != grid.end(); ++it, ++k) {
+    *it = T((k*7) % 23 - 11.0, (k*13) % 17 - 8.0);
+  }
+  return grid;
+}
+
+// Compare fft2d with LatticeFFT::cfft2d in both directions
+template <class T>
+void check(TestGridFT &ft, const IPosition &shape, Double tol)
+{
+  for (uInt dir = 0; dir < 2; dir++) {
+    const Bool toFrequency = (dir == 0);
+    Array<T> expected = testGrid<T>(shape);
+    ArrayLattice<T> lattice(expected);
+    LatticeFFT::cfft2d(lattice, toFrequency);
+    expected = lattice.get();
+
+    Array<T> grid = testGrid<T>(shape);
+    ft.transform(grid, toFrequency);
+    const Double scale = max(amplitude(expected));
+    cout << shape << (toFrequency ? " forward" : " backward")
+	 << " max difference " << max(amplitude(grid - expected))/scale << endl;
+    AlwaysAssert(allNearAbs(grid, expected, tol*scale), AipsError);
+  }
+}
+
+int main()
+{
+  try {
+    TestGridFT ft;
+    check<Complex>(ft, IPosition(4, 64, 64, 1, 1), 1e-5);
+    check<Complex>(ft, IPosition(4, 64, 48, 2, 3), 1e-5);
+    check<Complex>(ft, IPosition(4, 63, 50, 4, 1), 1e-5);
+    check<DComplex>(ft, IPosition(4, 64, 48, 2, 3), 1e-12);
+    // Plans for new lengths after the first ones
+    check<Complex>(ft, IPosition(4, 100, 36, 1, 2), 1e-5);
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,129 @@
+//# tGridFTDegrid.cc: compare the C++ and Fortran degridders of the refim GridFT
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/math.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/Timer.h>
+#include <casa/Utilities/Assert.h>
+#include <scimath/Mathematics/ConvolveGridder.h>
+#include <synthesis/TransformMachines2/GridFT.h>
+
+#include <casa/namespace.h>
+
+extern "C" {
+  void sectdgrid_(Complex*, const Int*, const Int*, const Int*, const Int*,
+		  const Int*, const Complex*, const Int*, const Int*, const Int*,
+		  const Int*, const Int*, const Int*, const Double*, const Int*,
+		  const Int*, const Int*, const Int*, const Int*, const Int*,
+		  const Complex*);
+}
+
+int main()
+{
+  try {
+    const Int nx=128, ny=96, npol=2, nchan=3;
+    const Int nvispol=4, nvischan=8, nrow=2000;
+
+    Vector<Double> uvScale(3, 1.0), uvOffset(3, 0.0);
+    ConvolveGridder<Double, Complex> gridder(IPosition(2, nx, ny), uvScale,
+					     uvOffset, "SF");
+    const Int support=gridder.cSupport()(0);
+    const Int sampling=gridder.cSampling();
+
+    Array<Complex> grid(IPosition(4, nx, ny, npol, nchan));
+    Int64 n=0;
+    for (Array<Complex>::iterator it=grid.begin(); it!=grid.end(); ++it, ++n) {
+      *it=Complex((n*7)%23-11.0, (n*13)%17-8.0);
+    }
+
+    // Locations as locuvw computes them, some of them off the grid
+    Cube<Int> loc(2, nvischan, nrow), off(2, nvischan, nrow);
+    Matrix<Complex> phasor(nvischan, nrow);
+    Cube<Int> flag(nvispol, nvischan, nrow, 0);
+    Vector<Int> rflag(nrow, 0);
+    for (Int irow=0; irow<nrow; ++irow) {
+      rflag(irow)=(irow%37==0) ? 1 : 0;
+      for (Int ichan=0; ichan<nvischan; ++ichan) {
+	const Double x=(irow*7919+ichan*104729)%(nx*100)/100.0+1.0;
+	const Double y=(irow*6053+ichan*15485)%(ny*100)/100.0+1.0;
+	loc(0, ichan, irow)=Int(x+0.5);
+	loc(1, ichan, irow)=Int(y+0.5);
+	off(0, ichan, irow)=Int(floor((loc(0, ichan, irow)-x)*sampling+0.5));
+	off(1, ichan, irow)=Int(floor((loc(1, ichan, irow)-y)*sampling+0.5));
+	const Double phase=0.001*irow*(ichan+1);
+	phasor(ichan, irow)=Complex(cos(phase), sin(phase));
+	flag((irow+ichan)%nvispol, ichan, irow)=(irow%5==0) ? 1 : 0;
+      }
+    }
+    // Channel 5 is not on the grid, visibility polarization 3 is not imaged
+    Vector<Int> chanmap(nvischan), polmap(nvispol);
+    for (Int ichan=0; ichan<nvischan; ++ichan) chanmap(ichan)=ichan%nchan;
+    chanmap(5)=-1;
+    polmap(0)=0; polmap(1)=1; polmap(2)=1; polmap(3)=-1;
+
+    Cube<Complex> fortran(nvispol, nvischan, nrow, Complex(-1.0));
+    Cube<Complex> cxx(fortran.copy());
+    const Int rbeg=1, rend=nrow;
+    Timer timer;
+    sectdgrid_(fortran.data(), &nvispol, &nvischan, flag.data(), rflag.data(),
+	       &nrow, grid.data(), &nx, &ny, &npol, &nchan, &support, &sampling,
+	       gridder.cFunction().data(), chanmap.data(), polmap.data(),
+	       &rbeg, &rend, loc.data(), off.data(), phasor.data());
+    cout << "Fortran sectdgrid " << timer.real() << " s" << endl;
+    for (Int nth=1; nth<=4; nth*=2) {
+      cxx=Complex(-1.0);
+      timer.mark();
+      refim::GridFT::degridRows(cxx.data(), nvispol, nvischan, flag.data(),
+				rflag.data(), grid.data(), nx, ny, npol, nchan,
+				support, sampling, gridder.cFunction().data(),
+				chanmap.data(), polmap.data(), 0, nrow-1,
+				loc.data(), off.data(), phasor.data(), nth);
+      cout << "GridFT::degridRows with " << nth << " threads "
+	   << timer.real() << " s, max difference "
+	   << max(amplitude(cxx-fortran)) << endl;
+      // Samples that are not degridded keep their value in both
+      AlwaysAssert(allEQ(cxx==Complex(-1.0), fortran==Complex(-1.0)), AipsError);
+      AlwaysAssert(anyNE(fortran, Complex(-1.0)), AipsError);
+      AlwaysAssert(allNearAbs(cxx, fortran, 1e-4*max(amplitude(fortran))),
+		   AipsError);
+    }
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
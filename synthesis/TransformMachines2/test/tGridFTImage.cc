@@ -0,0 +1,302 @@
+//# tGridFTImage.cc: compare the refim GridFT transforms between grid and
+//# image with the LatticeFFT ones they replaced
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/ArrayLogical.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Arrays/IPosition.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Utilities/Assert.h>
+#include <coordinates/Coordinates/CoordinateSystem.h>
+#include <coordinates/Coordinates/DirectionCoordinate.h>
+#include <coordinates/Coordinates/Projection.h>
+#include <coordinates/Coordinates/SpectralCoordinate.h>
+#include <coordinates/Coordinates/StokesCoordinate.h>
+#include <images/Images/TempImage.h>
+#include <lattices/Lattices/ArrayLattice.h>
+#include <lattices/LatticeMath/LatticeFFT.h>
+#include <measures/Measures/MDirection.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <msvis/MSVis/VisImagingWeight.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <scimath/Mathematics/ConvolveGridder.h>
+#include <synthesis/TransformMachines2/GridFT.h>
+#include <vector>
+
+#include <casa/namespace.h>
+using namespace casa::vi;
+using namespace casa::vi::test;
+
+namespace {
+
+const Double f0 = 1.0e9;
+const Double df = 1.0e6;
+const Int nVisChan = 4;
+
+// Baselines of up to 2 km, about 20 pixels from the centre of the grid
+class GenerateTestUvw : public Generator<Vector<Double> > {
+public:
+  Vector<Double> operator()(const FillState &fillState, Int, Int) const {
+    const Double length = 2000.0*(fillState.antenna2_p - fillState.antenna1_p)
+      / max(fillState.nAntennas_p, 1);
+    const Double angle = 0.7*fillState.antenna1_p + 7.27e-5*fillState.time_p;
+    Vector<Double> result(3);
+    result[0] = length*cos(angle);
+    result[1] = length*sin(angle);
+    result[2] = 0.0;
+    return result;
+  }
+};
+
+// Gives the test access to the grid, the weights and the gridder
+class TestGridFT : public refim::GridFT {
+public:
+  explicit TestGridFT(Bool useDouble)
+    : refim::GridFT(1000000, 16, "SF", 1.2, True, useDouble) {}
+  Array<Complex> &grid() {return griddedData;}
+  Array<DComplex> &grid2() {return griddedData2;}
+  Matrix<Double> &weightSums() {return sumWeight;}
+  ConvolveGridder<Double, Complex> &theGridder() {return *gridder;}
+};
+
+// RR and LL, one channel over the band, cells of 10 arcsec
+CoordinateSystem makeCoords(Int imnx)
+{
+  CoordinateSystem csys;
+  Matrix<Double> xform(2, 2);
+  xform = 0.0;
+  xform.diagonal() = 1.0;
+  csys.addCoordinate(DirectionCoordinate(MDirection::J2000,
+					 Projection(Projection::SIN),
+					 0.0, 0.0, -10.0*C::arcsec, 10.0*C::arcsec,
+					 xform, imnx/2, imnx/2));
+  Vector<Int> stokes(2);
+  stokes(0) = Stokes::RR;
+  stokes(1) = Stokes::LL;
+  csys.addCoordinate(StokesCoordinate(stokes));
+  const Double fc = f0 + 0.5*(nVisChan - 1)*df;
+  csys.addCoordinate(SpectralCoordinate(MFrequency::LSRK, fc, 8.0*df, 0.0, fc));
+  return csys;
+}
+
+// Divide every row of every plane of grid by the gridding correction, and
+// multiply the plane by factor(pol, chan)
+void gridCorrect(Array<Complex> &grid, ConvolveGridder<Double, Complex> &gridder,
+		 const Matrix<Complex> &factor)
+{
+  const IPosition shape = grid.shape();
+  Vector<Complex> correction(shape(0));
+  for (Int chan = 0; chan < shape(3); ++chan) {
+    for (Int pol = 0; pol < shape(2); ++pol) {
+      for (Int y = 0; y < shape(1); ++y) {
+	gridder.correctX1D(correction, y);
+	for (Int x = 0; x < shape(0); ++x) {
+	  IPosition pos(4, x, y, pol, chan);
+	  grid(pos) = (grid(pos)/correction(x))*factor(pol, chan);
+	}
+      }
+    }
+  }
+}
+
+IPosition imageBlc(const IPosition &gridShape, const IPosition &imageShape)
+{
+  const Int nx = gridShape(0);
+  const Int ny = gridShape(1);
+  return IPosition(4, (nx - imageShape(0) + (nx%2 == 0))/2,
+		   (ny - imageShape(1) + (ny%2 == 0))/2, 0, 0);
+}
+
+// The image getImage made before fft2d: LatticeFFT of the whole grid, grid
+// correction and normalization of the whole grid, then the image section
+template <class T>
+Array<Complex> oldImage(const Array<T> &grid, const Matrix<Float> &weights,
+			ConvolveGridder<Double, Complex> &gridder,
+			const IPosition &imageShape)
+{
+  Array<T> work(grid.copy());
+  ArrayLattice<T> lattice(work);
+  LatticeFFT::cfft2d(lattice, False);
+  Array<Complex> cgrid(grid.shape());
+  convertArray(cgrid, lattice.get());
+  const Float nxy = Float(grid.shape()(0))*Float(grid.shape()(1));
+  Matrix<Complex> factor(weights.shape());
+  for (uInt chan = 0; chan < weights.ncolumn(); ++chan) {
+    for (uInt pol = 0; pol < weights.nrow(); ++pol) {
+      factor(pol, chan) = (weights(pol, chan) != 0.0)
+	? Complex(nxy/weights(pol, chan)) : Complex(0.0);
+    }
+  }
+  gridCorrect(cgrid, gridder, factor);
+  const IPosition blc = imageBlc(grid.shape(), imageShape);
+  return cgrid(blc, blc + imageShape - 1).copy();
+}
+
+// The grid prepGridForDegrid made before fft2d: the image in the centre of
+// a zero grid, grid correction of the whole grid, then LatticeFFT
+Array<Complex> oldGrid(const Array<Complex> &model, const IPosition &gridShape,
+		       ConvolveGridder<Double, Complex> &gridder)
+{
+  Array<Complex> grid(gridShape);
+  grid = Complex(0.0);
+  const IPosition blc = imageBlc(gridShape, model.shape());
+  grid(blc, blc + model.shape() - 1) = model;
+  gridCorrect(grid, gridder, Matrix<Complex>(gridShape(2), gridShape(3), Complex(1.0)));
+  ArrayLattice<Complex> lattice(grid);
+  LatticeFFT::cfft2d(lattice, True);
+  return lattice.get();
+}
+
+// Grid all the data, drop the weight of LL so that its plane is blank,
+// and compare getImage with the old transform
+void checkToSky(MeasurementSet &ms, Int imnx, Bool useDouble)
+{
+  TempImage<Complex> image(IPosition(4, imnx, imnx, 2, 1), makeCoords(imnx));
+  TestGridFT ft(useDouble);
+  VisibilityIterator2 vi(ms, SortColumns(), False);
+  vi.useImagingWeight(VisImagingWeight("natural"));
+  VisBuffer2 *vb = vi.getVisBuffer();
+  vi.originChunks();
+  vi.origin();
+  Matrix<Float> weight;
+  ft.initializeToSky(image, weight, *vb);
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next()) {
+      ft.put(*vb);
+    }
+  }
+  ft.finalizeToSky();
+  AlwaysAssert(ft.weightSums()(0, 0) > 0.0, AipsError);
+  ft.weightSums()(1, 0) = 0.0;
+  Matrix<Float> weights(ft.weightSums().shape());
+  convertArray(weights, ft.weightSums());
+
+  Array<Complex> expected;
+  if (useDouble) {
+    expected = oldImage(ft.grid2(), weights, ft.theGridder(), image.shape());
+  } else {
+    expected = oldImage(ft.grid(), weights, ft.theGridder(), image.shape());
+  }
+  ft.getImage(weight, True);
+  const Array<Complex> got = image.get();
+  const Float scale = max(amplitude(expected));
+  cout << "toSky " << imnx << (useDouble ? " double" : " single")
+       << " max difference " << max(amplitude(got - expected))/scale << endl;
+  AlwaysAssert(scale > 0.0, AipsError);
+  AlwaysAssert(allNearAbs(got, expected, 1e-5*scale), AipsError);
+  // The plane with no weight is blank
+  AlwaysAssert(allEQ(got(IPosition(4, 0, 0, 1, 0), IPosition(4, imnx-1, imnx-1, 1, 0)),
+		     Complex(0.0)), AipsError);
+}
+
+// Compare the grid of initializeToVis with the old one, and the model
+// visibilities get degrids from the two
+void checkToVis(MeasurementSet &ms, Int imnx)
+{
+  TempImage<Complex> image(IPosition(4, imnx, imnx, 2, 1), makeCoords(imnx));
+  image.set(Complex(0.0));
+  image.putAt(Complex(1.0), IPosition(4, imnx/2, imnx/2, 0, 0));
+  image.putAt(Complex(1.0), IPosition(4, imnx/2, imnx/2, 1, 0));
+  image.putAt(Complex(0.5), IPosition(4, imnx/2 + 7, imnx/2 - 4, 0, 0));
+  image.putAt(Complex(0.3, 0.1), IPosition(4, 2, imnx - 3, 1, 0));
+  const Array<Complex> model = image.get();
+
+  TestGridFT ft(False);
+  VisibilityIterator2 vi(ms, SortColumns(), False);
+  VisBuffer2 *vb = vi.getVisBuffer();
+  vi.originChunks();
+  vi.origin();
+  ft.initializeToVis(image, *vb);
+  const Array<Complex> expected = oldGrid(model, ft.grid().shape(), ft.theGridder());
+  const Float scale = max(amplitude(expected));
+  cout << "toVis " << imnx << " grid max difference "
+       << max(amplitude(ft.grid() - expected))/scale << endl;
+  AlwaysAssert(allNearAbs(ft.grid(), expected, 1e-5*scale), AipsError);
+
+  std::vector<Cube<Complex> > got;
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next()) {
+      ft.get(*vb);
+      got.push_back(vb->visCubeModel().copy());
+    }
+  }
+  ft.grid() = expected;
+  uInt k = 0;
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next(), ++k) {
+      ft.get(*vb);
+      const Cube<Complex> &old = vb->visCubeModel();
+      AlwaysAssert(allNearAbs(got[k], old, 1e-5*max(amplitude(old))), AipsError);
+    }
+  }
+  AlwaysAssert(k == got.size() && k > 0, AipsError);
+  ft.finalizeToVis();
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const String msName("tGridFTImage.ms");
+    {
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(0, 20.0, 1.0);
+      msFactory.addAntennas(7);
+      msFactory.addFeeds(7);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", nVisChan, f0, df, "RR LL");
+      msFactory.setDataGenerator(MSMainEnums::UVW, new GenerateTestUvw);
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+    MeasurementSet ms(msName);
+
+    // Even and odd images, so that the image sits at different offsets in
+    // the padded grid
+    checkToSky(ms, 50, False);
+    checkToSky(ms, 45, False);
+    checkToSky(ms, 50, True);
+    checkToVis(ms, 50);
+    checkToVis(ms, 45);
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,217 @@
+//# tModelVisCache.cc: check that virtual model predictions are served from the
+//# process-wide model visibility cache and dropped when the model changes
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/Containers/Record.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/Directory.h>
+#include <casa/Quanta/Quantum.h>
+#include <casa/Utilities/Assert.h>
+#include <components/ComponentModels/ComponentList.h>
+#include <components/ComponentModels/ConstantSpectrum.h>
+#include <components/ComponentModels/Flux.h>
+#include <components/ComponentModels/PointShape.h>
+#include <components/ComponentModels/SkyComponent.h>
+#include <measures/Measures/MDirection.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <synthesis/TransformMachines/ModelVisCache.h>
+#include <synthesis/TransformMachines2/VisModelData.h>
+#include <tables/Tables/ExprNode.h>
+#include <vector>
+
+#include <casa/namespace.h>
+using namespace casa::vi;
+using namespace casa::vi::test;
+
+namespace {
+
+const Int nChan = 8;
+
+// Baselines of up to 1 km, so that the offset source gives a phase gradient
+class GenerateTestUvw : public Generator<Vector<Double> > {
+public:
+  Vector<Double> operator()(const FillState &fillState, Int, Int) const {
+    const Double length = 1000.0*(fillState.antenna2_p - fillState.antenna1_p)
+      / max(fillState.nAntennas_p, 1);
+    const Double angle = 0.5*fillState.antenna1_p + 7.27e-5*fillState.time_p;
+    Vector<Double> result(3);
+    result[0] = length*cos(angle);
+    result[1] = length*sin(angle);
+    result[2] = 0.0;
+    return result;
+  }
+};
+
+// Write a point source of the given flux as the virtual model of field 0
+void putPointModel(MeasurementSet& ms, Double flux)
+{
+  ComponentList compList;
+  compList.add(SkyComponent(Flux<Double>(flux),
+			    PointShape(MDirection(Quantity(20.0, "arcsec"),
+						  Quantity(-10.0, "arcsec"),
+						  MDirection::J2000)),
+			    ConstantSpectrum()));
+  Record rec;
+  String err;
+  AlwaysAssert(compList.toRecord(err, rec), AipsError);
+  refim::VisModelData::putModel(ms, rec, Vector<Int>(1, 0), Vector<Int>(1, 0),
+				Vector<Int>(1, 0), Vector<Int>(1, nChan),
+				Vector<Int>(1, 1), True, False);
+}
+
+// Read the model of every buffer with a new iterator, and so a new
+// VisModelData, each time
+void predict(MeasurementSet& ms, std::vector<Cube<Complex> >& models)
+{
+  models.clear();
+  VisibilityIterator2 vi(ms, SortColumns(), False);
+  VisBuffer2 *vb = vi.getVisBuffer();
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next()) {
+      models.push_back(vb->visCubeModel().copy());
+    }
+  }
+}
+
+void checkCounts(Int64 hits, Int64 misses)
+{
+  Int64 nhits, nmisses;
+  ModelVisCache::statistics(nhits, nmisses);
+  AlwaysAssert(nhits == hits && nmisses == misses, AipsError);
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const String msName("tModelVisCache.ms");
+    {
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(0, 10.0, 1.0);
+      msFactory.addAntennas(5);
+      msFactory.addFeeds(5);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", nChan, 1.0e9, 1.0e6, "RR LL");
+      msFactory.setDataGenerator(MSMainEnums::UVW, new GenerateTestUvw);
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+    MeasurementSet ms(msName, Table::Update);
+    putPointModel(ms, 1.0);
+
+    // In memory: the second prediction is a hit with the same values
+    refim::VisModelData().setModelCache(Int64(64)*1024*1024);
+    ModelVisCache::resetStatistics();
+    std::vector<Cube<Complex> > first, second;
+    predict(ms, first);
+    const Int64 nbuf = first.size();
+    AlwaysAssert(nbuf > 0, AipsError);
+    checkCounts(0, nbuf);
+    predict(ms, second);
+    checkCounts(nbuf, nbuf);
+    for (uInt k = 0; k < first.size(); ++k) {
+      AlwaysAssert(allEQ(first[k], second[k]), AipsError);
+    }
+
+    // A new model misses and is predicted again
+    putPointModel(ms, 2.0);
+    std::vector<Cube<Complex> > doubled;
+    predict(ms, doubled);
+    checkCounts(nbuf, 2*nbuf);
+    for (uInt k = 0; k < first.size(); ++k) {
+      AlwaysAssert(allNearAbs(doubled[k], Complex(2.0)*first[k], 1.0e-5), AipsError);
+    }
+
+    // On disk, in a directory set with setModelCache: putModel has to remove
+    // the predictions of the old model from it
+    Directory cacheDir("tModelVisCache.cache");
+    cacheDir.create(True);
+    refim::VisModelData().setModelCache(0, cacheDir.path().absoluteName());
+    ModelVisCache::resetStatistics();
+    predict(ms, second);
+    checkCounts(0, nbuf);
+    AlwaysAssert(cacheDir.nEntries() == uInt(nbuf), AipsError);
+    predict(ms, second);
+    checkCounts(nbuf, nbuf);
+    for (uInt k = 0; k < doubled.size(); ++k) {
+      AlwaysAssert(allEQ(doubled[k], second[k]), AipsError);
+    }
+    putPointModel(ms, 1.0);
+    AlwaysAssert(cacheDir.nEntries() == 0, AipsError);
+    predict(ms, second);
+    checkCounts(nbuf, 2*nbuf);
+    for (uInt k = 0; k < first.size(); ++k) {
+      AlwaysAssert(allNearAbs(first[k], second[k], 1.0e-5), AipsError);
+    }
+
+    // Two selections whose buffers have the same rows within the selection,
+    // times, field, spw and channels: each must get its own prediction
+    MeasurementSet high(ms(ms.col("ANTENNA1") >= 2));
+    MeasurementSet low(ms(ms.col("ANTENNA2") <= 2));
+    AlwaysAssert(high.nrow() > 0 && high.nrow() == low.nrow(), AipsError);
+    refim::VisModelData().setModelCache(0, "");
+    std::vector<Cube<Complex> > highUncached, lowUncached, highCached, lowCached;
+    predict(high, highUncached);
+    predict(low, lowUncached);
+    AlwaysAssert(highUncached.size() == lowUncached.size(), AipsError);
+    AlwaysAssert(!allNearAbs(highUncached[0], lowUncached[0], 1.0e-3), AipsError);
+    refim::VisModelData().setModelCache(Int64(64)*1024*1024);
+    ModelVisCache::resetStatistics();
+    predict(high, highCached);
+    predict(low, lowCached);
+    checkCounts(0, highUncached.size() + lowUncached.size());
+    AlwaysAssert(highCached.size() == highUncached.size(), AipsError);
+    AlwaysAssert(lowCached.size() == lowUncached.size(), AipsError);
+    for (uInt k = 0; k < highCached.size(); ++k) {
+      AlwaysAssert(allNearAbs(highCached[k], highUncached[k], 1.0e-5), AipsError);
+      AlwaysAssert(allNearAbs(lowCached[k], lowUncached[k], 1.0e-5), AipsError);
+    }
+    // and find it again after the other selection was read
+    predict(high, highCached);
+    checkCounts(highUncached.size(), highUncached.size() + lowUncached.size());
+    for (uInt k = 0; k < highCached.size(); ++k) {
+      AlwaysAssert(allNearAbs(highCached[k], highUncached[k], 1.0e-5), AipsError);
+    }
+    refim::VisModelData().setModelCache(0, "");
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
@@ -0,0 +1,155 @@
+//# tSimpleComponentFTMachine.cc: compare the batched ComponentList prediction
+//# of the refim SimpleComponentFTMachine with the per-component one
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Cube.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/Quanta/Quantum.h>
+#include <casa/Utilities/Assert.h>
+#include <components/ComponentModels/ComponentList.h>
+#include <components/ComponentModels/ConstantSpectrum.h>
+#include <components/ComponentModels/Flux.h>
+#include <components/ComponentModels/GaussianShape.h>
+#include <components/ComponentModels/PointShape.h>
+#include <components/ComponentModels/SkyComponent.h>
+#include <components/ComponentModels/SpectralIndex.h>
+#include <measures/Measures/MDirection.h>
+#include <measures/Measures/MFrequency.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <synthesis/TransformMachines2/SimpleComponentFTMachine.h>
+
+#include <casa/namespace.h>
+using namespace casa::vi;
+using namespace casa::vi::test;
+
+namespace {
+
+// Baselines of up to 2 km, so that the Gaussians are partly resolved
+class GenerateTestUvw : public Generator<Vector<Double> > {
+public:
+  Vector<Double> operator()(const FillState &fillState, Int, Int) const {
+    const Double length = 2000.0*(fillState.antenna2_p - fillState.antenna1_p)
+      / max(fillState.nAntennas_p, 1);
+    const Double angle = 0.7*fillState.antenna1_p + 7.27e-5*fillState.time_p;
+    Vector<Double> result(3);
+    result[0] = length*cos(angle);
+    result[1] = length*sin(angle);
+    result[2] = 0.1*length;
+    return result;
+  }
+};
+
+MDirection offsetDirection(Double dra, Double ddec)
+{
+  return MDirection(Quantity(dra, "arcsec"), Quantity(ddec, "arcsec"),
+		    MDirection::J2000);
+}
+
+} // anonymous namespace
+
+int main()
+{
+  try {
+    const String msName("tSimpleComponentFTMachine.ms");
+    const Double f0 = 1.0e9;
+    const Double df = 20.0e6;
+    {
+      MsFactory msFactory(msName);
+      msFactory.setTimeInfo(0, 20.0, 1.0);
+      msFactory.addAntennas(7);
+      msFactory.addFeeds(7);
+      msFactory.addField("field0", MDirection());
+      msFactory.addSpectralWindow("spw0", 16, f0, df, "RR RL LR LL");
+      msFactory.setDataGenerator(MSMainEnums::UVW, new GenerateTestUvw);
+      pair<MeasurementSet *, Int> made = msFactory.createMs();
+      made.first->flush();
+      delete made.first;
+    }
+
+    // Points and Gaussians, with constant spectra and spectral indices
+    const MFrequency refFreq(Quantity(f0, "Hz"), MFrequency::LSRK);
+    ComponentList compList;
+    compList.add(SkyComponent(Flux<Double>(2.0), PointShape(offsetDirection(0.0, 0.0)),
+			      ConstantSpectrum()));
+    compList.add(SkyComponent(Flux<Double>(1.0, 0.2, -0.1, 0.05),
+			      PointShape(offsetDirection(30.0, -20.0)),
+			      SpectralIndex(refFreq, -0.7)));
+    compList.add(SkyComponent(Flux<Double>(0.5),
+			      GaussianShape(offsetDirection(-45.0, 10.0),
+					    Quantity(8.0, "arcsec"),
+					    Quantity(4.0, "arcsec"),
+					    Quantity(30.0, "deg")),
+			      ConstantSpectrum()));
+    compList.add(SkyComponent(Flux<Double>(0.8, 0.0, 0.1, 0.0),
+			      GaussianShape(offsetDirection(15.0, 60.0),
+					    Quantity(5.0, "arcsec"),
+					    Quantity(5.0, "arcsec"),
+					    Quantity(0.0, "deg")),
+			      SpectralIndex(refFreq, 1.5)));
+
+    MeasurementSet ms(msName, Table::Update);
+    VisibilityIterator2 vi(ms, SortColumns(), True);
+    VisBuffer2 *vb = vi.getVisBuffer();
+    refim::SimpleComponentFTMachine cft;
+
+    uInt nbuffers = 0;
+    for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+      for (vi.origin(); vi.more(); vi.next()) {
+	// The old path: one component at a time, summed
+	Cube<Complex> expected(vb->visCubeModel().shape(), Complex(0.0));
+	for (uInt k = 0; k < compList.nelements(); ++k) {
+	  SkyComponent comp = compList.component(k).copy();
+	  cft.get(*vb, comp);
+	  expected += vb->visCubeModel();
+	}
+
+	// The batched path
+	cft.get(*vb, compList);
+	const Cube<Complex> batched = vb->visCubeModel().copy();
+
+	const Float tol = 1.0e-5*max(amplitude(expected));
+	AlwaysAssert(max(amplitude(batched - expected)) < tol, AipsError);
+	++nbuffers;
+      }
+    }
+    AlwaysAssert(nbuffers > 0, AipsError);
+  } catch (AipsError x) {
+    cout << "Caught exception " << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}
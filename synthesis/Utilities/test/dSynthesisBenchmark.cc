@@ -0,0 +1,348 @@
+//# dSynthesisBenchmark.cc: time the visibility iterators, gridders and cleaners
+//# Copyright (C) 2016
+//# Associated Universities, Inc. Washington DC, USA.
+//#
+//# This program is free software; you can redistribute it and/or modify it
+//# under the terms of the GNU General Public License as published by the Free
+//# Software Foundation; either version 2 of the License, or (at your option)
+//# any later version.
+//#
+//# This program is distributed in the hope that it will be useful, but WITHOUT
+//# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+//# FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General Public License for
+//# more details.
+//#
+//# You should have received a copy of the GNU General Public License along
+//# with this program; if not, write to the Free Software Foundation, Inc.,
+//# 675 Massachusetts Ave, Cambridge, MA 02139, USA.
+//#
+//# Correspondence concerning AIPS++ should be addressed as follows:
+//#        Internet email: aips2-request@nrao.edu.
+//#        Postal address: AIPS++ Project Office
+//#                        National Radio Astronomy Observatory
+//#                        520 Edgemont Road
+//#                        Charlottesville, VA 22903-2475 USA
+//#
+//# $Id$
+
+// Usage: dSynthesisBenchmark [nant [nchan [ntimes [nspw [outfile]]]]]
+//
+// Builds a synthetic MeasurementSet with MsFactory (nant antennas, nspw
+// spectral windows of nchan channels and ntimes integrations) and times the
+// hot paths that read it: a plain VisibilityIterator2 sweep, time averaging
+// with AveragingTvi2, channel averaging through MSTransform, on-the-fly
+// calibration with CalibratingVi2, GridFT gridding and degridding and a
+// multi-scale MatrixCleaner minor cycle.  A line per benchmark is printed
+// with the throughput; if outfile is given the results are also written
+// to it as comma-separated values, one row per benchmark, so that runs of
+// different builds can be compared.  Without arguments a small dataset is
+// used so that it can run as a test; e.g.
+// "dSynthesisBenchmark 27 256 600 4 bench.csv" times a representative one.
+
+#include <casa/aips.h>
+#include <casa/iostream.h>
+#include <casa/fstream.h>
+#include <casa/stdlib.h>
+#include <casa/Arrays/ArrayMath.h>
+#include <casa/Arrays/Matrix.h>
+#include <casa/BasicSL/Constants.h>
+#include <casa/Containers/Record.h>
+#include <casa/Exceptions/Error.h>
+#include <casa/OS/Timer.h>
+#include <casa/Quanta/Quantum.h>
+#include <casa/Utilities/Assert.h>
+#include <coordinates/Coordinates/CoordinateSystem.h>
+#include <coordinates/Coordinates/DirectionCoordinate.h>
+#include <coordinates/Coordinates/SpectralCoordinate.h>
+#include <coordinates/Coordinates/StokesCoordinate.h>
+#include <images/Images/TempImage.h>
+#include <ms/MeasurementSets/MeasurementSet.h>
+#include <tables/Tables/Table.h>
+#include <msvis/MSVis/AveragingVi2Factory.h>
+#include <msvis/MSVis/IteratingParameters.h>
+#include <msvis/MSVis/VisBuffer2.h>
+#include <msvis/MSVis/VisImagingWeight.h>
+#include <msvis/MSVis/VisibilityIterator2.h>
+#include <msvis/MSVis/test/MsFactory.h>
+#include <mstransform/MSTransform/MSTransformIteratorFactory.h>
+#include <synthesis/MeasurementComponents/CalibratingVi2.h>
+#include <synthesis/MeasurementComponents/CalibratingVi2Factory.h>
+#include <synthesis/MeasurementEquations/MatrixCleaner.h>
+#include <synthesis/TransformMachines2/GridFT.h>
+
+#include <vector>
+
+#include <casa/namespace.h>
+using namespace casa::vi;
+using namespace casa::vi::test;
+
+namespace {
+
+// Baselines of up to 1 km rotating with the earth, so that the uv coverage
+// stays on a fixed grid whatever the size of the dataset
+class GenerateBenchmarkUvw : public Generator<Vector<Double> > {
+public:
+  Vector<Double> operator()(const FillState &fillState, Int, Int) const {
+    const Double length = 1000.0*(fillState.antenna2_p - fillState.antenna1_p)
+      / max(fillState.nAntennas_p, 1);
+    const Double angle = 0.3*fillState.antenna1_p + 7.27e-5*fillState.time_p;
+    Vector<Double> result(3, 0.0);
+    result[0] = length*cos(angle);
+    result[1] = length*sin(angle);
+    return result;
+  }
+};
+
+struct BenchmarkResult {
+  String name;
+  Double items;
+  String unit;
+  Double bytes;
+  Double seconds;
+};
+
+void report(std::vector<BenchmarkResult> &results, const String &name,
+	    Double items, const String &unit, Double bytes, Double seconds)
+{
+  BenchmarkResult result;
+  result.name = name;
+  result.items = items;
+  result.unit = unit;
+  result.bytes = bytes;
+  result.seconds = max(seconds, 1e-9);
+  results.push_back(result);
+  cout << name << ": " << items << " " << unit << " in " << seconds << " s, "
+       << items/result.seconds << " " << unit << "/s, "
+       << bytes/result.seconds/1e6 << " MB/s" << endl;
+}
+
+// Read the data of every buffer of vi; returns the number of visibilities
+Double sweep(VisibilityIterator2 &vi, Bool corrected)
+{
+  VisBuffer2 *vb = vi.getVisBuffer();
+  Double nvis = 0;
+  for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+    for (vi.origin(); vi.more(); vi.next()) {
+      const Cube<Complex> &vis = corrected ? vb->visCubeCorrected()
+					   : vb->visCube();
+      nvis += vis.nelements();
+    }
+  }
+  return nvis;
+}
+
+// A single-plane Stokes I image covering every spectral window
+CoordinateSystem imageCoordinates(Int npix, Double cell, Double fcenter,
+				  Double bandwidth)
+{
+  CoordinateSystem csys;
+  Matrix<Double> xform(2, 2);
+  xform = 0.0;
+  xform.diagonal() = 1.0;
+  DirectionCoordinate dir(MDirection::J2000, Projection(Projection::SIN),
+			  0.0, 0.0, -cell, cell, xform, npix/2, npix/2);
+  csys.addCoordinate(dir);
+  csys.addCoordinate(StokesCoordinate(Vector<Int>(1, Stokes::I)));
+  csys.addCoordinate(SpectralCoordinate(MFrequency::TOPO, fcenter,
+					bandwidth*1.01, 0.0, fcenter));
+  return csys;
+}
+
+} // anonymous namespace
+
+int main(int argc, char **argv)
+{
+  const String msName("dSynthesisBenchmark.ms");
+  try {
+    Int nant = 6;
+    Int nchan = 16;
+    Int ntimes = 20;
+    Int nspw = 2;
+    String outfile;
+    if (argc > 1) nant = atoi(argv[1]);
+    if (argc > 2) nchan = atoi(argv[2]);
+    if (argc > 3) ntimes = atoi(argv[3]);
+    if (argc > 4) nspw = atoi(argv[4]);
+    if (argc > 5) outfile = argv[5];
+    const Double interval = 1.0;
+    const Double f0 = 1.0e9;
+    const Double df = 1.0e6;
+    const Int chanbin = max(nchan/4, 1);
+    const Int npix = 256;
+    const Double cell = 10.0*C::arcsec;
+
+    std::vector<BenchmarkResult> results;
+    Timer timer;
+
+    timer.mark();
+    MsFactory msFactory(msName);
+    msFactory.setTimeInfo(0, ntimes*interval, interval);
+    msFactory.addAntennas(nant);
+    msFactory.addFeeds(nant);
+    msFactory.addField("field0", MDirection());
+    for (Int spw = 0; spw < nspw; spw++) {
+      msFactory.addSpectralWindow(String::format("spw%d", spw), nchan,
+				  f0 + spw*nchan*df, df, "RR LL");
+    }
+    msFactory.setDataGenerator(MSMainEnums::UVW, new GenerateBenchmarkUvw);
+    pair<MeasurementSet *, Int> made = msFactory.createMs();
+    MeasurementSet ms(*made.first);
+    delete made.first;
+    ms.flush();
+    const Double nvisMs = Double(ms.nrow())*nchan*2;
+    report(results, "create_ms", ms.nrow(), "rows", nvisMs*sizeof(Complex),
+	   timer.real());
+
+    {
+      VisibilityIterator2 vi(ms);
+      timer.mark();
+      const Double nvis = sweep(vi, False);
+      report(results, "vi2_sweep", nvis, "vis", nvis*sizeof(Complex),
+	     timer.real());
+    }
+
+    {
+      AveragingParameters parameters(4*interval, 0.0, SortColumns(),
+				     AveragingOptions(AveragingOptions::AverageObserved |
+						      AveragingOptions::ObservedFlagAvg));
+      VisibilityIterator2 vi(AveragingVi2Factory(parameters, &ms));
+      vi.setWeightScaling(WeightScaling::generateUnityWeightScaling());
+      timer.mark();
+      sweep(vi, False);
+      report(results, "averaging_tvi2", nvisMs, "vis", nvisMs*sizeof(Complex),
+	     timer.real());
+    }
+
+    {
+      Record config;
+      config.define("inputms", msName);
+      config.define("datacolumn", "DATA");
+      config.define("chanaverage", True);
+      config.define("chanbin", chanbin);
+      timer.mark();
+      MSTransformIteratorFactory factory(config);
+      VisibilityIterator2 vi(factory);
+      sweep(vi, False);
+      report(results, "mstransform_chanavg", nvisMs, "vis",
+	     nvisMs*sizeof(Complex), timer.real());
+    }
+
+    {
+      IteratingParameters iterpar(0.0, SortColumns());
+      CalibratingParameters calpar(10.0f);
+      CalibratingVi2Factory factory(&ms, calpar, iterpar);
+      VisibilityIterator2 vi(factory);
+      timer.mark();
+      const Double nvis = sweep(vi, True);
+      report(results, "calibrating_vi2", nvis, "vis", nvis*sizeof(Complex),
+	     timer.real());
+    }
+
+    {
+      const CoordinateSystem csys =
+	imageCoordinates(npix, cell, f0 + (nspw*nchan - 1)*df/2, nspw*nchan*df);
+      const IPosition shape(4, npix, npix, 1, 1);
+      VisibilityIterator2 vi(ms, SortColumns(), True);
+      vi.useImagingWeight(VisImagingWeight("natural"));
+      VisBuffer2 *vb = vi.getVisBuffer();
+
+      TempImage<Complex> image(shape, csys);
+      image.set(Complex(0.0));
+      Matrix<Float> weight;
+      refim::GridFT gridder(1000000, 16, "SF", 1.0, False);
+      vi.originChunks();
+      vi.origin();
+      gridder.initializeToSky(image, weight, *vb);
+      timer.mark();
+      Double nvis = 0;
+      for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+	for (vi.origin(); vi.more(); vi.next()) {
+	  gridder.put(*vb);
+	  nvis += Double(vb->nRows())*vb->nChannels()*vb->nCorrelations();
+	}
+      }
+      gridder.finalizeToSky();
+      gridder.getImage(weight, True);
+      report(results, "gridft_put", nvis, "vis", nvis*sizeof(Complex),
+	     timer.real());
+
+      TempImage<Complex> model(shape, csys);
+      model.set(Complex(0.0));
+      model.putAt(Complex(1.0), IPosition(4, npix/2 + 5, npix/2 - 3, 0, 0));
+      refim::GridFT degridder(1000000, 16, "SF", 1.0, False);
+      vi.originChunks();
+      vi.origin();
+      degridder.initializeToVis(model, *vb);
+      timer.mark();
+      nvis = 0;
+      for (vi.originChunks(); vi.moreChunks(); vi.nextChunk()) {
+	for (vi.origin(); vi.more(); vi.next()) {
+	  degridder.get(*vb);
+	  nvis += Double(vb->nRows())*vb->nChannels()*vb->nCorrelations();
+	}
+      }
+      degridder.finalizeToVis();
+      report(results, "gridft_get", nvis, "vis", nvis*sizeof(Complex),
+	     timer.real());
+    }
+
+    {
+      // Gaussian psf and a few extended sources
+      Matrix<Float> psf(npix, npix), dirty(npix, npix, 0.0);
+      for (Int j = 0; j < npix; j++) {
+	for (Int i = 0; i < npix; i++) {
+	  const Double r2 = square(i - npix/2) + square(j - npix/2);
+	  psf(i, j) = exp(-0.5*r2/9.0);
+	  for (Int s = 0; s < 3; s++) {
+	    const Double d2 = square(i - npix/4 - 40*s) + square(j - npix/3 - 25*s);
+	    dirty(i, j) += (1.0 + s)*exp(-0.5*d2/(25.0*(1 + s)));
+	  }
+	}
+      }
+      Vector<Float> scales(3);
+      scales[0] = 0.0;
+      scales[1] = 3.0;
+      scales[2] = 10.0;
+      const Int niter = 100;
+      timer.mark();
+      MatrixCleaner cleaner;
+      cleaner.defineScales(scales);
+      cleaner.setPsf(psf);
+      cleaner.makePsfScales();
+      cleaner.setDirty(dirty);
+      cleaner.makeDirtyScales();
+      cleaner.setcontrol(CleanEnums::MULTISCALE, niter, 0.1, Quantity(0.0, "Jy"));
+      cleaner.ignoreCenterBox(True);
+      Matrix<Float> model(npix, npix, 0.0);
+      cleaner.clean(model);
+      // Each iteration updates the residual of every scale
+      const Double niterDone = cleaner.numberIterations();
+      report(results, "matrixcleaner", niterDone, "iterations",
+	     niterDone*npix*npix*scales.nelements()*sizeof(Float), timer.real());
+      AlwaysAssert(cleaner.numberIterations() > 0, AipsError);
+    }
+
+    if (!outfile.empty()) {
+      ofstream csv(outfile.c_str());
+      AlwaysAssert(csv, AipsError);
+      csv << "benchmark,nant,nchan,ntimes,nspw,items,unit,seconds,"
+	  << "items_per_s,mb_per_s" << endl;
+      for (uInt i = 0; i < results.size(); i++) {
+	const BenchmarkResult &r = results[i];
+	csv << r.name << "," << nant << "," << nchan << "," << ntimes << ","
+	    << nspw << "," << r.items << "," << r.unit << "," << r.seconds
+	    << "," << r.items/r.seconds << "," << r.bytes/r.seconds/1e6 << endl;
+      }
+    }
+
+    ms = MeasurementSet();
+    Table::deleteTable(msName);
+  }
+  catch (AipsError x) {
+    cerr << x.getMesg() << endl;
+    cout << "FAIL" << endl;
+    return 1;
+  }
+  cout << "OK" << endl;
+  return 0;
+}